@@ -75,8 +75,7 @@ void HttpCache::handleResponse(HttpResponse &response, HttpRequest request) {
   }
 
   // Check HTTP verb
-  switch (http::http_info::http_verbs.at(
-      std::string(request.method, request.method_len))) {
+  switch (request.getRequestMethod()) {
     case http::REQUEST_METHOD::GET:
       addResponse(response, request);
       break;
@@ -142,9 +141,8 @@ st::STORAGE_TYPE HttpCache::getStorageType(HttpResponse response) {
 }
 // Destructor free pattern and stop storage
 HttpCache::~HttpCache() {
-  // Free cache pattern
+  // the cache pattern belongs to the service config
   if (cache_pattern != nullptr) {
-    regfree(cache_pattern);
     cache_pattern = nullptr;
     ram_storage->stopCacheStorage();
     disk_storage->stopCacheStorage();
@@ -153,13 +151,13 @@ HttpCache::~HttpCache() {
 }
 
 // Init cache storage and set needed parameters
-void HttpCache::cacheInit(regex_t *pattern, const int timeout,
+void HttpCache::cacheInit(RegexPattern *pattern, const int timeout,
                           const std::string &svc, long storage_size,
                           int storage_threshold, const std::string &f_name,
                           const std::string &cache_ram_mpoint,
                           const std::string &cache_disk_mpoint) {
   if (pattern != nullptr) {
-    if (pattern->re_pcre != nullptr) {
+    if (pattern->isCompiled()) {
       this->cache_pattern = pattern;
       this->cache_timeout = timeout;
       this->service_name = svc;
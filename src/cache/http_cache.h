@@ -51,7 +51,7 @@ class HttpCache {
   RamICacheStorage *ram_storage;
   DiskICacheStorage *disk_storage;
   unordered_map<size_t, cache_commons::CacheObject *> cache;  // Caching map
-  regex_t *cache_pattern = nullptr;
+  RegexPattern *cache_pattern = nullptr;
   std::string ramfs_mount_point = "/tmp/cache_ramfs";
   std::string disk_mount_point = "/tmp/cache_disk";
   void addResponse(HttpResponse &response, HttpRequest request);
@@ -67,8 +67,8 @@ class HttpCache {
   /**
    * @brief cacheInit Initialize the cache manager configuring its pattern and
    * the timeout it also get the ram storage manager and disk storage manager,
-   * @param pattern is the pointer to the regex_t configured in the service,
-   * checks its re_pcre field to decide on enabling the cache or not
+   * @param pattern is the pointer to the RegexPattern configured in the service,
+   * checks whether it is compiled to decide on enabling the cache or not
    * @param timeout is the timeout value read from the configuration file
    * @param svc is the service name
    * @param storage_size is the ram storage max size
@@ -76,7 +76,7 @@ class HttpCache {
    * ram or by disk
    * @param f_name is the farm name, used to determine the mount point
    */
-  void cacheInit(regex_t *pattern, const int timeout, const std::string &svc,
+  void cacheInit(RegexPattern *pattern, const int timeout, const std::string &svc,
                  long storage_size, int storage_threshold,
                  const std::string &f_name, const std::string &cache_ram_mpoint,
                  const std::string &cache_disk_mpoint);
@@ -115,9 +115,9 @@ class HttpCache {
   /**
    * @brief returns the pattern used by the cache manager
    *
-   * @return returns the regex_t that is being used by the cache manager
+   * @return returns the RegexPattern that is being used by the cache manager
    */
-  regex_t *getCachePattern() { return cache_pattern; }
+  RegexPattern *getCachePattern() { return cache_pattern; }
   /**
    * @brief append data to a already stored response, in the case of a response
    * in multiple packets
@@ -33,9 +33,13 @@
 #undef NULL
 #undef SYSLOG_NAMES
 #include "../debug/logger.h"
+#include "../service/service_index.h"
+#include "../ssl/ssl_client_session.h"
 #include "../util/network.h"
 #include "config.h"
 #include "regex_manager.h"
+#include <algorithm>
+#include <vector>
 
 #ifdef WAF_ENABLED
 #include <modsecurity/rules.h>
@@ -87,6 +91,19 @@ void Config::parse_file() {
       daemonize = atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::Threads, lin, 4, matches, 0)) {
       numthreads = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::EventEngine, lin, 4, matches, 0)) {
+      use_io_uring = (lin[matches[1].rm_so] | 0x20) == 'i';
+    } else if (!regexec(&regex_set::EdgeTriggered, lin, 4, matches, 0)) {
+      edge_triggered = lin[matches[1].rm_so] == '1';
+    } else if (!regexec(&regex_set::ZeroCopy, lin, 4, matches, 0)) {
+      zero_copy = lin[matches[1].rm_so] == '1';
+    } else if (!regexec(&regex_set::HandshakeThreads, lin, 4, matches, 0)) {
+      handshake_threads = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::BackendKeepAlive, lin, 4, matches, 0)) {
+      backend_pool_size = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::BackendKeepAliveTimeout, lin, 4, matches,
+                        0)) {
+      backend_pool_timeout = atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::ThreadModel, lin, 4, matches,
                         0)) {  // ignore
       // threadpool = ((lin[matches[1].rm_so] | 0x20) == 'p'); /* 'pool' */ //
@@ -242,6 +259,12 @@ bool Config::init(const global::StartOptions &start_options) {
 
   DHCustom_params = nullptr;
   numthreads = 0;
+  use_io_uring = false;
+  edge_triggered = false;
+  zero_copy = false;
+  handshake_threads = 0;
+  backend_pool_size = 0;
+  backend_pool_timeout = 4;
   alive_to = 30;
   daemonize = 1;
   grace = 30;
@@ -308,7 +331,7 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTP() {
 #endif
 
   res->ssl_forward_sni_server_name = false;
-  if (regcomp(&res->verb, xhttp[0], REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+  if (!res->verb.compile(xhttp[0], REG_ICASE | REG_NEWLINE | REG_EXTENDED))
     conf_err("xHTTP bad default pattern - aborted");
   has_addr = has_port = 0;
   while (conf_fgets(lin, MAXBUF)) {
@@ -339,16 +362,16 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTP() {
       int n;
 
       n = atoi(lin + matches[1].rm_so);
-      regfree(&res->verb);
-      if (regcomp(&res->verb, xhttp[n], REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!res->verb.compile(xhttp[n], REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("xHTTP bad pattern - aborted");
     } else if (!regexec(&regex_set::Client, lin, 4, matches, 0)) {
       res->to = atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::CheckURL, lin, 4, matches, 0)) {
       if (res->has_pat) conf_err("CheckURL multiple pattern - aborted");
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&res->url_pat, lin + matches[1].rm_so,
-                  REG_NEWLINE | REG_EXTENDED | (ignore_case ? REG_ICASE : 0)))
+      if (!res->url_pat.compile(lin + matches[1].rm_so,
+                                REG_NEWLINE | REG_EXTENDED |
+                                    (ignore_case ? REG_ICASE : 0)))
         conf_err("CheckURL bad pattern - aborted");
       res->has_pat = 1;
     } else if (!regexec(&regex_set::Err414, lin, 4, matches, 0)) {
@@ -366,20 +389,8 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTP() {
     } else if (!regexec(&regex_set::MaxRequest, lin, 4, matches, 0)) {
       res->max_req = atoll(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::HeadRemove, lin, 4, matches, 0)) {
-      if (res->head_off) {
-        for (m = res->head_off; m->next; m = m->next)
-          ;
-        if ((m->next = new MATCHER()) == nullptr)
-          conf_err("HeadRemove config: out of memory - aborted");
-        m = m->next;
-      } else {
-        res->head_off = new MATCHER();
-        m = res->head_off;
-      }
-      memset(m, 0, sizeof(MATCHER));
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&m->pat, lin + matches[1].rm_so,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!res->head_off.add(lin + matches[1].rm_so))
         conf_err("HeadRemove bad pattern - aborted");
     } else if (!regexec(&regex_set::AddHeader, lin, 4, matches, 0)) {
       lin[matches[1].rm_eo] = '\0';
@@ -396,21 +407,8 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTP() {
     } else if (!regexec(&regex_set::RewriteLocation, lin, 4, matches, 0)) {
       res->rewr_loc = std::atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::RemoveResponseHeader, lin, 4, matches, 0)) {
-      if (res->response_head_off) {
-        for (m = res->response_head_off; m->next; m = m->next)
-          ;
-        if ((m->next = new MATCHER()) == nullptr)
-          conf_err("RemoveResponseHead config: out of memory - aborted");
-        m = m->next;
-      } else {
-        if ((res->response_head_off = new MATCHER()) == nullptr)
-          conf_err("RemoveResponseHead config: out of memory - aborted");
-        m = res->response_head_off;
-      }
-      memset(m, 0, sizeof(MATCHER));
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&m->pat, lin + matches[1].rm_so,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!res->response_head_off.add(lin + matches[1].rm_so))
         conf_err("RemoveResponseHead bad pattern - aborted");
     } else if (!regexec(&regex_set::AddResponseHeader, lin, 4, matches, 0)) {
       if (res->response_add_head.empty()) {
@@ -438,8 +436,8 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTP() {
       m->next = res->forcehttp10;
       res->forcehttp10 = m;
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&m->pat, lin + matches[1].rm_so,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!m->pat.compile(lin + matches[1].rm_so,
+                          REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("ForceHTTP10 bad pattern");
     } else if (!regexec(&regex_set::Service, lin, 4, matches, 0)) {
       if (res->services == nullptr) {
@@ -548,7 +546,7 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
   res->err403 = "The request was rejected by the server.";
 #endif
   res->ssl_forward_sni_server_name = true;
-  if (regcomp(&res->verb, xhttp[0], REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+  if (!res->verb.compile(xhttp[0], REG_ICASE | REG_NEWLINE | REG_EXTENDED))
     conf_err("xHTTP bad default pattern - aborted");
   has_addr = has_port = has_other = 0;
   while (conf_fgets(lin, MAXBUF)) {
@@ -603,8 +601,7 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
       int n;
 
       n = atoi(lin + matches[1].rm_so);
-      regfree(&res->verb);
-      if (regcomp(&res->verb, xhttp[n], REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!res->verb.compile(xhttp[n], REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("xHTTP bad pattern - aborted");
     } else if (!regexec(&regex_set::Client, lin, 4, matches, 0)) {
       res->to = atoi(lin + matches[1].rm_so);
@@ -613,8 +610,9 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
     } else if (!regexec(&regex_set::CheckURL, lin, 4, matches, 0)) {
       if (res->has_pat) conf_err("CheckURL multiple pattern - aborted");
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&res->url_pat, lin + matches[1].rm_so,
-                  REG_NEWLINE | REG_EXTENDED | (ignore_case ? REG_ICASE : 0)))
+      if (!res->url_pat.compile(lin + matches[1].rm_so,
+                                REG_NEWLINE | REG_EXTENDED |
+                                    (ignore_case ? REG_ICASE : 0)))
         conf_err("CheckURL bad pattern - aborted");
       res->has_pat = 1;
     } else if (!regexec(&regex_set::Err414, lin, 4, matches, 0)) {
@@ -648,21 +646,8 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
     } else if (!regexec(&regex_set::MaxRequest, lin, 4, matches, 0)) {
       res->max_req = atoll(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::HeadRemove, lin, 4, matches, 0)) {
-      if (res->head_off) {
-        for (m = res->head_off; m->next; m = m->next)
-          ;
-        if ((m->next = new MATCHER()) == nullptr)
-          conf_err("HeadRemove config: out of memory - aborted");
-        m = m->next;
-      } else {
-        if ((res->head_off = new MATCHER()) == nullptr)
-          conf_err("HeadRemove config: out of memory - aborted");
-        m = res->head_off;
-      }
-      memset(m, 0, sizeof(MATCHER));
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&m->pat, lin + matches[1].rm_so,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!res->head_off.add(lin + matches[1].rm_so))
         conf_err("HeadRemove bad pattern - aborted");
     } else if (!regexec(&regex_set::ForwardSNI, lin, 4, matches, 0)) {
       res->ssl_forward_sni_server_name = std::atoi(lin + matches[1].rm_so) == 1;
@@ -670,21 +655,8 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
       res->rewr_loc = atoi(lin + matches[1].rm_so);
 
     } else if (!regexec(&regex_set::RemoveResponseHeader, lin, 4, matches, 0)) {
-      if (res->response_head_off) {
-        for (m = res->response_head_off; m->next; m = m->next)
-          ;
-        if ((m->next = new MATCHER()) == nullptr)
-          conf_err("RemoveResponseHead config: out of memory - aborted");
-        m = m->next;
-      } else {
-        if ((res->response_head_off = new MATCHER()) == nullptr)
-          conf_err("RemoveResponseHead config: out of memory - aborted");
-        m = res->response_head_off;
-      }
-      memset(m, 0, sizeof(MATCHER));
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&m->pat, lin + matches[1].rm_so,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!res->response_head_off.add(lin + matches[1].rm_so))
         conf_err("RemoveResponseHead bad pattern - aborted");
     } else if (!regexec(&regex_set::AddResponseHeader, lin, 4, matches, 0)) {
       lin[matches[1].rm_eo] = '\0';
@@ -710,6 +682,11 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
     } else if (!regexec(&regex_set::CertDir, lin, 4, matches, 0)) {
       lin[matches[1].rm_eo] = '\0';
       load_certdir(has_other, res, lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::CertCache, lin, 4, matches, 0)) {
+      if (res->ctx != nullptr)
+        conf_err("CertCache must precede Cert and CertDir - aborted");
+      res->cert_cache_size =
+          static_cast<size_t>(std::atol(lin + matches[1].rm_so));
     } else if (!regexec(&regex_set::ClientCert, lin, 4, matches, 0)) {
       has_other = 1;
       if (res->ctx == nullptr)
@@ -813,6 +790,21 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
         ssl_op_disable |= SSL_OP_CIPHER_SERVER_PREFERENCE;
         ssl_op_enable &= ~SSL_OP_CIPHER_SERVER_PREFERENCE;
       }
+    } else if (!regexec(&regex_set::SSLSessionTickets, lin, 4, matches, 0)) {
+      res->ssl_session_tickets = std::atoi(lin + matches[1].rm_so) == 1;
+    } else if (!regexec(&regex_set::SSLTicketKeyRotation, lin, 4, matches,
+                        0)) {
+      res->ticket_key_rotation = std::atoi(lin + matches[1].rm_so);
+#ifdef SSL_OP_ENABLE_KTLS
+    } else if (!regexec(&regex_set::KTLS, lin, 4, matches, 0)) {
+      if (std::atoi(lin + matches[1].rm_so)) {
+        ssl_op_enable |= SSL_OP_ENABLE_KTLS;
+        ssl_op_disable &= ~SSL_OP_ENABLE_KTLS;
+      } else {
+        ssl_op_disable |= SSL_OP_ENABLE_KTLS;
+        ssl_op_enable &= ~SSL_OP_ENABLE_KTLS;
+      }
+#endif
     } else if (!regexec(&regex_set::Ciphers, lin, 4, matches, 0)) {
       has_other = 1;
       if (res->ctx == nullptr)
@@ -878,8 +870,8 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
       m->next = res->forcehttp10;
       res->forcehttp10 = m;
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&m->pat, lin + matches[1].rm_so,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!m->pat.compile(lin + matches[1].rm_so,
+                          REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("bad pattern");
     } else if (!regexec(&regex_set::SSLUncleanShutdown, lin, 4, matches, 0)) {
       if ((m = new MATCHER()) == nullptr) conf_err("out of memory");
@@ -887,8 +879,8 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
       m->next = res->ssl_uncln_shutdn;
       res->ssl_uncln_shutdn = m;
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&m->pat, lin + matches[1].rm_so,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!m->pat.compile(lin + matches[1].rm_so,
+                          REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("bad pattern");
     } else if (!regexec(&regex_set::Service, lin, 4, matches, 0)) {
       if (res->services == nullptr) {
@@ -918,46 +910,21 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
         conf_err(
             "ListenHTTPS missing Address, Port, SSL Config file or Certificate "
             "- aborted");
+      res->dh_params = DHCustom_params;
+      if (res->ecdh_curve_nid == 0) res->ecdh_curve_nid = EC_nid;
       if (!openssl_file_exists) {
         for (pc = res->ctx; pc; pc = pc->next) {
           SSL_CTX_set_app_data(pc->ctx.get(), res.get());
           SSL_CTX_set_mode(pc->ctx.get(), SSL_MODE_RELEASE_BUFFERS);
           SSL_CTX_set_options(pc->ctx.get(), ssl_op_enable);
           SSL_CTX_clear_options(pc->ctx.get(), ssl_op_disable);
-          sprintf(lin, "%d-zproxy-%ld", getpid(), random());
-          SSL_CTX_set_session_id_context(
-              pc->ctx.get(), reinterpret_cast<unsigned char *>(lin),
-              static_cast<unsigned int>(strlen(lin)));
+          global::SslHelper::setSessionIdContext(pc->ctx.get(), *res);
           SSL_CTX_set_tmp_rsa_callback(pc->ctx,
                                        global::SslHelper::RSA_tmp_callback);
           SSL_CTX_set_info_callback(pc->ctx.get(),
                                     global::SslHelper::SSLINFO_callback);
-          if (nullptr == DHCustom_params)
-            SSL_CTX_set_tmp_dh_callback(pc->ctx.get(),
-                                        global::SslHelper::DH_tmp_callback);
-          else
-            SSL_CTX_set_tmp_dh(pc->ctx.get(), DHCustom_params);
-
-#ifndef OPENSSL_NO_ECDH
-          /* This generates a EC_KEY structure with no key, but a group defined
-           */
-
-          if (res->ecdh_curve_nid != 0 || EC_nid != 0) {
-            if (res->ecdh_curve_nid == 0) res->ecdh_curve_nid = EC_nid;
-            EC_KEY *ecdh;
-            if ((ecdh = EC_KEY_new_by_curve_name(res->ecdh_curve_nid)) ==
-                nullptr)
-              conf_err("Unable to generate Listener temp ECDH key");
-            SSL_CTX_set_tmp_ecdh(pc->ctx.get(), ecdh);
-            SSL_CTX_set_options(pc->ctx.get(), SSL_OP_SINGLE_ECDH_USE);
-            EC_KEY_free(ecdh);
-          }
-#if defined(SSL_CTX_set_ecdh_auto)
-          else {
-            SSL_CTX_set_ecdh_auto(res->ctx, 1);
-          }
-#endif
-#endif
+          if (!global::SslHelper::setKeyExchange(pc->ctx.get(), *res))
+            conf_err("Unable to generate Listener temp ECDH key");
         }
       }
       return res;
@@ -1029,31 +996,46 @@ void Config::load_cert(int has_other, std::weak_ptr<ListenerConfig> listener_,
     conf_err(
         "Cert directives MUST precede other SSL-specific directives - "
         "aborted");
-  if (res->ctx) {
-    for (pc = res->ctx; pc->next; pc = pc->next)
-      ;
-    pc->next = std::make_shared<POUND_CTX>();
-    pc = pc->next;
+  if (res->cert_cache_size > 0 && res->ctx) {
+    // only the names are read now, the context is built on its first use
+    if (res->lazy_ctx) {
+      for (pc = res->lazy_ctx; pc->next; pc = pc->next)
+        ;
+      pc->next = std::make_shared<POUND_CTX>();
+      pc = pc->next;
+    } else {
+      res->lazy_ctx = std::make_shared<POUND_CTX>();
+      pc = res->lazy_ctx;
+    }
+    pc->cert_file = filename;
   } else {
-    res->ctx = std::make_shared<POUND_CTX>();
-    pc = res->ctx;
+    if (res->ctx) {
+      for (pc = res->ctx; pc->next; pc = pc->next)
+        ;
+      pc->next = std::make_shared<POUND_CTX>();
+      pc = pc->next;
+    } else {
+      res->ctx = std::make_shared<POUND_CTX>();
+      pc = res->ctx;
+    }
+    pc->ctx = std::shared_ptr<SSL_CTX>(SSL_CTX_new(SSLv23_server_method()),
+                                       &::__SSL_CTX_free);
+    if (SSL_CTX_use_certificate_chain_file(pc->ctx.get(), filename) != 1)
+      conf_err("SSL_CTX_use_certificate_chain_file failed - aborted");
+    if (SSL_CTX_use_PrivateKey_file(pc->ctx.get(), filename,
+                                    SSL_FILETYPE_PEM) != 1)
+      conf_err("SSL_CTX_use_PrivateKey_file failed - aborted");
+    if (SSL_CTX_check_private_key(pc->ctx.get()) != 1)
+      conf_err("SSL_CTX_check_private_key failed - aborted");
   }
-  pc->ctx = std::shared_ptr<SSL_CTX>(SSL_CTX_new(SSLv23_server_method()),
-                                     &::__SSL_CTX_free);
   pc->server_name = nullptr;
   pc->next = nullptr;
-  if (SSL_CTX_use_certificate_chain_file(pc->ctx.get(), filename) != 1)
-    conf_err("SSL_CTX_use_certificate_chain_file failed - aborted");
-  if (SSL_CTX_use_PrivateKey_file(pc->ctx.get(), filename, SSL_FILETYPE_PEM) !=
-      1)
-    conf_err("SSL_CTX_use_PrivateKey_file failed - aborted");
-  if (SSL_CTX_check_private_key(pc->ctx.get()) != 1)
-    conf_err("SSL_CTX_check_private_key failed - aborted");
   std::unique_ptr<BIO, decltype(&::BIO_free)> bio_cert(
       BIO_new_file(filename, "r"), ::BIO_free);
   std::unique_ptr<X509, decltype(&::X509_free)> x509(
       ::PEM_read_bio_X509(bio_cert.get(), nullptr, nullptr, nullptr),
       ::X509_free);
+  if (x509 == nullptr) conf_err("ListenHTTPS: could not read certificate");
   memset(server_name, '\0', MAXBUF);
   X509_NAME_oneline(X509_get_subject_name(x509.get()), server_name, MAXBUF - 1);
   pc->subjectAltNameCount = 0;
@@ -1099,10 +1081,8 @@ void Config::load_certdir(int has_other,
   struct dirent *de;
 
   char buf[512];
-  char *files[200];
+  std::vector<std::string> files;
   char *pattern;
-  int filecnt = 0;
-  int idx, use;
   auto res = listener_.lock();
   Logger::logmsg(LOG_DEBUG, "Including Certs from Dir %s", dir_path.data());
 
@@ -1123,25 +1103,15 @@ void Config::load_certdir(int has_other,
       snprintf(buf, sizeof(buf), "%s%s%s", dir_path.data(),
                (dir_path[dir_path.size() - 1] == '/') ? "" : "/", de->d_name);
       buf[sizeof(buf) - 1] = 0;
-      if (filecnt == sizeof(files) / sizeof(*files)) {
-        conf_err("Max certificate files per directory reached");
-      }
-      if ((files[filecnt++] = strdup(buf)) == nullptr) {
-        conf_err("CertDir out of memory");
-      }
+      files.emplace_back(buf);
       continue;
     }
   }
   /* We order the list, and load in ascending order */
-  while (filecnt) {
-    use = 0;
-    for (idx = 1; idx < filecnt; idx++)
-      if (strcmp(files[use], files[idx]) > 0) use = idx;
-
-    Logger::logmsg(LOG_DEBUG, " I Cert ==> %s", files[use]);
-
-    load_cert(has_other, res, files[use]);
-    files[use] = files[--filecnt];
+  std::sort(files.begin(), files.end());
+  for (auto &file : files) {
+    Logger::logmsg(LOG_DEBUG, " I Cert ==> %s", file.data());
+    load_cert(has_other, res, file.data());
   }
 
   closedir(dp);
@@ -1182,9 +1152,16 @@ std::shared_ptr<ServiceConfig> Config::parseService(const char *svc_name) {
       }
       memset(m, 0, sizeof(MATCHER));
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&m->pat, lin + matches[1].rm_so,
-                  REG_NEWLINE | REG_EXTENDED | (ign_case ? REG_ICASE : 0)))
+      if (!m->pat.compile(lin + matches[1].rm_so,
+                          REG_NEWLINE | REG_EXTENDED |
+                              (ign_case ? REG_ICASE : 0)))
         conf_err("URL bad pattern - aborted");
+      if (!ign_case) {
+        // every pattern must match, the longest prefix narrows the most
+        auto path_prefix = ServiceIndex::pathPrefix(lin + matches[1].rm_so);
+        if (path_prefix.size() > res->path_prefix.size())
+          res->path_prefix = path_prefix;
+      }
     } else if (!regexec(&regex_set::OrURLs, lin, 4, matches, 0)) {
       if (res->url) {
         for (m = res->url; m->next; m = m->next)
@@ -1199,8 +1176,9 @@ std::shared_ptr<ServiceConfig> Config::parseService(const char *svc_name) {
       }
       memset(m, 0, sizeof(MATCHER));
       ptr = parse_orurls();
-      if (regcomp(&m->pat, ptr,
-                  REG_NEWLINE | REG_EXTENDED | (ign_case ? REG_ICASE : 0)))
+      if (!m->pat.compile(ptr,
+                          REG_NEWLINE | REG_EXTENDED |
+                              (ign_case ? REG_ICASE : 0)))
         conf_err("OrURLs bad pattern - aborted");
       free(ptr);
     } else if (!regexec(&regex_set::HeadRequire, lin, 4, matches, 0)) {
@@ -1217,9 +1195,11 @@ std::shared_ptr<ServiceConfig> Config::parseService(const char *svc_name) {
       }
       memset(m, 0, sizeof(MATCHER));
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&m->pat, lin + matches[1].rm_so,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!m->pat.compile(lin + matches[1].rm_so,
+                          REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("HeadRequire bad pattern - aborted");
+      if (res->host_literal.empty())
+        res->host_literal = ServiceIndex::hostLiteral(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::HeadDeny, lin, 4, matches, 0)) {
       if (res->deny_head) {
         for (m = res->deny_head; m->next; m = m->next)
@@ -1234,8 +1214,8 @@ std::shared_ptr<ServiceConfig> Config::parseService(const char *svc_name) {
       }
       memset(m, 0, sizeof(MATCHER));
       lin[matches[1].rm_eo] = '\0';
-      if (regcomp(&m->pat, lin + matches[1].rm_so,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!m->pat.compile(lin + matches[1].rm_so,
+                          REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("HeadDeny bad pattern - aborted");
     } else if (!regexec(&regex_set::StrictTransportSecurity, lin, 4, matches,
                         0)) {
@@ -1293,8 +1273,8 @@ std::shared_ptr<ServiceConfig> Config::parseService(const char *svc_name) {
         conf_err("Backend cookie must have a name");
       if ((res->becookie = strdup(lin + matches[1].rm_so)) == nullptr)
         conf_err("out of memory");
-      if (regcomp(&res->becookie_re, pat,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!res->becookie_re.compile(pat,
+                                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("Backend Cookie pattern failed - aborted");
       if (matches[2].rm_so != matches[2].rm_eo &&
           (res->becdomain = strdup(lin + matches[2].rm_so)) == nullptr)
@@ -1512,6 +1492,8 @@ std::shared_ptr<BackendConfig> Config::parseBackend(const char *svc_name,
       SSL_CTX_set_session_id_context(res->ctx.get(),
                                      reinterpret_cast<unsigned char *>(lin),
                                      static_cast<uint32_t>(strlen(lin)));
+      // each Backend keeps the sessions of its connections to resume them
+      ssl::ClientSessionStore::attach(res->ctx.get());
       SSL_CTX_set_tmp_rsa_callback(res->ctx,
                                    global::SslHelper::RSA_tmp_callback);
       if (nullptr == DHCustom_params)
@@ -1536,6 +1518,15 @@ std::shared_ptr<BackendConfig> Config::parseBackend(const char *svc_name,
         conf_err("BackEnd Ciphers can only be used after HTTPS - aborted");
       lin[matches[1].rm_eo] = '\0';
       SSL_CTX_set_cipher_list(res->ctx.get(), lin + matches[1].rm_so);
+#ifdef SSL_OP_ENABLE_KTLS
+    } else if (!regexec(&regex_set::KTLS, lin, 4, matches, 0)) {
+      if (res->ctx == nullptr)
+        conf_err("BackEnd KTLS can only be used after HTTPS - aborted");
+      if (std::atoi(lin + matches[1].rm_so))
+        SSL_CTX_set_options(res->ctx.get(), SSL_OP_ENABLE_KTLS);
+      else
+        SSL_CTX_clear_options(res->ctx.get(), SSL_OP_ENABLE_KTLS);
+#endif
     } else if (!regexec(&regex_set::DisableProto, lin, 4, matches, 0)) {
       if (res->ctx == nullptr)
         conf_err("BackEnd Disable can only be used after HTTPS - aborted");
@@ -1653,8 +1644,8 @@ void Config::parseCache(ServiceConfig *const svc) {
     if (!regexec(&CacheContent, lin, 4, matches, 0)) {
       lin[matches[1].rm_eo] = '\0';
       cp = lin + matches[1].rm_so;
-      if (regcomp(&svc->cache_content, cp,
-                  REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+      if (!svc->cache_content.compile(cp,
+                                      REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("Cache content pattern failed, aborting");
       // Set the service CacheContent option
     } else if (!regexec(&CacheTO, lin, 4, matches, 0)) {
@@ -1719,41 +1710,41 @@ void Config::parseSession(std::weak_ptr<ServiceConfig> svc_spt) {
         conf_err("Session ID not defined - aborted");
       if (svc->sess_type == SESS_TYPE::SESS_COOKIE) {
         snprintf(lin, MAXBUF - 1, "Cookie[^:]*:.*[; \t]%s=", parm);
-        if (regcomp(&svc->sess_start, lin,
-                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+        if (!svc->sess_start.compile(lin,
+                                     REG_ICASE | REG_NEWLINE | REG_EXTENDED))
           conf_err("COOKIE pattern failed - aborted");
-        if (regcomp(&svc->sess_pat, "([^;]*)",
-                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+        if (!svc->sess_pat.compile("([^;]*)",
+                                   REG_ICASE | REG_NEWLINE | REG_EXTENDED))
           conf_err("COOKIE pattern failed - aborted");
       } else if (svc->sess_type == SESS_TYPE::SESS_URL) {
         snprintf(lin, MAXBUF - 1, "[?&]%s=", parm);
-        if (regcomp(&svc->sess_start, lin,
-                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+        if (!svc->sess_start.compile(lin,
+                                     REG_ICASE | REG_NEWLINE | REG_EXTENDED))
           conf_err("URL pattern failed - aborted");
-        if (regcomp(&svc->sess_pat, "([^&;#]*)",
-                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+        if (!svc->sess_pat.compile("([^&;#]*)",
+                                   REG_ICASE | REG_NEWLINE | REG_EXTENDED))
           conf_err("URL pattern failed - aborted");
       } else if (svc->sess_type == SESS_TYPE::SESS_PARM) {
-        if (regcomp(&svc->sess_start, ";",
-                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+        if (!svc->sess_start.compile(";",
+                                     REG_ICASE | REG_NEWLINE | REG_EXTENDED))
           conf_err("PARM pattern failed - aborted");
-        if (regcomp(&svc->sess_pat, "([^?]*)",
-                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+        if (!svc->sess_pat.compile("([^?]*)",
+                                   REG_ICASE | REG_NEWLINE | REG_EXTENDED))
           conf_err("PARM pattern failed - aborted");
       } else if (svc->sess_type == SESS_TYPE::SESS_BASIC) {
-        if (regcomp(&svc->sess_start, "Authorization:[ \t]*Basic[ \t]*",
-                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+        if (!svc->sess_start.compile("Authorization:[ \t]*Basic[ \t]*",
+                                     REG_ICASE | REG_NEWLINE | REG_EXTENDED))
           conf_err("BASIC pattern failed - aborted");
-        if (regcomp(&svc->sess_pat, "([^ \t]*)",
-                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+        if (!svc->sess_pat.compile("([^ \t]*)",
+                                   REG_ICASE | REG_NEWLINE | REG_EXTENDED))
           conf_err("BASIC pattern failed - aborted");
       } else if (svc->sess_type == SESS_TYPE::SESS_HEADER) {
         snprintf(lin, MAXBUF - 1, "%s:[ \t]*", parm);
-        if (regcomp(&svc->sess_start, lin,
-                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+        if (!svc->sess_start.compile(lin,
+                                     REG_ICASE | REG_NEWLINE | REG_EXTENDED))
           conf_err("HEADER pattern failed - aborted");
-        if (regcomp(&svc->sess_pat, "([^ \t]*)",
-                    REG_ICASE | REG_NEWLINE | REG_EXTENDED))
+        if (!svc->sess_pat.compile("([^ \t]*)",
+                                   REG_ICASE | REG_NEWLINE | REG_EXTENDED))
           conf_err("HEADER pattern failed - aborted");
       }
       if (parm != nullptr) free(parm);
@@ -1876,6 +1867,12 @@ void Config::include_dir(const char *conf_path) {
 void Config::setAsCurrent() {
   if (found_parse_error) return;
   global::run_options::getCurrent().num_threads = numthreads;
+  global::run_options::getCurrent().use_io_uring = use_io_uring;
+  global::run_options::getCurrent().edge_triggered = edge_triggered;
+  global::run_options::getCurrent().zero_copy = zero_copy;
+  global::run_options::getCurrent().handshake_threads = handshake_threads;
+  global::run_options::getCurrent().backend_pool_size = backend_pool_size;
+  global::run_options::getCurrent().backend_pool_timeout = backend_pool_timeout;
   global::run_options::getCurrent().log_level = log_level;
   global::run_options::getCurrent().log_facility = log_facility;
   global::run_options::getCurrent().user = user;
@@ -1907,6 +1904,12 @@ bool Config::init(const std::string &file_name) {
 
   DHCustom_params = nullptr;
   numthreads = 0;
+  use_io_uring = false;
+  edge_triggered = false;
+  zero_copy = false;
+  handshake_threads = 0;
+  backend_pool_size = 0;
+  backend_pool_timeout = 4;
   alive_to = 30;
   daemonize = 1;
   grace = 30;
@@ -125,6 +125,12 @@ class Config : public Counter<Config> {
                                       /* 1 Ignore header (Default)*/
                                       /* 0 Manages header */
       ctrl_port = 0, sync_is_enabled; /*session sync enabled*/
+  bool use_io_uring{false};           /* io_uring event engine */
+  bool edge_triggered{false};         /* edge triggered event registrations */
+  bool zero_copy{false};              /* splice the large bodies */
+  int handshake_threads{0};           /* threads running the TLS handshakes */
+  int backend_pool_size{0};           /* idle backend connections per worker */
+  int backend_pool_timeout{4};        /* idle backend connections timeout */
 #ifdef CACHE_ENABLED
       long cache_s;
       int cache_thr;
@@ -27,6 +27,8 @@
 #include <memory>
 #include <string>
 #include "../stats/counter.h"
+#include "../util/header_matcher.h"
+#include "../util/regex_pattern.h"
 
 #if WAF_ENABLED
 #include <modsecurity/modsecurity.h>
@@ -41,11 +43,10 @@ enum class RENEG_STATE {
 
 /* matcher chain */
 struct MATCHER {
-  regex_t pat; /* pattern to match the request/header against */
+  RegexPattern pat; /* pattern to match the request/header against */
   MATCHER *next{nullptr};
   ~MATCHER() {
     if (next != nullptr) delete next;
-    ::regfree(&pat);
   }
 };
 
@@ -106,6 +107,8 @@ class ServiceConfig : Counter<ServiceConfig> {
   MATCHER *url,             /* request matcher */
       *req_head,            /* required headers */
       *deny_head;           /* forbidden headers */
+  std::string host_literal; /* Host required by a HeadRequire, lower case */
+  std::string path_prefix;  /* literal prefix of the paths matched by url */
   std::shared_ptr<BackendConfig> backends;
   std::shared_ptr<BackendConfig> emergency;
   int abs_pri;         /* abs total priority for all back-ends */
@@ -114,17 +117,17 @@ class ServiceConfig : Counter<ServiceConfig> {
   SESS_TYPE sess_type;
   int sess_ttl;       /* session time-to-live */
   std::string sess_id;    /* id used to track the session */
-  regex_t sess_start; /* pattern to identify the session data */
-  regex_t sess_pat;   /* pattern to match the session data */
+  RegexPattern sess_start; /* pattern to identify the session data */
+  RegexPattern sess_pat;   /* pattern to match the session data */
 #ifdef CACHE_ENABLED
   int cache_timeout = -1; /* cached content timeout in seconds */
   std::string cache_disk_path, cache_ram_path;
-  regex_t cache_content; /* pattern to decide if must be cached or not */
+  RegexPattern cache_content; /* pattern to decide if must be cached or not */
   long cache_size;
   size_t cache_max_size;
   int cache_threshold;
 #endif
-  regex_t becookie_re; /* Regexs to find backend cookies */
+  RegexPattern becookie_re; /* Regexs to find backend cookies */
   char *becookie,      /* Backend Cookie Name */
       *becdomain,      /* Backend Cookie domain */
       *becpath;        /* Backend cookie path */
@@ -145,8 +148,6 @@ class ServiceConfig : Counter<ServiceConfig> {
     delete url;
     delete req_head;
     delete deny_head;
-    ::regfree(&sess_start);
-    ::regfree(&sess_pat);
   }
 };
 
@@ -155,6 +156,8 @@ struct POUND_CTX {
   char *server_name{nullptr};
   unsigned char **subjectAltNames{nullptr};
   unsigned int subjectAltNameCount;
+  /** Certificate file of a context built on its first use, ctx is nullptr. */
+  std::string cert_file;
   std::shared_ptr<POUND_CTX> next;
   ~POUND_CTX() {
     if (server_name != nullptr) free(server_name);
@@ -167,7 +170,7 @@ struct ListenerConfig : Counter<ListenerConfig> {
   std::string name;
   int id{0};
   std::string address;
-  addrinfo *addr_info; /* IPv4/6 address */
+  addrinfo *addr_info{nullptr}; /* IPv4/6 address */
   int port;
   std::shared_ptr<POUND_CTX> ctx{nullptr}; /* CTX for SSL connections */
   int clnt_check;          /* client verification mode */
@@ -178,18 +181,18 @@ struct ListenerConfig : Counter<ListenerConfig> {
       ssl_uncln_shutdn; /* User Agent Patterns to enable ssl unclean shutdown */
   std::string add_head; /* extra SSL header */
   std::string response_add_head; /* extra response headers */
-  regex_t verb;                  /* pattern to match the request verb against */
+  RegexPattern verb;             /* pattern to match the request verb against */
   int to;                        /* client time-out */
   int has_pat;                   /* was a URL pattern defined? */
-  regex_t url_pat;               /* pattern to match the request URL against */
+  RegexPattern url_pat;          /* pattern to match the request URL against */
   std::string err403, err414,    /* error messages */
       err500, err501, err503, errnossl;
   std::string nossl_url; /* If a user goes to a https port with a http: url,
                       redirect them to this url */
   int nossl_redir;       /* Code to use for redirect (301 302 307)*/
   long max_req;          /* max. request size */
-  MATCHER *head_off{nullptr};          /* headers to remove */
-  MATCHER *response_head_off{nullptr}; /* headers to remove  from response */
+  HeaderMatcher head_off;              /* headers to remove */
+  HeaderMatcher response_head_off;     /* headers to remove  from response */
   std::string ssl_config_file;         /* OpenSSL config file path */
   int rewr_loc{0};                     /* rewrite location response */
   int rewr_dest{0};                    /* rewrite destination header */
@@ -204,21 +207,27 @@ struct ListenerConfig : Counter<ListenerConfig> {
   std::string engine_id; /* Engine id loaded by openssl*/
   bool ssl_forward_sni_server_name{false}; /* enable SNI hostname forwarding to
                                          https backends, param ForwardSNI*/
+  bool ssl_session_tickets{false}; /* resume sessions with stateless tickets,
+                                      param SSLSessionTickets */
+  int ticket_key_rotation{3600}; /* seconds between ticket key rotations,
+                                    0 never, param SSLTicketKeyRotation */
+  size_t cert_cache_size{0}; /* certificate contexts kept built, 0 to build
+                                all at startup, param CertCache */
+  std::shared_ptr<POUND_CTX> lazy_ctx{
+      nullptr}; /* certificates built on their first use */
 #if WAF_ENABLED
   std::shared_ptr<modsecurity::ModSecurity> modsec{
       nullptr}; /* API connector with Modsecurity */
   std::shared_ptr<modsecurity::Rules> rules{nullptr}; /* Rules of modsecurity */
 #endif
   int ecdh_curve_nid{0};
+  DH *dh_params{nullptr}; /* DH parameters, param DHParams, the built-in ones
+                             if not set */
   std::shared_ptr<ServiceConfig> services{nullptr};
   std::shared_ptr<ListenerConfig> next{nullptr};
   ~ListenerConfig() {
     delete forcehttp10;
     delete ssl_uncln_shutdn;
-    ::regfree(&verb);
-    ::regfree(&url_pat);
-    delete head_off;
-    delete response_head_off;
-    ::freeaddrinfo(addr_info);
+    if (addr_info != nullptr) ::freeaddrinfo(addr_info);
   }
 };
@@ -20,6 +20,8 @@
  */
 
 #include "global.h"
+#include <unistd.h>
+#include <climits>
 global::run_options global::run_options::current{};
 global::StartOptions global::StartOptions::current{};
 
@@ -34,6 +36,8 @@ void global::StartOptions::setCurrent(const global::StartOptions& options) {
   current.check_only = options.check_only;
   current.verbose_mode = options.verbose_mode;
   current.sync_is_enabled = options.sync_is_enabled;
+  current.binary_path = options.binary_path;
+  current.argv = options.argv;
 }
 
 std::unique_ptr<global::StartOptions> global::StartOptions::parsePoundOption(
@@ -73,6 +77,13 @@ std::unique_ptr<global::StartOptions> global::StartOptions::parsePoundOption(
     Logger::logmsg(LOG_ERR, "unknown extra arguments (%s...)", argv[optind]);
     exit(EXIT_FAILURE);
   }
+  res->argv.assign(argv, argv + argc);
+  // resolved now, the path may be replaced by the new binary on upgrade
+  char binary_path[PATH_MAX];
+  auto length =
+      ::readlink("/proc/self/exe", binary_path, sizeof(binary_path) - 1);
+  if (length > 0)
+    res->binary_path.assign(binary_path, static_cast<size_t>(length));
   // we must write to the current configuration the first time we parse the
   // options
   if (write_to_current) {
@@ -23,6 +23,7 @@
 
 #include <getopt.h>
 #include <string>
+#include <vector>
 #include "../debug/logger.h"
 #include "../version.h"
 #include "ssl_helper.h"
@@ -32,6 +33,12 @@ struct run_options {
   explicit run_options(bool write_to_current = false);
   static run_options &getCurrent();
   int num_threads{0};           /*number of StreamManagers to use (workers)*/
+  bool use_io_uring{false};     /*use the io_uring event engine in the workers*/
+  bool edge_triggered{false};   /*register the connections once, edge triggered*/
+  bool zero_copy{false};        /*relay the large plain HTTP bodies with splice*/
+  int handshake_threads{0};     /*threads running the client TLS handshakes, 0 to run them in the workers*/
+  int backend_pool_size{0};     /*idle backend connections kept per worker and backend*/
+  int backend_pool_timeout{4};  /*seconds an idle backend connection is kept*/
   int log_level{5};             /*default log leves*/
   int log_facility{LOG_DAEMON}; /*syslog log facility to use*/
   std::string user;             /* user to run as */
@@ -59,6 +66,8 @@ struct StartOptions {
   bool check_only{false};
   bool sync_is_enabled{false};
   bool verbose_mode{false};
+  std::string binary_path;        /* executable, run again on upgrade */
+  std::vector<std::string> argv;  /* command line, run again on upgrade */
   /*Set current start options as global, this must be called at least once*/
   void setCurrent(const StartOptions &options);
   static std::unique_ptr<StartOptions> parsePoundOption(
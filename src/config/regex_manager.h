@@ -47,6 +47,12 @@ static const Regex Name("^[ \t]*Name[ \t]+(.+)[ \t]*$");
 static const Regex RootJail("^[ \t]*RootJail[ \t]+\"(.+)\"[ \t]*$");
 static const Regex Daemon("^[ \t]*Daemon[ \t]+([01])[ \t]*$");
 static const Regex Threads("^[ \t]*Threads[ \t]+([1-9][0-9]*)[ \t]*$");
+static const Regex EventEngine("^[ \t]*EventEngine[ \t]+(epoll|io_uring)[ \t]*$");
+static const Regex EdgeTriggered("^[ \t]*EdgeTriggered[ \t]+([01])[ \t]*$");
+static const Regex ZeroCopy("^[ \t]*ZeroCopy[ \t]+([01])[ \t]*$");
+static const Regex BackendKeepAlive("^[ \t]*BackendKeepAlive[ \t]+([0-9]+)[ \t]*$");
+static const Regex HandshakeThreads("^[ \t]*HandshakeThreads[ \t]+([0-9]+)[ \t]*$");
+static const Regex BackendKeepAliveTimeout("^[ \t]*BackendKeepAliveTimeout[ \t]+([1-9][0-9]*)[ \t]*$");
 static const Regex ThreadModel("^[ \t]*ThreadModel[ \t]+(pool|dynamic)[ \t]*$");
 static const Regex LogFacility("^[ \t]*LogFacility[ \t]+([a-z0-9-]+)[ \t]*$");
 static const Regex LogLevel("^[ \t]*LogLevel[ \t]+([0-9])[ \t]*$");
@@ -67,6 +73,7 @@ static const Regex Address("^[ \t]*Address[ \t]+([^ \t]+)[ \t]*$");
 static const Regex Port("^[ \t]*Port[ \t]+([1-9][0-9]*)[ \t]*$");
 static const Regex Cert("^[ \t]*Cert[ \t]+\"(.+)\"[ \t]*$");
 static const Regex CertDir("^[ \t]*CertDir[ \t]+\"(.+)\"[ \t]*$");
+static const Regex CertCache("^[ \t]*CertCache[ \t]+([0-9]+)[ \t]*$");
 static const Regex xHTTP("^[ \t]*xHTTP[ \t]+([012345])[ \t]*$");
 static const Regex Client("^[ \t]*Client[ \t]+([1-9][0-9]*)[ \t]*$");
 static const Regex CheckURL("^[ \t]*CheckURL[ \t]+\"(.+)\"[ \t]*$");
@@ -114,6 +121,8 @@ static const Regex AddHeader("^[ \t]*AddHeader[ \t]+\"(.+)\"[ \t]*$");
 static const Regex SSLAllowClientRenegotiation("^[ \t]*SSLAllowClientRenegotiation[ \t]+([012])[ \t]*$");
 static const Regex DisableProto("^[ \t]*Disable[ \t]+(SSLv2|SSLv3|TLSv1|TLSv1_1|TLSv1_2|TLSv1_3)[ \t]*$");
 static const Regex SSLHonorCipherOrder("^[ \t]*SSLHonorCipherOrder[ \t]+([01])[ \t]*$");
+static const Regex SSLSessionTickets("^[ \t]*SSLSessionTickets[ \t]+([01])[ \t]*$");
+static const Regex SSLTicketKeyRotation("^[ \t]*SSLTicketKeyRotation[ \t]+([0-9]+)[ \t]*$");
 static const Regex Ciphers("^[ \t]*Ciphers[ \t]+\"(.+)\"[ \t]*$");
 static const Regex CAlist("^[ \t]*CAlist[ \t]+\"(.+)\"[ \t]*$");
 static const Regex VerifyList("^[ \t]*VerifyList[ \t]+\"(.+)\"[ \t]*$");
@@ -145,6 +154,7 @@ static const Regex CacheDiskPath("^[ \t]*CacheDiskPath[ \t]+\"([a-zA-Z\\/\\._]*)
 static const Regex ECDHCurve("^[ \t]*ECDHCurve[ \t]+\"(.+)\"[ \t]*$");
 #endif
 static const Regex ForwardSNI("^[ \t]*ForwardSNI[ \t]+([01])[ \t]*$");
+static const Regex KTLS("^[ \t]*KTLS[ \t]+([01])[ \t]*$");
 static const Regex HEADER("^([a-z0-9!#$%&'*+.^_`|~-]+):[ \t]*(.*)[ \t]*$");
 static const Regex CONN_UPGRD("(^|[ \t,])upgrade([ \t,]|$)");
 static const Regex CHUNK_HEAD("^([0-9a-f]+).*$");
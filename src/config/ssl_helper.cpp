@@ -48,6 +48,49 @@ RSA *global::SslHelper::RSA_tmp_callback([[maybe_unused]] SSL *ssl,
   return res;
 }
 
+bool global::SslHelper::setKeyExchange(SSL_CTX *ctx,
+                                       const ListenerConfig &listener) {
+  if (listener.dh_params == nullptr)
+    SSL_CTX_set_tmp_dh_callback(ctx, DH_tmp_callback);
+  else
+    SSL_CTX_set_tmp_dh(ctx, listener.dh_params);
+#ifndef OPENSSL_NO_ECDH
+  if (listener.ecdh_curve_nid != 0) {
+    /* This generates a EC_KEY structure with no key, but a group defined */
+    EC_KEY *ecdh = EC_KEY_new_by_curve_name(listener.ecdh_curve_nid);
+    if (ecdh == nullptr) return false;
+    SSL_CTX_set_tmp_ecdh(ctx, ecdh);
+    SSL_CTX_set_options(ctx, SSL_OP_SINGLE_ECDH_USE);
+    EC_KEY_free(ecdh);
+  }
+#if defined(SSL_CTX_set_ecdh_auto)
+  else {
+    SSL_CTX_set_ecdh_auto(ctx, 1);
+  }
+#endif
+#endif
+  return true;
+}
+
+void global::SslHelper::setSessionIdContext(SSL_CTX *ctx,
+                                            const ListenerConfig &listener) {
+  auto listen = listener.address + ":" + std::to_string(listener.port);
+  unsigned char cert_md[EVP_MAX_MD_SIZE];
+  unsigned int cert_md_len = 0;
+  if (X509 *cert = SSL_CTX_get0_certificate(ctx))
+    X509_digest(cert, EVP_sha256(), cert_md, &cert_md_len);
+  /* SHA-256 is SSL_MAX_SID_CTX_LENGTH long */
+  unsigned char sid_ctx[EVP_MAX_MD_SIZE];
+  unsigned int sid_ctx_len = 0;
+  EVP_MD_CTX *md_ctx = EVP_MD_CTX_new();
+  EVP_DigestInit_ex(md_ctx, EVP_sha256(), nullptr);
+  EVP_DigestUpdate(md_ctx, listen.data(), listen.size());
+  EVP_DigestUpdate(md_ctx, cert_md, cert_md_len);
+  EVP_DigestFinal_ex(md_ctx, sid_ctx, &sid_ctx_len);
+  EVP_MD_CTX_free(md_ctx);
+  SSL_CTX_set_session_id_context(ctx, sid_ctx, sid_ctx_len);
+}
+
 void global::SslHelper::SSLINFO_callback(const SSL *ssl, int where,
                                          [[maybe_unused]] int rc) {
   RENEG_STATE *reneg_state;
@@ -34,6 +34,8 @@
 #include "dh2048.h"
 #endif
 
+struct ListenerConfig;
+
 namespace global {
 /*
  * RSA ephemeral keys: how many and how often
@@ -80,6 +82,19 @@ struct SslHelper {
   }
 #endif
 
+  /*
+   * Set the DH parameters and the ECDH curve of a listener in one of its
+   * contexts, returns false if the curve can not be used
+   */
+  static bool setKeyExchange(SSL_CTX *ctx, const ListenerConfig &listener);
+
+  /*
+   * Set the session id context of a listener context, derived from the
+   * listener address and the context certificate so that it is the same on
+   * every build of the context
+   */
+  static void setSessionIdContext(SSL_CTX *ctx, const ListenerConfig &listener);
+
   /*
    * initialise DH and RSA keys
    */
@@ -25,3 +25,9 @@ BackendConnection::BackendConnection() : connection_retries(0), backend(nullptr)
 Backend *BackendConnection::getBackend() const { return backend; }
 
 void BackendConnection::setBackend(Backend *bck) { backend = bck; connection_retries++; }
+
+int BackendConnection::releaseFileDescriptor() {
+  int fd = fd_;
+  fd_ = -1;
+  return fd;
+}
@@ -32,6 +32,13 @@ class BackendConnection : public Connection, public Counter<BackendConnection> {
  public:
   Backend *getBackend() const;
   void setBackend(Backend *backend);
+  /**
+   * @brief Detaches the socket from the connection without closing it, used
+   * to hand it over to the BackendConnectionPool.
+   *
+   * @return the detached file descriptor.
+   */
+  int releaseFileDescriptor();
 
   BackendConnection();
   virtual ~BackendConnection() = default;
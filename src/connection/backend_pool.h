@@ -0,0 +1,186 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <ctime>
+#include <unordered_map>
+#include <vector>
+#include "../stats/backend_stats.h"
+
+/** Default seconds a backend connection may stay idle in the pool. */
+#define BACKEND_POOL_IDLE_TIMEOUT 4
+
+/**
+ * @class BackendConnectionPool backend_pool.h "src/connection/backend_pool.h"
+ * @brief Idle keep-alive backend connections of a worker.
+ *
+ * Once a response has been completely relayed, the backend socket can be
+ * handed back to the pool instead of being closed, and the next request to
+ * the same backend, from any client of the worker, checks it out instead of
+ * connecting again. Connections are kept per backend in LIFO order, so the
+ * most recently used, and most likely alive, is reused first. The pool is
+ * only used from the worker thread, the statistics are published through
+ * the backend BackendInfo counters.
+ */
+class BackendConnectionPool {
+  struct IdleConnection {
+    int fd;
+    /** Second at which the connection was returned to the pool. */
+    time_t since;
+  };
+  std::unordered_map<Statistics::BackendInfo *, std::vector<IdleConnection>>
+      idle_set;
+  std::unordered_map<int, Statistics::BackendInfo *> idle_fds;
+
+ public:
+  /** Maximum idle connections kept per backend, 0 disables the pool. */
+  size_t max_idle{0};
+  /** Seconds an idle connection is kept before closing it. */
+  int idle_timeout{BACKEND_POOL_IDLE_TIMEOUT};
+
+  BackendConnectionPool() = default;
+  BackendConnectionPool(const BackendConnectionPool &) = delete;
+  ~BackendConnectionPool() {
+    // the backends may be gone already, only release the sockets
+    for (auto &idle_fd : idle_fds) ::close(idle_fd.first);
+  }
+
+  inline bool isEnabled() const { return max_idle > 0; }
+
+  /** @brief Returns the number of idle connections in the pool. */
+  inline size_t size() const { return idle_fds.size(); }
+
+  /**
+   * @brief Checks that an idle connection is still usable.
+   *
+   * Nothing may be pending on an idle connection, so it is alive only if a
+   * non blocking peek would block. A zero read means the backend closed it
+   * and any data means it is out of sync with the HTTP exchange.
+   */
+  static bool isAlive(int fd) {
+    char byte;
+    return ::recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) < 0 &&
+           (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+
+  /**
+   * @brief Returns an idle connection of @p backend to the pool.
+   *
+   * @param backend owning the connection.
+   * @param fd is the connected socket, it must not be registered in any event
+   * manager.
+   * @param now is the current time in seconds.
+   * @return @c false if the pool is disabled or full for this backend, the
+   * caller keeps the ownership of @p fd.
+   */
+  bool put(Statistics::BackendInfo *backend, int fd, time_t now) {
+    if (!isEnabled() || fd < 0) return false;
+    auto &connections = idle_set[backend];
+    if (connections.size() >= max_idle) return false;
+    connections.push_back({fd, now});
+    idle_fds[fd] = backend;
+    backend->increaseIdleConn();
+    return true;
+  }
+
+  /**
+   * @brief Checks out an idle connection to @p backend.
+   *
+   * Expired and dead connections found on the way are closed.
+   *
+   * @param backend to get the connection for.
+   * @param now is the current time in seconds.
+   * @param on_release is called with each socket leaving the pool, the one
+   * returned included, before it is closed, to cancel its idle timeout.
+   * @return the connected socket or -1 if there is none available.
+   */
+  template <typename Callback>
+  int get(Statistics::BackendInfo *backend, time_t now,
+          Callback &&on_release) {
+    auto it = idle_set.find(backend);
+    if (it == idle_set.end()) return -1;
+    auto &connections = it->second;
+    while (!connections.empty()) {
+      auto connection = connections.back();
+      connections.pop_back();
+      idle_fds.erase(connection.fd);
+      backend->decreaseIdleConn();
+      on_release(connection.fd);
+      if (now - connection.since < idle_timeout && isAlive(connection.fd)) {
+        backend->increaseReusedConn();
+        return connection.fd;
+      }
+      ::close(connection.fd);
+    }
+    return -1;
+  }
+
+  int get(Statistics::BackendInfo *backend, time_t now) {
+    return get(backend, now, [](int) {});
+  }
+
+  /**
+   * @brief Closes the idle connection @p fd, used when its idle timeout
+   * expires.
+   *
+   * @return @c false if @p fd is not in the pool.
+   */
+  bool expire(int fd) {
+    auto it = idle_fds.find(fd);
+    if (it == idle_fds.end()) return false;
+    auto backend = it->second;
+    idle_fds.erase(it);
+    auto &connections = idle_set[backend];
+    for (auto conn_it = connections.begin(); conn_it != connections.end();
+         conn_it++) {
+      if (conn_it->fd == fd) {
+        connections.erase(conn_it);
+        break;
+      }
+    }
+    backend->decreaseIdleConn();
+    ::close(fd);
+    return true;
+  }
+
+  /**
+   * @brief Closes all the idle connections.
+   *
+   * @param on_release is called with each socket before it is closed.
+   */
+  template <typename Callback>
+  void clear(Callback &&on_release) {
+    for (auto &backend_connections : idle_set) {
+      for (auto &connection : backend_connections.second) {
+        backend_connections.first->decreaseIdleConn();
+        on_release(connection.fd);
+        ::close(connection.fd);
+      }
+    }
+    idle_set.clear();
+    idle_fds.clear();
+  }
+
+  void clear() { clear([](int) {}); }
+};
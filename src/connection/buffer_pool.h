@@ -0,0 +1,234 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#ifndef MAX_DATA_SIZE
+#define MAX_DATA_SIZE (1024 * 32)
+#endif
+
+/** Number of buffer size classes, each one doubles the previous one. */
+#define BUFFER_POOL_CLASSES 3
+/** Size of the largest buffer, only used to hold oversized headers. */
+#define MAX_BUFFER_SIZE (MAX_DATA_SIZE << (BUFFER_POOL_CLASSES - 1))
+/** Free buffers of each size class kept by a worker for reuse. */
+#define BUFFER_POOL_MAX_FREE 256
+/** Buffers of each slab mapped by a pool. */
+#define BUFFER_POOL_SLAB_BUFFERS 16
+
+/**
+ * @class BufferPool buffer_pool.h "src/connection/buffer_pool.h"
+ * @brief Per thread cache of connection I/O buffers.
+ *
+ * Connections only hold a buffer while they have data in flight: it is taken
+ * before reading and given back once the connection is idle and drained, so
+ * an idle keep-alive connection does not pin MAX_DATA_SIZE bytes. Buffers come
+ * in size classes of MAX_DATA_SIZE, 2 * MAX_DATA_SIZE, ... MAX_BUFFER_SIZE;
+ * the bigger ones are only used by connections whose headers do not fit in
+ * the default one. Each thread keeps up to BUFFER_POOL_MAX_FREE free buffers
+ * per class in LIFO order, so the most recently used, cache hot, buffer is
+ * reused first, and gives the pages of the rest back to the kernel.
+ *
+ * The buffers are carved out of slabs the pool maps itself, each one behind a
+ * header naming its pool. A connection may give its buffer back from another
+ * thread, e.g. after a TLS handshake offload or when the streams are released
+ * on shutdown: the buffer is then pushed to the owner lock free, and reused by
+ * it on its next get(). A pool outlives its thread until all its buffers are
+ * back.
+ */
+class BufferPool {
+  /** Header of each buffer in the slab, the buffer follows it. */
+  struct alignas(64) BufferHeader {
+    BufferPool *owner;
+    /** Next buffer given back by other threads. */
+    BufferHeader *next;
+    size_t size_class;
+  };
+
+  /** Keeps the pool of a thread, until the thread exits. */
+  struct LocalPool {
+    BufferPool *pool;
+    ~LocalPool() { pool->unref(); }
+  };
+
+  std::vector<char *> free_buffers[BUFFER_POOL_CLASSES];
+  /** Free buffers whose pages were given back to the kernel. */
+  std::vector<char *> released_buffers[BUFFER_POOL_CLASSES];
+  /** Next buffer of the current slab and buffers left in it. */
+  char *slab_next[BUFFER_POOL_CLASSES]{};
+  size_t slab_left[BUFFER_POOL_CLASSES]{};
+  std::vector<std::pair<void *, size_t>> slabs;
+  /** Buffers given back by other threads. */
+  std::atomic<BufferHeader *> remote_buffers{nullptr};
+  /** The thread reference plus one per buffer taken. */
+  std::atomic<int> refs{1};
+  /** Buffers with their pages in memory. */
+  int committed{0};
+
+  BufferPool() = default;
+
+  static inline BufferHeader *header(char *buffer) {
+    return reinterpret_cast<BufferHeader *>(buffer) - 1;
+  }
+
+  void unref() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+  }
+
+  char *carve(size_t size_class) {
+    const size_t stride = sizeof(BufferHeader) + classSize(size_class);
+    if (slab_left[size_class] == 0) {
+      const size_t size = stride * BUFFER_POOL_SLAB_BUFFERS;
+      // the pages are only backed once a buffer is used
+      auto slab = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (slab == MAP_FAILED) return nullptr;
+      slabs.emplace_back(slab, size);
+      slab_next[size_class] = static_cast<char *>(slab);
+      slab_left[size_class] = BUFFER_POOL_SLAB_BUFFERS;
+    }
+    auto buffer_header = reinterpret_cast<BufferHeader *>(slab_next[size_class]);
+    buffer_header->owner = this;
+    buffer_header->next = nullptr;
+    buffer_header->size_class = size_class;
+    slab_next[size_class] += stride;
+    slab_left[size_class]--;
+    return reinterpret_cast<char *>(buffer_header + 1);
+  }
+
+  /** Keeps @p buffer for reuse, or gives its pages back past the limit. */
+  void keep(char *buffer, size_t size_class) {
+    if (free_buffers[size_class].size() < BUFFER_POOL_MAX_FREE) {
+      free_buffers[size_class].push_back(buffer);
+      return;
+    }
+    static const auto page_size = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+    auto start = (reinterpret_cast<uintptr_t>(buffer) + page_size - 1) &
+                 ~(page_size - 1);
+    auto end = (reinterpret_cast<uintptr_t>(buffer) + classSize(size_class)) &
+               ~(page_size - 1);
+    if (end > start)
+      ::madvise(reinterpret_cast<void *>(start), end - start, MADV_DONTNEED);
+    released_buffers[size_class].push_back(buffer);
+    committed--;
+    total_buffers--;
+  }
+
+  /** Takes back the buffers other threads gave back. */
+  void collectRemote() {
+    auto buffer_header =
+        remote_buffers.exchange(nullptr, std::memory_order_acquire);
+    while (buffer_header != nullptr) {
+      auto next = buffer_header->next;
+      keep(reinterpret_cast<char *>(buffer_header + 1),
+           buffer_header->size_class);
+      buffer_header = next;
+    }
+  }
+
+ public:
+  /** Buffers allocated by all the threads. */
+  inline static std::atomic<int> total_buffers{0};
+  /** Buffers held by connections. */
+  inline static std::atomic<int> used_buffers{0};
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+  ~BufferPool() {
+    total_buffers -= committed;
+    for (auto &slab : slabs) ::munmap(slab.first, slab.second);
+  }
+
+  /** @brief Returns the pool of the calling thread. */
+  static BufferPool &local() {
+    static thread_local LocalPool local_pool{new BufferPool()};
+    return *local_pool.pool;
+  }
+
+  /** @brief Returns the size in bytes of the buffers of @p size_class. */
+  static constexpr size_t classSize(size_t size_class) {
+    return static_cast<size_t>(MAX_DATA_SIZE) << size_class;
+  }
+
+  /**
+   * @brief Takes a buffer of @p size_class.
+   *
+   * @return the buffer or @c nullptr if it could not be allocated.
+   */
+  char *get(size_t size_class) {
+    char *buffer;
+    auto &free_list = free_buffers[size_class];
+    if (free_list.empty() &&
+        remote_buffers.load(std::memory_order_relaxed) != nullptr)
+      collectRemote();
+    if (!free_list.empty()) {
+      buffer = free_list.back();
+      free_list.pop_back();
+    } else {
+      auto &released = released_buffers[size_class];
+      if (!released.empty()) {
+        buffer = released.back();
+        released.pop_back();
+      } else {
+        buffer = carve(size_class);
+        if (buffer == nullptr) return nullptr;
+      }
+      committed++;
+      total_buffers++;
+    }
+    refs.fetch_add(1, std::memory_order_relaxed);
+    used_buffers++;
+    return buffer;
+  }
+
+  /**
+   * @brief Gives back a @p buffer of @p size_class taken with get(), from
+   * this or any other pool.
+   */
+  void put(char *buffer, size_t size_class) {
+    used_buffers--;
+    auto owner = header(buffer)->owner;
+    if (owner == this) {
+      keep(buffer, size_class);
+      refs.fetch_sub(1, std::memory_order_relaxed);
+      return;
+    }
+    auto buffer_header = header(buffer);
+    buffer_header->next = owner->remote_buffers.load(std::memory_order_relaxed);
+    while (!owner->remote_buffers.compare_exchange_weak(
+        buffer_header->next, buffer_header, std::memory_order_release,
+        std::memory_order_relaxed))
+      ;
+    // the last buffer of a pool whose thread is gone releases it
+    owner->unref();
+  }
+
+  /** @brief Returns the number of free buffers of @p size_class. */
+  size_t freeBuffers(size_t size_class) const {
+    return free_buffers[size_class].size();
+  }
+};
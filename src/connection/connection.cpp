@@ -46,17 +46,21 @@ IO::IO_RESULT Connection::read() {
   ssize_t count;
   IO::IO_RESULT result = IO::IO_RESULT::ERROR;
   //  PRINT_BUFFER_SIZE
-  if ((MAX_DATA_SIZE - (buffer_size + buffer_offset)) == 0)
+  bool new_buffer = buffer == nullptr;
+  if (new_buffer && !acquireBuffer()) return IO::IO_RESULT::ERROR;
+  const size_t capacity = bufferCapacity();
+  if ((capacity - (buffer_size + buffer_offset)) == 0)
     return IO::IO_RESULT::FULL_BUFFER;
   while (!done) {
-    count = ::read(fd_, (buffer + buffer_offset + buffer_size),
-                   (MAX_DATA_SIZE - buffer_size - buffer_offset));
+    count = receive((buffer + buffer_offset + buffer_size),
+                    (capacity - buffer_size - buffer_offset));
     if (count < 0) {
       if (errno != EAGAIN && errno != EWOULDBLOCK) {
         Logger::logmsg(LOG_DEBUG, " read() failed: %s",std::strerror(errno));
         result = IO::IO_RESULT::ERROR;
       } else {
         result = IO::IO_RESULT::DONE_TRY_AGAIN;
+        readDrained();
       }
       done = true;
     } else if (count == 0) {
@@ -67,19 +71,56 @@ IO::IO_RESULT Connection::read() {
       // PRINT_BUFFER_SIZE
       buffer_size += static_cast<size_t>(count);
       // PRINT_BUFFER_SIZE
-      if ((MAX_DATA_SIZE - (buffer_size + buffer_offset)) == 0) {
+      if ((capacity - (buffer_size + buffer_offset)) == 0) {
         //        PRINT_BUFFER_SIZE
         //        Logger::LogInfo("Buffer maximum size reached !!", LOG_DEBUG);
         return IO::IO_RESULT::FULL_BUFFER;
-      } else
+      } else {
+        // short read, the socket is drained
         result = IO::IO_RESULT::SUCCESS;
+        readDrained();
+      }
       done = true;
     }
   }
+  // nothing to hold, e.g. a spurious wakeup
+  if (new_buffer && buffer_size == 0) releaseBuffer();
   // PRINT_BUFFER_SIZE
   return result;
 }
 
+bool Connection::acquireBuffer() {
+  if (buffer != nullptr) return true;
+  buffer_class = 0;
+  buffer = BufferPool::local().get(buffer_class);
+  if (buffer == nullptr) {
+    Logger::logmsg(LOG_ERR, "fd: %d can not allocate the I/O buffer", fd_);
+    return false;
+  }
+  return true;
+}
+
+void Connection::releaseBuffer() {
+  if (buffer == nullptr) return;
+  BufferPool::local().put(buffer, buffer_class);
+  buffer = nullptr;
+  buffer_class = 0;
+  buffer_size = 0;
+  buffer_offset = 0;
+}
+
+bool Connection::growBuffer() {
+  if (buffer == nullptr) return acquireBuffer();
+  if (buffer_class + 1 >= BUFFER_POOL_CLASSES) return false;
+  auto bigger = BufferPool::local().get(buffer_class + 1);
+  if (bigger == nullptr) return false;
+  std::memcpy(bigger, buffer, buffer_offset + buffer_size);
+  BufferPool::local().put(buffer, buffer_class);
+  buffer = bigger;
+  buffer_class++;
+  return true;
+}
+
 std::string Connection::getPeerAddress() {
   if (this->fd_ > 0 && address_str.empty()) {
 	char addr[150];
@@ -112,14 +153,16 @@ int Connection::getLocalPort() {
 }
 
 void Connection::reset() {
-  this->disableEvents();
+  this->removeEvents();
   freeSsl();
-  buffer_size = 0;
-  buffer_offset = 0;
+  releaseBuffer();
+#if ENABLE_ZERO_COPY
+  releasePipe();
+#endif
   if (fd_ > 0) {
     // drain connecition socket data
-    while (::recv(fd_, buffer ,
-                     MAX_DATA_SIZE,MSG_DONTWAIT ) > 0);
+    char drain[4096];
+    while (::recv(fd_, drain, sizeof(drain), MSG_DONTWAIT) > 0);
     this->closeConnection();
   }
   fd_ = -1;
@@ -138,6 +181,9 @@ void Connection::reset() {
 void Connection::freeSsl() {
   this->ssl_connected = false;
   handshake_retries = 0;
+  handshake_cpu = 0;
+  ktls_send = false;
+  ktls_recv = false;
   if (ssl != nullptr) {
     SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
     SSL_shutdown(ssl);
@@ -162,113 +208,96 @@ void Connection::freeSsl() {
 }
 
 #if ENABLE_ZERO_COPY
-#if !FAKE_ZERO_COPY
-IO::IO_RESULT Connection::zeroRead() {
-  IO::IO_RESULT result = IO::IO_RESULT::ZERO_DATA;
-  for (;;) {
-    if (splice_pipe.bytes >= BUFSZ) {
-      result = IO::IO_RESULT::FULL_BUFFER;
-      break;
-    }
-    auto n = splice(fd_, nullptr, splice_pipe.pipe[1], nullptr, BUFSZ,
-                    SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
-    if (n > 0) splice_pipe.bytes += n;
-    if (n == 0) break;
-    if (n < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        result = IO::IO_RESULT::DONE_TRY_AGAIN;
-        break;
-      }
-      result = IO::IO_RESULT::ERROR;
-      break;
-    }
+bool Connection::acquirePipe() {
+  if (splice_pipe.isValid()) return true;
+  if (!SplicePipePool::local().get(splice_pipe)) {
+    Logger::logmsg(LOG_ERR, "fd: %d can not create the splice pipe: %s", fd_,
+                   std::strerror(errno));
+    return false;
   }
-  Logger::logmsg(LOG_REMOVE, "ZERO READ write %d  buffer %d", splice_pipe.bytes,
-                buffer_size);
-  return result;
+  return true;
 }
 
-IO::IO_RESULT Connection::zeroWrite(int dst_fd,
-                                    http_parser::HttpData &http_data) {
-  //  Logger::LogInfo("ZERO_BUFFER::SIZE = " + std::to_string(splice_pipe.bytes),
-  //  LOG_DEBUG);
+void Connection::releasePipe() {
+  if (!splice_pipe.isValid()) return;
+  SplicePipePool::local().put(splice_pipe);
+}
 
-  Logger::logmsg(LOG_REMOVE, "ZERO WRITE write %d  left %d  buffer %d",
-                splice_pipe.bytes, http_data.message_bytes_left, buffer_size);
-  while (splice_pipe.bytes > 0) {
-    int bytes = splice_pipe.bytes;
-    if (bytes > BUFSZ) bytes = BUFSZ;
-    auto n = ::splice(splice_pipe.pipe[0], nullptr, dst_fd, nullptr, bytes,
-                      SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
-    //    Logger::LogInfo("ZERO_BUFFER::SIZE = " +
-    //    std::to_string(splice_pipe.bytes), LOG_DEBUG);
-    if (n == 0) break;
-    if (n < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK)
-        return IO::IO_RESULT::DONE_TRY_AGAIN;
+IO::IO_RESULT Connection::zeroRead(size_t max_bytes, size_t &received) {
+  received = 0;
+  while (received < max_bytes && splice_pipe.room() > 0) {
+    auto count = ::splice(fd_, nullptr, splice_pipe.pipe[1], nullptr,
+                          std::min(max_bytes - received, splice_pipe.room()),
+                          SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+    if (count > 0) {
+      splice_pipe.bytes += static_cast<size_t>(count);
+      received += static_cast<size_t>(count);
+    } else if (count == 0) {
+      return received > 0 ? IO::IO_RESULT::SUCCESS : IO::IO_RESULT::FD_CLOSED;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      readDrained();
+      return IO::IO_RESULT::DONE_TRY_AGAIN;
+    } else if (errno != EINTR) {
+      Logger::logmsg(LOG_DEBUG, " splice() failed: %s", std::strerror(errno));
       return IO::IO_RESULT::ERROR;
     }
-    splice_pipe.bytes -= n;
-    http_data.message_bytes_left -= n;
   }
-  /* bytes > 0, add dst to epoll set */
-  /* else remove if it was added */
   return IO::IO_RESULT::SUCCESS;
 }
 
-#else
-IO::IO_RESULT Connection::zeroRead() {
-  IO::IO_RESULT result = IO::IO_RESULT::ZERO_DATA;
-  //  Logger::logmsg(LOG_REMOVE, "ZERO READ IN %d  buffer %d", splice_pipe.bytes,
-  //  buffer_size);
-  for (;;) {
-    if (splice_pipe.bytes >= BUFSZ) {
-      result = IO::IO_RESULT::FULL_BUFFER;
-      break;
-    }
-    auto n =
-        ::read(fd_, buffer_aux + splice_pipe.bytes, BUFSZ - splice_pipe.bytes);
-    if (n > 0) splice_pipe.bytes += n;
-    if (n == 0) break;
-    if (n < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        result = IO::IO_RESULT::DONE_TRY_AGAIN;
-        break;
-      }
-      result = IO::IO_RESULT::ERROR;
-      break;
+IO::IO_RESULT Connection::zeroReadFraming(http::ChunkedParser &parser,
+                                          size_t &received) {
+  char framing[SPLICE_FRAMING_SIZE];
+  received = 0;
+  auto size = std::min(sizeof(framing), splice_pipe.room());
+  if (size == 0) return IO::IO_RESULT::FULL_BUFFER;
+  // look at the framing first, the chunk data behind it stays in the socket
+  auto count = ::recv(fd_, framing, size, MSG_PEEK);
+  if (count == 0) return IO::IO_RESULT::FD_CLOSED;
+  if (count < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      readDrained();
+      return IO::IO_RESULT::DONE_TRY_AGAIN;
     }
+    Logger::logmsg(LOG_DEBUG, " recv() failed: %s", std::strerror(errno));
+    return IO::IO_RESULT::ERROR;
   }
-  //  Logger::logmsg(LOG_REMOVE, "ZERO READ OUT %d  buffer %d",
-  //  splice_pipe.bytes, buffer_size);
-  return result;
+  auto consumed = parser.parse(framing, static_cast<size_t>(count));
+  if (parser.failed()) {
+    Logger::logmsg(LOG_DEBUG, "fd: %d malformed chunked body", fd_);
+    return IO::IO_RESULT::ERROR;
+  }
+  if (::recv(fd_, framing, consumed, 0) != static_cast<ssize_t>(consumed) ||
+      ::write(splice_pipe.pipe[1], framing, consumed) !=
+          static_cast<ssize_t>(consumed))
+    return IO::IO_RESULT::ERROR;
+  splice_pipe.bytes += consumed;
+  received = consumed;
+  return IO::IO_RESULT::SUCCESS;
 }
 
-IO::IO_RESULT Connection::zeroWrite(int dst_fd,
-                                    http_parser::HttpData &http_data) {
-  //  Logger::logmsg(LOG_REMOVE, "ZERO WRITE write %d  left %d  buffer %d",
-  //  splice_pipe.bytes, http_data.message_bytes_left, buffer_size);
-  int sent = 0;
+IO::IO_RESULT Connection::zeroWrite(int dst_fd, size_t &sent) {
+  sent = 0;
+  auto result = IO::IO_RESULT::SUCCESS;
   while (splice_pipe.bytes > 0) {
-    int bytes = splice_pipe.bytes;
-    if (bytes > BUFSZ) bytes = BUFSZ;
-    auto n = ::write(dst_fd, buffer_aux + sent, bytes - sent);
-    if (n == 0) break;
-    if (n < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK)
-        return IO::IO_RESULT::DONE_TRY_AGAIN;
+    auto count = ::splice(splice_pipe.pipe[0], nullptr, dst_fd, nullptr,
+                          splice_pipe.bytes, SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+    if (count > 0) {
+      splice_pipe.bytes -= static_cast<size_t>(count);
+      sent += static_cast<size_t>(count);
+    } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      writeBlocked(dst_fd);
+      result = IO::IO_RESULT::DONE_TRY_AGAIN;
+      break;
+    } else if (count == 0 || errno != EINTR) {
+      Logger::logmsg(LOG_DEBUG, " splice() failed: %s", std::strerror(errno));
       return IO::IO_RESULT::ERROR;
     }
-    splice_pipe.bytes -= n;
-    http_data.message_bytes_left -= n;
-    sent += n;
   }
-  /* bytes > 0, add dst to epoll set */
-  /* else remove if it was added */
-  return IO::IO_RESULT::SUCCESS;
+  SplicePipePool::spliced_bytes += sent;
+  return result;
 }
 #endif
-#endif
 IO::IO_RESULT Connection::writeTo(int fd, size_t &sent) {
   bool done = false;
   sent = 0;
@@ -287,6 +316,7 @@ IO::IO_RESULT Connection::writeTo(int fd, size_t &sent) {
         result = IO::IO_RESULT::ERROR;
       } else {
         result = IO::IO_RESULT::DONE_TRY_AGAIN;
+        writeBlocked(fd);
       }
       done = true;
       break;
@@ -322,7 +352,10 @@ IO::IO_RESULT Connection::writeTo(int target_fd,
   //  IO RESULT: %s\n", http_data.iov.size(),
   //                iovec_written, nwritten,
   //                IO::getResultString(result).data());
-  if (result != IO::IO_RESULT::SUCCESS) return result;
+  if (result != IO::IO_RESULT::SUCCESS) {
+    if (result == IO::IO_RESULT::DONE_TRY_AGAIN) writeBlocked(target_fd);
+    return result;
+  }
 
   buffer_size = buffer_size - buffer_offset;
   if (buffer_size == 0) buffer_offset = 0;
@@ -424,6 +457,7 @@ IO::IO_RESULT Connection::write(const char *data, size_t size, size_t &sent) {
         result = IO::IO_RESULT::ERROR;
       } else {
         result = IO::IO_RESULT::DONE_TRY_AGAIN;
+        writeBlocked();
       }
       done = true;
       break;
@@ -26,37 +26,14 @@
 #include "../http/http_request.h"
 #include "../ssl/ssl_common.h"
 #include "../util/utils.h"
+#include "buffer_pool.h"
+#include "splice_pipe_pool.h"
 #include <atomic>
 #include <fcntl.h>
 #include <netdb.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
-#ifndef MAX_DATA_SIZE
-#define MAX_DATA_SIZE (1024 * 32)
-#endif
-
-#define FAKE_ZERO_COPY 0
-
-#if ENABLE_ZERO_COPY
-
-#define BUFSZ MAX_DATA_SIZE
-
-struct SplicePipe {
-  int pipe[2];
-  int bytes{0};
-  SplicePipe() {
-    if (pipe2(pipe, O_NONBLOCK) < 0) {
-      perror("pipe");
-    }
-  }
-  ~SplicePipe() {
-    close(pipe[0]);
-    close(pipe[1]);
-  }
-};
-
-#endif
 using namespace events;
 class Connection : public Descriptor {
  protected:
@@ -66,10 +43,8 @@ class Connection : public Descriptor {
 //  std::time_t date;
 //  std::string str_buffer;
 #if ENABLE_ZERO_COPY
+  /** Pipe of a spliced body, only held from the SplicePipePool meanwhile. */
   SplicePipe splice_pipe;
-#if FAKE_ZERO_COPY
-  char buffer_aux[MAX_DATA_SIZE];
-#endif
 #endif
   std::string address_str{""};        // the remote socket ip
   std::string local_address_str{""};  // the local socket ip
@@ -78,9 +53,19 @@ class Connection : public Descriptor {
   addrinfo *address;
 
   // StringBuffer string_buffer;
-  char buffer[MAX_DATA_SIZE];
+  /** I/O buffer, only held from the BufferPool while there is data. */
+  char *buffer{nullptr};
+  /** BufferPool size class of the buffer. */
+  size_t buffer_class{0};
   size_t buffer_size{0};
   size_t buffer_offset{0};  // TODO::REMOVE
+  /** @brief Returns the size of the buffer, 0 if there is none. */
+  inline size_t bufferCapacity() const {
+    return buffer == nullptr ? 0 : BufferPool::classSize(buffer_class);
+  }
+  bool acquireBuffer();
+  void releaseBuffer();
+  bool growBuffer();
   std::string getPeerAddress();
   std::string getLocalAddress();
   int getPeerPort();
@@ -88,8 +73,29 @@ class Connection : public Descriptor {
   void reset();
   void freeSsl();
 #if ENABLE_ZERO_COPY
-  IO::IO_RESULT zeroRead();
-  IO::IO_RESULT zeroWrite(int dst_fd, http_parser::HttpData &http_data);
+  bool acquirePipe();
+  void releasePipe();
+  /**
+   * @brief Splices up to @p max_bytes from the connection into the pipe,
+   * as many as fit.
+   *
+   * @param received is set to the number of bytes spliced.
+   */
+  IO::IO_RESULT zeroRead(size_t max_bytes, size_t &received);
+  /**
+   * @brief Moves the chunked framing at the head of the connection into the
+   * pipe, up to the next chunk data or the end of the body, as parsed by
+   * @p parser. Only the framing bytes are copied.
+   *
+   * @param received is set to the number of bytes moved.
+   */
+  IO::IO_RESULT zeroReadFraming(http::ChunkedParser &parser, size_t &received);
+  /**
+   * @brief Splices the pipe content to @p dst_fd.
+   *
+   * @param sent is set to the number of bytes spliced.
+   */
+  IO::IO_RESULT zeroWrite(int dst_fd, size_t &sent);
 #endif
   static IO::IO_RESULT writeIOvec(int target_fd, iovec *iov, size_t iovec_size,
 								  size_t &iovec_written, size_t &nwritten);
@@ -116,6 +122,8 @@ class Connection : public Descriptor {
  public:
   ssl::SSL_STATUS ssl_conn_status{ssl::SSL_STATUS::NONE};
   int handshake_retries{0};
+  /** Thread CPU time spent in the handshake, in microseconds. */
+  uint64_t handshake_cpu{0};
   SSL *ssl{nullptr};
   // socket bio
   BIO *sbio{nullptr};
@@ -125,4 +133,8 @@ class Connection : public Descriptor {
   BIO *ssl_bio{nullptr};
   const char *server_name{nullptr};
   std::atomic<bool> ssl_connected;
+  /** The kernel encrypts the records sent, kTLS offload. */
+  bool ktls_send{false};
+  /** The kernel decrypts the records received, kTLS offload. */
+  bool ktls_recv{false};
 };
@@ -0,0 +1,130 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/** Capacity requested for each pipe, the kernel default is 64KB. */
+#define SPLICE_PIPE_SIZE (1024 * 256)
+/** Free pipes kept by a worker for reuse. */
+#define SPLICE_POOL_MAX_FREE 64
+/** Smallest known length body spliced, smaller ones are cheaper to copy. */
+#define SPLICE_MIN_BODY (1024 * 64)
+/** Bytes peeked at a time to parse the framing of a chunked body. */
+#define SPLICE_FRAMING_SIZE 64
+
+/** @brief Kernel pipe a message body is spliced through. */
+struct SplicePipe {
+  /** Read and write ends, -1 if the pipe is not held. */
+  int pipe[2]{-1, -1};
+  /** Bytes in the pipe not yet spliced out. */
+  size_t bytes{0};
+  /** Bytes the pipe can hold. */
+  size_t capacity{0};
+  inline bool isValid() const { return pipe[0] >= 0; }
+  inline size_t room() const { return capacity - bytes; }
+};
+
+/**
+ * @class SplicePipePool splice_pipe_pool.h "src/connection/splice_pipe_pool.h"
+ * @brief Per thread cache of the pipes used to splice message bodies.
+ *
+ * A connection only holds a pipe while it relays a body with splice(), so
+ * the file descriptors are not pinned by idle or small message connections.
+ * The pipes are enlarged to SPLICE_PIPE_SIZE once, on creation, and each
+ * thread keeps up to SPLICE_POOL_MAX_FREE free ones in LIFO order. A pipe
+ * given back with data in it, from an aborted relay, is closed instead, its
+ * data belongs to a message that will never be completed.
+ */
+class SplicePipePool {
+  std::vector<SplicePipe> free_pipes;
+
+  SplicePipePool() = default;
+
+ public:
+  /** Pipes created by all the threads. */
+  inline static std::atomic<int> total_pipes{0};
+  /** Pipes held by connections. */
+  inline static std::atomic<int> used_pipes{0};
+  /** Body bytes relayed through the pipes. */
+  inline static std::atomic<uint64_t> spliced_bytes{0};
+
+  SplicePipePool(const SplicePipePool &) = delete;
+  SplicePipePool &operator=(const SplicePipePool &) = delete;
+  ~SplicePipePool() {
+    for (auto &splice_pipe : free_pipes) close(splice_pipe);
+  }
+
+  /** @brief Returns the pool of the calling thread. */
+  static SplicePipePool &local() {
+    static thread_local SplicePipePool pool;
+    return pool;
+  }
+
+  /**
+   * @brief Takes a pipe into @p splice_pipe.
+   *
+   * @return @c false if a new pipe could not be created.
+   */
+  bool get(SplicePipe &splice_pipe) {
+    if (!free_pipes.empty()) {
+      splice_pipe = free_pipes.back();
+      free_pipes.pop_back();
+    } else {
+      if (::pipe2(splice_pipe.pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+        splice_pipe.pipe[0] = splice_pipe.pipe[1] = -1;
+        return false;
+      }
+      // the size may be capped by /proc/sys/fs/pipe-max-size, keep the default
+      ::fcntl(splice_pipe.pipe[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE);
+      auto capacity = ::fcntl(splice_pipe.pipe[1], F_GETPIPE_SZ);
+      splice_pipe.capacity = capacity > 0 ? static_cast<size_t>(capacity) : 0;
+      splice_pipe.bytes = 0;
+      total_pipes++;
+    }
+    used_pipes++;
+    return true;
+  }
+
+  /** @brief Gives back a @p splice_pipe taken with get(). */
+  void put(SplicePipe &splice_pipe) {
+    used_pipes--;
+    if (splice_pipe.bytes == 0 && free_pipes.size() < SPLICE_POOL_MAX_FREE)
+      free_pipes.push_back(splice_pipe);
+    else
+      close(splice_pipe);
+    splice_pipe = SplicePipe();
+  }
+
+  /** @brief Returns the number of free pipes of the calling thread. */
+  size_t freePipes() const { return free_pipes.size(); }
+
+ private:
+  static void close(SplicePipe &splice_pipe) {
+    ::close(splice_pipe.pipe[0]);
+    ::close(splice_pipe.pipe[1]);
+    total_pipes--;
+  }
+};
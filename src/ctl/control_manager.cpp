@@ -48,14 +48,26 @@ bool ctl::ControlManager::init(Config &configuration, ctl::CTL_INTERFACE_MODE li
   }
   if (listener_mode == CTL_INTERFACE_MODE::CTL_UNIX) {
     control_path_name = configuration.ctrl_name;
-    control_listener.listen(control_path_name);
+    control_key = "ctl:" + control_path_name;
+    // an upgraded process keeps the control socket of the previous binary
+    int inherited_fd = SocketHandoff::takeInherited(control_key);
+    if (inherited_fd > 0)
+      control_listener.setFileDescriptor(inherited_fd);
+    else
+      control_listener.listen(control_path_name);
     if (!configuration.ctrl_user.empty())
       Environment::setFileUserName(std::string(configuration.ctrl_user), control_path_name);
     if (!configuration.ctrl_group.empty())
       Environment::setFileGroupName(std::string(configuration.ctrl_group), control_path_name);
     if (configuration.ctrl_mode > 0) Environment::setFileUserMode(configuration.ctrl_mode, control_path_name);
   } else {
-    control_listener.listen(configuration.ctrl_ip, configuration.ctrl_port);
+    control_key = "ctl:" + SocketHandoff::listenerKey(configuration.ctrl_ip,
+                                                      configuration.ctrl_port);
+    int inherited_fd = SocketHandoff::takeInherited(control_key);
+    if (inherited_fd > 0)
+      control_listener.setFileDescriptor(inherited_fd);
+    else
+      control_listener.listen(configuration.ctrl_ip, configuration.ctrl_port);
   }
   handleAccept(control_listener.getFileDescriptor());
   return true;
@@ -81,6 +93,21 @@ void ctl::ControlManager::stop() {
   if(this->control_thread.joinable()) this->control_thread.join();
 }
 
+bool ControlManager::handOver(int channel_fd) {
+  if (control_listener.getFileDescriptor() <= 0) return true;
+  return SocketHandoff::sendSocket(channel_fd,
+                                   control_listener.getFileDescriptor(),
+                                   control_key);
+}
+
+void ControlManager::release() {
+  if (control_listener.getFileDescriptor() <= 0) return;
+  stopAccept(control_listener.getFileDescriptor());
+  control_listener.closeConnection();
+  // the path belongs to the upgraded process now
+  control_path_name.clear();
+}
+
 void ControlManager::sendCtlCommand(CTL_COMMAND command,
                                     CTL_HANDLER_TYPE handler,
                                     CTL_SUBJECT subject, std::string data) {
@@ -277,6 +304,13 @@ bool ControlManager::setTaskTarget(HttpRequest &request, CtlTask &task) {
         }
         break;
       }
+      case 'u': {
+        if (str == JSON_KEYS::UPGRADE) {
+          task.target = CTL_HANDLER_TYPE::LISTENER_MANAGER;
+          task.subject = CTL_SUBJECT::UPGRADE;
+        }
+        break;
+      }
       case 'w':{
         if (task.subject  == CTL_SUBJECT::DEBUG) {
           task.target = CTL_HANDLER_TYPE::STREAM_MANAGER;
@@ -305,6 +339,8 @@ bool ControlManager::setListenerTarget(CtlTask &task, std::istringstream &ss) {
         task.subject = CTL_SUBJECT::STATUS;
       } else if (str == JSON_KEYS::DEBUG) {
         task.subject = CTL_SUBJECT::DEBUG;
+      } else if (str == JSON_KEYS::TICKET_KEYS) {
+        task.subject = CTL_SUBJECT::TICKET_KEYS;
 #if WAF_ENABLED
       } else if (str == JSON_KEYS::WAF) {
         task.subject = CTL_SUBJECT::RELOAD_WAF;
@@ -27,6 +27,7 @@
 #include "../http/http_request.h"
 #include "../json/json.h"
 #include "../util/environment.h"
+#include "../util/socket_handoff.h"
 #include "ctl.h"
 #include "observer.h"
 #include <atomic>
@@ -41,6 +42,7 @@ class ControlManager : public EpollManager, public CtlNotify<CtlTask, std::strin
   std::atomic<bool> is_running;
   CTL_INTERFACE_MODE ctl_listener_mode;
   std::string control_path_name;
+  std::string control_key;
   void HandleEvent(int fd, EVENT_TYPE event_type, EVENT_GROUP event_group) override;
   void doWork();
 
@@ -52,6 +54,16 @@ class ControlManager : public EpollManager, public CtlNotify<CtlTask, std::strin
   bool init(Config &configuration, CTL_INTERFACE_MODE listener_mode = CTL_INTERFACE_MODE::CTL_UNIX);
   void start();
   void stop();
+  /**
+   * @brief Sends the control socket to an upgraded process through
+   * @p channel_fd.
+   */
+  bool handOver(int channel_fd);
+  /**
+   * @brief Stops accepting control requests, the upgraded process serves
+   * them from now on.
+   */
+  void release();
   void sendCtlCommand(CTL_COMMAND command, CTL_HANDLER_TYPE handler,
                       CTL_SUBJECT subject, std::string data = "");
 
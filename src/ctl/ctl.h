@@ -62,6 +62,8 @@ enum class CTL_SUBJECT {
   WEIGHT,
   DEBUG,
   S_BACKEND,
+  UPGRADE,
+  TICKET_KEYS,
 #if CACHE_ENABLED
   CACHE,
 #endif
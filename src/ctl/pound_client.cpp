@@ -80,6 +80,9 @@ void PoundClient::showHelp(const std::string error, bool exit_on_error) {
   std::cout << "\t-l n - disable listener n" << std::endl;
   std::cout << "\t-R n - reload the listener configuration from file"
             << std::endl;
+  std::cout << "\t-U - upgrade to the zproxy binary installed, keeping the "
+               "listeners"
+            << std::endl;
   std::cout << "\t-S n m - enable service m in listener n (use -1 for "
                "global services)"
             << std::endl;
@@ -172,6 +175,10 @@ bool PoundClient::executeCommand() {
     path = "/config";
     method = http::REQUEST_METHOD::UPDATE;
   }
+  if (ctl_command == CTL_ACTION::UPGRADE) {
+    path = "/upgrade";
+    method = http::REQUEST_METHOD::UPDATE;
+  }
   if (ctl_command_subject == CTL_SUBJECT::SESSION) {
     path += "/service/" + std::to_string(service_id) + "/session/";
     switch (ctl_command) {
@@ -295,6 +302,10 @@ bool PoundClient::init(int argc, char *argv[]) {
         trySetAllTargetId(argv, optind);
         break;
       }
+      case 'U': {
+        ctl_command = CTL_ACTION::UPGRADE;
+        break;
+      }
       case 'L': {
         ctl_command = CTL_ACTION::ENABLE;
         ctl_command_subject = CTL_SUBJECT::LISTENER;
@@ -383,6 +394,9 @@ bool PoundClient::init(int argc, char *argv[]) {
       case CTL_ACTION::RELOAD:
         action_message = "Reload WAF rulesets";
         break;
+      case CTL_ACTION::UPGRADE:
+        action_message = "Upgrade binary";
+        break;
     }
 
     if (!session_key.empty()) {
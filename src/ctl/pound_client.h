@@ -46,6 +46,7 @@ static const struct option long_options[] = {
     {"add-session", required_argument, nullptr, 'N'},
     {"delete-session", required_argument, nullptr, 'n'},
     {"reload-listener-conf", required_argument, nullptr, 'R'},
+    {"upgrade-binary", no_argument, nullptr, 'U'},
 
     {"enable-XML-output", no_argument, nullptr, 'X'},
     {"resolve-host", no_argument, nullptr, 'H'},
@@ -60,13 +61,14 @@ enum class CTL_ACTION {
   DISABLE,
   ADD_SESSION,
   DELETE_SESSION,
-  FLUSH_SESSIONS
+  FLUSH_SESSIONS,
+  UPGRADE
 };
 
 struct OptionArgs {};
 
 class PoundClient /*: public EpollManager*/ {
-  const char *options_string = "a:vc:LlRSsBbNnfXH";
+  const char *options_string = "a:vc:LlRSsBbNnfXHU";
   std::string binary_name;    /*argv[0]*/
   std::string control_socket; /* -c option */
   std::string session_key;    /* -k option */
@@ -40,12 +40,49 @@ class Descriptor {
   }
 
   inline void setEventManager(events::EpollManager &event_manager) { event_manager_ = &event_manager; }
+
+  /**
+   * @brief Detaches the descriptor from its event manager, so it can be used
+   * from another thread. Its events are not changed until setEventManager()
+   * is called again, disable them first.
+   */
+  inline void detachEventManager() { event_manager_ = nullptr; }
   inline bool disableEvents() {
+    current_event = events::EVENT_TYPE::NONE;
+    if (event_manager_ != nullptr && fd_ > 0) return event_manager_->disableFd(fd_);
+    return false;
+  }
+
+  /** @brief Removes the descriptor from the event manager, before closing it. */
+  inline bool removeEvents() {
     current_event = events::EVENT_TYPE::NONE;
     if (event_manager_ != nullptr && fd_ > 0) return event_manager_->deleteFd(fd_);
     return false;
   }
 
+  /**
+   * @brief Same contract as read(2). The event manager may have received the
+   * data already, see EpollManager::enableRecv().
+   */
+  inline ssize_t receive(void *buf, size_t len) {
+    if (event_manager_ != nullptr) return event_manager_->recv(fd_, buf, len);
+    return ::read(fd_, buf, len);
+  }
+
+  /** @brief Tells the event manager that a read of the descriptor would block. */
+  inline void readDrained() {
+    if (event_manager_ != nullptr) event_manager_->setReadDrained(fd_);
+  }
+
+  /**
+   * @brief Tells the event manager that a write to @p fd would block. It is
+   * the descriptor itself or the peer of the same stream it is relayed to.
+   */
+  inline void writeBlocked(int fd) {
+    if (event_manager_ != nullptr) event_manager_->setWriteBlocked(fd);
+  }
+  inline void writeBlocked() { writeBlocked(fd_); }
+
   inline bool enableEvents(events::EpollManager *epoll_manager, events::EVENT_TYPE event_type,
                            events::EVENT_GROUP event_group) {
     if (epoll_manager != nullptr && fd_ > 0) {
@@ -22,16 +22,94 @@
 #include "epoll_manager.h"
 #include "../debug/logger.h"
 #include "../util/network.h"
+#include <algorithm>
 #include <climits>
 namespace events {
 
-EpollManager::EpollManager() : accept_fd_set() {
+EpollManager::EpollManager(EVENT_ENGINE engine) : accept_fd_set() {
   if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
     std::string error = "epoll_create(2) failed: ";
     error += std::strerror(errno);
     Logger::LogInfo(error, LOG_ERR);
     throw std::system_error(errno, std::system_category());
   }
+  if (engine == EVENT_ENGINE::IO_URING) {
+#if ENABLE_IO_URING
+    io_uring = std::make_unique<IoUringPoller>();
+    if (!io_uring->init()) {
+      Logger::logmsg(LOG_NOTICE, "io_uring not available, using epoll");
+      io_uring.reset();
+    }
+#else
+    Logger::logmsg(LOG_NOTICE, "io_uring support not built in, using epoll");
+#endif
+  }
+}
+
+int EpollManager::ctl(int op, int fd, epoll_event *event) {
+  ctl_calls++;
+#if ENABLE_IO_URING
+  if (io_uring != nullptr) return io_uring->ctl(op, fd, event);
+#endif
+  return epoll_ctl(epoll_fd, op, fd, event);
+}
+
+void EpollManager::setEdgeTriggered(bool enable) {
+  if (enable && getEventEngine() != EVENT_ENGINE::EPOLL) {
+    Logger::logmsg(LOG_NOTICE,
+                   "edge triggered events are only supported with epoll");
+    return;
+  }
+  edge_triggered = enable;
+}
+
+EVENT_ENGINE EpollManager::getEventEngine() const {
+#if ENABLE_IO_URING
+  if (io_uring != nullptr) return EVENT_ENGINE::IO_URING;
+#endif
+  return EVENT_ENGINE::EPOLL;
+}
+
+uint64_t EpollManager::getSyscalls() const {
+#if ENABLE_IO_URING
+  if (io_uring != nullptr) return io_uring->enter_calls + io_uring->read_calls;
+#endif
+  return wait_calls + ctl_calls + read_calls;
+}
+
+bool EpollManager::enableRecv(int fd) {
+#if ENABLE_IO_URING
+  if (io_uring != nullptr) return io_uring->enableRecv(fd);
+#else
+  static_cast<void>(fd);
+#endif
+  return false;
+}
+
+bool EpollManager::isRecvEnabled(int fd) const {
+#if ENABLE_IO_URING
+  if (io_uring != nullptr) return io_uring->isRecvEnabled(fd);
+#else
+  static_cast<void>(fd);
+#endif
+  return false;
+}
+
+bool EpollManager::hasRecvData(int fd) const {
+#if ENABLE_IO_URING
+  if (io_uring != nullptr) return io_uring->hasRecvData(fd);
+#else
+  static_cast<void>(fd);
+#endif
+  return false;
+}
+
+ssize_t EpollManager::recv(int fd, void *buf, size_t len) {
+#if ENABLE_IO_URING
+  if (io_uring != nullptr) return io_uring->recv(fd, buf, len);
+#endif
+  read_calls++;
+  return ::read(fd, buf, len);
 }
 
 /** Handles the connect events. */
@@ -65,7 +143,8 @@ void EpollManager::onReadEvent(epoll_event &event) {
 }
 
 bool EpollManager::deleteFd(int fd) {
-  if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) < 0) {
+  if (static_cast<size_t>(fd) < fd_states.size()) fd_states[fd] = FdState();
+  if (ctl(EPOLL_CTL_DEL, fd, nullptr) < 0) {
     if (errno == ENOENT || errno == EBADF || errno == EPERM) {
       //      std::string error = "epoll_ctl(delete) unnecessary. ";
       //      error += std::strerror(errno);
@@ -83,54 +162,148 @@ bool EpollManager::deleteFd(int fd) {
   return true;
 }
 
-int EpollManager::loopOnce(int time_out) {
-  int fd, i, ev_count = 0;
-  ev_count = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENT, time_out);
-  Time::updateTime();
-#if USE_TIMER_FD_TIMEOUT==0
-  for (auto it= timeouts.begin(); it != timeouts.end();) {
-    if (it->second.timeout > 0) {
-      if (Time::getTimeSec() - it->second.last_seent > it->second.timeout) {
-        it->second.timeout = 0;
-        onTimeOut(it->first, it->second.type);
+bool EpollManager::disableFd(int fd) {
+#if ENABLE_IO_URING
+  // deleting it would drop the data already received
+  if (io_uring != nullptr && io_uring->isRecvEnabled(fd)) {
+    io_uring->disable(fd);
+#if USE_TIMER_FD_TIMEOUT == 0
+    deleteTimeOut(fd);
+#endif
+    return true;
+  }
+#endif
+  auto state = getFdState(fd);
+  if (state == nullptr) return deleteFd(fd);
+  state->flags &= ~(FD_WANT_READ | FD_WANT_WRITE | FD_ONESHOT);
+#if USE_TIMER_FD_TIMEOUT == 0
+  deleteTimeOut(fd);
+#endif
+  return true;
+}
+
+void EpollManager::setWantedEvents(int fd, FdState &state,
+                                   EVENT_TYPE event_type) {
+  state.flags &= ~(FD_WANT_READ | FD_WANT_WRITE | FD_ONESHOT);
+  switch (event_type) {
+    case EVENT_TYPE::READ:
+      state.flags |= FD_WANT_READ;
+      break;
+    case EVENT_TYPE::READ_ONESHOT:
+      state.flags |= FD_WANT_READ | FD_ONESHOT;
+      break;
+    case EVENT_TYPE::WRITE:
+      state.flags |= FD_WANT_WRITE | FD_ONESHOT;
+      break;
+    case EVENT_TYPE::ANY:
+      state.flags |= FD_WANT_READ | FD_WANT_WRITE | FD_ONESHOT;
+      break;
+    default:
+      break;
+  }
+  // the kernel will not report again what is already ready
+  if (readyEvents(state) != 0 && (state.flags & FD_QUEUED) == 0) {
+    state.flags |= FD_QUEUED;
+    ready_set.push_back(fd);
+  }
+}
+
+void EpollManager::dispatchReady(int fd) {
+  auto state = getFdState(fd);
+  if (state == nullptr) return;
+  epoll_event event = {};
+  event.events = readyEvents(*state);
+  if (event.events == 0) return;
+  if ((state->flags & FD_ONESHOT) != 0)
+    state->flags &= ~(FD_WANT_READ | FD_WANT_WRITE | FD_ONESHOT);
+  event.data.u64 = static_cast<uint64_t>(fd);
+  event.data.u64 <<= CHAR_BIT;
+  event.data.u64 |= static_cast<char>(state->group) & 0xff;
+  dispatchEvent(event);
+  // level triggered read not drained by the handler, as epoll would do, keep
+  // reporting it. The handler may have added fds, so look the state up again.
+  state = getFdState(fd);
+  if (state != nullptr && (state->flags & FD_QUEUED) == 0 &&
+      readyEvents(*state) != 0) {
+    state->flags |= FD_QUEUED;
+    ready_set.push_back(fd);
+  }
+}
+
+void EpollManager::dispatchEvent(epoll_event &event) {
+  int fd = static_cast<int>(event.data.u64 >> CHAR_BIT);
+  auto event_group = static_cast<EVENT_GROUP>(event.data.u64 & 0xff);
+  if ((event.events & EPOLLERR) != 0u) {
+    HandleEvent(fd, EVENT_TYPE::DISCONNECT, event_group);
+    return;
+  }
+  if ((event.events & EPOLLIN) != 0u) {
+    if (event_group == EVENT_GROUP::ACCEPTOR) {
+      for (auto accept_fd : accept_fd_set) {
+        if (fd == accept_fd) {
+          onConnectEvent(event);
+          continue;
+        }
       }
-      it++;
     } else {
-      it = timeouts.erase(it);
+      onReadEvent(event);
     }
   }
+  if ((event.events & (EPOLLRDHUP | EPOLLHUP)) != 0u) {
+    HandleEvent(fd, EVENT_TYPE::DISCONNECT, event_group);
+    return;
+  }
+  if ((event.events & EPOLLOUT) != 0u) {
+    onWriteEvent(event);
+  }
+}
+
+int EpollManager::loopOnce(int time_out) {
+  int fd, i, ev_count = 0;
+  // pending edge triggered readiness, do not wait for new events
+  if (!ready_set.empty()) time_out = 0;
+#if ENABLE_IO_URING
+  if (io_uring != nullptr)
+    ev_count = io_uring->wait(events, MAX_EPOLL_EVENT, time_out);
+  else
+#endif
+  {
+    wait_calls++;
+    ev_count = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENT, time_out);
+  }
+  Time::updateTime();
+#if USE_TIMER_FD_TIMEOUT==0
+  timeouts.advance(Time::getTimeSec(),
+                   [this](int timeout_fd, TIMEOUT_TYPE type) {
+                     onTimeOut(timeout_fd, type);
+                   });
 #endif
 
-  if (ev_count <= 0) return ev_count;
   for (i = 0; i < ev_count; ++i) {
     fd = static_cast<int>(events[i].data.u64 >> CHAR_BIT);
-    auto event_group = static_cast<EVENT_GROUP>(events[i].data.u64 & 0xff);
-    if ((events[i].events & EPOLLERR) != 0u) {
-      HandleEvent(fd, EVENT_TYPE::DISCONNECT, event_group);
+    auto state = getFdState(fd);
+    if (state == nullptr) {
+      dispatchEvent(events[i]);
       continue;
-    } else {
-      if ((events[i].events & EPOLLIN) != 0u) {
-        if (event_group == EVENT_GROUP::ACCEPTOR) {
-          for (auto accept_fd : accept_fd_set) {
-            if (fd == accept_fd) {
-              onConnectEvent(events[i]);
-              continue;
-            }
-          }
-        } else {
-          onReadEvent(events[i]);
-        }
-      }
-      if ((events[i].events & (EPOLLRDHUP | EPOLLHUP)) != 0u) {
-        HandleEvent(fd, EVENT_TYPE::DISCONNECT, event_group);
-        continue;
-      }
-      if ((events[i].events & EPOLLOUT) != 0u) {
-        onWriteEvent(events[i]);
-      }
     }
+    // edge triggered, record the readiness and report the wanted events
+    if ((events[i].events & EPOLLIN) != 0u) state->flags |= FD_READ_READY;
+    if ((events[i].events & EPOLLOUT) != 0u) state->flags &= ~FD_WRITE_BLOCKED;
+    if ((events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0u)
+      state->flags |= FD_HANGUP;
+    dispatchReady(fd);
   }
-
+  if (ready_set.empty()) return ev_count;
+  if (ev_count < 0) ev_count = 0;
+  dispatch_set.swap(ready_set);
+  for (auto ready_fd : dispatch_set) {
+    auto state = getFdState(ready_fd);
+    if (state == nullptr || (state->flags & FD_QUEUED) == 0) continue;
+    state->flags &= ~FD_QUEUED;
+    dispatchReady(ready_fd);
+    ev_count++;
+  }
+  dispatch_set.clear();
   return ev_count;
 }
 
@@ -147,11 +320,14 @@ bool EpollManager::addFd(int fd, EVENT_TYPE event_type,
                          EVENT_GROUP event_group, int time_out) {
   //  std::lock_guard<std::mutex> loc(epoll_mutex);
   struct epoll_event epevent = {};
-  epevent.events = static_cast<uint32_t>(event_type);
+  bool persistent = edge_triggered && (event_group == EVENT_GROUP::CLIENT ||
+                                       event_group == EVENT_GROUP::SERVER);
+  epevent.events = persistent ? EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP
+                              : static_cast<uint32_t>(event_type);
   epevent.data.u64 = static_cast<uint64_t>(fd);
   epevent.data.u64 <<= CHAR_BIT;
   epevent.data.u64 |= static_cast<char>(event_group) & 0xff;
-  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &epevent) < 0) {
+  if (ctl(EPOLL_CTL_ADD, fd, &epevent) < 0) {
     if (errno == EEXIST) {
       return updateFd(fd, event_type, event_group);
     } else {
@@ -161,6 +337,16 @@ bool EpollManager::addFd(int fd, EVENT_TYPE event_type,
       return false;
     }
   }
+  if (persistent) {
+    if (static_cast<size_t>(fd) >= fd_states.size())
+      fd_states.resize(std::max(static_cast<size_t>(fd) + 1,
+                                fd_states.size() * 2));
+    // the kernel reports the current readiness once it is added
+    auto &state = fd_states[fd];
+    state.flags = FD_PERSISTENT | FD_WRITE_BLOCKED;
+    state.group = event_group;
+    setWantedEvents(fd, state, event_type);
+  }
 #if DEBUG_EVENT_MANAGER
   Logger::LogInfo("Epoll::AddFD " + std::to_string(fd) +
                  " To EpollFD: " + std::to_string(epoll_fd),
@@ -196,22 +382,29 @@ bool EpollManager::updateFd(int fd, EVENT_TYPE event_type,
 #if DEBUG_EVENT_MANAGER
   Logger::LogInfo("Epoll::UpdateFd " + std::to_string(fd), LOG_DEBUG);
 #endif
-  struct epoll_event epevent = {};
-  epevent.events = static_cast<uint32_t>(event_type);
-  epevent.data.u64 = static_cast<uint64_t>(fd);
-  epevent.data.u64 <<= CHAR_BIT;
-  epevent.data.u64 |= static_cast<char>(event_group) & 0xff;
-  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &epevent) < 0) {
-    if (errno == ENOENT) {
-      std::string error = "epoll_ctl(update) failed, fd reopened, adding .. ";
-      error += std::strerror(errno);
-      Logger::LogInfo(error, LOG_DEBUG);
-      return addFd(fd, event_type, event_group);
-    } else {
-      std::string error = "epoll_ctl(update) failed ";
-      error += std::strerror(errno);
-      Logger::LogInfo(error, LOG_DEBUG);
-      return false;
+  auto state = getFdState(fd);
+  if (state != nullptr) {
+    state->group = event_group;
+    setWantedEvents(fd, *state, event_type);
+  } else {
+    struct epoll_event epevent = {};
+    epevent.events = static_cast<uint32_t>(event_type);
+    epevent.data.u64 = static_cast<uint64_t>(fd);
+    epevent.data.u64 <<= CHAR_BIT;
+    epevent.data.u64 |= static_cast<char>(event_group) & 0xff;
+    if (ctl(EPOLL_CTL_MOD, fd, &epevent) < 0) {
+      if (errno == ENOENT) {
+        std::string error =
+            "epoll_ctl(update) failed, fd reopened, adding .. ";
+        error += std::strerror(errno);
+        Logger::LogInfo(error, LOG_DEBUG);
+        return addFd(fd, event_type, event_group);
+      } else {
+        std::string error = "epoll_ctl(update) failed ";
+        error += std::strerror(errno);
+        Logger::LogInfo(error, LOG_DEBUG);
+        return false;
+      }
     }
   }
   if(time_out != 0) {
@@ -252,31 +445,10 @@ bool EpollManager::stopAccept(int listener_fd) {
 #if USE_TIMER_FD_TIMEOUT==0
 void EpollManager::setTimeOut(int fd, TIMEOUT_TYPE type, int timeout_sec) {
   if (timeout_sec > 0) {
-    auto it = timeouts.find(fd);
-    if (it != timeouts.end()) {
-      it->second.last_seent = Time::getTimeSec();
-      it->second.timeout = timeout_sec;
-      it->second.type = type;
-    } else {
-      TimeOut item;
-      item.last_seent = Time::getTimeSec();
-      item.timeout = timeout_sec;
-      item.type = type;
-      timeouts[fd] = item;
-    }
-  }
-}
-void EpollManager::stopTimeOut(int fd) {
-  auto it = timeouts.find(fd);
-  if (it != timeouts.end()) {
-    it->second.timeout = 0;
-  }
-}
-void EpollManager::deleteTimeOut(int fd) {
-  auto it = timeouts.find(fd);
-  if (it != timeouts.end()) {
-    it->second.timeout = 0;
+    timeouts.add(fd, type, Time::getTimeSec(), timeout_sec);
   }
 }
+void EpollManager::stopTimeOut(int fd) { timeouts.remove(fd); }
+void EpollManager::deleteTimeOut(int fd) { timeouts.remove(fd); }
 #endif
   };  // namespace events
@@ -23,11 +23,19 @@
 
 #include <sys/epoll.h>
 #include <unistd.h>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
 #include "../util/time.h"
 #include "../stats/counter.h"
+#if USE_TIMER_FD_TIMEOUT==0
+#include "timer_wheel.h"
+#endif
+#if ENABLE_IO_URING
+#include "io_uring_poller.h"
+#endif
 namespace events {
 
 #define MAX_EPOLL_EVENT 500
@@ -52,6 +60,8 @@ enum class EVENT_GROUP : char {
   MAINTENANCE,
   /** This groups handles the CTL events. */
   CTL_INTERFACE,
+  /** This group handles the handshakes finished by the HandshakePool. */
+  HANDSHAKE,
   NONE,
 };
 
@@ -85,20 +95,14 @@ enum class EVENT_TYPE : uint32_t {
   DISCONNECT,
   NONE
 };
-#if USE_TIMER_FD_TIMEOUT==0
-enum class TIMEOUT_TYPE:uint8_t {
-  INACTIVE_TIMEOUT,
-  CLIENT_READ_TIMEOUT,
-  SERVER_READ_TIMEOUT,
-  CLIENT_WRITE_TIMEOUT,
-  SERVER_WRITE_TIMEOUT,
+/** The enum EVENT_ENGINE defines the readiness notification backend. */
+enum class EVENT_ENGINE {
+  /** epoll(7), always available. */
+  EPOLL,
+  /** io_uring poll requests, needs ENABLE_IO_URING and kernel >= 5.11. */
+  IO_URING,
 };
-struct TimeOut: public Counter<TimeOut>{
-  TIMEOUT_TYPE type;
-  time_t last_seent{0};
-  int timeout{0};
-};
-#endif
+
 // TODO:: Make it static polimorphosm, template<typename Handler>
 /**
  * @class EpollManager epoll_manager.h "src/event/epoll_manager.h"
@@ -108,20 +112,94 @@ struct TimeOut: public Counter<TimeOut>{
  */
 class EpollManager {
   int epoll_fd;
+#if ENABLE_IO_URING
+  /** If set, used instead of epoll_ctl/epoll_wait on epoll_fd. */
+  std::unique_ptr<IoUringPoller> io_uring;
+#endif
 #if USE_TIMER_FD_TIMEOUT==0
-  std::unordered_map<int /*fd*/,TimeOut> timeouts;
+  /** Connection timeouts keyed by fd. */
+  TimerWheel timeouts;
 #endif
   std::vector<int> accept_fd_set;
   /** Array of epoll_event. This array contains all the events. */
   epoll_event events[MAX_EPOLL_EVENT];
+  /** Flags of the FdState of the edge triggered registrations. */
+  enum FD_FLAGS : uint8_t {
+    /** Registered once for reading and writing, edge triggered. */
+    FD_PERSISTENT = 0x1,
+    /** The handler wants read events. */
+    FD_WANT_READ = 0x2,
+    /** The handler wants write events. */
+    FD_WANT_WRITE = 0x4,
+    /** The wanted events are cleared once one is dispatched. */
+    FD_ONESHOT = 0x8,
+    /** There may be data to read, until a read finds the socket drained. */
+    FD_READ_READY = 0x10,
+    /** A write would block, until the kernel reports EPOLLOUT. */
+    FD_WRITE_BLOCKED = 0x20,
+    /** The peer hung up or the socket failed. */
+    FD_HANGUP = 0x40,
+    /** The fd is in the ready_set. */
+    FD_QUEUED = 0x80,
+  };
+  /**
+   * Readiness and wanted events of a fd in the edge triggered mode, the
+   * kernel only reports changes so the readiness is tracked here.
+   */
+  struct FdState {
+    uint8_t flags{0};
+    EVENT_GROUP group{EVENT_GROUP::NONE};
+  };
+  /** Register the CLIENT and SERVER fds once, edge triggered. */
+  bool edge_triggered{false};
+  /** FdState of the edge triggered fds, indexed by fd. */
+  std::vector<FdState> fd_states;
+  /** Fds with wanted readiness to dispatch at the end of loopOnce(). */
+  std::vector<int> ready_set;
+  std::vector<int> dispatch_set;
+  /** Registration system calls issued, epoll_ctl(2) or io_uring requests. */
+  std::atomic<uint64_t> ctl_calls{0};
+  /** epoll_wait(2) and read(2) calls issued by loopOnce() and recv(). */
+  uint64_t wait_calls{0};
+  uint64_t read_calls{0};
+
+  inline FdState *getFdState(int fd) {
+    if (static_cast<size_t>(fd) >= fd_states.size() ||
+        (fd_states[fd].flags & FD_PERSISTENT) == 0)
+      return nullptr;
+    return &fd_states[fd];
+  }
+  /** Returns the events to dispatch for @p state, 0 if none. */
+  static inline uint32_t readyEvents(const FdState &state) {
+    uint32_t ready = 0;
+    if ((state.flags & (FD_WANT_READ | FD_READ_READY)) ==
+        (FD_WANT_READ | FD_READ_READY))
+      ready |= EPOLLIN;
+    if ((state.flags & (FD_WANT_WRITE | FD_WRITE_BLOCKED)) == FD_WANT_WRITE)
+      ready |= EPOLLOUT;
+    if ((state.flags & (FD_WANT_READ | FD_WANT_WRITE)) != 0 &&
+        (state.flags & FD_HANGUP) != 0)
+      ready |= EPOLLRDHUP;
+    return ready;
+  }
+  inline void setWantedEvents(int fd, FdState &state, EVENT_TYPE event_type);
+  inline void dispatchReady(int fd);
+  inline void dispatchEvent(epoll_event &event);
 protected:
   virtual void HandleEvent(int fd, EVENT_TYPE event_type,
 						   EVENT_GROUP event_group) = 0;
   inline void onReadEvent(epoll_event &event);
   inline void onWriteEvent(epoll_event &event);
   inline void onConnectEvent(epoll_event &event);
+  inline int ctl(int op, int fd, epoll_event *event);
  public:
-  EpollManager();
+  /**
+   * @brief Creates the event manager using the @p engine backend.
+   *
+   * If the io_uring backend is not built in or the kernel does not support it,
+   * it falls back to epoll.
+   */
+  explicit EpollManager(EVENT_ENGINE engine = EVENT_ENGINE::EPOLL);
 
   virtual ~EpollManager();
 
@@ -179,6 +257,95 @@ protected:
    */
   bool updateFd(int fd, EVENT_TYPE event_type, EVENT_GROUP event_group, int time_out = 0);
 
+  /**
+   * @brief Stops reporting events of @p fd without removing it from the
+   * event manager.
+   *
+   * Edge triggered fds keep their registration and readiness, so enabling
+   * them again with updateFd() needs no system call and dispatches at once
+   * anything that became ready meanwhile. Other fds are deleted.
+   *
+   * @param fd to disable.
+   * @return @c true if everything is ok, @c false if not.
+   */
+  bool disableFd(int fd);
+
+  /**
+   * @brief Registers the CLIENT and SERVER fds once, edge triggered.
+   *
+   * The fds are added for reading and writing with EPOLLET and the event
+   * types requested by addFd() and updateFd() are only recorded, along with
+   * the readiness reported by the kernel, so switching between read and write
+   * does not issue epoll_ctl(2) calls. The level triggered and one shot
+   * semantics of the EVENT_TYPE values are kept: ready events are dispatched
+   * again at the end of loopOnce() until the handler reads the socket until
+   * it would block, reported with setReadDrained(), or stops wanting them.
+   * It must be set before adding any fd and it is ignored with the io_uring
+   * engine.
+   *
+   * @param enable the edge triggered mode.
+   */
+  void setEdgeTriggered(bool enable);
+
+  /** @brief Returns @c true if the edge triggered mode is in use. */
+  inline bool isEdgeTriggered() const { return edge_triggered; }
+
+  /**
+   * @brief Records that a read of @p fd would block, so it is not dispatched
+   * again until the kernel reports new data.
+   */
+  inline void setReadDrained(int fd) {
+    if (static_cast<size_t>(fd) < fd_states.size())
+      fd_states[fd].flags &= ~FD_READ_READY;
+  }
+
+  /**
+   * @brief Records that a write to @p fd would block, so write events are not
+   * dispatched until the kernel reports EPOLLOUT.
+   */
+  inline void setWriteBlocked(int fd) {
+    if (static_cast<size_t>(fd) < fd_states.size())
+      fd_states[fd].flags |= FD_WRITE_BLOCKED;
+  }
+
+  /** @brief Returns the number of registration system calls issued. */
+  inline uint64_t getCtlCalls() const { return ctl_calls; }
+
+  /** @brief Returns the backend in use. */
+  EVENT_ENGINE getEventEngine() const;
+
+  /**
+   * @brief Returns the system calls issued to wait for events and read them:
+   * epoll_wait(2) and epoll_ctl(2), or io_uring_enter(2), plus the read(2)
+   * calls of recv().
+   */
+  uint64_t getSyscalls() const;
+
+  /**
+   * @brief Reads the registered @p fd with a multishot recv request of the
+   * io_uring engine, the data arrives along with its read event.
+   *
+   * From then on the fd must only be read with recv(), until it is deleted.
+   *
+   * @return @c false with epoll or if the kernel does not support it.
+   */
+  bool enableRecv(int fd);
+
+  /** @brief Returns @c true if @p fd was set with enableRecv(). */
+  bool isRecvEnabled(int fd) const;
+
+  /**
+   * @brief Returns @c true if @p fd was set with enableRecv() and has data or
+   * a hang up received and not read yet.
+   */
+  bool hasRecvData(int fd) const;
+
+  /**
+   * @brief Same contract as read(2), the fds set with enableRecv() are read
+   * from the data already received.
+   */
+  ssize_t recv(int fd, void *buf, size_t len);
+
 #if USE_TIMER_FD_TIMEOUT==0
   void setTimeOut(int fd, TIMEOUT_TYPE type, int timeout_sec);
   void stopTimeOut(int fd);
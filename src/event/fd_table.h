@@ -0,0 +1,84 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace events {
+
+/**
+ * @class FdTable fd_table.h "src/event/fd_table.h"
+ * @brief Maps file descriptors to objects with a flat vector indexed by fd.
+ *
+ * File descriptors are small dense integers, so a lookup is a bounds check
+ * and an array load, with no hashing and no allocation. Unknown and negative
+ * fds read as @c nullptr without inserting anything. The vector only grows,
+ * up to the highest fd stored.
+ *
+ * @tparam T is the type of the objects referenced.
+ */
+template <typename T>
+class FdTable {
+  std::vector<T *> table;
+  size_t count{0};
+
+ public:
+  /** @brief Returns the object of @p fd or @c nullptr if there is none. */
+  inline T *get(int fd) const {
+    return static_cast<size_t>(fd) < table.size() ? table[fd] : nullptr;
+  }
+
+  /** @brief Sets the object of @p fd, a @c nullptr @p value removes it. */
+  inline void set(int fd, T *value) {
+    if (fd < 0) return;
+    if (static_cast<size_t>(fd) >= table.size()) {
+      if (value == nullptr) return;
+      table.resize(std::max(static_cast<size_t>(fd) + 1, table.size() * 2));
+    }
+    if (table[fd] == nullptr) {
+      if (value != nullptr) count++;
+    } else if (value == nullptr) {
+      count--;
+    }
+    table[fd] = value;
+  }
+
+  /** @brief Removes the object of @p fd if any. */
+  inline void erase(int fd) { set(fd, nullptr); }
+
+  /** @brief Returns the number of fds with an object. */
+  inline size_t size() const { return count; }
+
+  /**
+   * @brief Calls @p callback(fd, object) for every fd with an object.
+   *
+   * The callback may erase any entry, including the current one.
+   */
+  template <typename Callback>
+  void forEach(Callback &&callback) {
+    for (size_t fd = 0; fd < table.size() && count > 0; fd++) {
+      if (table[fd] != nullptr) callback(static_cast<int>(fd), table[fd]);
+    }
+  }
+};
+
+}  // namespace events
@@ -0,0 +1,550 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "io_uring_poller.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include "../debug/logger.h"
+
+namespace events {
+
+/** user_data of the requests whose completion is not reported. */
+#define IO_URING_INTERNAL_DATA UINT64_MAX
+
+/** Flag of the user_data of the recv requests, fds are never this high. */
+#define IO_URING_RECV_FLAG 0x80000000u
+/** Buffer group id of the provided buffer ring. */
+#define IO_URING_BUFFER_GROUP 0
+
+static inline uint64_t pollUserData(int fd, uint32_t generation) {
+  return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+static inline uint64_t recvUserData(int fd, uint32_t generation) {
+  return pollUserData(fd, generation) | IO_URING_RECV_FLAG;
+}
+
+IoUringPoller::~IoUringPoller() {
+  if (buffer_ring != nullptr) ::munmap(buffer_ring, buffer_ring_len);
+  if (recv_buffers != nullptr)
+    ::munmap(recv_buffers, IO_URING_RECV_BUFFERS * IO_URING_RECV_BUFFER_SIZE);
+  if (sqes != nullptr) ::munmap(sqes, sqes_len);
+  if (cq_ptr != nullptr && cq_ptr != sq_ptr) ::munmap(cq_ptr, cq_len);
+  if (sq_ptr != nullptr) ::munmap(sq_ptr, sq_len);
+  if (ring_fd >= 0) ::close(ring_fd);
+}
+
+bool IoUringPoller::init(unsigned entries) {
+  io_uring_params params{};
+  ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+  if (ring_fd < 0) {
+    Logger::logmsg(LOG_NOTICE, "io_uring_setup failed: %s",
+                   std::strerror(errno));
+    return false;
+  }
+  if ((params.features & IORING_FEAT_EXT_ARG) == 0u) {
+    Logger::logmsg(LOG_NOTICE, "io_uring: kernel lacks IORING_FEAT_EXT_ARG");
+    return false;
+  }
+  sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0u;
+  if (single_mmap) sq_len = cq_len = std::max(sq_len, cq_len);
+  sq_ptr = ::mmap(nullptr, sq_len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (sq_ptr == MAP_FAILED) {
+    sq_ptr = nullptr;
+    return false;
+  }
+  if (single_mmap) {
+    cq_ptr = sq_ptr;
+  } else {
+    cq_ptr = ::mmap(nullptr, cq_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ptr == MAP_FAILED) {
+      cq_ptr = nullptr;
+      return false;
+    }
+  }
+  sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+  auto sqes_ptr = ::mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (sqes_ptr == MAP_FAILED) return false;
+  sqes = static_cast<io_uring_sqe *>(sqes_ptr);
+
+  auto sq = static_cast<char *>(sq_ptr);
+  sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  sq_entries = params.sq_entries;
+  auto cq = static_cast<char *>(cq_ptr);
+  cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  if (!initBufferRing())
+    Logger::logmsg(LOG_NOTICE, "io_uring: multishot recv not supported");
+  return true;
+}
+
+bool IoUringPoller::initBufferRing() {
+#ifdef IORING_RECV_MULTISHOT
+  buffer_ring_len = IO_URING_RECV_BUFFERS * sizeof(io_uring_buf);
+  auto ring = ::mmap(nullptr, buffer_ring_len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (ring == MAP_FAILED) return false;
+  buffer_ring = static_cast<io_uring_buf_ring *>(ring);
+  auto buffers =
+      ::mmap(nullptr, IO_URING_RECV_BUFFERS * IO_URING_RECV_BUFFER_SIZE,
+             PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffers == MAP_FAILED) {
+    ::munmap(buffer_ring, buffer_ring_len);
+    buffer_ring = nullptr;
+    return false;
+  }
+  recv_buffers = static_cast<char *>(buffers);
+  io_uring_buf_reg reg{};
+  reg.ring_addr = reinterpret_cast<uint64_t>(buffer_ring);
+  reg.ring_entries = IO_URING_RECV_BUFFERS;
+  reg.bgid = IO_URING_BUFFER_GROUP;
+  if (::syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING,
+                &reg, 1) < 0) {
+    ::munmap(recv_buffers, IO_URING_RECV_BUFFERS * IO_URING_RECV_BUFFER_SIZE);
+    ::munmap(buffer_ring, buffer_ring_len);
+    recv_buffers = nullptr;
+    buffer_ring = nullptr;
+    return false;
+  }
+  for (uint16_t id = 0; id < IO_URING_RECV_BUFFERS; id++) recycleBuffer(id);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void IoUringPoller::recycleBuffer(uint16_t buffer_id) {
+#ifdef IORING_RECV_MULTISHOT
+  // not bufs[], its flexible array is not at offset 0 in C++
+  auto &buf = reinterpret_cast<io_uring_buf *>(
+      buffer_ring)[buffer_tail & (IO_URING_RECV_BUFFERS - 1)];
+  buf.addr = reinterpret_cast<uint64_t>(recv_buffers) +
+             static_cast<uint64_t>(buffer_id) * IO_URING_RECV_BUFFER_SIZE;
+  buf.len = IO_URING_RECV_BUFFER_SIZE;
+  buf.bid = buffer_id;
+  buffer_tail++;
+  __atomic_store_n(&buffer_ring->tail, buffer_tail, __ATOMIC_RELEASE);
+#else
+  (void)buffer_id;
+#endif
+}
+
+bool IoUringPoller::submit(unsigned min_complete, unsigned flags, void *arg,
+                           size_t arg_size) {
+  enter_calls++;
+  auto ret = ::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                       flags, arg, arg_size);
+  if (ret < 0) {
+    // ETIME means the wait timed out, EINTR a signal, EBUSY the completion
+    // queue is full, in all the cases the caller will reap what is there.
+    if (errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+      Logger::logmsg(LOG_DEBUG, "io_uring_enter failed: %s",
+                     std::strerror(errno));
+    return false;
+  }
+  to_submit -= static_cast<unsigned>(ret);
+  return true;
+}
+
+io_uring_sqe *IoUringPoller::getSqe() {
+  unsigned tail = *sq_tail;
+  if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+    // submission queue full, flush it without waiting
+    submit(0, 0, nullptr, 0);
+    if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+      return nullptr;
+  }
+  unsigned index = tail & *sq_mask;
+  auto sqe = &sqes[index];
+  std::memset(sqe, 0, sizeof(io_uring_sqe));
+  sq_array[index] = index;
+  __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+  to_submit++;
+  submitted_sqes++;
+  return sqe;
+}
+
+void IoUringPoller::queuePoll(int fd) {
+  auto &reg = registrations[fd];
+  reg.rearm = false;
+  auto poll_events = reg.events & ~static_cast<uint32_t>(EPOLLET | EPOLLONESHOT |
+                                                         EPOLLEXCLUSIVE);
+  // the read events come from the recv request or the data it left
+  if (reg.recv_mode && (reg.recv_pending || recvEvents(reg) != 0))
+    poll_events &= ~static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP);
+  if (poll_events == 0) return;
+  auto sqe = getSqe();
+  if (sqe == nullptr) {
+    Logger::logmsg(LOG_ERR, "io_uring submission queue full, fd %d lost", fd);
+    return;
+  }
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = poll_events;
+  sqe->user_data = pollUserData(fd, reg.generation);
+  reg.poll_events = poll_events;
+  reg.pending = true;
+}
+
+void IoUringPoller::queueRecv(int fd) {
+#ifdef IORING_RECV_MULTISHOT
+  auto &reg = registrations[fd];
+  auto sqe = getSqe();
+  if (sqe == nullptr) return;
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = IO_URING_BUFFER_GROUP;
+  sqe->user_data = recvUserData(fd, reg.recv_generation);
+  reg.recv_pending = true;
+  // the poll request in flight does not need to report reads anymore
+  if (reg.pending && (reg.poll_events & (EPOLLIN | EPOLLRDHUP)) != 0u) {
+    queueRemove(fd);
+    queuePoll(fd);
+  }
+#else
+  (void)fd;
+#endif
+}
+
+void IoUringPoller::queueRecvCancel(int fd) {
+  auto &reg = registrations[fd];
+  if (!reg.recv_pending || reg.recv_stopping) return;
+  auto sqe = getSqe();
+  if (sqe == nullptr) return;
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = recvUserData(fd, reg.recv_generation);
+  sqe->user_data = IO_URING_INTERNAL_DATA;
+  reg.recv_stopping = true;
+}
+
+void IoUringPoller::resetRecv(Registration &reg) {
+  for (auto &chunk : reg.chunks) recycleBuffer(chunk.buffer_id);
+  reg.chunks.clear();
+  reg.recv_mode = false;
+  reg.recv_pending = false;
+  reg.recv_stopping = false;
+  reg.recv_eof = false;
+  reg.recv_error = 0;
+  // completions of the cancelled request only give their buffers back
+  reg.recv_generation++;
+}
+
+uint32_t IoUringPoller::recvEvents(const Registration &reg) {
+  uint32_t ready = 0;
+  if (!reg.chunks.empty() || reg.recv_eof || reg.recv_error != 0)
+    ready |= EPOLLIN;
+  if (reg.recv_eof) ready |= EPOLLRDHUP;
+  if (reg.recv_error != 0) ready |= EPOLLERR | EPOLLHUP;
+  // a disabled fd reports nothing, not even errors
+  return reg.events != 0 ? ready & (reg.events | EPOLLERR | EPOLLHUP) : 0;
+}
+
+void IoUringPoller::report(epoll_event *events, int &count, int fd,
+                           uint32_t ready) {
+  auto &reg = registrations[fd];
+  // one event per fd and wait, as epoll_wait(2)
+  if (reg.event_epoch == epoch) {
+    events[reg.event_index].events |= ready;
+    return;
+  }
+  reg.event_epoch = epoch;
+  reg.event_index = count;
+  events[count].events = ready;
+  events[count].data.u64 = reg.data;
+  count++;
+  if ((reg.events & EPOLLONESHOT) != 0u) {
+    reg.fired = true;
+    queueRemove(fd);
+  } else if (reg.recv_mode) {
+    // level triggered, reported again while there is data left
+    recvQueue(fd);
+  }
+}
+
+void IoUringPoller::queueRemove(int fd) {
+  auto &reg = registrations[fd];
+  reg.rearm = false;
+  if (!reg.pending) return;
+  auto sqe = getSqe();
+  if (sqe != nullptr) {
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = pollUserData(fd, reg.generation);
+    sqe->user_data = IO_URING_INTERNAL_DATA;
+  }
+  reg.pending = false;
+  reg.generation++;
+}
+
+int IoUringPoller::ctl(int op, int fd, epoll_event *event) {
+  if (fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  if (static_cast<size_t>(fd) >= registrations.size())
+    registrations.resize(fd + 1);
+  auto &reg = registrations[fd];
+  switch (op) {
+    case EPOLL_CTL_ADD:
+      if (reg.registered) {
+        errno = EEXIST;
+        return -1;
+      }
+      reg.registered = true;
+      reg.generation++;
+      break;
+    case EPOLL_CTL_MOD:
+      if (!reg.registered) {
+        errno = ENOENT;
+        return -1;
+      }
+      queueRemove(fd);
+      break;
+    case EPOLL_CTL_DEL:
+      if (!reg.registered) {
+        errno = ENOENT;
+        return -1;
+      }
+      queueRemove(fd);
+      if (reg.recv_mode) {
+        queueRecvCancel(fd);
+        resetRecv(reg);
+      }
+      reg.registered = false;
+      return 0;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+  reg.events = event->events;
+  reg.data = event->data.u64;
+  reg.fired = false;
+  queuePoll(fd);
+  if (reg.recv_mode) recvQueue(fd);
+  return 0;
+}
+
+bool IoUringPoller::enableRecv(int fd) {
+  if (buffer_ring == nullptr || fd < 0 ||
+      static_cast<size_t>(fd) >= registrations.size() ||
+      !registrations[fd].registered)
+    return false;
+  auto &reg = registrations[fd];
+  if (reg.recv_mode) return true;
+  reg.recv_mode = true;
+  recvQueue(fd);
+  return true;
+}
+
+void IoUringPoller::disable(int fd) {
+  if (fd < 0 || static_cast<size_t>(fd) >= registrations.size()) return;
+  auto &reg = registrations[fd];
+  queueRemove(fd);
+  reg.events = 0;
+}
+
+bool IoUringPoller::hasRecvData(int fd) const {
+  if (!isRecvEnabled(fd)) return false;
+  auto &reg = registrations[fd];
+  return !reg.chunks.empty() || reg.recv_eof || reg.recv_error != 0;
+}
+
+ssize_t IoUringPoller::recv(int fd, void *buf, size_t len) {
+  if (!isRecvEnabled(fd)) {
+    read_calls++;
+    return ::read(fd, buf, len);
+  }
+  auto &reg = registrations[fd];
+  size_t copied = 0;
+  auto dst = static_cast<char *>(buf);
+  while (copied < len && !reg.chunks.empty()) {
+    auto &chunk = reg.chunks.front();
+    auto size = std::min(len - copied, static_cast<size_t>(chunk.length));
+    std::memcpy(dst + copied,
+                recv_buffers +
+                    static_cast<size_t>(chunk.buffer_id) *
+                        IO_URING_RECV_BUFFER_SIZE +
+                    chunk.offset,
+                size);
+    copied += size;
+    chunk.offset += static_cast<uint32_t>(size);
+    chunk.length -= static_cast<uint32_t>(size);
+    if (chunk.length == 0) {
+      recycleBuffer(chunk.buffer_id);
+      reg.chunks.erase(reg.chunks.begin());
+    }
+  }
+  if (copied > 0) {
+    // arm the recv again once the data it left is consumed
+    if (reg.chunks.empty() && !reg.recv_pending) recvQueue(fd);
+    return static_cast<ssize_t>(copied);
+  }
+  if (reg.recv_error != 0) {
+    errno = reg.recv_error;
+    return -1;
+  }
+  if (reg.recv_eof) return 0;
+  if (reg.recv_pending) {
+    errno = EAGAIN;
+    return -1;
+  }
+  // the recv stopped, e.g. out of buffers, the socket has the data
+  read_calls++;
+  auto count = ::read(fd, buf, len);
+  if (count < 0 && errno == EAGAIN) recvQueue(fd);
+  return count;
+}
+
+void IoUringPoller::onRecvCompletion(const io_uring_cqe &cqe,
+                                     epoll_event *events, int &count) {
+  auto fd = static_cast<int>(cqe.user_data & ~IO_URING_RECV_FLAG & 0xffffffff);
+  auto generation = static_cast<uint32_t>(cqe.user_data >> 32);
+  bool has_buffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0u;
+  auto buffer_id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+  if (static_cast<size_t>(fd) >= registrations.size() ||
+      !registrations[fd].recv_mode ||
+      registrations[fd].recv_generation != generation) {
+    if (has_buffer) recycleBuffer(buffer_id);
+    return;
+  }
+  auto &reg = registrations[fd];
+  if ((cqe.flags & IORING_CQE_F_MORE) == 0u) {
+    reg.recv_pending = false;
+    reg.recv_stopping = false;
+  }
+  uint32_t ready = 0;
+  if (cqe.res > 0 && has_buffer) {
+    reg.chunks.push_back(
+        RecvChunk{buffer_id, 0, static_cast<uint32_t>(cqe.res)});
+    // bound the buffers a slow reader takes from the others
+    if (reg.chunks.size() >= IO_URING_RECV_FD_BUFFERS) queueRecvCancel(fd);
+  } else {
+    if (has_buffer) recycleBuffer(buffer_id);
+    if (cqe.res == 0) {
+      reg.recv_eof = true;
+    } else if (cqe.res == -ENOBUFS) {
+      // the data stays in the socket, recv() reads it until the recv is
+      // armed again
+      ready = EPOLLIN;
+    } else if (cqe.res != -ECANCELED) {
+      reg.recv_error = -cqe.res;
+    }
+  }
+  if (!reg.fired) {
+    ready = (ready & reg.events) | recvEvents(reg);
+    if (ready != 0) report(events, count, fd, ready);
+  }
+}
+
+int IoUringPoller::wait(epoll_event *events, int max_events, int timeout_ms) {
+  int count = 0;
+  epoch++;
+  for (auto fd : rearm_set) {
+    if (registrations[fd].rearm) queuePoll(fd);
+  }
+  rearm_set.clear();
+  // report the data left by the recv requests and arm the stopped ones
+  recv_dispatch.swap(recv_set);
+  for (auto fd : recv_dispatch) {
+    auto &reg = registrations[fd];
+    reg.recv_queued = false;
+    if (!reg.registered || !reg.recv_mode) continue;
+    auto ready = reg.fired ? 0 : recvEvents(reg);
+    if (ready != 0) {
+      if (count < max_events)
+        report(events, count, fd, ready);
+      else
+        recvQueue(fd);
+    } else if (!reg.recv_pending && reg.chunks.empty() && !reg.recv_eof &&
+               reg.recv_error == 0 && (reg.events & EPOLLIN) != 0u) {
+      queueRecv(fd);
+    }
+  }
+  recv_dispatch.clear();
+
+  unsigned head = *cq_head;
+  bool ready = count > 0 || head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+  if (to_submit > 0 || (!ready && timeout_ms != 0)) {
+    __kernel_timespec ts{};
+    io_uring_getevents_arg arg{};
+    arg.sigmask = 0;
+    arg.sigmask_sz = _NSIG / 8;
+    if (timeout_ms >= 0) {
+      ts.tv_sec = timeout_ms / 1000;
+      ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+      arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    // if there are completions already, just flush the submissions
+    if (!ready && timeout_ms != 0) flags |= IORING_ENTER_GETEVENTS;
+    if (!submit(ready ? 0 : 1, flags, &arg, sizeof(arg)) && errno == EINTR &&
+        count == 0)
+      return -1;
+  }
+
+  unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+  while (head != tail && count < max_events) {
+    auto &cqe = cqes[head & *cq_mask];
+    head++;
+    if (cqe.user_data == IO_URING_INTERNAL_DATA) continue;
+    if ((cqe.user_data & IO_URING_RECV_FLAG) != 0u) {
+      onRecvCompletion(cqe, events, count);
+      continue;
+    }
+    auto fd = static_cast<int>(cqe.user_data & 0xffffffff);
+    auto generation = static_cast<uint32_t>(cqe.user_data >> 32);
+    if (static_cast<size_t>(fd) >= registrations.size()) continue;
+    auto &reg = registrations[fd];
+    if (!reg.pending || reg.generation != generation) continue;
+    reg.pending = false;
+    if ((reg.events & EPOLLONESHOT) == 0u) {
+      reg.rearm = true;
+      rearm_set.push_back(fd);
+    }
+    auto polled = cqe.res < 0 ? static_cast<uint32_t>(EPOLLERR | EPOLLHUP)
+                              : static_cast<uint32_t>(cqe.res);
+    // a hang up is reported along with the data still to read
+    if (reg.recv_mode) polled |= recvEvents(reg);
+    report(events, count, fd, polled);
+  }
+  __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  return count;
+}
+
+}  // namespace events
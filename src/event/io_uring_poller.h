@@ -0,0 +1,223 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/types.h>
+#include <cstdint>
+#include <vector>
+
+namespace events {
+
+#define IO_URING_ENTRIES 1024
+/** Provided buffers shared by the multishot recv requests of a ring. */
+#define IO_URING_RECV_BUFFERS 512
+#define IO_URING_RECV_BUFFER_SIZE 4096
+/** Received buffers a fd may hold before its multishot recv is stopped. */
+#define IO_URING_RECV_FD_BUFFERS 16
+
+/**
+ * @class IoUringPoller io_uring_poller.h "src/event/io_uring_poller.h"
+ * @brief Readiness notification over io_uring, drop-in for epoll_ctl(2) and
+ * epoll_wait(2).
+ *
+ * Every registration is an IORING_OP_POLL_ADD request. Registering, updating
+ * and removing descriptors only queues submission entries, which are flushed
+ * together with the wait in a single io_uring_enter(2) call, so the
+ * epoll_ctl(2) syscall per event is gone. Level triggered registrations are
+ * re-armed lazily on the next wait() unless the handler changed them in the
+ * meantime. It uses the raw syscall interface, liburing is not needed, and
+ * requires a kernel with IORING_FEAT_EXT_ARG (5.11).
+ *
+ * The fds set with enableRecv() are read by a multishot IORING_OP_RECV
+ * request instead, which fills the buffers of a provided buffer ring as the
+ * data arrives. Their read events are reported from the recv completions and
+ * recv() copies the data out of the buffers, so neither the poll request nor
+ * the read(2) per event are needed. If the ring runs out of buffers, the read
+ * event is reported anyway and recv() reads the socket with read(2) until the
+ * recv is armed again. This needs kernel 6.0.
+ */
+class IoUringPoller {
+  /** Received data, held in a provided buffer. */
+  struct RecvChunk {
+    uint16_t buffer_id;
+    uint32_t offset;
+    uint32_t length;
+  };
+  struct Registration {
+    /** epoll_event data returned to the caller. */
+    uint64_t data{0};
+    /** epoll events mask requested. */
+    uint32_t events{0};
+    /** Generation of the in flight poll request, older completions are
+     * discarded. */
+    uint32_t generation{0};
+    /** The fd is registered, as EPOLL_CTL_ADD. */
+    bool registered{false};
+    /** There is a poll request in flight. */
+    bool pending{false};
+    /** Level triggered registration waiting to be re-armed. */
+    bool rearm{false};
+    /** One shot registration that already reported its event. */
+    bool fired{false};
+    /** Events of the poll request in flight. */
+    uint32_t poll_events{0};
+    /** Wait call in which the fd reported an event, and its index there. */
+    uint64_t event_epoch{0};
+    int event_index{0};
+    /** The fd is read by a multishot recv, see enableRecv(). */
+    bool recv_mode{false};
+    /** There is a multishot recv request in flight. */
+    bool recv_pending{false};
+    /** The recv request in flight is being cancelled. */
+    bool recv_stopping{false};
+    /** The fd is in recv_set. */
+    bool recv_queued{false};
+    /** The peer closed the connection, after the received data. */
+    bool recv_eof{false};
+    /** errno of the failed recv, reported after the received data. */
+    int recv_error{0};
+    /** Generation of the recv request, independent of the poll one. */
+    uint32_t recv_generation{0};
+    /** Received data not yet copied out by recv(), in order. */
+    std::vector<RecvChunk> chunks;
+  };
+  int ring_fd{-1};
+  /* submission queue */
+  void *sq_ptr{nullptr};
+  size_t sq_len{0};
+  unsigned *sq_head{nullptr};
+  unsigned *sq_tail{nullptr};
+  unsigned *sq_mask{nullptr};
+  unsigned *sq_array{nullptr};
+  unsigned sq_entries{0};
+  io_uring_sqe *sqes{nullptr};
+  size_t sqes_len{0};
+  unsigned to_submit{0};
+  /* completion queue */
+  void *cq_ptr{nullptr};
+  size_t cq_len{0};
+  unsigned *cq_head{nullptr};
+  unsigned *cq_tail{nullptr};
+  unsigned *cq_mask{nullptr};
+  io_uring_cqe *cqes{nullptr};
+
+  /* provided buffer ring of the multishot recv requests */
+  struct io_uring_buf_ring *buffer_ring{nullptr};
+  size_t buffer_ring_len{0};
+  char *recv_buffers{nullptr};
+  uint16_t buffer_tail{0};
+
+  std::vector<Registration> registrations;
+  std::vector<int> rearm_set;
+  /** recv mode fds with data to report or a recv request to arm. */
+  std::vector<int> recv_set;
+  std::vector<int> recv_dispatch;
+  uint64_t epoch{0};
+
+  io_uring_sqe *getSqe();
+  bool submit(unsigned min_complete, unsigned flags, void *arg, size_t arg_size);
+  void queuePoll(int fd);
+  void queueRemove(int fd);
+  bool initBufferRing();
+  void recycleBuffer(uint16_t buffer_id);
+  void queueRecv(int fd);
+  void queueRecvCancel(int fd);
+  void resetRecv(Registration &reg);
+  void onRecvCompletion(const io_uring_cqe &cqe, epoll_event *events,
+                        int &count);
+  inline void recvQueue(int fd) {
+    auto &reg = registrations[fd];
+    if (reg.recv_queued) return;
+    reg.recv_queued = true;
+    recv_set.push_back(fd);
+  }
+  static uint32_t recvEvents(const Registration &reg);
+  void report(epoll_event *events, int &count, int fd, uint32_t ready);
+
+ public:
+  /** io_uring_enter(2) calls done. */
+  uint64_t enter_calls{0};
+  /** Submission entries queued. */
+  uint64_t submitted_sqes{0};
+  /** read(2) calls done by recv(), the fd had no recv request. */
+  uint64_t read_calls{0};
+
+  IoUringPoller() = default;
+  IoUringPoller(const IoUringPoller &) = delete;
+  ~IoUringPoller();
+
+  /**
+   * @brief Sets up the ring.
+   *
+   * @param entries is the submission queue size.
+   * @return @c false if the kernel does not support the features needed, the
+   * caller must fall back to epoll.
+   */
+  bool init(unsigned entries = IO_URING_ENTRIES);
+
+  /**
+   * @brief Same contract as epoll_ctl(2), errors are returned as -1 with
+   * errno set to EEXIST, ENOENT or EBADF.
+   */
+  int ctl(int op, int fd, epoll_event *event);
+
+  /** @brief Same contract as epoll_wait(2). */
+  int wait(epoll_event *events, int max_events, int timeout_ms);
+
+  /**
+   * @brief Reads the registered @p fd with a multishot recv request from now
+   * on, its data must then be read with recv().
+   *
+   * The mode lasts until the fd is removed with EPOLL_CTL_DEL, which drops
+   * any data not read yet. Nothing else may read the socket meanwhile.
+   *
+   * @return @c false if the kernel does not support it.
+   */
+  bool enableRecv(int fd);
+
+  /** @brief Returns @c true if @p fd is read by a multishot recv. */
+  bool isRecvEnabled(int fd) const {
+    return static_cast<size_t>(fd) < registrations.size() &&
+           registrations[fd].recv_mode;
+  }
+
+  /**
+   * @brief Returns @c true if @p fd has received data or a hang up not read
+   * with recv() yet.
+   */
+  bool hasRecvData(int fd) const;
+
+  /**
+   * @brief Same contract as read(2). The data received by the multishot recv
+   * of @p fd is copied first, fds not in recv mode are read(2) directly.
+   */
+  ssize_t recv(int fd, void *buf, size_t len);
+
+  /**
+   * @brief Stops reporting the events of @p fd, keeping its registration and
+   * the data already received.
+   */
+  void disable(int fd);
+};
+
+}  // namespace events
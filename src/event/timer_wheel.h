@@ -0,0 +1,212 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <vector>
+#include "../stats/counter.h"
+
+namespace events {
+
+enum class TIMEOUT_TYPE : uint8_t {
+  INACTIVE_TIMEOUT,
+  CLIENT_READ_TIMEOUT,
+  SERVER_READ_TIMEOUT,
+  CLIENT_WRITE_TIMEOUT,
+  SERVER_WRITE_TIMEOUT,
+  /** Idle timeout of a pooled keep-alive backend connection. */
+  BACKEND_IDLE_TIMEOUT,
+};
+
+/**
+ * @brief Intrusive timer node, one per file descriptor.
+ *
+ * The node links itself in a TimerWheel slot list using the fd of the
+ * neighbours, so arming, re-arming and cancelling never allocate.
+ * Counter<TimeOut>::count tracks the number of armed timers.
+ */
+struct TimeOut {
+  TIMEOUT_TYPE type{TIMEOUT_TYPE::INACTIVE_TIMEOUT};
+  /** Absolute second at which the timer expires. */
+  time_t expire{0};
+  int prev{-1};
+  int next{-1};
+  /** Slot index in the wheel, -1 if the timer is not armed. */
+  int slot{-1};
+};
+
+/**
+ * @class TimerWheel timer_wheel.h "src/event/timer_wheel.h"
+ * @brief Hierarchical timing wheel with one second resolution.
+ *
+ * Timers are keyed by file descriptor. There are TW_LEVELS levels of TW_SLOTS
+ * slots each; level 0 holds the timers expiring in the next TW_SLOTS seconds
+ * and each upper level covers TW_SLOTS times the range of the previous one.
+ * Upper level slots are cascaded down when the lower level wraps around, so
+ * add() and remove() are O(1) and advance() only touches the expired slots.
+ */
+class TimerWheel {
+ public:
+  static constexpr int TW_BITS = 6;
+  static constexpr int TW_SLOTS = 1 << TW_BITS;
+  static constexpr int TW_MASK = TW_SLOTS - 1;
+  static constexpr int TW_LEVELS = 4;
+  /** Maximum delay in seconds that can be represented, longer ones are
+   * clamped. */
+  static constexpr time_t TW_MAX_DELAY =
+      (static_cast<time_t>(1) << (TW_BITS * TW_LEVELS)) - 1;
+
+ private:
+  std::vector<TimeOut> nodes;
+  int slots[TW_LEVELS * TW_SLOTS];
+  /** Last second processed by advance(). */
+  time_t current{0};
+  size_t armed{0};
+
+  inline void link(int fd) {
+    auto &node = nodes[fd];
+    time_t delta = node.expire - current;
+    int level = 0;
+    while (level < TW_LEVELS - 1 &&
+           delta >= (static_cast<time_t>(1) << (TW_BITS * (level + 1))))
+      level++;
+    int slot = level * TW_SLOTS +
+               static_cast<int>((node.expire >> (TW_BITS * level)) & TW_MASK);
+    node.slot = slot;
+    node.prev = -1;
+    node.next = slots[slot];
+    if (node.next != -1) nodes[node.next].prev = fd;
+    slots[slot] = fd;
+  }
+
+  inline void unlink(int fd) {
+    auto &node = nodes[fd];
+    if (node.prev != -1)
+      nodes[node.prev].next = node.next;
+    else
+      slots[node.slot] = node.next;
+    if (node.next != -1) nodes[node.next].prev = node.prev;
+    node.prev = node.next = node.slot = -1;
+  }
+
+  /** Moves every timer of an upper level slot to the lower levels. */
+  inline void cascade(int level) {
+    int slot = level * TW_SLOTS +
+               static_cast<int>((current >> (TW_BITS * level)) & TW_MASK);
+    int fd = slots[slot];
+    slots[slot] = -1;
+    while (fd != -1) {
+      int next = nodes[fd].next;
+      link(fd);
+      fd = next;
+    }
+  }
+
+ public:
+  TimerWheel() {
+    for (auto &slot : slots) slot = -1;
+  }
+  TimerWheel(const TimerWheel &) = delete;
+  ~TimerWheel() { Counter<TimeOut>::count -= static_cast<int>(armed); }
+
+  /**
+   * @brief Arms or re-arms the timer of @p fd.
+   *
+   * @param fd is the file descriptor owning the timer.
+   * @param type of the timeout reported on expiration.
+   * @param now is the current time in seconds.
+   * @param delay in seconds, the timer fires once @p delay seconds have fully
+   * elapsed.
+   */
+  void add(int fd, TIMEOUT_TYPE type, time_t now, int delay) {
+    if (fd < 0) return;
+    if (static_cast<size_t>(fd) >= nodes.size()) nodes.resize(fd + 1);
+    if (nodes[fd].slot != -1) {
+      unlink(fd);
+    } else {
+      armed++;
+      Counter<TimeOut>::count++;
+    }
+    if (armed == 1 && now > current) current = now;
+    time_t expire = now + delay + 1;
+    if (expire <= current) expire = current + 1;
+    if (expire - current > TW_MAX_DELAY) expire = current + TW_MAX_DELAY;
+    nodes[fd].type = type;
+    nodes[fd].expire = expire;
+    link(fd);
+  }
+
+  /** @brief Cancels the timer of @p fd if it is armed. */
+  void remove(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= nodes.size() ||
+        nodes[fd].slot == -1)
+      return;
+    unlink(fd);
+    armed--;
+    Counter<TimeOut>::count--;
+  }
+
+  /** @brief Returns @c true if the timer of @p fd is armed. */
+  bool isArmed(int fd) const {
+    return fd >= 0 && static_cast<size_t>(fd) < nodes.size() &&
+           nodes[fd].slot != -1;
+  }
+
+  /** @brief Returns the number of armed timers. */
+  size_t size() const { return armed; }
+
+  /**
+   * @brief Expires all the timers due up to @p now.
+   *
+   * The timer is disarmed before @p on_expire(fd, type) is called, so the
+   * callback may re-arm or remove any timer, including the expired one.
+   *
+   * @param now is the current time in seconds.
+   * @param on_expire is the callback to call for each expired timer.
+   */
+  template <typename Callback>
+  void advance(time_t now, Callback &&on_expire) {
+    if (armed == 0) {
+      if (now > current) current = now;
+      return;
+    }
+    while (current < now && armed > 0) {
+      current++;
+      for (int level = TW_LEVELS - 1; level > 0; level--) {
+        if ((current & ((static_cast<time_t>(1) << (TW_BITS * level)) - 1)) ==
+            0)
+          cascade(level);
+      }
+      int slot = static_cast<int>(current & TW_MASK);
+      int fd;
+      while ((fd = slots[slot]) != -1) {
+        unlink(fd);
+        armed--;
+        Counter<TimeOut>::count--;
+        on_expire(fd, nodes[fd].type);
+      }
+    }
+    if (now > current) current = now;
+  }
+};
+
+}  // namespace events
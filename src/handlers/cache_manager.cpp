@@ -26,10 +26,9 @@ void CacheManager::handleResponse(HttpStream *stream, Service *service) {
   }
   if (!stream->response.hasPendingData()) {
     CacheManager::validateCacheResponse(stream->response);
-    regex_t *pattern = service->http_cache->getCachePattern();
-    regmatch_t matches[2];
+    RegexPattern *pattern = service->http_cache->getCachePattern();
     if (pattern != nullptr) {
-      if (regexec(pattern, stream->request.getUrl().data(), 1, matches, 0) == 0) {
+      if (pattern->match(stream->request.getUrl().data())) {
         if (stream->request.c_opt.no_store == false) {
           service->http_cache->handleResponse(stream->response, stream->request);
         } else {
@@ -63,8 +62,7 @@ int CacheManager::handleRequest(HttpStream *stream, Service *service, ListenerCo
                                                     stream->backend_connection.str_buffer) == 0) {
         http_manager::validateResponse(*stream, listener_config_);
 
-        if (http::http_info::http_verbs.at(std::string(stream->request.method, stream->request.method_len)) ==
-            http::REQUEST_METHOD::HEAD) {
+        if (stream->request.getRequestMethod() == http::REQUEST_METHOD::HEAD) {
           // If HTTP verb is HEAD, just send headers
           stream->response.buffer_size = stream->response.buffer_size - stream->response.message_length;
           stream->response.message = nullptr;
@@ -101,10 +99,9 @@ void CacheManager::validateCacheResponse(HttpResponse &response) {
 
     auto header = std::string_view(response.headers[i].name, response.headers[i].name_len);
     auto header_value = std::string_view(response.headers[i].value, response.headers[i].value_len);
-    auto it = http::http_info::headers_names.find(header);
-    if (it != http::http_info::headers_names.end()) {
-      const auto header_name = it->second;
-      switch (header_name) {
+    auto header_name = http::http_info::headers_names.find(header);
+    if (header_name != nullptr) {
+      switch (*header_name) {
         case http::HTTP_HEADER_NAME::CONTENT_LENGTH: {
           response.content_length = static_cast<size_t>(std::atoi(response.headers[i].value));
           continue;
@@ -208,10 +205,9 @@ void CacheManager::validateCacheRequest(HttpRequest &request) {
     auto header = std::string_view(request.headers[i].name, request.headers[i].name_len);
     auto header_value = std::string_view(request.headers[i].value, request.headers[i].value_len);
 
-    auto it = http::http_info::headers_names.find(header);
-    if (it != http::http_info::headers_names.end()) {
-      auto header_name = it->second;
-      switch (header_name) {
+    auto header_name = http::http_info::headers_names.find(header);
+    if (header_name != nullptr) {
+      switch (*header_name) {
         case http::HTTP_HEADER_NAME::TRANSFER_ENCODING:
           // TODO
           break;
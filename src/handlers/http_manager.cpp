@@ -21,6 +21,7 @@
 
 #include "http_manager.h"
 #include "../config/regex_manager.h"
+#include "../http/http_scan.h"
 #include "../util/network.h"
 
 //#define PRINT_DEBUG_CHUNKED 1
@@ -156,10 +157,10 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
   regmatch_t matches[4];
   auto &listener_config_ = *stream.service_manager->listener_config_;
   HttpRequest &request = stream.request;
-  auto res = ::regexec(&listener_config_.verb, request.getRequestLine().data(),
-                       3,  // include validation data package
-                       matches, REG_EXTENDED);
-  if (UNLIKELY(res == REG_NOMATCH)) {
+  if (UNLIKELY(!listener_config_.verb.match(
+          request.getRequestLine().data(),
+          3,  // include validation data package
+          matches))) {
     // TODO:: check RPC
 
     /*
@@ -176,13 +177,13 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
   } else {
     request.setRequestMethod();
   }
-  const auto request_url = std::string(request.path, request.path_length);
-  if (request_url.find("%00") != std::string::npos) {
+  const auto path_end = request.path + request.path_length;
+  if (http::scan::findEncodedNull(request.path, path_end) != path_end) {
     return validation::REQUEST_RESULT::URL_CONTAIN_NULL;
   }
 
   if (listener_config_.has_pat &&
-      regexec(&listener_config_.url_pat, request.path, 0, nullptr, 0)) {
+      !listener_config_.url_pat.match(request.path)) {
     return validation::REQUEST_RESULT::BAD_URL;
   }
 
@@ -204,13 +205,14 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
         request.headers[i].name);
 #endif
     /* maybe header to be removed */
-    MATCHER *m;
-    for (m = listener_config_.head_off; m; m = m->next) {
-      if (::regexec(&m->pat, request.headers[i].name, 0, nullptr, 0) == 0) {
-        request.headers[i].header_off = true;
-        break;
-      }
-    }
+    if (!listener_config_.head_off.empty() &&
+        request.headers[i].name != nullptr &&
+        listener_config_.head_off.matches(
+            request.headers[i].name,
+            request.headers[i].value + request.headers[i].value_len -
+                request.headers[i].name,
+            request.headers[i].name_len))
+      request.headers[i].header_off = true;
     if (request.headers[i].header_off) continue;
 
     //      Logger::logmsg(LOG_REMOVE, "\t%.*s",request.headers[i].name_len +
@@ -225,10 +227,9 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
     auto header_value = std::string_view(request.headers[i].value,
                                          request.headers[i].value_len);
 
-    auto it = http::http_info::headers_names.find(header);
-    if (it != http::http_info::headers_names.end()) {
-      auto header_name = it->second;
-      switch (header_name) {
+    auto header_name = http::http_info::headers_names.find(header);
+    if (header_name != nullptr) {
+      switch (*header_name) {
         case http::HTTP_HEADER_NAME::DESTINATION:
           if (listener_config_.rewr_dest != 0) {
             request.headers[i].header_off = true;
@@ -240,10 +241,10 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
 
           break;
         case http::HTTP_HEADER_NAME::CONNECTION: {
-          if (http_info::connection_values.count(std::string(header_value)) >
-                  0 &&
-              http_info::connection_values.at(std::string(header_value)) ==
-                  CONNECTION_VALUES::UPGRADE)
+          auto connection_value =
+              http_info::connection_values.find(header_value);
+          if (connection_value != nullptr &&
+              *connection_value == CONNECTION_VALUES::UPGRADE)
             request.connection_header_upgrade = true;
           else if(header_value.find("close") != std::string::npos){
             connection_close_pending = true;
@@ -353,6 +354,8 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
 validation::REQUEST_RESULT http_manager::validateResponse(HttpStream &stream) {
   auto &listener_config_ = *stream.service_manager->listener_config_;
   HttpResponse &response = stream.response;
+  response.keep_alive =
+      response.minor_version >= 1 && response.http_status_code >= 200;
   /* If the response is 100 continue we need to enable chunked transfer. */
   if (response.http_status_code < 200) {
     //    stream.response.chunked_status =
@@ -365,6 +368,7 @@ validation::REQUEST_RESULT http_manager::validateResponse(HttpStream &stream) {
                                 : response.c_opt.cacheable = true;
 #endif
   bool connection_close_pending = false;
+  bool has_content_length = false;
   for (size_t i = 0; i != response.num_headers; i++) {
     // check header values length
 
@@ -378,18 +382,19 @@ validation::REQUEST_RESULT http_manager::validateResponse(HttpStream &stream) {
         response.headers[i].name_len + response.headers[i].value_len + 2,
         response.headers[i].name);
 #endif
-    auto it = http::http_info::headers_names.find(header);
-    if (it != http::http_info::headers_names.end()) {
-      const auto header_name = it->second;
-      switch (header_name) {
+    auto header_name = http::http_info::headers_names.find(header);
+    if (header_name != nullptr) {
+      switch (*header_name) {
         case http::HTTP_HEADER_NAME::CONNECTION:
         {
           if(header_value.find("close") != std::string::npos){
             connection_close_pending = true;
+            response.keep_alive = false;
           }
           continue;
         }
         case http::HTTP_HEADER_NAME::CONTENT_LENGTH: {
+          has_content_length = true;
           stream.response.content_length =
               static_cast<size_t>(std::atoi(header_value.data()));
           continue;
@@ -460,7 +465,7 @@ validation::REQUEST_RESULT http_manager::validateResponse(HttpStream &stream) {
               header_value_ += std::to_string(listener_config_.port);
             }
             header_value_ += path;
-            response.addHeader(header_name, header_value_);
+            response.addHeader(*header_name, header_value_);
             response.headers[i].header_off = true;
           }
           break;
@@ -534,19 +539,27 @@ validation::REQUEST_RESULT http_manager::validateResponse(HttpStream &stream) {
       }
     }
     /* maybe header to be removed from response */
-    MATCHER *m;
-    for (m = listener_config_.response_head_off; m; m = m->next) {
-      if (::regexec(&m->pat, response.headers[i].name, 0, nullptr, 0) == 0) {
-        response.headers[i].header_off = true;
-        break;
-      }
-    }
+    if (!listener_config_.response_head_off.empty() &&
+        response.headers[i].name != nullptr &&
+        listener_config_.response_head_off.matches(
+            response.headers[i].name,
+            response.headers[i].value + response.headers[i].value_len -
+                response.headers[i].name,
+            response.headers[i].name_len))
+      response.headers[i].header_off = true;
   }
   if (stream.response.content_length > 0 &&
       (stream.response.content_length - stream.response.message_length) > 0) {
     stream.response.message_bytes_left =
         stream.response.content_length - stream.response.message_length;
   }
+  /* Without a known body end the body lasts until the backend closes the
+   * connection, so it can not be reused. */
+  if (response.keep_alive && !has_content_length &&
+      response.chunked_status == http::CHUNKED_STATUS::CHUNKED_DISABLED &&
+      response.http_status_code != 204 && response.http_status_code != 304 &&
+      stream.request.request_method != http::REQUEST_METHOD::HEAD)
+    response.keep_alive = false;
   if(connection_close_pending && response.content_length == 0 && response.chunked_status == http::CHUNKED_STATUS::CHUNKED_DISABLED){
     //we have unknown amount of body data pending, wait until connection is closed
     //FIXME:: As workaround we use chunked
@@ -564,10 +577,16 @@ void http_manager::replyError(http::Code code, const std::string &code_string,
                                        200) == nullptr)) {
     Logger::LogInfo("Error getting peer address", LOG_DEBUG);
   } else {
-    auto request_data_len = std::string_view(target.buffer).find('\r');
+    std::string_view request_line;
+    if (target.buffer != nullptr) {
+      request_line = std::string_view(
+          target.buffer, target.buffer_offset + target.buffer_size);
+      request_line = request_line.substr(0, request_line.find('\r'));
+    }
     Logger::logmsg(LOG_INFO, "(%lx) e%d %s %.*s from %s",
                    std::this_thread::get_id(), static_cast<int>(code),
-                   code_string.data(), request_data_len, target.buffer, caddr);
+                   code_string.data(), static_cast<int>(request_line.size()),
+                   request_line.data(), caddr);
   }
   auto response_ = http::getHttpResponse(code, code_string, str);
   size_t written = 0;
@@ -605,8 +624,8 @@ bool http_manager::replyRedirect(HttpStream &stream,
       memset(buf.get(), 0, MAXBUF);
       regmatch_t umtch[10];
       char *chptr, *enptr, *srcptr;
-      if (regexec(&service->service_config.url->pat, request_url.data(), 10,
-                  umtch, 0)) {
+      if (!service->service_config.url->pat.match(request_url.data(), 10,
+                                                  umtch)) {
         Logger::logmsg(
             LOG_WARNING,
             "URL pattern didn't match in redirdynamic... shouldn't happen %s",
@@ -674,6 +693,9 @@ bool http_manager::replyRedirect(int code, const std::string &url,
   }
 
   if (result == IO::IO_RESULT::DONE_TRY_AGAIN && sent < response_.length()) {
+    if (!stream.backend_connection.acquireBuffer() ||
+        response_.size() - sent > stream.backend_connection.bufferCapacity())
+      return true;
     std::strncpy(stream.backend_connection.buffer, response_.data() + sent,
                  response_.size() - sent);
     stream.backend_connection.buffer_size = response_.size() - sent;
@@ -0,0 +1,217 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "http_scan.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace http {
+
+/**
+ * @class ChunkedParser chunked_parser.h "src/http/chunked_parser.h"
+ * @brief Incremental parser of the chunked transfer coding framing.
+ *
+ * It tracks where a chunked body ends without holding any of it: the framing
+ * (chunk size lines, the CRLF after each chunk and the trailer section) is
+ * parsed byte by byte as it arrives, in pieces of any size, and the chunk
+ * data is only counted, so the caller can splice it without looking at it.
+ */
+class ChunkedParser {
+ public:
+  enum class STATE : uint8_t {
+    /** Chunk size hex digits. */
+    SIZE,
+    /** Chunk extensions, up to the end of the size line. */
+    EXTENSION,
+    /** LF of the size line. */
+    SIZE_LF,
+    /** Chunk data, chunk_left bytes. */
+    DATA,
+    /** CR after the chunk data. */
+    DATA_CR,
+    /** LF after the chunk data. */
+    DATA_LF,
+    /** Start of a trailer line, after the last chunk. */
+    TRAILER,
+    /** Trailer field, up to the end of the line. */
+    TRAILER_FIELD,
+    /** LF of the empty line that ends the body. */
+    END_LF,
+    /** The whole body was parsed. */
+    DONE,
+    /** Malformed framing. */
+    ERROR,
+  };
+
+  STATE state{STATE::SIZE};
+  /** Data bytes left of the current chunk. */
+  size_t chunk_left{0};
+
+  inline void reset() {
+    state = STATE::SIZE;
+    chunk_left = 0;
+    size_digits = false;
+  }
+  inline bool done() const { return state == STATE::DONE; }
+  inline bool failed() const { return state == STATE::ERROR; }
+  inline bool inData() const { return state == STATE::DATA; }
+
+  /**
+   * @brief Parses the framing in @p data up to the start of the chunk data,
+   * the end of the body or an error.
+   *
+   * @return the number of bytes of @p data consumed.
+   */
+  size_t parse(const char *data, size_t size) {
+    static constexpr char line_end[16] = "\n\n\r\r";
+    size_t pos = 0;
+    while (pos < size && state != STATE::DATA && state != STATE::DONE &&
+           state != STATE::ERROR) {
+      // the extensions and trailer fields are skipped up to the line end
+      if (state == STATE::EXTENSION || state == STATE::TRAILER_FIELD) {
+        pos = static_cast<size_t>(
+            scan::findRanges(data + pos, data + size, line_end, 4) - data);
+        if (pos == size) break;
+      }
+      step(data[pos++]);
+    }
+    return pos;
+  }
+
+  /**
+   * @brief Accounts up to @p size bytes of chunk data.
+   *
+   * @return the number of bytes that belong to the current chunk.
+   */
+  size_t skip(size_t size) {
+    if (state != STATE::DATA) return 0;
+    if (size >= chunk_left) {
+      size = chunk_left;
+      chunk_left = 0;
+      state = STATE::DATA_CR;
+    } else {
+      chunk_left -= size;
+    }
+    return size;
+  }
+
+  /**
+   * @brief Parses a piece of body, framing and data.
+   *
+   * @return the number of bytes of @p data that belong to the body.
+   */
+  size_t feed(const char *data, size_t size) {
+    size_t pos = 0;
+    while (pos < size && state != STATE::DONE && state != STATE::ERROR) {
+      pos += parse(data + pos, size - pos);
+      pos += skip(size - pos);
+    }
+    return pos;
+  }
+
+ private:
+  /** The current size line has a digit. */
+  bool size_digits{false};
+
+  inline void endSizeLine() {
+    state = chunk_left > 0 ? STATE::DATA : STATE::TRAILER;
+    size_digits = false;
+  }
+
+  void step(char c) {
+    switch (state) {
+      case STATE::SIZE: {
+        int digit = hexValue(c);
+        if (digit >= 0) {
+          // one more digit would overflow
+          if (chunk_left >> (8 * sizeof(size_t) - 4) != 0) {
+            state = STATE::ERROR;
+            break;
+          }
+          size_digits = true;
+          chunk_left = (chunk_left << 4) | static_cast<size_t>(digit);
+        } else if (!size_digits) {
+          state = STATE::ERROR;
+        } else if (c == ';' || c == ' ' || c == '\t') {
+          state = STATE::EXTENSION;
+        } else if (c == '\r') {
+          state = STATE::SIZE_LF;
+        } else if (c == '\n') {
+          endSizeLine();
+        } else {
+          state = STATE::ERROR;
+        }
+        break;
+      }
+      case STATE::EXTENSION:
+        if (c == '\r')
+          state = STATE::SIZE_LF;
+        else if (c == '\n')
+          endSizeLine();
+        break;
+      case STATE::SIZE_LF:
+        if (c == '\n')
+          endSizeLine();
+        else
+          state = STATE::ERROR;
+        break;
+      case STATE::DATA_CR:
+        if (c == '\r')
+          state = STATE::DATA_LF;
+        else if (c == '\n')
+          state = STATE::SIZE;
+        else
+          state = STATE::ERROR;
+        break;
+      case STATE::DATA_LF:
+        state = c == '\n' ? STATE::SIZE : STATE::ERROR;
+        break;
+      case STATE::TRAILER:
+        if (c == '\r')
+          state = STATE::END_LF;
+        else if (c == '\n')
+          state = STATE::DONE;
+        else
+          state = STATE::TRAILER_FIELD;
+        break;
+      case STATE::TRAILER_FIELD:
+        if (c == '\n') state = STATE::TRAILER;
+        break;
+      case STATE::END_LF:
+        state = c == '\n' ? STATE::DONE : STATE::ERROR;
+        break;
+      case STATE::DATA:
+      case STATE::DONE:
+      case STATE::ERROR:
+        break;
+    }
+  }
+
+  static inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+  }
+};
+
+}  // namespace http
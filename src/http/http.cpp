@@ -23,14 +23,8 @@
 
 using namespace http;
 
-const std::map<std::string, HTTP_HEADER_NAME,
-#if ENABLE_CI_HEADERS
-               helper::ci_less>
-#else
-               std::less<>>
-#endif
-    http_info::headers_names = {
-    {"", HTTP_HEADER_NAME::NONE},
+/* constexpr, so the compiler builds the tables and checks them */
+static constexpr decltype(http_info::headers_names) headers_names_table({
     {"Accept", HTTP_HEADER_NAME::ACCEPT},
     {"Accept-Charset", HTTP_HEADER_NAME::ACCEPT_CHARSET},
     {"Accept-Encoding", HTTP_HEADER_NAME::ACCEPT_ENCODING},
@@ -112,7 +106,9 @@ const std::map<std::string, HTTP_HEADER_NAME,
     {"X-Forwarded-Host", HTTP_HEADER_NAME::X_FORWARDED_HOST},
     {"X-Forwarded-Proto", HTTP_HEADER_NAME::X_FORWARDED_PROTO},
     {"X-Frame-Options", HTTP_HEADER_NAME::X_FRAME_OPTIONS},
-    {"X-XSS-Protection", HTTP_HEADER_NAME::X_XSS_PROTECTION}};
+    {"X-XSS-Protection", HTTP_HEADER_NAME::X_XSS_PROTECTION}});
+const decltype(http_info::headers_names) http_info::headers_names = headers_names_table;
+
 const std::unordered_map<HTTP_HEADER_NAME, const std::string> http_info::headers_names_strings = {
     {HTTP_HEADER_NAME::NONE, ""},
     {HTTP_HEADER_NAME::ACCEPT, "Accept"},
@@ -258,7 +254,7 @@ const std::unordered_map<REQUEST_METHOD, const std::string> http_info::http_verb
     {REQUEST_METHOD::VERSION_CONTROL, "VERSION-CONTROL"},
     {REQUEST_METHOD::X_MS_ENUMATTS, "X_MS_ENUMATTS"}};
 
-const std::map<std::string, REQUEST_METHOD, std::less<>> http_info::http_verbs = {
+static constexpr decltype(http_info::http_verbs) http_verbs_table({
     {"ACL", REQUEST_METHOD::ACL},
     {"BASELINE-CONTROL", REQUEST_METHOD::BASELINE_CONTROL},
     {"BCOPY", REQUEST_METHOD::BCOPY},
@@ -309,7 +305,8 @@ const std::map<std::string, REQUEST_METHOD, std::less<>> http_info::http_verbs =
     {"UPDATE", REQUEST_METHOD::UPDATE},
     {"UPDATEREDIRECTREF", REQUEST_METHOD::UPDATEREDIRECTREF},
     {"VERSION-CONTROL", REQUEST_METHOD::VERSION_CONTROL},
-    {"X_MS_ENUMATTS", REQUEST_METHOD::X_MS_ENUMATTS}};
+    {"X_MS_ENUMATTS", REQUEST_METHOD::X_MS_ENUMATTS}});
+const decltype(http_info::http_verbs) http_info::http_verbs = http_verbs_table;
 
 const std::unordered_map<validation::REQUEST_RESULT, const std::string> validation::request_result_reason = {
     {REQUEST_RESULT::OK, "valid request"},
@@ -335,11 +332,12 @@ const std::map<std::string, UPGRADE_PROTOCOLS, std::less<>> http_info::upgrade_p
     {"tls", UPGRADE_PROTOCOLS::TLS},
 };
 
-const std::map<std::string, CONNECTION_VALUES, std::less<>> http_info::connection_values = {
+static constexpr decltype(http_info::connection_values) connection_values_table({
     {"Upgrade", CONNECTION_VALUES::UPGRADE},
     {"close", CONNECTION_VALUES::CLOSE},
     {"Keep-Alive", CONNECTION_VALUES::KEEP_ALIVE},
-};
+});
+const decltype(http_info::connection_values) http_info::connection_values = connection_values_table;
 
 const std::unordered_map<http::TRANSFER_ENCODING_TYPE, const std::string> http_info::compression_types_strings = {
     {http::TRANSFER_ENCODING_TYPE::GZIP, "gzip"},         {http::TRANSFER_ENCODING_TYPE::COMPRESS, "compress"},
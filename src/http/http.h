@@ -26,12 +26,17 @@
 #include <unordered_map>
 #include "../version.h"
 #include <memory>
+#include "../util/perfect_hash.h"
 #include "../util/utils.h"
 
 #ifndef MAX_HEADER_LEN
 #define MAX_HEADER_LEN 4096
 #define MAX_HEADERS_SIZE 100
 #endif
+/** Headers of a message that fit without allocating, up to MAX_HEADERS_SIZE. */
+#ifndef INLINE_HEADERS_SIZE
+#define INLINE_HEADERS_SIZE 24
+#endif
 
 namespace http {
 constexpr const char *CRLF = "\r\n";
@@ -342,19 +347,14 @@ enum class Code {
   // 512-599	Unassigned
 };
 struct http_info {
-  static const std::map<std::string, HTTP_HEADER_NAME,
-#if ENABLE_CI_HEADERS
-                        helper::ci_less>
-#else
-                        std::less<>>
-#endif
-headers_names;
+  /* the name sets are fixed, they are looked up with perfect hashes */
+  static const helper::PerfectHash<HTTP_HEADER_NAME, 82> headers_names;
   static const std::unordered_map<HTTP_HEADER_NAME, const std::string> headers_names_strings;
-  static const std::map<std::string, REQUEST_METHOD, std::less<>> http_verbs;
+  static const helper::PerfectHash<REQUEST_METHOD, 51, false> http_verbs;
   static const std::unordered_map<REQUEST_METHOD, const std::string> http_verb_strings;
   static const std::map<std::string, UPGRADE_PROTOCOLS, std::less<>> upgrade_protocols;
   static const std::unordered_map<UPGRADE_PROTOCOLS, const std::string> upgrade_protocols_strings;
-  static const std::map<std::string, CONNECTION_VALUES, std::less<>> connection_values;
+  static const helper::PerfectHash<CONNECTION_VALUES, 3> connection_values;
   static const std::unordered_map<TRANSFER_ENCODING_TYPE, const std::string> compression_types_strings;
   static const std::map<std::string, TRANSFER_ENCODING_TYPE, std::less<>> compression_types;
 #if CACHE_ENABLED
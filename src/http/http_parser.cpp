@@ -23,6 +23,7 @@
 #include "../debug/logger.h"
 #include "../util/common.h"
 #include "http.h"
+#include <cstring>
 
 #define DEBUG_HTTP_PARSER 0
 
@@ -30,6 +31,7 @@ http_parser::HttpData::HttpData()
     : buffer(nullptr),
       buffer_size(0),
       last_length(0),
+      parsed_length(0),
       num_headers(0),
       method(nullptr),
       method_len(0),
@@ -50,6 +52,7 @@ void http_parser::HttpData::reset_parser() {
   minor_version = -1;
   num_headers = 0;
   last_length = 0;
+  parsed_length = 0;
   http_status_code = 0;
   status_message = nullptr;
   message_length = 0;
@@ -61,6 +64,10 @@ void http_parser::HttpData::reset_parser() {
   iov_size = 0;
   chunk_size_left = 0;
   http_message_str.clear();
+#if ENABLE_ZERO_COPY
+  splice_body = false;
+  chunked_parser.reset();
+#endif
 }
 
 void http_parser::HttpData::setBuffer(char *ext_buffer,
@@ -70,6 +77,8 @@ void http_parser::HttpData::setBuffer(char *ext_buffer,
 }
 
 void http_parser::HttpData::prepareToSend() {
+  // first line, headers, the two extra header blocks, CRLF and body
+  iov.reserve(num_headers + 5);
   iov_size = 0;
   iov[iov_size++] = {http_message, http_message_length + CRLF_LEN};
 
@@ -83,22 +92,20 @@ void http_parser::HttpData::prepareToSend() {
 #endif
   }
 
-  for (const auto &header :
-       extra_headers) {  // header must be always  used as reference,
-    // it's copied it invalidate c_str() reference.
-    iov[iov_size++] = {const_cast<char *>(header.c_str()), header.length()};
+  // the extra headers must not be modified until the message is sent
+  if (!extra_headers.empty()) {
+    iov[iov_size++] = {extra_headers.data(), extra_headers.size()};
 #if DEBUG_HTTP_HEADERS
-    Logger::logmsg(LOG_DEBUG, "%.*s", header.length() - 2, header.c_str());
+    Logger::logmsg(LOG_DEBUG, "%.*s", extra_headers.size() - 2,
+                   extra_headers.data());
 #endif
   }
-
-  for (const auto &header :
-       permanent_extra_headers) {  // header must be always  used as
-    // reference,
-    // it's copied it invalidate c_str() reference.
-    iov[iov_size++] = {const_cast<char *>(header.c_str()), header.length()};
+  if (!permanent_extra_headers.empty()) {
+    iov[iov_size++] = {permanent_extra_headers.data(),
+                       permanent_extra_headers.size()};
 #if DEBUG_HTTP_HEADERS
-    Logger::logmsg(LOG_DEBUG, "%.*s", header.length() - 2, header.c_str());
+    Logger::logmsg(LOG_DEBUG, "%.*s", permanent_extra_headers.size() - 2,
+                   permanent_extra_headers.data());
 #endif
   }
   iov[iov_size++] = {const_cast<char *>(http::CRLF), http::CRLF_LEN};
@@ -113,43 +120,35 @@ void http_parser::HttpData::prepareToSend() {
 void http_parser::HttpData::addHeader(http::HTTP_HEADER_NAME header_name,
                                       const std::string &header_value,
                                       bool permanent) {
-  std::string newh;
-  newh.reserve(http::http_info::headers_names_strings.at(header_name).size() +
-               http::CRLF_LEN + header_value.size() + http::CRLF_LEN);
-  newh += http::http_info::headers_names_strings.at(header_name);
-  newh += ": ";
-  newh += header_value;
-  newh += http::CRLF;
-  !permanent ? extra_headers.push_back(std::move(newh))
-             : permanent_extra_headers.push_back(std::move(newh));
+  auto &lines = !permanent ? extra_headers : permanent_extra_headers;
+  lines += http::http_info::headers_names_strings.at(header_name);
+  lines += ": ";
+  lines += header_value;
+  lines += http::CRLF;
 }
 
 void http_parser::HttpData::addHeader(const std::string &header_value,
                                       bool permanent) {
-  std::string newh;
-  newh.reserve(header_value.size() + http::CRLF_LEN);
-  newh += header_value;
-  newh += http::CRLF;
-  !permanent ? extra_headers.push_back(newh)
-             : permanent_extra_headers.push_back(std::move(newh));
+  auto &lines = !permanent ? extra_headers : permanent_extra_headers;
+  lines += header_value;
+  lines += http::CRLF;
 }
 
 void http_parser::HttpData::removeHeader(http::HTTP_HEADER_NAME header_name) {
-  auto header_to_remove =
+  const auto &header_to_remove =
       http::http_info::headers_names_strings.at(header_name);
-  extra_headers.erase(
-      std::remove_if(extra_headers.begin(), extra_headers.end(),
-                     [header_to_remove](const std::string &header) {
-                       return header.find(header_to_remove) !=
-                              std::string::npos;
-                     }),
-      extra_headers.end());
-  //  for (auto it = extra_headers.begin(); it != extra_headers.end();) {
-  //    if (it->find(header_to_remove) != std::string::npos) {
-  //      extra_headers.erase(it++);
-  //    } else
-  //      it++;
-  //  }
+  size_t line_start = 0;
+  while (line_start < extra_headers.size()) {
+    auto line_end = extra_headers.find(http::CRLF, line_start);
+    line_end = line_end == std::string::npos ? extra_headers.size()
+                                             : line_end + http::CRLF_LEN;
+    std::string_view line(extra_headers.data() + line_start,
+                          line_end - line_start);
+    if (line.find(header_to_remove) != std::string_view::npos)
+      extra_headers.erase(line_start, line_end - line_start);
+    else
+      line_start = line_end;
+  }
 }
 
 char *http_parser::HttpData::getBuffer() const { return buffer; }
@@ -161,15 +160,11 @@ void http_parser::HttpData::setHeaderSent(bool value) { headers_sent = value; }
 bool http_parser::HttpData::getHeaderValue(http::HTTP_HEADER_NAME header_name,
                                            std::string &out_key) {
   for (size_t i = 0; i != num_headers; ++i) {
-    std::string header(headers[i].name, headers[i].name_len);
-    std::string header_value(headers[i].value, headers[i].value_len);
-    if (http_info::headers_names.find(header) !=
-        http_info::headers_names.end()) {
-      auto header_name_ = http_info::headers_names.at(header);
-      if (header_name_ == header_name) {
-        out_key = header_value;
-        return true;
-      }
+    auto header_name_ = http_info::headers_names.find(
+        std::string_view(headers[i].name, headers[i].name_len));
+    if (header_name_ != nullptr && *header_name_ == header_name) {
+      out_key = std::string(headers[i].value, headers[i].value_len);
+      return true;
     }
   }
   return false;
@@ -194,20 +189,41 @@ http_parser::PARSE_RESULT http_parser::HttpData::parseRequest(
   return parseRequest(data.c_str(), data.length(), used_bytes, reset);
 }
 
+bool http_parser::HttpData::resumeParse(const char *data, size_t data_size) {
+  if (last_length == 0 || data != buffer || data_size < last_length)
+    reset_parser();
+  buffer = const_cast<char *>(data);
+  buffer_size = data_size;
+  if (data_size == last_length) return false;
+  auto seen = last_length;
+  last_length = data_size;
+  // until the first line is parsed pico sees every read, so garbage, as a
+  // TLS ClientHello on a plain port, is rejected at once
+  return parsed_length == 0 ||
+         std::memchr(data + seen, '\n', data_size - seen) != nullptr;
+}
+
 http_parser::PARSE_RESULT http_parser::HttpData::parseRequest(
     const char *data, const size_t data_size, size_t *used_bytes,
     [[maybe_unused]] bool reset) {
-  //  if (LIKELY(reset))
-  reset_parser();
-  buffer = const_cast<char *>(data);
-  buffer_size = data_size;
-  num_headers = sizeof(headers) / sizeof(headers[0]);
+  if (!resumeParse(data, data_size)) return PARSE_RESULT::INCOMPLETE;
   const char **method_ = const_cast<const char **>(&method);
   const char **path_ = const_cast<const char **>(&path);
-  auto pret = phr_parse_request(data, data_size, method_, &method_len, path_,
-                                &path_length, &minor_version, headers,
-                                &num_headers, last_length);
-  last_length = data_size;
+  auto pret = phr_resume_request(data, data_size, method_, &method_len, path_,
+                                 &path_length, &minor_version, headers.data(),
+                                 &num_headers, headers.capacity(),
+                                 &parsed_length);
+  if (pret == -1 && num_headers == headers.capacity() &&
+      num_headers < MAX_HEADERS_SIZE) {
+    // too many headers for the inline room, go on with all of it
+    headers.reserve(MAX_HEADERS_SIZE);
+    pret = phr_resume_request(data, data_size, method_, &method_len, path_,
+                              &path_length, &minor_version, headers.data(),
+                              &num_headers, headers.capacity(),
+                              &parsed_length);
+  }
+  // only an incomplete message is resumed
+  if (pret != -2) last_length = 0;
   //  Logger::logmsg(LOG_DEBUG, "request is %d bytes long\n", pret);
   if (pret > 0) {
     *used_bytes = static_cast<size_t>(pret);
@@ -244,16 +260,23 @@ http_parser::PARSE_RESULT http_parser::HttpData::parseResponse(
 http_parser::PARSE_RESULT http_parser::HttpData::parseResponse(
     const char *data, const size_t data_size, size_t *used_bytes,
     [[maybe_unused]] bool reset) {
-  //  if (LIKELY(reset))
-  reset_parser();
-  buffer = const_cast<char *>(data);
-  buffer_size = data_size;
-  num_headers = sizeof(headers) / sizeof(headers[0]);
+  if (!resumeParse(data, data_size)) return PARSE_RESULT::INCOMPLETE;
   const char **status_message_ = const_cast<const char **>(&status_message);
-  auto pret = phr_parse_response(
+  auto pret = phr_resume_response(
       data, data_size, &minor_version, &http_status_code, status_message_,
-      &message_length, headers, &num_headers, last_length);
-  last_length = data_size;
+      &message_length, headers.data(), &num_headers, headers.capacity(),
+      &parsed_length);
+  if (pret == -1 && num_headers == headers.capacity() &&
+      num_headers < MAX_HEADERS_SIZE) {
+    // too many headers for the inline room, go on with all of it
+    headers.reserve(MAX_HEADERS_SIZE);
+    pret = phr_resume_response(data, data_size, &minor_version,
+                               &http_status_code, status_message_,
+                               &message_length, headers.data(), &num_headers,
+                               headers.capacity(), &parsed_length);
+  }
+  // only an incomplete message is resumed
+  if (pret != -2) last_length = 0;
   //  Logger::logmsg(LOG_DEBUG, "request is %d bytes long\n", pret);
   if (pret > 0) {
     *used_bytes = static_cast<size_t>(pret);
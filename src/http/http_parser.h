@@ -20,6 +20,8 @@
  */
 #pragma once
 
+#include "../util/inline_array.h"
+#include "chunked_parser.h"
 #include "http.h"
 #include "pico_http_parser.h"
 #include "regex"
@@ -43,10 +45,7 @@ using namespace http;
 class HttpData {
 public:
   HttpData();
-  virtual ~HttpData() {
-    extra_headers.clear();
-    permanent_extra_headers.clear();
-  }
+  virtual ~HttpData() = default;
   PARSE_RESULT parseRequest(const std::string &data, size_t *used_bytes,
                             bool reset = true);
   PARSE_RESULT parseRequest(const char *data, size_t data_size,
@@ -66,9 +65,12 @@ public:
   void setBuffer(char *ext_buffer, size_t ext_buffer_size);
 
 public:
-  std::vector< std::string> extra_headers;
-  std::vector< std::string> permanent_extra_headers;
-  std::array<iovec,MAX_HEADERS_SIZE + 2> iov;
+  /** Added header lines, back to back, cleared with every message. */
+  std::string extra_headers;
+  /** Added header lines, back to back, kept for the whole stream. */
+  std::string permanent_extra_headers;
+  /** First line, headers, extra headers, CRLF and body to be sent. */
+  InlineArray<iovec, INLINE_HEADERS_SIZE + 5> iov;
   size_t iov_size;
   void prepareToSend();
   void addHeader(http::HTTP_HEADER_NAME header_name,
@@ -80,10 +82,15 @@ public:
   bool pragma = false;
   bool cache_control = false;
 #endif
-  phr_header headers[MAX_HEADERS_SIZE];
+  /** Parsed headers, only messages with more than INLINE_HEADERS_SIZE
+   * headers allocate room for up to MAX_HEADERS_SIZE. */
+  InlineArray<phr_header, INLINE_HEADERS_SIZE> headers;
   char *buffer;
   size_t buffer_size;
+  /** Bytes of the buffer seen by the last parse, while it is incomplete. */
   size_t last_length;
+  /** Bytes of complete lines, first line and headers, already parsed. */
+  size_t parsed_length;
   size_t num_headers;
   char *http_message; // indicate firl line in a http request / response
   size_t http_message_length;
@@ -109,6 +116,12 @@ public:
   http::HTTP_VERSION http_version;
   http::REQUEST_METHOD request_method;
   http::TRANSFER_ENCODING_TYPE transfer_encoding_type;
+#if ENABLE_ZERO_COPY
+  /** The rest of the body is spliced, it does not go through the buffers. */
+  bool splice_body{false};
+  /** Framing of a spliced chunked body. */
+  http::ChunkedParser chunked_parser;
+#endif
 
   bool hasPendingData();
   char *getBuffer() const;
@@ -116,6 +129,18 @@ public:
   void setHeaderSent(bool value);
 private:
   bool headers_sent{false};
+
+  /**
+   * @brief Starts parsing @p data, or goes on with the last incomplete parse
+   * if it is the same buffer with more bytes.
+   *
+   * A message can only be completed by a line end, and once the first line
+   * is parsed the lines received before are not parsed again, so only the
+   * new bytes are looked at.
+   *
+   * @return @c false if there is nothing new to parse.
+   */
+  bool resumeParse(const char *data, size_t data_size);
 };
 } // namespace http_parser
 
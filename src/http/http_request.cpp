@@ -21,10 +21,8 @@
 #include "http_request.h"
 
 void HttpRequest::setRequestMethod() {
-  auto sv = std::string_view(method, method_len);
-  //    auto sv = std::string(method, method_len);
-  auto it = http::http_info::http_verbs.find(sv);
-  if (it != http::http_info::http_verbs.end()) request_method = it->second;
+  auto verb = http::http_info::http_verbs.find(std::string_view(method, method_len));
+  if (verb != nullptr) request_method = *verb;
 }
 
 http::REQUEST_METHOD HttpRequest::getRequestMethod() {
@@ -75,6 +75,8 @@ class HttpRequest : public http_parser::HttpData {
 
 class HttpResponse : public http_parser::HttpData {
  public:
+  /** The backend keeps the connection open after this response. */
+  bool keep_alive{false};
 #ifdef CACHE_ENABLED
   bool transfer_encoding_header;
   bool cached = false;
@@ -0,0 +1,211 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "http_scan.h"
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_SCAN_X86 1
+#else
+#define HTTP_SCAN_X86 0
+#endif
+
+using namespace http;
+
+static const char *findRangesScalar(const char *buf, const char *buf_end,
+                                    const char *ranges, size_t ranges_size) {
+  for (; buf != buf_end; ++buf) {
+    auto c = static_cast<unsigned char>(*buf);
+    for (size_t i = 0; i + 1 < ranges_size; i += 2)
+      if (c >= static_cast<unsigned char>(ranges[i]) &&
+          c <= static_cast<unsigned char>(ranges[i + 1]))
+        return buf;
+  }
+  return buf_end;
+}
+
+static const char *findEncodedNullScalar(const char *buf,
+                                         const char *buf_end) {
+  while (buf_end - buf >= 3) {
+    auto percent = static_cast<const char *>(
+        std::memchr(buf, '%', static_cast<size_t>(buf_end - buf - 2)));
+    if (percent == nullptr) break;
+    if (percent[1] == '0' && percent[2] == '0') return percent;
+    buf = percent + 1;
+  }
+  return buf_end;
+}
+
+#if HTTP_SCAN_X86
+__attribute__((target("sse4.2"))) static const char *findRangesSse42(
+    const char *buf, const char *buf_end, const char *ranges,
+    size_t ranges_size) {
+  __m128i ranges16 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ranges));
+  while (buf_end - buf >= 16) {
+    __m128i b16 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf));
+    int r = _mm_cmpestri(ranges16, static_cast<int>(ranges_size), b16, 16,
+                         _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES |
+                             _SIDD_UBYTE_OPS);
+    if (r != 16) return buf + r;
+    buf += 16;
+  }
+  return findRangesScalar(buf, buf_end, ranges, ranges_size);
+}
+
+/** Unrolled for each number of ranges, a byte is in [low, high] when
+ * max(byte, low) and min(byte, high) are the byte itself. */
+template <size_t PAIRS>
+__attribute__((target("avx2"))) static const char *findRangesAvx2(
+    const char *buf, const char *buf_end, const char *ranges) {
+  __m256i lows[PAIRS], highs[PAIRS];
+  for (size_t i = 0; i < PAIRS; i++) {
+    lows[i] = _mm256_set1_epi8(ranges[2 * i]);
+    highs[i] = _mm256_set1_epi8(ranges[2 * i + 1]);
+  }
+  while (buf_end - buf >= 32) {
+    __m256i b32 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buf));
+    __m256i hits = _mm256_setzero_si256();
+    for (size_t i = 0; i < PAIRS; i++)
+      hits = _mm256_or_si256(
+          hits, _mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_max_epu8(b32, lows[i]), b32),
+                    _mm256_cmpeq_epi8(_mm256_min_epu8(b32, highs[i]), b32)));
+    auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+    if (mask != 0) return buf + __builtin_ctz(mask);
+    buf += 32;
+  }
+  // most header lines are short, the tail still takes a 16 bytes step; the
+  // legacy SSE code is slowed down by dirty upper halves of the registers
+  _mm256_zeroupper();
+  return findRangesSse42(buf, buf_end, ranges, 2 * PAIRS);
+}
+
+static const char *findRangesAvx2(const char *buf, const char *buf_end,
+                                  const char *ranges, size_t ranges_size) {
+  switch (ranges_size / 2) {
+    case 0:
+      return buf_end;
+    case 1:
+      return findRangesAvx2<1>(buf, buf_end, ranges);
+    case 2:
+      return findRangesAvx2<2>(buf, buf_end, ranges);
+    case 3:
+      return findRangesAvx2<3>(buf, buf_end, ranges);
+    case 4:
+      return findRangesAvx2<4>(buf, buf_end, ranges);
+    case 5:
+      return findRangesAvx2<5>(buf, buf_end, ranges);
+    case 6:
+      return findRangesAvx2<6>(buf, buf_end, ranges);
+    case 7:
+      return findRangesAvx2<7>(buf, buf_end, ranges);
+    default:
+      return findRangesAvx2<8>(buf, buf_end, ranges);
+  }
+}
+
+__attribute__((target("avx2"))) static const char *findEncodedNullAvx2(
+    const char *buf, const char *buf_end) {
+  const __m256i percent = _mm256_set1_epi8('%');
+  // the '%' are rare, only where there is one the "00" is checked
+  while (buf_end - buf >= 32) {
+    auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buf)), percent)));
+    for (; mask != 0; mask &= mask - 1) {
+      auto candidate = buf + __builtin_ctz(mask);
+      if (buf_end - candidate < 3) break;
+      if (candidate[1] == '0' && candidate[2] == '0') {
+        _mm256_zeroupper();
+        return candidate;
+      }
+    }
+    buf += 32;
+  }
+  _mm256_zeroupper();
+  return findEncodedNullScalar(buf, buf_end);
+}
+#endif
+
+bool scan::supported(KERNEL kernel) {
+  switch (kernel) {
+    case KERNEL::SCALAR:
+      return true;
+#if HTTP_SCAN_X86
+    case KERNEL::SSE42:
+      return __builtin_cpu_supports("sse4.2");
+    case KERNEL::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+scan::KERNEL scan::kernel() {
+  static const KERNEL best = supported(KERNEL::AVX2)    ? KERNEL::AVX2
+                             : supported(KERNEL::SSE42) ? KERNEL::SSE42
+                                                        : KERNEL::SCALAR;
+  return best;
+}
+
+const char *scan::kernelName(KERNEL kernel) {
+  switch (kernel) {
+    case KERNEL::SSE42:
+      return "sse4.2";
+    case KERNEL::AVX2:
+      return "avx2";
+    default:
+      return "scalar";
+  }
+}
+
+const char *scan::findRanges(KERNEL kernel, const char *buf,
+                             const char *buf_end, const char *ranges,
+                             size_t ranges_size) {
+  switch (kernel) {
+#if HTTP_SCAN_X86
+    case KERNEL::AVX2:
+      return findRangesAvx2(buf, buf_end, ranges, ranges_size);
+    case KERNEL::SSE42:
+      return findRangesSse42(buf, buf_end, ranges, ranges_size);
+#endif
+    default:
+      return findRangesScalar(buf, buf_end, ranges, ranges_size);
+  }
+}
+
+const char *scan::findRanges(const char *buf, const char *buf_end,
+                             const char *ranges, size_t ranges_size) {
+  return findRanges(kernel(), buf, buf_end, ranges, ranges_size);
+}
+
+const char *scan::findEncodedNull(KERNEL kernel, const char *buf,
+                                  const char *buf_end) {
+#if HTTP_SCAN_X86
+  if (kernel == KERNEL::AVX2) return findEncodedNullAvx2(buf, buf_end);
+#endif
+  // glibc memchr() is already vectorized
+  return findEncodedNullScalar(buf, buf_end);
+}
+
+const char *scan::findEncodedNull(const char *buf, const char *buf_end) {
+  return findEncodedNull(kernel(), buf, buf_end);
+}
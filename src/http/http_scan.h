@@ -0,0 +1,65 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace http {
+namespace scan {
+
+/** Implementations of the scans, the best one the CPU runs is used. */
+enum class KERNEL : uint8_t {
+  SCALAR,
+  SSE42,
+  AVX2,
+};
+
+/** @brief Returns the kernel picked for this CPU, detected once. */
+KERNEL kernel();
+
+/** @brief Whether this CPU, and build, can run @p kernel. */
+bool supported(KERNEL kernel);
+
+const char *kernelName(KERNEL kernel);
+
+/**
+ * @brief Returns the first byte of [@p buf, @p buf_end) within any of the
+ * inclusive ranges of byte pairs in @p ranges, or @p buf_end.
+ *
+ * @p ranges is read as 16 bytes, @p ranges_size of them, at most 16, are the
+ * pairs, as the _mm_cmpestri() ranges of the SSE4.2 parser.
+ */
+const char *findRanges(const char *buf, const char *buf_end,
+                       const char *ranges, size_t ranges_size);
+const char *findRanges(KERNEL kernel, const char *buf, const char *buf_end,
+                       const char *ranges, size_t ranges_size);
+
+/**
+ * @brief Returns the first "%00", an encoded NUL, in [@p buf, @p buf_end),
+ * or @p buf_end.
+ */
+const char *findEncodedNull(const char *buf, const char *buf_end);
+const char *findEncodedNull(KERNEL kernel, const char *buf,
+                            const char *buf_end);
+
+}  // namespace scan
+}  // namespace http
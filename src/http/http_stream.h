@@ -54,7 +54,15 @@ enum class STREAM_STATUS : uint32_t {
   CL_WRITE_PENDING= 0x1 << 5,
   REQUEST_PENDING = 0x1 << 6,
   RESPONSE_PENDING = 0x1 << 7,
-  CLOSE_CONNECTION = 0x1 << 8
+  CLOSE_CONNECTION = 0x1 << 8,
+  /** The last response was completely relayed and the backend connection
+   * can be reused by another stream. */
+  BCK_IDLE = 0x1 << 9,
+  /** The client handshake runs in the HandshakePool, the stream is not
+   * released until it is back. */
+  HANDSHAKE_OFFLOADED = 0x1 << 10,
+  /** The stream was cleared while HANDSHAKE_OFFLOADED. */
+  CLEAR_PENDING = 0x1 << 11
 };
 
 /**
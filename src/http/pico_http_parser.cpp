@@ -27,14 +27,8 @@
 #include <assert.h>
 #include <stddef.h>
 #include <string.h>
-#ifdef __SSE4_2__
-#ifdef _MSC_VER
-#include <nmmintrin.h>
-#else
-#include <x86intrin.h>
-#endif
-#endif
 #include "pico_http_parser.h"
+#include "http_scan.h"
 
 #if __GNUC__ >= 3
 #define likely(x) __builtin_expect(!!(x), 1)
@@ -102,35 +96,14 @@ static const char *token_char_map = "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\
                                     "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
                                     "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0";
 
+/* the widest kernel the CPU runs is picked at runtime, see http_scan.h */
 static const char *findchar_fast(const char *buf,
                                  const char *buf_end,
                                  const char *ranges,
                                  size_t ranges_size,
                                  int *found) {
-  *found = 0;
-#if __SSE4_2__
-  if (likely(buf_end - buf >= 16)) {
-        __m128i ranges16 = _mm_loadu_si128((const __m128i *)ranges);
-
-        size_t left = (buf_end - buf) & ~15;
-        do {
-            __m128i b16 = _mm_loadu_si128((const __m128i *)buf);
-            int r = _mm_cmpestri(ranges16, ranges_size, b16, 16, _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
-            if (unlikely(r != 16)) {
-                buf += r;
-                *found = 1;
-                break;
-            }
-            buf += 16;
-            left -= 16;
-        } while (likely(left != 0));
-    }
-#else
-  /* suppress unused parameter warning */
-  (void) buf_end;
-  (void) ranges;
-  (void) ranges_size;
-#endif
+  buf = http::scan::findRanges(buf, buf_end, ranges, ranges_size);
+  *found = buf != buf_end;
   return buf;
 }
 
@@ -141,49 +114,14 @@ static const char *get_token_to_eol(const char *buf,
                                     int *ret) {
   const char *token_start = buf;
 
-#ifdef __SSE4_2__
   static const char ALIGNED(16) ranges1[16] = "\0\010"    /* allow HT */
-                                                "\012\037"  /* allow SP and up to but not including DEL */
-                                                "\177\177"; /* allow chars w. MSB set */
-    int found;
-    buf = findchar_fast(buf, buf_end, ranges1, 6, &found);
-    if (found)
-        goto FOUND_CTL;
-#else
-  /* find non-printable char within the next 8 bytes, this is the hottest code; manually inlined */
-  while (likely(buf_end - buf >= 8)) {
-#define DOIT()                                                                                                                     \
-    do {                                                                                                                           \
-        if (unlikely(!IS_PRINTABLE_ASCII(*buf)))                                                                                   \
-            goto NonPrintable;                                                                                                     \
-        ++buf;                                                                                                                     \
-    } while (0)
-    DOIT();
-    DOIT();
-    DOIT();
-    DOIT();
-    DOIT();
-    DOIT();
-    DOIT();
-    DOIT();
-#undef DOIT
-    continue;
-    NonPrintable:
-    if ((likely((unsigned char) *buf < '\040') && likely(*buf != '\011')) || unlikely(*buf == '\177')) {
-      goto FOUND_CTL;
-    }
-    ++buf;
-  }
-#endif
-  for (;; ++buf) {
+                                              "\012\037"  /* allow SP and up to but not including DEL */
+                                              "\177\177"; /* allow chars w. MSB set */
+  int found;
+  buf = findchar_fast(buf, buf_end, ranges1, 6, &found);
+  if (!found) {
     CHECK_EOF();
-    if (unlikely(!IS_PRINTABLE_ASCII(*buf))) {
-      if ((likely((unsigned char) *buf < '\040') && likely(*buf != '\011')) || unlikely(*buf == '\177')) {
-        goto FOUND_CTL;
-      }
-    }
   }
-  FOUND_CTL:
   if (likely(*buf == '\015')) {
     ++buf;
     EXPECT_CHAR('\012');
@@ -265,9 +203,11 @@ static const char *parse_http_version(const char *buf, const char *buf_end, int
 }
 
 static const char *parse_headers(const char *buf, const char *buf_end, struct phr_header *headers, size_t *num_headers,
-                                 size_t max_headers, int *ret) {
+                                 size_t max_headers, int *ret, const char **line_start) {
   for (;; ++*num_headers) {
-    headers[*num_headers].reset();
+    /* the previous lines are complete, a resumed parse starts here */
+    if (line_start != NULL)
+      *line_start = buf;
     CHECK_EOF();
     if (*buf == '\015') {
       ++buf;
@@ -281,6 +221,7 @@ static const char *parse_headers(const char *buf, const char *buf_end, struct ph
       *ret = -1;
       return NULL;
     }
+    headers[*num_headers].reset();
     if (!(*num_headers != 0 && (*buf == ' ' || *buf == '\t'))) {
       /* parsing name, but do not discard SP before colon, see
        * http://www.mozilla.org/security/announce/2006/mfsa2006-33.html */
@@ -343,17 +284,14 @@ static const char *parse_headers(const char *buf, const char *buf_end, struct ph
   return buf;
 }
 
-static const char *parse_request(const char *buf,
-                                 const char *buf_end,
-                                 const char **method,
-                                 size_t *method_len,
-                                 const char **path,
-                                 size_t *path_len,
-                                 int *minor_version,
-                                 struct phr_header *headers,
-                                 size_t *num_headers,
-                                 size_t max_headers,
-                                 int *ret) {
+static const char *parse_request_line(const char *buf,
+                                      const char *buf_end,
+                                      const char **method,
+                                      size_t *method_len,
+                                      const char **path,
+                                      size_t *path_len,
+                                      int *minor_version,
+                                      int *ret) {
   /* skip first empty line (some clients add CRLF after POST content) */
   CHECK_EOF();
   if (*buf == '\015') {
@@ -388,8 +326,24 @@ static const char *parse_request(const char *buf,
     *ret = -1;
     return NULL;
   }
+  return buf;
+}
 
-  return parse_headers(buf, buf_end, headers, num_headers, max_headers, ret);
+static const char *parse_request(const char *buf,
+                                 const char *buf_end,
+                                 const char **method,
+                                 size_t *method_len,
+                                 const char **path,
+                                 size_t *path_len,
+                                 int *minor_version,
+                                 struct phr_header *headers,
+                                 size_t *num_headers,
+                                 size_t max_headers,
+                                 int *ret) {
+  if ((buf = parse_request_line(buf, buf_end, method, method_len, path, path_len, minor_version, ret)) == NULL) {
+    return NULL;
+  }
+  return parse_headers(buf, buf_end, headers, num_headers, max_headers, ret, NULL);
 }
 
 int phr_parse_request(const char *buf_start,
@@ -436,16 +390,13 @@ int phr_parse_request(const char *buf_start,
   return (int) (buf - buf_start);
 }
 
-static const char *parse_response(const char *buf,
-                                  const char *buf_end,
-                                  int *minor_version,
-                                  int *status,
-                                  const char **msg,
-                                  size_t *msg_len,
-                                  struct phr_header *headers,
-                                  size_t *num_headers,
-                                  size_t max_headers,
-                                  int *ret) {
+static const char *parse_status_line(const char *buf,
+                                     const char *buf_end,
+                                     int *minor_version,
+                                     int *status,
+                                     const char **msg,
+                                     size_t *msg_len,
+                                     int *ret) {
   /* parse "HTTP/1.x" */
   if ((buf = parse_http_version(buf, buf_end, minor_version, ret)) == NULL) {
     return NULL;
@@ -482,8 +433,23 @@ static const char *parse_response(const char *buf,
     *ret = -1;
     return NULL;
   }
+  return buf;
+}
 
-  return parse_headers(buf, buf_end, headers, num_headers, max_headers, ret);
+static const char *parse_response(const char *buf,
+                                  const char *buf_end,
+                                  int *minor_version,
+                                  int *status,
+                                  const char **msg,
+                                  size_t *msg_len,
+                                  struct phr_header *headers,
+                                  size_t *num_headers,
+                                  size_t max_headers,
+                                  int *ret) {
+  if ((buf = parse_status_line(buf, buf_end, minor_version, status, msg, msg_len, ret)) == NULL) {
+    return NULL;
+  }
+  return parse_headers(buf, buf_end, headers, num_headers, max_headers, ret, NULL);
 }
 
 int phr_parse_response(const char *buf_start,
@@ -536,7 +502,77 @@ int phr_parse_headers(const char *buf_start,
     return r;
   }
 
-  if ((buf = parse_headers(buf, buf_end, headers, num_headers, max_headers, &r)) == NULL) {
+  if ((buf = parse_headers(buf, buf_end, headers, num_headers, max_headers, &r, NULL)) == NULL) {
+    return r;
+  }
+
+  return (int) (buf - buf_start);
+}
+
+int phr_resume_request(const char *buf_start,
+                       size_t len,
+                       const char **method,
+                       size_t *method_len,
+                       const char **path,
+                       size_t *path_len,
+                       int *minor_version,
+                       struct phr_header *headers,
+                       size_t *num_headers,
+                       size_t max_headers,
+                       size_t *parsed_len) {
+  const char *buf = buf_start + *parsed_len, *buf_end = buf_start + len, *line_start;
+  int r;
+
+  if (*parsed_len == 0) {
+    *method = NULL;
+    *method_len = 0;
+    *path = NULL;
+    *path_len = 0;
+    *minor_version = -1;
+    *num_headers = 0;
+    if ((buf = parse_request_line(buf, buf_end, method, method_len, path, path_len, minor_version, &r)) == NULL) {
+      return r;
+    }
+    *parsed_len = buf - buf_start;
+  }
+
+  buf = parse_headers(buf, buf_end, headers, num_headers, max_headers, &r, &line_start);
+  *parsed_len = line_start - buf_start;
+  if (buf == NULL) {
+    return r;
+  }
+
+  return (int) (buf - buf_start);
+}
+
+int phr_resume_response(const char *buf_start,
+                        size_t len,
+                        int *minor_version,
+                        int *status,
+                        const char **msg,
+                        size_t *msg_len,
+                        struct phr_header *headers,
+                        size_t *num_headers,
+                        size_t max_headers,
+                        size_t *parsed_len) {
+  const char *buf = buf_start + *parsed_len, *buf_end = buf_start + len, *line_start;
+  int r;
+
+  if (*parsed_len == 0) {
+    *minor_version = -1;
+    *status = 0;
+    *msg = NULL;
+    *msg_len = 0;
+    *num_headers = 0;
+    if ((buf = parse_status_line(buf, buf_end, minor_version, status, msg, msg_len, &r)) == NULL) {
+      return r;
+    }
+    *parsed_len = buf - buf_start;
+  }
+
+  buf = parse_headers(buf, buf_end, headers, num_headers, max_headers, &r, &line_start);
+  *parsed_len = line_start - buf_start;
+  if (buf == NULL) {
     return r;
   }
 
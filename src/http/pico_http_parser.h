@@ -45,6 +45,7 @@
 #ifndef picohttpparser_h
 #define picohttpparser_h
 
+#include <stdint.h>
 #include <sys/types.h>
 
 #ifdef _MSC_VER
@@ -59,11 +60,12 @@ extern "C" {
  * of a multiline header */
 struct phr_header {
   const char *name;
-  size_t name_len;
   const char *value;
-  size_t value_len;
+  uint32_t name_len;
+  uint32_t value_len;
+  /* whole line length, including the CRLF */
+  uint32_t line_size;
   bool header_off;
-  size_t line_size;
   inline void reset(){
     name_len = 0;
     value_len = 0;
@@ -84,6 +86,18 @@ int phr_parse_response(const char *_buf, size_t len, int *minor_version, int *st
 /* ditto */
 int phr_parse_headers(const char *buf, size_t len, struct phr_header *headers, size_t *num_headers, size_t last_len);
 
+/* phr_parse_request() that goes on from a previous call on the same buffer,
+ * grown since: *parsed_len is the length of the complete lines already parsed,
+ * the first line and the first *num_headers headers, 0 to start. It is moved
+ * past the complete lines parsed, so those are not parsed again */
+int phr_resume_request(const char *buf, size_t len, const char **method, size_t *method_len, const char **path,
+                       size_t *path_len, int *minor_version, struct phr_header *headers, size_t *num_headers,
+                       size_t max_headers, size_t *parsed_len);
+
+/* ditto */
+int phr_resume_response(const char *buf, size_t len, int *minor_version, int *status, const char **msg, size_t *msg_len,
+                        struct phr_header *headers, size_t *num_headers, size_t max_headers, size_t *parsed_len);
+
 /* should be zero-filled before start */
 struct phr_chunked_decoder {
     size_t bytes_left_in_chunk; /* number of bytes left in current chunk */
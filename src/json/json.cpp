@@ -58,11 +58,31 @@ const std::string JSON_KEYS::TO = "to";
 const std::string JSON_KEYS::LAST_SEEN_TS = "last-seen";
 const std::string JSON_KEYS::CONNECTIONS = "connections";
 const std::string JSON_KEYS::PENDING_CONNS = "pending-connections";
+const std::string JSON_KEYS::IDLE_CONNS = "idle-connections";
+const std::string JSON_KEYS::REUSED_CONNS = "reused-connections";
+const std::string JSON_KEYS::KTLS_TX_CONNS = "ktls-tx-connections";
+const std::string JSON_KEYS::KTLS_RX_CONNS = "ktls-rx-connections";
+const std::string JSON_KEYS::TLS_HANDSHAKES = "tls-handshakes";
+const std::string JSON_KEYS::TLS_RESUMED = "tls-resumed";
+const std::string JSON_KEYS::TLS_RESUMPTION_RATIO = "tls-resumption-ratio";
+const std::string JSON_KEYS::TLS_HANDSHAKE_CPU_SAVED =
+    "tls-handshake-cpu-saved-ms";
+const std::string JSON_KEYS::TLS_OFFLOADED = "tls-offloaded-steps";
+const std::string JSON_KEYS::TLS_LOOP_STALL = "tls-loop-stall-ms";
+const std::string JSON_KEYS::TLS_LOOP_STALL_MAX = "tls-loop-stall-max-ms";
+const std::string JSON_KEYS::TICKET_KEYS = "ticket-keys";
+const std::string JSON_KEYS::CERT_CACHE_ENTRIES = "cert-cache-entries";
+const std::string JSON_KEYS::CERT_CACHE_HIT_RATIO = "cert-cache-hit-ratio";
+const std::string JSON_KEYS::CERT_COLD_BUILDS = "cert-cold-builds";
+const std::string JSON_KEYS::CERT_COLD_BUILD_AVG = "cert-cold-build-avg-ms";
+const std::string JSON_KEYS::CERT_COLD_BUILD_MAX = "cert-cold-build-max-ms";
+const std::string JSON_KEYS::CERT_PREBUILDS = "cert-prebuilds";
 const std::string JSON_KEYS::RESPONSE_TIME = "response-time";
 const std::string JSON_KEYS::CONNECT_TIME = "connect-time";
 const std::string JSON_KEYS::WEIGHT = "weight";
 const std::string JSON_KEYS::PRIORITY = "priority";
 const std::string JSON_KEYS::CONFIG = "config";
+const std::string JSON_KEYS::UPGRADE = "upgrade";
 const std::string JSON_KEYS::TYPE = "type";
 #if WAF_ENABLED
 const std::string JSON_KEYS::WAF = "waf";
@@ -61,11 +61,30 @@ struct JSON_KEYS {
   static const std::string LAST_SEEN_TS;
   static const std::string CONNECTIONS;
   static const std::string PENDING_CONNS;
+  static const std::string IDLE_CONNS;
+  static const std::string REUSED_CONNS;
+  static const std::string KTLS_TX_CONNS;
+  static const std::string KTLS_RX_CONNS;
+  static const std::string TLS_HANDSHAKES;
+  static const std::string TLS_RESUMED;
+  static const std::string TLS_RESUMPTION_RATIO;
+  static const std::string TLS_HANDSHAKE_CPU_SAVED;
+  static const std::string TLS_OFFLOADED;
+  static const std::string TLS_LOOP_STALL;
+  static const std::string TLS_LOOP_STALL_MAX;
+  static const std::string TICKET_KEYS;
+  static const std::string CERT_CACHE_ENTRIES;
+  static const std::string CERT_CACHE_HIT_RATIO;
+  static const std::string CERT_COLD_BUILDS;
+  static const std::string CERT_COLD_BUILD_AVG;
+  static const std::string CERT_COLD_BUILD_MAX;
+  static const std::string CERT_PREBUILDS;
   static const std::string RESPONSE_TIME;
   static const std::string CONNECT_TIME;
   static const std::string WEIGHT;
   static const std::string PRIORITY;
   static const std::string CONFIG;
+  static const std::string UPGRADE;
   static const std::string TYPE;
 #if WAF_ENABLED
   static const std::string WAF;
@@ -26,6 +26,7 @@
 #include "ctl/control_manager.h"
 #include "debug/backtrace.h"
 #include "stream/listener_manager.h"
+#include "util/socket_handoff.h"
 #include "util/system.h"
 
 static jmp_buf jmpbuf;
@@ -117,6 +118,9 @@ int main(int argc, char *argv[]) {
       }
     }
 
+    /* started by an upgrade, take over the sockets of the running process */
+    SocketHandoff::receiveInherited();
+
     //  /* block all signals. we take signals synchronously via signalfd */
     //  sigset_t all;
     //  sigfillset(&all);
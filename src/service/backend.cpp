@@ -153,10 +153,27 @@ std::unique_ptr<JsonObject> Backend::getBackendJson() {
                   std::make_unique<JsonDataValue>(this->established_conn));
     root->emplace(JSON_KEYS::PENDING_CONNS,
                   std::make_unique<JsonDataValue>(this->pending_connections));
+    root->emplace(JSON_KEYS::IDLE_CONNS,
+                  std::make_unique<JsonDataValue>(this->idle_connections));
+    root->emplace(JSON_KEYS::REUSED_CONNS,
+                  std::make_unique<JsonDataValue>(this->reused_connections));
     root->emplace(JSON_KEYS::RESPONSE_TIME,
                   std::make_unique<JsonDataValue>(this->avg_response_time));
     root->emplace(JSON_KEYS::CONNECT_TIME,
                   std::make_unique<JsonDataValue>(this->avg_conn_time));
+    if (this->isHttps()) {
+      uint64_t handshakes = tls_sessions.handshakes;
+      uint64_t resumed = tls_sessions.resumed;
+      root->emplace(JSON_KEYS::TLS_HANDSHAKES,
+                    std::make_unique<JsonDataValue>(handshakes));
+      root->emplace(JSON_KEYS::TLS_RESUMED,
+                    std::make_unique<JsonDataValue>(resumed));
+      root->emplace(
+          JSON_KEYS::TLS_RESUMPTION_RATIO,
+          std::make_unique<JsonDataValue>(
+              handshakes > 0 ? static_cast<double>(resumed) / handshakes
+                             : 0.0));
+    }
   }
   return root;
 }
@@ -182,6 +199,20 @@ void Backend::doMaintenance() {
 }
 bool Backend::isHttps() { return ctx != nullptr; }
 
+bool Backend::handleHandshake(Connection &connection) {
+  if (connection.ssl == nullptr) {
+    if (!SSLConnectionManager::initSslConnection(ctx.get(), connection, true))
+      return false;
+    tls_sessions.offer(connection.ssl);
+  }
+  bool connected = connection.ssl_connected;
+  if (!SSLConnectionManager::handleHandshake(ctx.get(), connection, true))
+    return false;
+  if (!connected && connection.ssl_connected)
+    tls_sessions.countHandshake(connection.ssl);
+  return true;
+}
+
 void Backend::setStatus(BACKEND_STATUS new_status) {
   this->status = new_status;
 }
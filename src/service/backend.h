@@ -28,6 +28,7 @@
 #include "../json/json_data_value.h"
 #include "../json/json_data_value_types.h"
 #include "../json/json_parser.h"
+#include "../ssl/ssl_client_session.h"
 #include "../ssl/ssl_connection_manager.h"
 #include "../stats/backend_stats.h"
 #include "../util/utils.h"
@@ -99,6 +100,8 @@ class Backend : public CtlObserver<ctl::CtlTask, std::string>, public BackendInf
   int response_timeout{};
   /** SSL_CTX if the Backend is HTTPS. */
   std::shared_ptr<SSL_CTX> ctx{nullptr};
+  /** Last TLS session of the Backend, resumed by the new connections. */
+  ClientSessionStore tls_sessions;
   bool cut;
   /**
    * @brief Checks if the Backend still alive.
@@ -130,6 +133,15 @@ class Backend : public CtlObserver<ctl::CtlTask, std::string>, public BackendInf
    */
   std::unique_ptr<JsonObject> getBackendJson();
 
+  /**
+   * @brief Runs a step of the TLS handshake of the @p connection to the
+   * Backend, offering the last session of the Backend on the first one.
+   *
+   * @param connection is a connection to this Backend.
+   * @return false if the handshake failed.
+   */
+  bool handleHandshake(Connection &connection);
+
   void setStatus(BACKEND_STATUS new_status);
   BACKEND_STATUS getStatus() ;
   int nf_mark;
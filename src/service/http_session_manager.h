@@ -67,8 +67,9 @@ class HttpSessionManager {
  protected:
   HttpSessionType session_type;
   std::string sess_id;  /* id to construct the pattern */
-  regex_t sess_start{}; /* pattern to identify the session data */
-  regex_t sess_pat{};   /* pattern to match the session data */
+  /* patterns to identify and to match the session data */
+  const RegexPattern *sess_start{nullptr};
+  const RegexPattern *sess_pat{nullptr};
 
  public:
   unsigned int ttl{};
@@ -189,13 +189,13 @@ Service::Service(ServiceConfig &service_config_)
       static_cast<sessions::HttpSessionType>(service_config_.sess_type);
   this->ttl = static_cast<unsigned int>(service_config_.sess_ttl);
   this->sess_id = service_config_.sess_id + '=';
-  this->sess_pat = service_config_.sess_pat;
-  this->sess_start = service_config_.sess_start;
+  this->sess_pat = &service_config_.sess_pat;
+  this->sess_start = &service_config_.sess_start;
   this->routing_policy =
       static_cast<ROUTING_POLICY>(service_config_.routing_policy);
 #ifdef CACHE_ENABLED
   // Initialize cache manager
-  if (service_config_.cache_content.re_pcre != nullptr) {
+  if (service_config_.cache_content.isCompiled()) {
     this->cache_enabled = true;
     http_cache = make_shared<HttpCache>();
     http_cache->cacheInit(
@@ -236,21 +236,20 @@ bool Service::doMatch(HttpRequest &request) {
   /* check for request */
   auto url = std::string(request.path, request.path_length);
   for (auto m = service_config.url; m; m = m->next)
-    if (regexec(&m->pat, url.data(), 0, nullptr, 0)) return false;
+    if (!m->pat.match(url.data())) return false;
 
   /* check for required headers */
   for (auto m = service_config.req_head; m; m = m->next) {
     for (found = i = 0; i < static_cast<int>(request.num_headers) && !found;
          i++)
-      if (!regexec(&m->pat, request.headers[i].name, 0, nullptr, 0)) found = 1;
+      if (m->pat.match(request.headers[i].name)) found = 1;
     if (!found) return false;
   }
 
   /* check for forbidden headers */
   for (auto m = service_config.deny_head; m; m = m->next) {
     for (found = i = 0; i < static_cast<int>(request.num_headers); i++)
-      if (!regexec(&m->pat, request.headers[i].name, 0, nullptr, 0))
-        return false;
+      if (m->pat.match(request.headers[i].name)) return false;
   }
   return true;
 }
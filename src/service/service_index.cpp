@@ -0,0 +1,225 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "service_index.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <strings.h>
+
+/**
+ * Skips the expressions of a pattern that only match blanks, as
+ * "[[:blank:]]*" or " +", returning the position after them. @p line_end
+ * also skips the ones matching the CR of the line end.
+ */
+static size_t skipBlankExpressions(const std::string &pattern, size_t pos,
+                                   bool line_end) {
+  static const std::vector<std::string> blanks = {"[[:blank:]]", "[ \t]", " "};
+  static const std::vector<std::string> line_end_blanks = {
+      "[[:blank:]]", "[ \t]", " ", "[[:space:]]", "\\s"};
+  for (bool found = true; found;) {
+    found = false;
+    for (auto &blank : line_end ? line_end_blanks : blanks) {
+      if (pattern.compare(pos, blank.size(), blank) != 0) continue;
+      pos += blank.size();
+      if (pos < pattern.size() && std::strchr("*+?", pattern[pos]) != nullptr)
+        pos++;
+      found = true;
+      break;
+    }
+  }
+  return pos;
+}
+
+std::string ServiceIndex::hostLiteral(const std::string &pattern) {
+  // the header patterns are matched line by line ignoring the case, a line
+  // matches "^Host: *h *$" only if it is a Host header with the value h
+  if (pattern.size() < 6 || strncasecmp(pattern.data(), "^Host:", 6) != 0)
+    return "";
+  std::string host;
+  size_t pos = skipBlankExpressions(pattern, 6, false);
+  while (pos < pattern.size()) {
+    char c = pattern[pos];
+    if (c == '\\' && pos + 1 < pattern.size() && pattern[pos + 1] == '.') {
+      c = '.';
+      pos++;
+    } else if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' &&
+               c != '_' && c != ':') {
+      break;
+    }
+    pos++;
+    if (pos < pattern.size() && std::strchr("*+?{", pattern[pos]) != nullptr)
+      return "";
+    host += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  pos = skipBlankExpressions(pattern, pos, true);
+  if (pattern.compare(pos, std::string::npos, "$") != 0) return "";
+  return host;
+}
+
+std::string ServiceIndex::pathPrefix(const std::string &pattern) {
+  if (pattern.empty() || pattern[0] != '^') return "";
+  // "^/a|/b" matches paths without the prefix
+  int depth = 0;
+  for (size_t i = 0; i < pattern.size(); i++) {
+    switch (pattern[i]) {
+      case '\\':
+        i++;
+        break;
+      case '[':
+        if (i + 1 < pattern.size() && pattern[i + 1] == '^') i++;
+        if (i + 1 < pattern.size() && pattern[i + 1] == ']') i++;
+        while (i + 1 < pattern.size() && pattern[i + 1] != ']') i++;
+        i++;
+        break;
+      case '(':
+        depth++;
+        break;
+      case ')':
+        depth--;
+        break;
+      case '|':
+        if (depth <= 0) return "";
+        break;
+    }
+  }
+  std::string prefix;
+  for (size_t pos = 1; pos < pattern.size();) {
+    char c = pattern[pos];
+    if (c == '\\') {
+      // "\." is a literal dot, "\w" or "\<" are expressions
+      if (pos + 1 >= pattern.size() ||
+          !std::ispunct(static_cast<unsigned char>(pattern[pos + 1])) ||
+          std::strchr("<>`'", pattern[pos + 1]) != nullptr)
+        break;
+      c = pattern[++pos];
+    } else if (std::strchr(".[]()*+?{}|^$", c) != nullptr) {
+      break;
+    }
+    pos++;
+    // a quantified character may be missing, "+" keeps the first one
+    if (pos < pattern.size() && std::strchr("*?{", pattern[pos]) != nullptr)
+      break;
+    prefix += c;
+    if (pos < pattern.size() && pattern[pos] == '+') break;
+  }
+  return prefix;
+}
+
+void ServiceIndex::addToSubtree(PathNode &node, size_t position) {
+  node.services.push_back(position);
+  for (auto &child : node.children) addToSubtree(*child, position);
+}
+
+ServiceIndex::PathNode &ServiceIndex::insertPrefix(
+    const std::string &path_prefix) {
+  PathNode *node = &path_root;
+  size_t pos = 0;
+  while (pos < path_prefix.size()) {
+    auto child = std::find_if(
+        node->children.begin(), node->children.end(),
+        [&](const std::unique_ptr<PathNode> &node_child) {
+          return node_child->label[0] == path_prefix[pos];
+        });
+    if (child == node->children.end()) {
+      auto leaf = std::make_unique<PathNode>();
+      leaf->label = path_prefix.substr(pos);
+      leaf->services = node->services;
+      node->children.push_back(std::move(leaf));
+      return *node->children.back();
+    }
+    auto &label = (*child)->label;
+    size_t common = 1;
+    while (common < label.size() && pos + common < path_prefix.size() &&
+           label[common] == path_prefix[pos + common])
+      common++;
+    if (common < label.size()) {
+      // split the edge, no prefix ends inside it
+      auto middle = std::make_unique<PathNode>();
+      middle->label = label.substr(0, common);
+      middle->services = node->services;
+      label.erase(0, common);
+      middle->children.push_back(std::move(*child));
+      *child = std::move(middle);
+    }
+    node = child->get();
+    pos += common;
+  }
+  return *node;
+}
+
+size_t ServiceIndex::add(const std::string &host,
+                         const std::string &path_prefix) {
+  size_t position = size++;
+  if (host.empty()) {
+    any_host_services.push_back(position);
+    for (auto &host_entry : host_services)
+      host_entry.second.push_back(position);
+  } else {
+    auto host_entry = host_services.find(host);
+    if (host_entry == host_services.end())
+      host_entry = host_services.emplace(host, any_host_services).first;
+    host_entry->second.push_back(position);
+  }
+  addToSubtree(insertPrefix(path_prefix), position);
+  return position;
+}
+
+const std::vector<size_t> *ServiceIndex::hostCandidates(
+    const http_parser::HttpData &request) const {
+  bool found = false;
+  std::string host;
+  for (size_t i = 0; i < request.num_headers; i++) {
+    auto header = &request.headers[i];
+    if (!(cmp_header_name(header, "host"))) continue;
+    std::string value(header->value, header->value_len);
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    if (found && value != host) return nullptr;
+    host = std::move(value);
+    found = true;
+  }
+  if (!found) return &any_host_services;
+  auto host_entry = host_services.find(host);
+  return host_entry == host_services.end() ? &any_host_services
+                                           : &host_entry->second;
+}
+
+const std::vector<size_t> &ServiceIndex::pathCandidates(const char *path,
+                                                        size_t length) const {
+  const PathNode *node = &path_root;
+  size_t pos = 0;
+  while (pos < length) {
+    auto child = std::find_if(
+        node->children.begin(), node->children.end(),
+        [&](const std::unique_ptr<PathNode> &node_child) {
+          return node_child->label[0] == path[pos];
+        });
+    if (child == node->children.end()) break;
+    auto &label = (*child)->label;
+    if (length - pos < label.size() ||
+        std::memcmp(path + pos, label.data(), label.size()) != 0)
+      break;
+    node = child->get();
+    pos += label.size();
+  }
+  return node->services;
+}
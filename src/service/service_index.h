@@ -0,0 +1,136 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "../http/http_parser.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class ServiceIndex service_index.h "src/service/service_index.h"
+ * @brief Narrows the services of a listener a request can match before their
+ * patterns are run.
+ *
+ * At config load the HeadRequire patterns that only accept a literal Host
+ * and the literal prefix of the URL patterns are extracted. The services are
+ * indexed by them, the ones without a literal Host in a hash map and those
+ * without a prefix at the root of a radix tree of the prefixes. A lookup
+ * returns the positions of the services whose literal requirements the
+ * request meets, in the configuration order; their patterns still have to be
+ * matched, the first service that matches is the chosen one as before.
+ */
+class ServiceIndex {
+  struct PathNode {
+    /** Characters of the edge from the parent node. */
+    std::string label;
+    std::vector<std::unique_ptr<PathNode>> children;
+    /** Services whose prefix is a prefix of the node key, sorted. */
+    std::vector<size_t> services;
+  };
+
+  /** Services by the Host they require, including the ones of any Host. */
+  std::unordered_map<std::string, std::vector<size_t>> host_services;
+  std::vector<size_t> any_host_services;
+  PathNode path_root;
+  size_t size{0};
+
+  static void addToSubtree(PathNode &node, size_t position);
+  PathNode &insertPrefix(const std::string &path_prefix);
+
+ public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  /**
+   * @brief Returns the Host a HeadRequire @p pattern accepts, lower case, if
+   * it only matches a Host header with that value.
+   *
+   * @return the host or an empty string if the pattern is not a literal Host.
+   */
+  static std::string hostLiteral(const std::string &pattern);
+
+  /**
+   * @brief Returns the literal text every path a URL @p pattern matches
+   * starts with.
+   *
+   * @return the prefix, empty if the pattern is not anchored, has a top level
+   * alternation or starts with an expression.
+   */
+  static std::string pathPrefix(const std::string &pattern);
+
+  /**
+   * @brief Adds the next service in the configuration order.
+   *
+   * @param host is the Host the service requires or empty.
+   * @param path_prefix is the prefix of the paths the service matches.
+   * @return the position of the service.
+   */
+  size_t add(const std::string &host, const std::string &path_prefix);
+
+  /**
+   * @brief Returns the services the Host headers of @p request can match.
+   *
+   * @return a sorted list of positions, @c nullptr if the request has several
+   * different Host headers and any service can match.
+   */
+  const std::vector<size_t> *hostCandidates(
+      const http_parser::HttpData &request) const;
+
+  /** @brief Returns the services whose path prefix @p path starts with. */
+  const std::vector<size_t> &pathCandidates(const char *path,
+                                            size_t length) const;
+
+  /**
+   * @brief Finds the first service in the configuration order that matches
+   * @p request.
+   *
+   * @param match is called with the positions of the candidates in order,
+   * and returns whether the service matches the request.
+   * @return the position of the service or ServiceIndex::npos.
+   */
+  template <typename Matcher>
+  size_t find(const http_parser::HttpData &request, Matcher &&match) const {
+    auto host_candidates = hostCandidates(request);
+    auto &path_candidates = pathCandidates(request.path, request.path_length);
+    if (host_candidates == nullptr) {
+      for (auto position : path_candidates)
+        if (match(position)) return position;
+      return npos;
+    }
+    // both lists are sorted, walk their intersection
+    auto host_it = host_candidates->begin();
+    auto path_it = path_candidates.begin();
+    while (host_it != host_candidates->end() &&
+           path_it != path_candidates.end()) {
+      if (*host_it < *path_it) {
+        host_it++;
+      } else if (*path_it < *host_it) {
+        path_it++;
+      } else {
+        if (match(*host_it)) return *host_it;
+        host_it++;
+        path_it++;
+      }
+    }
+    return npos;
+  }
+};
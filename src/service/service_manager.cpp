@@ -27,18 +27,17 @@
 #endif
 
 std::map<int, std::shared_ptr<ServiceManager>> ServiceManager::instance;
+std::mutex ServiceManager::instance_mtx;
 
-std::shared_ptr<ServiceManager> &ServiceManager::getInstance(
-    std::shared_ptr<ListenerConfig> listener_config) {
-  auto it = instance.find(listener_config->id);
-  if (it == instance.end())
-    instance[listener_config->id] =
-        std::make_shared<ServiceManager>(listener_config);
-  return instance[listener_config->id];
+std::map<int, std::shared_ptr<ServiceManager>> ServiceManager::getInstance() {
+  std::lock_guard<std::mutex> lock(instance_mtx);
+  return instance;
 }
 
-std::map<int, std::shared_ptr<ServiceManager>> &ServiceManager::getInstance() {
-  return instance;
+void ServiceManager::setInstance(
+    std::map<int, std::shared_ptr<ServiceManager>> service_managers) {
+  std::lock_guard<std::mutex> lock(instance_mtx);
+  instance.swap(service_managers);
 }
 
 ServiceManager::ServiceManager(std::shared_ptr<ListenerConfig> listener_config)
@@ -72,16 +71,11 @@ ServiceManager::~ServiceManager() {
 }
 
 Service *ServiceManager::getService(HttpRequest &request) {
-  for (auto srv : services) {
-    if (!srv->service_config.disabled) {
-      if (srv->doMatch(request)) {
-        // Logger::logmsg(LOG_DEBUG, "Service found id:%d , %s", srv->id,
-        // srv->service_config.name, LOG_DEBUG);
-        return srv;
-      }
-    }
-  }
-  return nullptr;
+  auto position = service_index.find(request, [&](size_t candidate) {
+    auto srv = services[candidate];
+    return !srv->service_config.disabled && srv->doMatch(request);
+  });
+  return position == ServiceIndex::npos ? nullptr : services[position];
 }
 
 std::vector<Service *> ServiceManager::getServices() { return services; }
@@ -89,6 +83,7 @@ std::vector<Service *> ServiceManager::getServices() { return services; }
 bool ServiceManager::addService(ServiceConfig &service_config, int _id) {
   auto service = new Service(service_config);
   service->id = _id;
+  service_index.add(service_config.host_literal, service_config.path_prefix);
   services.push_back(service);
   return true;
 }
@@ -107,6 +102,16 @@ std::string ServiceManager::handleTask(ctl::CtlTask &task) {
       switch (task.subject) {
         case ctl::CTL_SUBJECT::DEBUG:
           return JSON_OP_RESULT::EMPTY_OBJECT;
+        case ctl::CTL_SUBJECT::TICKET_KEYS: {
+          if (ssl_context == nullptr || ssl_context->ticket_keys == nullptr)
+            return JSON_OP_RESULT::ERROR;
+          auto keys_array = std::make_unique<JsonArray>();
+          for (auto &key : ssl_context->ticket_keys->exportKeys())
+            keys_array->emplace_back(std::make_unique<JsonDataValue>(key));
+          JsonObject root;
+          root.emplace(JSON_KEYS::TICKET_KEYS, std::move(keys_array));
+          return root.stringify();
+        }
         default: {
           std::unique_ptr<json::JsonObject> root =
               std::make_unique<JsonObject>();
@@ -129,6 +134,68 @@ std::string ServiceManager::handleTask(ctl::CtlTask &task) {
           auto count = this->disabled ? sm.use_count() : sm.use_count() - 1;
           root->emplace(JSON_KEYS::CONNECTIONS,
                         std::make_unique<JsonDataValue>(established_connection));
+          root->emplace(JSON_KEYS::KTLS_TX_CONNS,
+                        std::make_unique<JsonDataValue>(ktls_tx_connections));
+          root->emplace(JSON_KEYS::KTLS_RX_CONNS,
+                        std::make_unique<JsonDataValue>(ktls_rx_connections));
+          if (is_https_listener) {
+            uint64_t handshakes = tls_handshakes;
+            uint64_t resumed = tls_resumed;
+            uint64_t full = handshakes - resumed;
+            double saved_ms = 0;
+            if (full > 0 && resumed > 0) {
+              double full_avg = static_cast<double>(full_handshake_cpu) / full;
+              double resumed_avg =
+                  static_cast<double>(resumed_handshake_cpu) / resumed;
+              saved_ms = resumed * (full_avg - resumed_avg) / 1000;
+            }
+            root->emplace(JSON_KEYS::TLS_HANDSHAKES,
+                          std::make_unique<JsonDataValue>(handshakes));
+            root->emplace(JSON_KEYS::TLS_RESUMED,
+                          std::make_unique<JsonDataValue>(resumed));
+            root->emplace(
+                JSON_KEYS::TLS_RESUMPTION_RATIO,
+                std::make_unique<JsonDataValue>(
+                    handshakes > 0 ? static_cast<double>(resumed) / handshakes
+                                   : 0.0));
+            root->emplace(JSON_KEYS::TLS_HANDSHAKE_CPU_SAVED,
+                          std::make_unique<JsonDataValue>(saved_ms));
+            root->emplace(JSON_KEYS::TLS_OFFLOADED,
+                          std::make_unique<JsonDataValue>(tls_offloaded.load()));
+            root->emplace(JSON_KEYS::TLS_LOOP_STALL,
+                          std::make_unique<JsonDataValue>(
+                              static_cast<double>(handshake_stall) / 1000));
+            root->emplace(JSON_KEYS::TLS_LOOP_STALL_MAX,
+                          std::make_unique<JsonDataValue>(
+                              static_cast<double>(max_handshake_stall) / 1000));
+          }
+          if (ssl_context != nullptr && ssl_context->cert_cache != nullptr) {
+            auto &cert_cache = *ssl_context->cert_cache;
+            uint64_t hits = cert_cache.hits, misses = cert_cache.misses;
+            uint64_t cold_builds = cert_cache.cold_builds;
+            root->emplace(JSON_KEYS::CERT_CACHE_ENTRIES,
+                          std::make_unique<JsonDataValue>(cert_cache.size()));
+            root->emplace(JSON_KEYS::CERT_CACHE_HIT_RATIO,
+                          std::make_unique<JsonDataValue>(
+                              hits + misses > 0
+                                  ? static_cast<double>(hits) / (hits + misses)
+                                  : 0.0));
+            root->emplace(JSON_KEYS::CERT_COLD_BUILDS,
+                          std::make_unique<JsonDataValue>(cold_builds));
+            root->emplace(
+                JSON_KEYS::CERT_COLD_BUILD_AVG,
+                std::make_unique<JsonDataValue>(
+                    cold_builds > 0 ? static_cast<double>(cert_cache.cold_build_us) /
+                                          cold_builds / 1000
+                                    : 0.0));
+            root->emplace(JSON_KEYS::CERT_COLD_BUILD_MAX,
+                          std::make_unique<JsonDataValue>(
+                              static_cast<double>(cert_cache.max_cold_build_us) /
+                              1000));
+            root->emplace(JSON_KEYS::CERT_PREBUILDS,
+                          std::make_unique<JsonDataValue>(
+                              cert_cache.prebuilds.load()));
+          }
           root->emplace("object_ref",
                         std::make_unique<JsonDataValue>(count));
           auto services_array = std::make_unique<JsonArray>();
@@ -144,6 +211,8 @@ std::string ServiceManager::handleTask(ctl::CtlTask &task) {
     case ctl::CTL_COMMAND::NONE:
       break;
     case ctl::CTL_COMMAND::ADD:
+      if (task.subject == ctl::CTL_SUBJECT::TICKET_KEYS)
+        return importTicketKeys(task.data);
       break;
     case ctl::CTL_COMMAND::DELETE:
       break;
@@ -164,6 +233,8 @@ std::string ServiceManager::handleTask(ctl::CtlTask &task) {
           return JSON_OP_RESULT::OK;
         }
 #endif
+        case ctl::CTL_SUBJECT::TICKET_KEYS:
+          return importTicketKeys(task.data);
         case ctl::CTL_SUBJECT::CONFIG:
           // TODO:: update service config (timeouts, headers, routing policy)
           break;
@@ -201,6 +272,27 @@ std::string ServiceManager::handleTask(ctl::CtlTask &task) {
   return JSON_OP_RESULT::ERROR;
 }
 
+std::string ServiceManager::importTicketKeys(const std::string &data) {
+  if (ssl_context == nullptr || ssl_context->ticket_keys == nullptr)
+    return JSON_OP_RESULT::ERROR;
+  std::unique_ptr<JsonObject> json_data(JsonParser::parse(data));
+  if (json_data == nullptr || json_data->count(JSON_KEYS::TICKET_KEYS) == 0 ||
+      !json_data->at(JSON_KEYS::TICKET_KEYS)->isArray())
+    return JSON_OP_RESULT::ERROR;
+  auto keys_array =
+      dynamic_cast<JsonArray *>(json_data->at(JSON_KEYS::TICKET_KEYS).get());
+  std::vector<std::string> hex_keys;
+  for (auto &key : *keys_array) {
+    if (!key->isValue()) return JSON_OP_RESULT::ERROR;
+    hex_keys.push_back(dynamic_cast<JsonDataValue *>(key.get())->string_value);
+  }
+  if (!ssl_context->ticket_keys->importKeys(hex_keys))
+    return JSON_OP_RESULT::ERROR;
+  Logger::logmsg(LOG_NOTICE, "Imported %lu session ticket keys in listener %d",
+                 hex_keys.size(), id);
+  return JSON_OP_RESULT::OK;
+}
+
 bool ServiceManager::isHandler(ctl::CtlTask &task) {
   return !disabled &&
          (((task.target == ctl::CTL_HANDLER_TYPE::SERVICE_MANAGER) &&
@@ -21,9 +21,11 @@
 
 #pragma once
 #include <map>
+#include <mutex>
 #include <ostream>
 #include <vector>
 #include "service.h"
+#include "service_index.h"
 
 /**
  * @class ServiceManager ServiceManager.h "src/service/ServiceManager.h"
@@ -33,9 +35,21 @@
 class ServiceManager : public CtlObserver<ctl::CtlTask, std::string>,
                        public std::enable_shared_from_this<ServiceManager> {
   std::vector<Service *> services;
+  /** Literal Host and path requirements of the services. */
+  ServiceIndex service_index;
   static std::map<int, std::shared_ptr<ServiceManager>> instance;
+  /** Guards instance, a reload replaces it from the control thread. */
+  static std::mutex instance_mtx;
   std::shared_ptr<ctl::ControlManager> ctl_manager{nullptr};
 
+  /**
+   * @brief Replaces the session ticket keys of the listener by the ones in
+   * @p data, a JSON object with the hex strings in a "ticket-keys" array.
+   *
+   * @return json formatted string with the result of the operation.
+   */
+  std::string importTicketKeys(const std::string &data);
+
  public:
   /** ListenerConfig from the listener related with all the services managed by
    * the class. */
@@ -44,10 +58,34 @@ class ServiceManager : public CtlObserver<ctl::CtlTask, std::string>,
   std::shared_ptr<ListenerConfig> listener_config_;
   bool is_https_listener{false};
   std::atomic<int> established_connection{0};
-  /** ServiceManager instance. */
-  static std::shared_ptr<ServiceManager> &getInstance(
-      std::shared_ptr<ListenerConfig> listener_config);
-  static std::map<int,std::shared_ptr<ServiceManager>>& getInstance() ;
+  /** Client connections whose sent records are encrypted by the kernel. */
+  std::atomic<int> ktls_tx_connections{0};
+  /** Client connections whose received records are decrypted by the kernel. */
+  std::atomic<int> ktls_rx_connections{0};
+  /** Client TLS handshakes completed, and how many of them resumed a session. */
+  std::atomic<uint64_t> tls_handshakes{0};
+  std::atomic<uint64_t> tls_resumed{0};
+  /** Thread CPU time of the full and the resumed handshakes, in microseconds. */
+  std::atomic<uint64_t> full_handshake_cpu{0};
+  std::atomic<uint64_t> resumed_handshake_cpu{0};
+  /**
+   * Wall time the workers event loops spent on the client handshakes, in
+   * microseconds, the longest one, and the handshake steps run in the
+   * HandshakePool instead.
+   */
+  std::atomic<uint64_t> handshake_stall{0};
+  std::atomic<uint64_t> max_handshake_stall{0};
+  std::atomic<uint64_t> tls_offloaded{0};
+  /**
+   * @brief Returns the running ServiceManager set, keyed by listener id.
+   *
+   * It is a copy, so it can be iterated from any thread while a reload
+   * publishes a new set with setInstance().
+   */
+  static std::map<int, std::shared_ptr<ServiceManager>> getInstance();
+  /** @brief Publishes @p service_managers as the running set. */
+  static void setInstance(
+      std::map<int, std::shared_ptr<ServiceManager>> service_managers);
   explicit ServiceManager(std::shared_ptr<ListenerConfig> listener_config);
   ~ServiceManager() final;
 
@@ -101,4 +139,43 @@ class ServiceManager : public CtlObserver<ctl::CtlTask, std::string>,
    * @return true if should handle the task, false if not.
    */
   bool isHandler(ctl::CtlTask &task) override;
+
+  /**
+   * @brief Accounts the kTLS offload of a client @p connection.
+   *
+   * @param connection is a client connection after the handshake.
+   * @param count is 1 when the handshake is done, -1 when it is closed.
+   */
+  inline void countKtls(const Connection &connection, int count) {
+    if (connection.ktls_send) ktls_tx_connections += count;
+    if (connection.ktls_recv) ktls_rx_connections += count;
+  }
+
+  /**
+   * @brief Accounts a completed client handshake, its kTLS offload and
+   * whether it resumed a session.
+   *
+   * @param connection is a client connection after the handshake.
+   */
+  inline void countHandshake(const Connection &connection) {
+    countKtls(connection, 1);
+    tls_handshakes++;
+    if (SSL_session_reused(connection.ssl) != 0) {
+      tls_resumed++;
+      resumed_handshake_cpu += connection.handshake_cpu;
+    } else {
+      full_handshake_cpu += connection.handshake_cpu;
+    }
+  }
+
+  /**
+   * @brief Accounts the @p stall microseconds a worker event loop spent on a
+   * step of a client handshake.
+   */
+  inline void countHandshakeStall(uint64_t stall) {
+    handshake_stall += stall;
+    auto max = max_handshake_stall.load();
+    while (stall > max && !max_handshake_stall.compare_exchange_weak(max, stall))
+      ;
+  }
 };
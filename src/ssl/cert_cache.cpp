@@ -0,0 +1,157 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cert_cache.h"
+#include "../config/ssl_helper.h"
+#include "../debug/logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace ssl;
+
+CertCache::CertCache(std::shared_ptr<ListenerConfig> listener_config_,
+                     std::shared_ptr<TicketKeys> ticket_keys_)
+    : listener_config(std::move(listener_config_)),
+      ticket_keys(std::move(ticket_keys_)),
+      capacity(listener_config->cert_cache_size > 0
+                   ? listener_config->cert_cache_size
+                   : 1) {}
+
+std::shared_ptr<SSL_CTX> CertCache::build(POUND_CTX *pc) {
+  std::shared_ptr<SSL_CTX> ctx(SSL_CTX_new(TLS_server_method()),
+                               &::SSL_CTX_free);
+  auto file = pc->cert_file.c_str();
+  if (ctx == nullptr ||
+      SSL_CTX_use_certificate_chain_file(ctx.get(), file) != 1 ||
+      SSL_CTX_use_PrivateKey_file(ctx.get(), file, SSL_FILETYPE_PEM) != 1 ||
+      SSL_CTX_check_private_key(ctx.get()) != 1) {
+    Logger::logmsg(LOG_ERR, "Can not load the certificate %s", file);
+    build_errors++;
+    return nullptr;
+  }
+  // the settings of the listener, as the parser applies them to its contexts
+  auto from = listener_config->ctx->ctx.get();
+  auto to = ctx.get();
+  SSL_CTX_set_app_data(to, SSL_CTX_get_app_data(from));
+  SSL_CTX_set_mode(to, SSL_CTX_get_mode(from));
+  SSL_CTX_clear_options(to, SSL_CTX_get_options(to));
+  SSL_CTX_set_options(to, SSL_CTX_get_options(from));
+  SSL_CTX_set_min_proto_version(to, SSL_CTX_get_min_proto_version(from));
+  SSL_CTX_set_max_proto_version(to, SSL_CTX_get_max_proto_version(from));
+  SSL_CTX_set_info_callback(to, SSL_CTX_get_info_callback(from));
+  SSL_CTX_set_verify(to, SSL_CTX_get_verify_mode(from),
+                     SSL_CTX_get_verify_callback(from));
+  SSL_CTX_set_verify_depth(to, SSL_CTX_get_verify_depth(from));
+  SSL_CTX_set1_cert_store(to, SSL_CTX_get_cert_store(from));
+  if (auto ca_list = SSL_CTX_get_client_CA_list(from))
+    SSL_CTX_set_client_CA_list(to, SSL_dup_CA_list(ca_list));
+  std::string ciphers;
+  auto cipher_stack = SSL_CTX_get_ciphers(from);
+  for (int i = 0; i < sk_SSL_CIPHER_num(cipher_stack); i++) {
+    auto cipher = sk_SSL_CIPHER_value(cipher_stack, i);
+    // the TLSv1.3 suites are set apart
+    if (std::strcmp(SSL_CIPHER_get_version(cipher), "TLSv1.3") == 0) continue;
+    if (!ciphers.empty()) ciphers += ':';
+    ciphers += SSL_CIPHER_get_name(cipher);
+  }
+  if (!ciphers.empty()) SSL_CTX_set_cipher_list(to, ciphers.c_str());
+  if (!global::SslHelper::setKeyExchange(to, *listener_config)) {
+    Logger::logmsg(LOG_ERR, "Can not set the ECDH curve of %s", file);
+    build_errors++;
+    return nullptr;
+  }
+  global::SslHelper::setSessionIdContext(to, *listener_config);
+  if (ticket_keys != nullptr) ticket_keys->attach(to);
+  return ctx;
+}
+
+void CertCache::insert(POUND_CTX *pc, std::shared_ptr<SSL_CTX> ctx) {
+  if (index.count(pc) != 0) return;
+  while (lru.size() >= capacity) {
+    index.erase(lru.back().pc);
+    lru.pop_back();
+  }
+  lru.push_front({pc, std::move(ctx)});
+  index[pc] = lru.begin();
+}
+
+std::shared_ptr<SSL_CTX> CertCache::get(POUND_CTX *pc) {
+  {
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    auto found = index.find(pc);
+    if (found != index.end()) {
+      lru.splice(lru.begin(), lru, found->second);
+      hits++;
+      return found->second->ctx;
+    }
+    misses++;
+    requests[pc]++;
+  }
+  // built without the lock, other certificates are served meanwhile
+  auto start = std::chrono::steady_clock::now();
+  auto ctx = build(pc);
+  if (ctx == nullptr) return nullptr;
+  uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  cold_builds++;
+  cold_build_us += elapsed;
+  auto max = max_cold_build_us.load();
+  while (elapsed > max && !max_cold_build_us.compare_exchange_weak(max, elapsed))
+    ;
+  std::lock_guard<std::mutex> lock(cache_mtx);
+  insert(pc, ctx);
+  return ctx;
+}
+
+size_t CertCache::prebuildHot() {
+  std::vector<std::pair<unsigned int, POUND_CTX *>> hot;
+  {
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    for (auto &[pc, count] : requests)
+      if (count >= CERT_CACHE_HOT_REQUESTS && index.count(pc) == 0)
+        hot.emplace_back(count, pc);
+    requests.clear();
+  }
+  std::sort(hot.begin(), hot.end(),
+            [](auto &a, auto &b) { return a.first > b.first; });
+  // more than the capacity would release the ones just built
+  auto max_prebuilds = std::min<size_t>(CERT_CACHE_PREBUILD_MAX, capacity);
+  if (hot.size() > max_prebuilds) hot.resize(max_prebuilds);
+  size_t built = 0;
+  for (auto &[count, pc] : hot) {
+    auto ctx = build(pc);
+    if (ctx == nullptr) continue;
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    insert(pc, std::move(ctx));
+    built++;
+  }
+  prebuilds += built;
+  return built;
+}
+
+size_t CertCache::size() {
+  std::lock_guard<std::mutex> lock(cache_mtx);
+  return lru.size();
+}
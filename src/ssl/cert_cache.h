@@ -0,0 +1,121 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "../config/config_data.h"
+#include "ssl_ticket_keys.h"
+#include <openssl/ssl.h>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/** Lookups of a certificate not built, between two maintenances, for it to be
+ * prebuilt. */
+#define CERT_CACHE_HOT_REQUESTS 4
+/** Certificates prebuilt by a maintenance. */
+#define CERT_CACHE_PREBUILD_MAX 16
+
+namespace ssl {
+
+/**
+ * @class CertCache cert_cache.h "src/ssl/cert_cache.h"
+ * @brief Contexts of the certificates of a listener loaded on their first use.
+ *
+ * With CertCache set, only the first certificate of a listener is loaded at
+ * startup, the others are only indexed by their names and their SSL_CTX is
+ * built the first time the SNI of a handshake selects them, with the settings
+ * of the first one. Up to capacity contexts are kept, the least recently used
+ * ones are released. The handshakes that already use a released context keep
+ * it until they end. The maintenance prebuilds the certificates requested
+ * most often while they were not built, so the workers do not keep paying for
+ * them.
+ *
+ * A context not cached is built by get() in the SNI callback, so on the thread
+ * running the handshake: the worker, or the handshake pool when the listener
+ * offloads them. The build takes about as long as a full handshake and the
+ * worker serves nothing else meanwhile; cold_build_us and max_cold_build_us
+ * measure it, and prebuildHot() moves the frequent ones to the maintenance.
+ */
+class CertCache {
+  struct Entry {
+    POUND_CTX *pc;
+    std::shared_ptr<SSL_CTX> ctx;
+  };
+  std::mutex cache_mtx;
+  /** Most recently used first. */
+  std::list<Entry> lru;
+  std::unordered_map<POUND_CTX *, std::list<Entry>::iterator> index;
+  /** Lookups of the certificates not built since the last maintenance. */
+  std::unordered_map<POUND_CTX *, unsigned int> requests;
+  std::shared_ptr<ListenerConfig> listener_config;
+  std::shared_ptr<TicketKeys> ticket_keys;
+  size_t capacity;
+
+  /** @brief Caches @p ctx for @p pc, the cache must be locked. */
+  void insert(POUND_CTX *pc, std::shared_ptr<SSL_CTX> ctx);
+
+ public:
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+  /** Contexts built on a handshake, and the time they took in microseconds. */
+  std::atomic<uint64_t> cold_builds{0};
+  std::atomic<uint64_t> cold_build_us{0};
+  std::atomic<uint64_t> max_cold_build_us{0};
+  std::atomic<uint64_t> prebuilds{0};
+  std::atomic<uint64_t> build_errors{0};
+
+  /**
+   * @param listener_config is the listener of the certificates, the new
+   * contexts copy the settings of its first one and keep up to its
+   * cert_cache_size.
+   * @param ticket_keys are the session ticket keys of the listener, if any.
+   */
+  CertCache(std::shared_ptr<ListenerConfig> listener_config,
+            std::shared_ptr<TicketKeys> ticket_keys);
+
+  /**
+   * @brief Returns the context of @p pc, building it if it is not cached.
+   *
+   * It builds it on the calling thread, without holding the cache.
+   *
+   * @return @c nullptr if the certificate can not be loaded.
+   */
+  std::shared_ptr<SSL_CTX> get(POUND_CTX *pc);
+
+  /** @brief Loads the certificate of @p pc in a new context. */
+  std::shared_ptr<SSL_CTX> build(POUND_CTX *pc);
+
+  /**
+   * @brief Builds the certificates looked up at least CERT_CACHE_HOT_REQUESTS
+   * times since the last call while they were not cached.
+   *
+   * @return the number of contexts built.
+   */
+  size_t prebuildHot();
+
+  /** @brief Returns the number of contexts built. */
+  size_t size();
+};
+
+}  // namespace ssl
@@ -0,0 +1,171 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "handshake_offload.h"
+#include "../util/utils.h"
+#include "ssl_connection_manager.h"
+#include <openssl/err.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace ssl;
+
+HandshakePool &HandshakePool::getInstance() {
+  static HandshakePool instance;
+  return instance;
+}
+
+HandshakePool::~HandshakePool() { stop(); }
+
+void HandshakePool::start(int num_threads) {
+  std::lock_guard<std::mutex> lock(jobs_mtx);
+  if (!threads.empty()) return;
+  stopping = false;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([this] { run(); });
+    helper::ThreadHelper::setThreadName("HANDSHAKE_" + std::to_string(i),
+                                        threads.back().native_handle());
+  }
+}
+
+void HandshakePool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(jobs_mtx);
+    stopping = true;
+  }
+  jobs_cv.notify_all();
+  for (auto &thread : threads)
+    if (thread.joinable()) thread.join();
+  std::lock_guard<std::mutex> lock(jobs_mtx);
+  threads.clear();
+}
+
+bool HandshakePool::isRunning() {
+  std::lock_guard<std::mutex> lock(jobs_mtx);
+  return !threads.empty() && !stopping;
+}
+
+void HandshakePool::submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(jobs_mtx);
+    jobs.push_back(std::move(job));
+  }
+  jobs_cv.notify_one();
+}
+
+void HandshakePool::run() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(jobs_mtx);
+      jobs_cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+      if (jobs.empty()) return;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    job();
+  }
+}
+
+HandshakeOffload::HandshakeOffload() {}
+
+HandshakeOffload::~HandshakeOffload() {
+  waitIdle();
+  if (fd_ >= 0) {
+    removeEvents();
+    ::close(fd_);
+  }
+}
+
+bool HandshakeOffload::init() {
+  fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd_ < 0) {
+    Logger::logmsg(LOG_ERR, "Can not create the handshake eventfd: %s",
+                   std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void HandshakeOffload::submit(Connection &connection,
+                              const SSLContext &ssl_context) {
+  connection.disableEvents();
+  // what is received from now on is reported again by the kernel
+  connection.readDrained();
+  connection.detachEventManager();
+  {
+    std::lock_guard<std::mutex> lock(done_mtx);
+    running++;
+  }
+  HandshakePool::getInstance().submit([this, &connection, &ssl_context] {
+    ERR_clear_error();
+    Job job{&connection,
+            SSLConnectionManager::handleHandshake(ssl_context, connection),
+            ERR_peek_error()};
+    std::lock_guard<std::mutex> lock(done_mtx);
+    done.push_back(job);
+    uint64_t one = 1;
+    if (::write(fd_, &one, sizeof(one)) < 0)
+      Logger::logmsg(LOG_ERR, "Can not wake the worker up: %s",
+                     std::strerror(errno));
+    if (--running == 0) done_cv.notify_all();
+  });
+}
+
+std::vector<HandshakeOffload::Job> HandshakeOffload::takeDone() {
+  uint64_t count;
+  while (::read(fd_, &count, sizeof(count)) > 0)
+    ;
+  std::vector<Job> jobs;
+  std::lock_guard<std::mutex> lock(done_mtx);
+  jobs.swap(done);
+  return jobs;
+}
+
+void HandshakeOffload::waitIdle() {
+  std::unique_lock<std::mutex> lock(done_mtx);
+  done_cv.wait(lock, [this] { return running == 0; });
+}
+
+void HandshakeOffload::resume(Job &job, events::EpollManager &event_manager) {
+  auto &connection = *job.connection;
+  connection.setEventManager(event_manager);
+  ERR_clear_error();
+  if (job.error != 0) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    ERR_raise(ERR_GET_LIB(job.error), ERR_GET_REASON(job.error));
+#else
+    ERR_PUT_error(ERR_GET_LIB(job.error), 0, ERR_GET_REASON(job.error),
+                  __FILE__, __LINE__);
+#endif
+  }
+  if (!job.result) return;
+  if (connection.ssl_conn_status == SSL_STATUS::WANT_WRITE) {
+    // the kernel may have reported EPOLLOUT already, before the worker took
+    // the connection back
+    pollfd pfd{connection.getFileDescriptor(), POLLOUT, 0};
+    if (::poll(&pfd, 1, 0) != 1) connection.writeBlocked();
+    connection.enableWriteEvent();
+  } else {
+    connection.enableReadEvent();
+  }
+}
@@ -0,0 +1,127 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "../connection/connection.h"
+#include "../event/descriptor.h"
+#include "ssl_context.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ssl {
+
+/**
+ * @class HandshakePool handshake_offload.h "src/ssl/handshake_offload.h"
+ * @brief Threads running the client TLS handshakes of the workers.
+ *
+ * The key exchange and the signature of a full handshake take from tens of
+ * microseconds to milliseconds of CPU, depending on the key; run on a worker
+ * they delay every other connection of its event loop. The pool is shared by
+ * all the workers, it is started with HandshakeThreads.
+ */
+class HandshakePool {
+  std::mutex jobs_mtx;
+  std::condition_variable jobs_cv;
+  std::deque<std::function<void()>> jobs;
+  std::vector<std::thread> threads;
+  bool stopping{false};
+
+  void run();
+
+ public:
+  static HandshakePool &getInstance();
+  ~HandshakePool();
+
+  /** @brief Starts @p num_threads threads, if the pool is not running. */
+  void start(int num_threads);
+
+  /** @brief Stops the threads once the queued jobs are done. */
+  void stop();
+
+  /** @brief Returns @c true if the pool has threads to run the jobs. */
+  bool isRunning();
+
+  void submit(std::function<void()> job);
+};
+
+/**
+ * @class HandshakeOffload handshake_offload.h "src/ssl/handshake_offload.h"
+ * @brief Client handshakes of a worker run in the HandshakePool.
+ *
+ * Each time a handshake needs to progress, the worker disables the events of
+ * the connection, detaches it from its event manager and queues the step to
+ * the pool, so the pool thread is the only one touching the connection.
+ * Once it is done the connection is handed back and the worker is woken up
+ * through this eventfd, registered in its event manager. The worker then
+ * calls resume() and goes on as if the step had run inline.
+ */
+class HandshakeOffload : public events::Descriptor {
+ public:
+  struct Job {
+    Connection *connection;
+    /** Returned by SSLConnectionManager::handleHandshake(). */
+    bool result;
+    /** First error of the step, the OpenSSL error queue is per thread. */
+    unsigned long error;
+  };
+
+ private:
+  std::mutex done_mtx;
+  std::condition_variable done_cv;
+  std::vector<Job> done;
+  /** Steps queued to the pool and not done yet. */
+  size_t running{0};
+
+ public:
+  HandshakeOffload();
+  ~HandshakeOffload() override;
+
+  /** @brief Creates the eventfd. */
+  bool init();
+
+  /**
+   * @brief Runs a step of the server handshake of @p connection in the pool.
+   *
+   * The connection must not be used until takeDone() returns it.
+   */
+  void submit(Connection &connection, const SSLContext &ssl_context);
+
+  /** @brief Returns the steps done, from the worker once woken up. */
+  std::vector<Job> takeDone();
+
+  /** @brief Waits until every step submitted is done. */
+  void waitIdle();
+
+  /**
+   * @brief Attaches the connection of @p job to @p event_manager again and
+   * enables the events its handshake waits for.
+   *
+   * The error of the step is restored in the OpenSSL error queue of the
+   * calling thread.
+   */
+  static void resume(Job &job, events::EpollManager &event_manager);
+};
+
+}  // namespace ssl
@@ -0,0 +1,100 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sni_index.h"
+#include <fnmatch.h>
+
+using namespace ssl;
+
+SniIndex::SniIndex(POUND_CTX *ctx, POUND_CTX *lazy_ctx) {
+  for (auto list : {ctx, lazy_ctx}) {
+    for (auto pc = list; pc != nullptr; pc = pc->next.get()) {
+      auto order = contexts.size();
+      contexts.push_back(pc);
+      add(pc->server_name, order);
+      if (pc->subjectAltNames == nullptr) continue;
+      for (unsigned int i = 0; i < pc->subjectAltNameCount; i++)
+        add(reinterpret_cast<char *>(pc->subjectAltNames[i]), order);
+    }
+  }
+}
+
+void SniIndex::add(const char *pattern, size_t order) {
+  if (pattern == nullptr) return;
+  std::string_view name(pattern);
+  auto is_plain = [](std::string_view text) {
+    return text.find_first_of("*?[\\") == std::string_view::npos;
+  };
+  if (is_plain(name)) {
+    // the first certificate with the name is used
+    names.emplace(name, order);
+    return;
+  }
+  if (name.size() > 2 && name.substr(0, 2) == "*." && is_plain(name.substr(2))) {
+    // the '*' also matches dots, so "*.domain" matches any name ending in
+    // ".domain"
+    auto node = &wildcards;
+    auto end = name.size();
+    while (true) {
+      auto dot = name.rfind('.', end - 1);
+      auto &child = node->children[std::string(name.substr(dot + 1, end - dot - 1))];
+      if (child == nullptr) child = std::make_unique<Node>();
+      node = child.get();
+      if (dot == 1) break;
+      end = dot;
+    }
+    if (node->wildcard == NONE) node->wildcard = order;
+    return;
+  }
+  patterns.push_back({std::string(name), order});
+}
+
+POUND_CTX *SniIndex::find(std::string_view server_name) const {
+  auto best = NONE;
+  auto name = names.find(std::string(server_name));
+  if (name != names.end()) best = name->second;
+
+  auto node = &wildcards;
+  auto end = server_name.size();
+  while (true) {
+    auto dot = end == 0 ? std::string_view::npos : server_name.rfind('.', end - 1);
+    auto start = dot == std::string_view::npos ? 0 : dot + 1;
+    auto child =
+        node->children.find(std::string(server_name.substr(start, end - start)));
+    // a wildcard needs something before its domain
+    if (child == node->children.end() || dot == std::string_view::npos) break;
+    node = child->second.get();
+    if (node->wildcard < best) best = node->wildcard;
+    end = dot;
+  }
+
+  if (!patterns.empty()) {
+    std::string host(server_name);
+    for (auto &pattern : patterns) {
+      if (pattern.order >= best) break;
+      if (::fnmatch(pattern.pattern.c_str(), host.c_str(), 0) == 0) {
+        best = pattern.order;
+        break;
+      }
+    }
+  }
+  return best == NONE ? nullptr : contexts[best];
+}
@@ -0,0 +1,81 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "../config/config_data.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ssl {
+
+/**
+ * @class SniIndex sni_index.h "src/ssl/sni_index.h"
+ * @brief Index of the certificate names of a listener, for the SNI lookup.
+ *
+ * It is built once, when the listener is loaded. The plain names go to a hash
+ * map and the "*.domain" ones to a trie of the domain labels, last label
+ * first, so a lookup costs one hash probe per label of the requested name.
+ * Any other pattern is kept in a list and checked with fnmatch(). The result
+ * is the same as matching the patterns in the configuration order: the first
+ * certificate whose CN or any subjectAltName matches.
+ */
+class SniIndex {
+  struct Node {
+    std::unordered_map<std::string, std::unique_ptr<Node>> children;
+    /** Certificate of the "*." pattern ending at this node. */
+    size_t wildcard{NONE};
+  };
+  struct Pattern {
+    std::string pattern;
+    size_t order;
+  };
+  static constexpr size_t NONE = static_cast<size_t>(-1);
+
+  /** Certificates in configuration order. */
+  std::vector<POUND_CTX *> contexts;
+  std::unordered_map<std::string, size_t> names;
+  Node wildcards;
+  /** Patterns neither plain nor "*.domain", in configuration order. */
+  std::vector<Pattern> patterns;
+
+  void add(const char *pattern, size_t order);
+
+ public:
+  /**
+   * @brief Indexes the certificates of the @p ctx list, then the ones of the
+   * @p lazy_ctx list.
+   */
+  explicit SniIndex(POUND_CTX *ctx, POUND_CTX *lazy_ctx = nullptr);
+
+  /**
+   * @brief Returns the certificate for @p server_name, @c nullptr if none of
+   * them matches.
+   */
+  POUND_CTX *find(std::string_view server_name) const;
+
+  /** @brief Returns the first certificate, used when none matches. */
+  POUND_CTX *defaultContext() const { return contexts.front(); }
+};
+
+}  // namespace ssl
@@ -0,0 +1,84 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "ssl_client_session.h"
+
+using namespace ssl;
+
+ClientSessionStore::~ClientSessionStore() {
+  if (session != nullptr) SSL_SESSION_free(session);
+}
+
+int ClientSessionStore::exIndex() {
+  static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+void ClientSessionStore::attach(SSL_CTX *ssl_ctx) {
+  SSL_CTX_set_session_cache_mode(
+      ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ssl_ctx, newSessionCallback);
+}
+
+int ClientSessionStore::newSessionCallback(SSL *ssl, SSL_SESSION *new_session) {
+  auto store = static_cast<ClientSessionStore *>(SSL_get_ex_data(ssl, exIndex()));
+  if (store == nullptr || SSL_SESSION_is_resumable(new_session) == 0) return 0;
+  SSL_SESSION *old_session;
+  {
+    std::lock_guard<std::mutex> lock(store->session_mtx);
+    old_session = store->session;
+    store->session = new_session;
+  }
+  if (old_session != nullptr) SSL_SESSION_free(old_session);
+  // the store keeps the reference
+  return 1;
+}
+
+void ClientSessionStore::offer(SSL *ssl) {
+  SSL_set_ex_data(ssl, exIndex(), this);
+  std::lock_guard<std::mutex> lock(session_mtx);
+  if (session != nullptr) SSL_set_session(ssl, session);
+}
+
+void ClientSessionStore::countHandshake(SSL *ssl) {
+  handshakes++;
+  if (SSL_session_reused(ssl) != 0) {
+    resumed++;
+    return;
+  }
+  SSL_SESSION *refused = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(session_mtx);
+    // a TLSv1.2 full handshake already stored its own session, the TLSv1.3
+    // tickets arrive after it
+    if (session != nullptr && session != SSL_get0_session(ssl)) {
+      refused = session;
+      session = nullptr;
+    }
+  }
+  if (refused != nullptr) SSL_SESSION_free(refused);
+}
+
+bool ClientSessionStore::hasSession() {
+  std::lock_guard<std::mutex> lock(session_mtx);
+  return session != nullptr;
+}
@@ -0,0 +1,76 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <openssl/ssl.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace ssl {
+
+/**
+ * @class ClientSessionStore ssl_client_session.h "src/ssl/ssl_client_session.h"
+ * @brief Last TLS session issued by a backend, offered again on every new
+ * connection to it so the handshake resumes instead of doing a full one.
+ *
+ * The backend SSL_CTX gets a client session cache without internal store, its
+ * new session callback hands the sessions, the TLSv1.3 tickets included, to
+ * the store the connection was created for. A session the backend refuses to
+ * resume is dropped, the full handshake issues a new one.
+ */
+class ClientSessionStore {
+  std::mutex session_mtx;
+  SSL_SESSION *session{nullptr};
+
+  static int exIndex();
+  static int newSessionCallback(SSL *ssl, SSL_SESSION *new_session);
+
+ public:
+  /** Handshakes completed with the backend, and how many of them resumed. */
+  std::atomic<uint64_t> handshakes{0};
+  std::atomic<uint64_t> resumed{0};
+
+  ClientSessionStore() = default;
+  ClientSessionStore(const ClientSessionStore &) = delete;
+  ClientSessionStore &operator=(const ClientSessionStore &) = delete;
+  ~ClientSessionStore();
+
+  /** @brief Makes the client @p ssl_ctx hand its new sessions to the stores. */
+  static void attach(SSL_CTX *ssl_ctx);
+
+  /**
+   * @brief Binds the new @p ssl to this store and offers it the stored
+   * session, call it before the first handshake step.
+   */
+  void offer(SSL *ssl);
+
+  /**
+   * @brief Accounts the completed handshake of @p ssl, dropping the offered
+   * session if the backend did not resume it.
+   */
+  void countHandshake(SSL *ssl);
+
+  /** @brief Whether there is a session to offer. */
+  bool hasSession();
+};
+
+}  // namespace ssl
@@ -21,6 +21,7 @@
 
 #include "ssl_connection_manager.h"
 #include "../util/common.h"
+#include "../util/time.h"
 #include <openssl/err.h>
 
 using namespace ssl;
@@ -76,14 +77,50 @@ bool SSLConnectionManager::initSslConnection(SSL_CTX *ssl_ctx,
   return true;
 }
 
+void SSLConnectionManager::checkKtls(Connection &ssl_connection) {
+#ifdef SSL_OP_ENABLE_KTLS
+  ssl_connection.ktls_send =
+      BIO_get_ktls_send(SSL_get_wbio(ssl_connection.ssl));
+  ssl_connection.ktls_recv =
+      BIO_get_ktls_recv(SSL_get_rbio(ssl_connection.ssl));
+  if (ssl_connection.ktls_send || ssl_connection.ktls_recv)
+    Logger::logmsg(LOG_DEBUG, "fd:%d kTLS offload send: %s receive: %s",
+                   ssl_connection.getFileDescriptor(),
+                   ssl_connection.ktls_send ? "yes" : "no",
+                   ssl_connection.ktls_recv ? "yes" : "no");
+#endif
+}
+
+bool SSLConnectionManager::isKtlsReadReady(Connection &ssl_connection) {
+  if (!ssl_connection.ktls_recv) return false;
+#if USE_SSL_BIO_BUFFER
+  // the buffer BIO asks the ssl BIO, and so SSL_pending(), when empty
+  return BIO_pending(ssl_connection.io) == 0;
+#else
+  return SSL_pending(ssl_connection.ssl) == 0;
+#endif
+}
+
+bool SSLConnectionManager::isKtlsWriteReady(Connection &ssl_connection) {
+  if (!ssl_connection.ktls_send) return false;
+#if USE_SSL_BIO_BUFFER
+  return BIO_wpending(ssl_connection.io) == 0;
+#else
+  return true;
+#endif
+}
+
 IO::IO_RESULT SSLConnectionManager::handleDataRead(Connection &ssl_connection) {
+  if (isKtlsReadReady(ssl_connection)) return ssl_connection.read();
 #if USE_SSL_BIO_BUFFER==0
   return sslRead(ssl_connection);
 #endif
   if (!ssl_connection.ssl_connected) {
     return IO::IO_RESULT::SSL_NEED_HANDSHAKE;
   }
-  if (MAX_DATA_SIZE == ssl_connection.buffer_size)
+  if (!ssl_connection.acquireBuffer()) return IO::IO_RESULT::ERROR;
+  const size_t capacity = ssl_connection.bufferCapacity();
+  if (capacity == ssl_connection.buffer_size + ssl_connection.buffer_offset)
     return IO::IO_RESULT::FULL_BUFFER;
   //  Logger::logmsg(LOG_DEBUG, "> handleRead");
   int rc = -1;
@@ -96,12 +133,15 @@ IO::IO_RESULT SSLConnectionManager::handleDataRead(Connection &ssl_connection) {
         ssl_connection.io,
         ssl_connection.buffer + ssl_connection.buffer_offset +
             ssl_connection.buffer_size,
-        static_cast<int>(MAX_DATA_SIZE - ssl_connection.buffer_size -
+        static_cast<int>(capacity - ssl_connection.buffer_size -
                          ssl_connection.buffer_offset),
         &bytes_read);
     //    Logger::logmsg(LOG_DEBUG,
     //                   "BIO_read return code %d buffer size %d bytes_read %d",
     //                   rc, ssl_connection.buffer_size, bytes_read);
+    if (rc <= 0 && BIO_should_retry(ssl_connection.io) &&
+        BIO_should_read(ssl_connection.io))
+      ssl_connection.readDrained();
 
     if (rc == 0) {
       if (total_bytes_read > 0)
@@ -121,7 +161,7 @@ IO::IO_RESULT SSLConnectionManager::handleDataRead(Connection &ssl_connection) {
     }
     total_bytes_read += bytes_read;
     ssl_connection.buffer_size += static_cast<size_t>(bytes_read);
-    if (static_cast<int>(MAX_DATA_SIZE - ssl_connection.buffer_size -
+    if (static_cast<int>(capacity - ssl_connection.buffer_size -
                          ssl_connection.buffer_offset) == 0)
       return IO::IO_RESULT::FULL_BUFFER;
     // return IO::IO_RESULT::SUCCESS;
@@ -134,6 +174,8 @@ IO::IO_RESULT SSLConnectionManager::handleWrite(Connection &ssl_connection, cons
     return IO::IO_RESULT::SSL_NEED_HANDSHAKE;
   }
   if (data_size == 0) return IO::IO_RESULT::SUCCESS;
+  if (isKtlsWriteReady(ssl_connection))
+    return ssl_connection.write(data, data_size, total_written);
   IO::IO_RESULT result;
   int rc = -1;
   //  // FIXME: Buggy, used just for test
@@ -147,6 +189,9 @@ IO::IO_RESULT SSLConnectionManager::handleWrite(Connection &ssl_connection, cons
 //    if(rc != written){
 //      Logger::logmsg(LOG_DEBUG, "BIO_write_ex return code %d written: %d total %d size: %d", rc,written, total_written, data_size);
 //    }
+    if (rc <= 0 && BIO_should_retry(ssl_connection.io) &&
+        BIO_should_write(ssl_connection.io))
+      ssl_connection.writeBlocked();
 
     if (rc == 0) {
       if (total_written > 0) {
@@ -190,8 +235,10 @@ IO::IO_RESULT SSLConnectionManager::handleWrite(Connection &ssl_connection, cons
 bool SSLConnectionManager::handleHandshake(const SSLContext &ssl_context,
                                            Connection &ssl_connection,
                                            bool client_mode) {
+  auto cpu_start = Time::getThreadCpuUs();
   auto result =
       handleHandshake(ssl_context.ssl_ctx.get(), ssl_connection, client_mode);
+  ssl_connection.handshake_cpu += Time::getThreadCpuUs() - cpu_start;
   if (result && ssl_connection.ssl_connected) {
     if (!client_mode &&
         ssl_context.listener_config->ssl_forward_sni_server_name) {
@@ -265,10 +312,12 @@ bool SSLConnectionManager::handleHandshake(SSL_CTX *ssl_ctx,
       return errno__ == 0;
     }
     if (BIO_should_write(ssl_connection.io)) {
+      ssl_connection.writeBlocked();
       ssl_connection.enableWriteEvent();
       ssl_connection.ssl_conn_status = SSL_STATUS::WANT_WRITE;
       return true;
     } else if (BIO_should_read(ssl_connection.io)) {
+      ssl_connection.readDrained();
       ssl_connection.enableReadEvent();
       ssl_connection.ssl_conn_status = SSL_STATUS::WANT_READ;
       return true;
@@ -293,6 +342,7 @@ bool SSLConnectionManager::handleHandshake(SSL_CTX *ssl_ctx,
   } else if (r == 1) {
 #endif
   ssl_connection.ssl_connected = true;
+  checkKtls(ssl_connection);
   const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl_connection.ssl);
   if (cipher) {
     auto buf = std::make_unique<char[]>(MAXBUF);
@@ -321,11 +371,13 @@ else {
   int err = SSL_get_error(ssl_connection.ssl, r);
   switch (err) {
     case SSL_ERROR_WANT_READ: {
+      ssl_connection.readDrained();
       ssl_connection.enableReadEvent();
       ssl_connection.ssl_conn_status = SSL_STATUS::WANT_READ;
       return true;
     }
     case SSL_ERROR_WANT_WRITE: {
+      ssl_connection.writeBlocked();
       ssl_connection.enableWriteEvent();
       ssl_connection.ssl_conn_status = SSL_STATUS::WANT_WRITE;
       return true;
@@ -412,23 +464,33 @@ IO::IO_RESULT SSLConnectionManager::sslRead(Connection &ssl_connection) {
   if (!ssl_connection.ssl_connected) {
     return IO::IO_RESULT::SSL_NEED_HANDSHAKE;
   }
+  if (!ssl_connection.acquireBuffer()) return IO::IO_RESULT::ERROR;
+  const size_t capacity = ssl_connection.bufferCapacity();
+  if (capacity == ssl_connection.buffer_size + ssl_connection.buffer_offset)
+    return IO::IO_RESULT::FULL_BUFFER;
   IO::IO_RESULT result = IO::IO_RESULT::ERROR;
   int rc = -1;
   do {
     ERR_clear_error();
     rc = SSL_read(ssl_connection.ssl,
                   ssl_connection.buffer + ssl_connection.buffer_offset + ssl_connection.buffer_size,
-                  static_cast<int>(MAX_DATA_SIZE - ssl_connection.buffer_size - ssl_connection.buffer_offset ));
+                  static_cast<int>(capacity - ssl_connection.buffer_size - ssl_connection.buffer_offset ));
     auto ssle = SSL_get_error(ssl_connection.ssl, rc);
     switch (ssle) {
       case SSL_ERROR_NONE:
         ssl_connection.buffer_size += static_cast<size_t>(rc);
+        if (capacity == ssl_connection.buffer_size + ssl_connection.buffer_offset)
+          return IO::IO_RESULT::FULL_BUFFER;
         result = IO::IO_RESULT::SUCCESS;
         break;
       case SSL_ERROR_WANT_READ:
       case SSL_ERROR_WANT_WRITE: {
         Logger::logmsg(LOG_DEBUG, "SSL_read return %d error %d errno %d msg %s",
                        rc, ssle, errno, strerror(errno));
+        if (ssle == SSL_ERROR_WANT_READ)
+          ssl_connection.readDrained();
+        else
+          ssl_connection.writeBlocked();
         return IO::IO_RESULT::DONE_TRY_AGAIN;  // TODO::  check want read
       }
       case SSL_ERROR_ZERO_RETURN:
@@ -468,6 +530,7 @@ IO::IO_RESULT SSLConnectionManager::sslWrite(Connection &ssl_connection,
     return IO::IO_RESULT::SUCCESS;
   }
   int ssle = SSL_get_error(ssl_connection.ssl, static_cast<int>(rc));
+  if (ssle == SSL_ERROR_WANT_WRITE) ssl_connection.writeBlocked();
   if (rc < 0 && ssle != SSL_ERROR_WANT_WRITE) {
     // Renegotiation is not possible in a TLSv1.3 connection
     Logger::logmsg(LOG_DEBUG, "SSL_read return %d error %d errno %d msg %s", rc,
@@ -514,6 +577,14 @@ IO::IO_RESULT SSLConnectionManager::sslWriteIOvec(
 IO::IO_RESULT SSLConnectionManager::handleWriteIOvec(Connection &target_ssl_connection, iovec *iov, size_t &iovec_size,
                                                      size_t &iovec_written, size_t &nwritten) {
   IO::IO_RESULT result = IO::IO_RESULT::ERROR;
+  if (isKtlsWriteReady(target_ssl_connection)) {
+    // a single writev, the kernel splits it in records
+    result = Connection::writeIOvec(target_ssl_connection.getFileDescriptor(),
+                                    iov, iovec_size, iovec_written, nwritten);
+    if (result == IO::IO_RESULT::DONE_TRY_AGAIN)
+      target_ssl_connection.writeBlocked();
+    return result;
+  }
   size_t count = 0;
   auto nvec = iovec_size;
   nwritten = 0;
@@ -167,6 +167,33 @@ class SSLConnectionManager {
   static bool initSslConnection(SSL_CTX *ssl_ctx, Connection &ssl_connection,
                                 bool client_mode = false);
 
+  /**
+   * @brief Sets the kTLS offload flags of the @p ssl_connection.
+   *
+   * Called once the handshake is done. OpenSSL moves the keys to the kernel
+   * if the SSL_CTX has SSL_OP_ENABLE_KTLS, the tls module is loaded and the
+   * protocol version and cipher are supported, each direction on its own.
+   * An offloaded direction is then handled with plain socket calls, anything
+   * else keeps going through OpenSSL.
+   *
+   * @param ssl_connection is the connection that finished the handshake.
+   */
+  static void checkKtls(Connection &ssl_connection);
+
+  /**
+   * @brief Checks if the received records of the @p ssl_connection can be
+   * read from the socket as plain data.
+   *
+   * It requires the kTLS offload and nothing left in the OpenSSL buffers.
+   */
+  static bool isKtlsReadReady(Connection &ssl_connection);
+
+  /**
+   * @brief Checks if the @p ssl_connection socket can be written with plain
+   * data, the kTLS offload is on and nothing is left in the OpenSSL buffers.
+   */
+  static bool isKtlsWriteReady(Connection &ssl_connection);
+
   /**
    * @brief Async Ssl connection Shutdown
    * @param ssl_connection used to read from.
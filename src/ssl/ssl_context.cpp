@@ -96,18 +96,21 @@ bool SSLContext::init(std::shared_ptr<ListenerConfig> listener_config_) {
   listener_config = listener_config_;
   if (listener_config->ctx != nullptr) {
 #ifdef SSL_CTRL_SET_TLSEXT_SERVERNAME_CB
-    if (listener_config_->ctx->next)
+    if (listener_config_->ctx->next || listener_config_->lazy_ctx) {
+      sni_index = std::make_unique<SniIndex>(listener_config_->ctx.get(),
+                                             listener_config_->lazy_ctx.get());
       if (!SSL_CTX_set_tlsext_servername_callback(
               listener_config_->ctx->ctx.get(), SNIServerName) ||
           !SSL_CTX_set_tlsext_servername_arg(listener_config_->ctx->ctx.get(),
-                                             listener_config_->ctx.get()))
+                                             this))
         Logger::logmsg(LOG_ERR, "ListenHTTPS: can't set SNI callback");
+    }
 #endif
 
     ssl_ctx = listener_config->ctx->ctx;
 
 #if ENABLE_SSL_SESSION_CACHING
-    SslSessionManager::attachCallbacks(ssl_ctx);
+    SslSessionManager::attachCallbacks(ssl_ctx.get());
 #endif
 
 #if SSL_DISABLE_SESSION_CACHE
@@ -118,6 +121,14 @@ bool SSLContext::init(std::shared_ptr<ListenerConfig> listener_config_) {
     SSL_CTX_set_options(ssl_ctx, SSL_OP_NO_TICKET);
     SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_OFF);
 #endif
+    if (listener_config->ssl_session_tickets) {
+      ticket_keys =
+          std::make_shared<TicketKeys>(listener_config->ticket_key_rotation);
+      for (auto pc = listener_config->ctx; pc; pc = pc->next)
+        ticket_keys->attach(pc->ctx.get());
+    }
+    if (listener_config->lazy_ctx != nullptr)
+      cert_cache = std::make_unique<CertCache>(listener_config, ticket_keys);
     SSL_CTX_set_options(ssl_ctx.get(), SSL_OP_NO_COMPRESSION);
     SSL_CTX_set_mode(ssl_ctx.get(), SSL_MODE_RELEASE_BUFFERS);
     return true;
@@ -197,34 +208,24 @@ bool SSLContext::loadOpensslConfig(const std::string &config_file_path, const st
   }
 }
 
-int SSLContext::SNIServerName(SSL *ssl, int dummy, POUND_CTX *ctx) {
+int SSLContext::SNIServerName(SSL *ssl, int dummy, SSLContext *ssl_context) {
   const char *server_name;
-  POUND_CTX *pc;
 
   if ((server_name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name)) == nullptr) return SSL_TLSEXT_ERR_NOACK;
 
   /* logmsg(LOG_DEBUG, "Received SSL SNI Header for servername %s",
    * servername); */
 
-  SSL_set_SSL_CTX(ssl, nullptr);
-  for (pc = ctx; pc; pc = pc->next.get()) {
-    if (fnmatch(pc->server_name, server_name, 0) == 0) {
-      /* logmsg(LOG_DEBUG, "Found cert for %s", servername); */
-      SSL_set_SSL_CTX(ssl, pc->ctx.get());
-      return SSL_TLSEXT_ERR_OK;
-    } else if (pc->subjectAltNameCount > 0 && pc->subjectAltNames != nullptr) {
-      size_t i;
-      for (i = 0; i < pc->subjectAltNameCount; i++) {
-        if (fnmatch(reinterpret_cast<char *>(pc->subjectAltNames[i]), server_name, 0) == 0) {
-          SSL_set_SSL_CTX(ssl, pc->ctx.get());
-          return SSL_TLSEXT_ERR_OK;
-        }
-      }
-    }
+  std::shared_ptr<SSL_CTX> ctx;
+  auto pc = ssl_context->sni_index->find(server_name);
+  if (pc != nullptr)
+    ctx = pc->ctx != nullptr ? pc->ctx : ssl_context->cert_cache->get(pc);
+  if (ctx == nullptr) {
+    /* logmsg(LOG_DEBUG, "No match for %s, default used", server_name); */
+    ctx = ssl_context->sni_index->defaultContext()->ctx;
   }
-
-  /* logmsg(LOG_DEBUG, "No match for %s, default used", server_name); */
-  SSL_set_SSL_CTX(ssl, ctx->ctx.get());
+  // the handshake keeps its own reference if the cache releases it
+  SSL_set_SSL_CTX(ssl, ctx.get());
   return SSL_TLSEXT_ERR_OK;
 }
 
@@ -23,6 +23,9 @@
 
 #include "../config/config.h"
 #include "../debug/logger.h"
+#include "cert_cache.h"
+#include "sni_index.h"
+#include "ssl_ticket_keys.h"
 #include <openssl/bio.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
@@ -57,6 +60,12 @@ class SSLContext {
   std::shared_ptr<ListenerConfig> listener_config;
   /** This struct is used to support SNI. */
   SSLData ctx;
+  /** Session ticket keys, if the listener resumes sessions with tickets. */
+  std::shared_ptr<TicketKeys> ticket_keys{nullptr};
+  /** Certificate names of the listener, if it has more than one. */
+  std::unique_ptr<SniIndex> sni_index{nullptr};
+  /** Certificates built on their first use, with CertCache. */
+  std::unique_ptr<CertCache> cert_cache{nullptr};
 
   SSLContext();
   virtual ~SSLContext();
@@ -107,12 +116,12 @@ class SSLContext {
    *
    * @param ssl is the SSL object to load.
    * @param dummy is a OpenSSL internal.
-   * @param ctx is the linked list with the different SSL_CTX.
+   * @param ssl_context is the SSLContext of the listener.
    *
    * @return SSL_TLSEXT_ERR_OK if everything is ok, if not return an OpenSSL
    * error code.
    */
-  static int SNIServerName(SSL *ssl, int dummy, POUND_CTX *ctx);
+  static int SNIServerName(SSL *ssl, int dummy, SSLContext *ssl_context);
 
   /**
    * @brief Check if the @p engine_id set in the configuration file is valid and
@@ -32,70 +32,107 @@ SslSessionManager *SslSessionManager::getInstance() {
   return ssl_session_manager;
 }
 
+SslSessionManager::SslSessionManager(size_t max_bytes)
+    : shard_max_bytes(max_bytes / SSL_SESSION_CACHE_SHARDS) {}
+
+SslSessionManager::Shard &SslSessionManager::getShard(const std::string &id) {
+  return shards[std::hash<std::string>()(id) % SSL_SESSION_CACHE_SHARDS];
+}
+
+void SslSessionManager::erase(Shard &shard, std::list<SslSessionData>::iterator it) {
+  auto size = it->size();
+  shard.bytes -= size;
+  bytes -= size;
+  entries--;
+  shard.index.erase(it->sess_id);
+  shard.lru.erase(it);
+}
+
 void SslSessionManager::removeSessionId(const unsigned char *id, int idLength) {
-  Logger::logmsg(LOG_ERR, "SESSION DELETE id: %s", id);
-  std::lock_guard<std::mutex> lock(data_mtx);
-  auto i = sessions.begin();
-  while (i != sessions.end()) {
-    if (std::memcmp((*i)->sess_id, id, idLength) == 0) {
-      delete (*i);
-      sessions.erase(i++);
-    } else
-      ++i;
-  }
+  std::string sess_id(reinterpret_cast<const char *>(id), static_cast<size_t>(idLength));
+  auto &shard = getShard(sess_id);
+  std::lock_guard<std::mutex> lock(shard.data_mtx);
+  auto found = shard.index.find(sess_id);
+  if (found != shard.index.end()) erase(shard, found->second);
 }
 
 int SslSessionManager::addSession(SSL *ssl, SSL_SESSION *session) {
-  auto encoded_length = i2d_SSL_SESSION(session, NULL);
-
-  unsigned char *buff;
+  auto encoded_length = i2d_SSL_SESSION(session, nullptr);
+  if (encoded_length <= 0) return 0;
   unsigned int id_length;
   const unsigned char *id = SSL_SESSION_get_id(session, &id_length);
-  Logger::logmsg(LOG_ERR, "SESSION ADD id: %s", id);
-  removeSessionId(id, id_length);
-  std::lock_guard<std::mutex> lock(data_mtx);
-
-  auto *data = new SslSessionData();
-
-  buff = data->encoding_data;
-
+  SslSessionData data;
+  data.sess_id.assign(reinterpret_cast<const char *>(id), id_length);
+  data.encoding.resize(static_cast<size_t>(encoded_length));
+  auto buff = data.encoding.data();
   i2d_SSL_SESSION(session, &buff);
-
-  memcpy(data->sess_id, id, id_length);
-  data->encoding_length = encoded_length;
-  data->sess_id_size = id_length;
-
-  sessions.push_back(data);
-  return 1;
+  data.expires = SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session);
+  auto size = data.size();
+  if (size > shard_max_bytes) return 0;
+
+  auto &shard = getShard(data.sess_id);
+  std::lock_guard<std::mutex> lock(shard.data_mtx);
+  auto found = shard.index.find(data.sess_id);
+  if (found != shard.index.end()) erase(shard, found->second);
+  auto now = std::time(nullptr);
+  while (!shard.lru.empty() && shard.bytes + size > shard_max_bytes) {
+    if (shard.lru.back().expires <= now)
+      expirations++;
+    else
+      evictions++;
+    erase(shard, std::prev(shard.lru.end()));
+  }
+  shard.lru.push_front(std::move(data));
+  shard.index.emplace(shard.lru.front().sess_id, shard.lru.begin());
+  shard.bytes += size;
+  bytes += size;
+  entries++;
+  // the cache keeps its own copy
+  return 0;
 }
 
 SSL_SESSION *SslSessionManager::getSession(SSL *ssl, const unsigned char *id, int id_length, int *do_copy) {
-  unsigned char *buff;
-  std::lock_guard<std::mutex> lock(data_mtx);
-  Logger::logmsg(LOG_REMOVE, "SESSION GET id: %x", id);
   *do_copy = 0;
-
-  for (auto data : sessions) {
-    if (std::memcmp(data->sess_id, id, id_length) == 0) {
-      buff = (unsigned char *)malloc(data->encoding_length);
-      memcpy(buff, data->encoding_data, data->encoding_length);
-      return d2i_SSL_SESSION(NULL, (const unsigned char **)&buff, data->encoding_length);
-    }
+  std::string sess_id(reinterpret_cast<const char *>(id), static_cast<size_t>(id_length));
+  auto &shard = getShard(sess_id);
+  std::lock_guard<std::mutex> lock(shard.data_mtx);
+  auto found = shard.index.find(sess_id);
+  if (found == shard.index.end()) {
+    misses++;
+    return nullptr;
   }
-
-  return NULL;
+  auto it = found->second;
+  if (it->expires <= std::time(nullptr)) {
+    erase(shard, it);
+    expirations++;
+    misses++;
+    return nullptr;
+  }
+  shard.lru.splice(shard.lru.begin(), shard.lru, it);
+  hits++;
+  const unsigned char *buff = it->encoding.data();
+  return d2i_SSL_SESSION(nullptr, &buff, static_cast<long>(it->encoding.size()));
 }
+
 void SslSessionManager::deleteSession(SSL_CTX *sctx, SSL_SESSION *session) {
   unsigned int id_length;
   const unsigned char *id = SSL_SESSION_get_id(session, &id_length);
-  removeSessionId(id, id_length);
+  removeSessionId(id, static_cast<int>(id_length));
 }
-SslSessionManager::SslSessionManager() {}
-SslSessionManager::~SslSessionManager() {
-  for (auto data : sessions) {
-    delete data;
+
+void SslSessionManager::flushExpired(time_t now) {
+  for (auto &shard : shards) {
+    std::lock_guard<std::mutex> lock(shard.data_mtx);
+    for (auto it = shard.lru.begin(); it != shard.lru.end();) {
+      auto current = it++;
+      if (current->expires <= now) {
+        erase(shard, current);
+        expirations++;
+      }
+    }
   }
 }
+
 void SslSessionManager::attachCallbacks(SSL_CTX *sctx) {
   SSL_CTX_set_session_cache_mode(sctx, SSL_SESS_CACHE_NO_INTERNAL | SSL_SESS_CACHE_SERVER);
   SSL_CTX_sess_set_new_cb(sctx, addSessionCb);
@@ -21,28 +21,80 @@
 #pragma once
 
 #include <openssl/ssl.h>
-#include <cstring>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
 #include <list>
 #include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** Independent parts of the cache, each one with its own lock. */
+#ifndef SSL_SESSION_CACHE_SHARDS
+#define SSL_SESSION_CACHE_SHARDS 16
+#endif
+/** Memory used by all the cached sessions, the least recently used ones are
+ * evicted past it. */
+#ifndef SSL_SESSION_CACHE_MAX_BYTES
+#define SSL_SESSION_CACHE_MAX_BYTES (64 * 1024 * 1024)
+#endif
 
-#define MAX_ENCODING_SIZE 4096
-#define MAX_ID_SIZE 512
 namespace ssl {
-typedef struct {
-  unsigned int sess_id_size;
-  unsigned char sess_id[MAX_ID_SIZE];
-  size_t encoding_length;
-  unsigned char encoding_data[MAX_ENCODING_SIZE];
-} SslSessionData;
 
+/** @brief A cached session, encoded with i2d_SSL_SESSION(). */
+struct SslSessionData {
+  std::string sess_id;
+  std::vector<unsigned char> encoding;
+  /** The session is discarded after this time. */
+  time_t expires;
+  /** Bytes accounted against SSL_SESSION_CACHE_MAX_BYTES. */
+  size_t size() const {
+    return sizeof(SslSessionData) + sess_id.size() + encoding.size();
+  }
+};
+
+/**
+ * @class SslSessionManager ssl_session.h "src/ssl/ssl_session.h"
+ * @brief Server side TLS session cache shared by all the workers.
+ *
+ * The sessions are spread by their id hash over SSL_SESSION_CACHE_SHARDS
+ * shards, each one with its own lock, hash map and LRU list, so lookups,
+ * insertions and removals are O(1) and the workers seldom contend. A session
+ * is dropped once its OpenSSL timeout expires, and the least recently used
+ * ones of a shard are evicted when it goes over its part of
+ * SSL_SESSION_CACHE_MAX_BYTES.
+ */
 class SslSessionManager {
+  struct Shard {
+    std::mutex data_mtx;
+    /** Most recently used first. */
+    std::list<SslSessionData> lru;
+    std::unordered_map<std::string, std::list<SslSessionData>::iterator> index;
+    size_t bytes{0};
+  };
+  Shard shards[SSL_SESSION_CACHE_SHARDS];
+  size_t shard_max_bytes;
+
  public:
-  std::list<SslSessionData *> sessions;
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+  /** Sessions evicted to stay under the memory cap. */
+  std::atomic<uint64_t> evictions{0};
+  /** Sessions dropped after their timeout. */
+  std::atomic<uint64_t> expirations{0};
+  std::atomic<size_t> entries{0};
+  std::atomic<size_t> bytes{0};
+
   static std::mutex singleton_mtx;
   static SslSessionManager *getInstance();
+  explicit SslSessionManager(size_t max_bytes = SSL_SESSION_CACHE_MAX_BYTES);
+  virtual ~SslSessionManager() = default;
   int addSession(SSL *ssl, SSL_SESSION *session);
   SSL_SESSION *getSession(SSL *ssl, const unsigned char *id, int id_length, int *do_copy);
   void deleteSession(SSL_CTX *sctx, SSL_SESSION *session);
+  /** @brief Drops the sessions expired at @p now. */
+  void flushExpired(time_t now);
   static void attachCallbacks(SSL_CTX *sctx);
   static int addSessionCb(SSL *ssl, SSL_SESSION *session);
   static SSL_SESSION *getSessionCb(SSL *ssl, const unsigned char *id, int id_length, int *do_copy);
@@ -50,10 +102,10 @@ class SslSessionManager {
 
  private:
   static SslSessionManager *ssl_session_manager;
-  std::mutex data_mtx;
 
-  SslSessionManager();
-  virtual ~SslSessionManager();
+  Shard &getShard(const std::string &id);
+  /** @brief Removes @p it from @p shard, which must be locked. */
+  void erase(Shard &shard, std::list<SslSessionData>::iterator it);
   void removeSessionId(const unsigned char *id, int idLength);
 };
 }  // namespace ssl
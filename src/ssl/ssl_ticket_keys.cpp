@@ -0,0 +1,189 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ssl_ticket_keys.h"
+#include "../debug/logger.h"
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <cstring>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+
+using namespace ssl;
+
+TicketKeys::TicketKeys(int rotation_interval_)
+    : rotation_interval(rotation_interval_) {
+  rotate();
+}
+
+int TicketKeys::exIndex() {
+  static int index =
+      SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+void TicketKeys::attach(SSL_CTX *ssl_ctx) {
+  SSL_CTX_set_ex_data(ssl_ctx, exIndex(), this);
+  SSL_CTX_clear_options(ssl_ctx, SSL_OP_NO_TICKET);
+  SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_OFF);
+  // a ticket is not offered once its key is gone
+  if (rotation_interval > 0)
+    SSL_CTX_set_timeout(ssl_ctx, rotation_interval * (TICKET_KEYS_MAX - 1));
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  SSL_CTX_set_tlsext_ticket_key_evp_cb(ssl_ctx, ticketKeyCallback);
+#else
+  SSL_CTX_set_tlsext_ticket_key_cb(ssl_ctx, ticketKeyCallback);
+#endif
+}
+
+bool TicketKeys::rotate() {
+  TicketKey key;
+  if (RAND_bytes(reinterpret_cast<unsigned char *>(&key), sizeof(key)) != 1) {
+    Logger::logmsg(LOG_ERR, "Can not generate a session ticket key");
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(keys_mtx);
+  keys.insert(keys.begin(), key);
+  if (keys.size() > TICKET_KEYS_MAX) keys.resize(TICKET_KEYS_MAX);
+  last_rotation = std::time(nullptr);
+  return true;
+}
+
+bool TicketKeys::rotateIfDue(time_t now) {
+  {
+    std::lock_guard<std::mutex> lock(keys_mtx);
+    if (rotation_interval <= 0 || now - last_rotation < rotation_interval)
+      return false;
+  }
+  return rotate();
+}
+
+std::vector<std::string> TicketKeys::exportKeys() {
+  static const char digits[] = "0123456789abcdef";
+  std::vector<std::string> hex_keys;
+  std::lock_guard<std::mutex> lock(keys_mtx);
+  for (auto &key : keys) {
+    auto data = reinterpret_cast<const unsigned char *>(&key);
+    std::string hex;
+    hex.reserve(sizeof(key) * 2);
+    for (size_t i = 0; i < sizeof(key); i++) {
+      hex += digits[data[i] >> 4];
+      hex += digits[data[i] & 0x0f];
+    }
+    hex_keys.push_back(std::move(hex));
+  }
+  return hex_keys;
+}
+
+bool TicketKeys::importKeys(const std::vector<std::string> &hex_keys) {
+  if (hex_keys.empty() || hex_keys.size() > TICKET_KEYS_MAX) return false;
+  std::vector<TicketKey> new_keys(hex_keys.size());
+  for (size_t k = 0; k < hex_keys.size(); k++) {
+    auto &hex = hex_keys[k];
+    if (hex.size() != sizeof(TicketKey) * 2) return false;
+    auto data = reinterpret_cast<unsigned char *>(&new_keys[k]);
+    for (size_t i = 0; i < sizeof(TicketKey); i++) {
+      int value = 0;
+      for (char c : {hex[2 * i], hex[2 * i + 1]}) {
+        c = static_cast<char>(c | 0x20);
+        if (c >= '0' && c <= '9')
+          value = value << 4 | (c - '0');
+        else if (c >= 'a' && c <= 'f')
+          value = value << 4 | (c - 'a' + 10);
+        else
+          return false;
+      }
+      data[i] = static_cast<unsigned char>(value);
+    }
+  }
+  std::lock_guard<std::mutex> lock(keys_mtx);
+  keys = std::move(new_keys);
+  last_rotation = std::time(nullptr);
+  return true;
+}
+
+bool TicketKeys::findKey(const unsigned char *name, TicketKey &key,
+                         bool &current) {
+  std::lock_guard<std::mutex> lock(keys_mtx);
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (std::memcmp(keys[i].name, name, sizeof(key.name)) == 0) {
+      key = keys[i];
+      current = i == 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static bool initTicketHmac(EVP_MAC_CTX *hmac_ctx, TicketKey &key) {
+  OSSL_PARAM params[] = {
+      OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac_key,
+                                        sizeof(key.hmac_key)),
+      OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                       const_cast<char *>("SHA256"), 0),
+      OSSL_PARAM_construct_end()};
+  return EVP_MAC_CTX_set_params(hmac_ctx, params) == 1;
+}
+
+int TicketKeys::ticketKeyCallback(SSL *ssl, unsigned char *key_name,
+                                  unsigned char *iv, EVP_CIPHER_CTX *cipher_ctx,
+                                  EVP_MAC_CTX *hmac_ctx, int enc) {
+#else
+static bool initTicketHmac(HMAC_CTX *hmac_ctx, TicketKey &key) {
+  return HMAC_Init_ex(hmac_ctx, key.hmac_key, sizeof(key.hmac_key),
+                      EVP_sha256(), nullptr) == 1;
+}
+
+int TicketKeys::ticketKeyCallback(SSL *ssl, unsigned char *key_name,
+                                  unsigned char *iv, EVP_CIPHER_CTX *cipher_ctx,
+                                  HMAC_CTX *hmac_ctx, int enc) {
+#endif
+  auto ticket_keys = static_cast<TicketKeys *>(
+      SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), exIndex()));
+  if (ticket_keys == nullptr) return -1;
+  TicketKey key;
+  bool current = true;
+  if (enc) {
+    {
+      std::lock_guard<std::mutex> lock(ticket_keys->keys_mtx);
+      if (ticket_keys->keys.empty()) return 0;
+      key = ticket_keys->keys.front();
+    }
+    std::memcpy(key_name, key.name, sizeof(key.name));
+    if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1 ||
+        EVP_EncryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), nullptr, key.aes_key,
+                           iv) != 1 ||
+        !initTicketHmac(hmac_ctx, key))
+      return -1;
+    return 1;
+  }
+  // an unknown or expired key, a full handshake issues a new ticket
+  if (!ticket_keys->findKey(key_name, key, current)) return 0;
+  if (!initTicketHmac(hmac_ctx, key) ||
+      EVP_DecryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), nullptr, key.aes_key,
+                         iv) != 1)
+    return -1;
+  // renew the tickets of the previous keys
+  return current ? 1 : 2;
+}
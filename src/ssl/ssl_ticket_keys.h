@@ -0,0 +1,107 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <openssl/ssl.h>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** Keys kept to decrypt tickets, the current one and the previous ones. */
+#define TICKET_KEYS_MAX 3
+
+namespace ssl {
+
+/** @brief Key of the session tickets, as the OpenSSL built in ones. */
+struct TicketKey {
+  unsigned char name[16];
+  unsigned char aes_key[32];
+  unsigned char hmac_key[32];
+};
+
+/**
+ * @class TicketKeys ssl_ticket_keys.h "src/ssl/ssl_ticket_keys.h"
+ * @brief Rotating keys of the stateless session tickets of a listener.
+ *
+ * The keys are generated at startup and shared by all the workers through
+ * the listener SSL_CTX, so a ticket issued by one worker resumes the session
+ * in any other. The newest key encrypts the new tickets, the previous ones
+ * only decrypt and the tickets they opened are renewed. The keys can be
+ * exported and imported through the control interface, so several nodes can
+ * use the same ones; a node that imports them should not rotate its own.
+ */
+class TicketKeys {
+  std::mutex keys_mtx;
+  /** Newest first. */
+  std::vector<TicketKey> keys;
+  time_t last_rotation{0};
+
+  static int exIndex();
+  bool findKey(const unsigned char *name, TicketKey &key, bool &current);
+
+ public:
+  /** Seconds between two rotations, 0 to never rotate. */
+  int rotation_interval;
+
+  explicit TicketKeys(int rotation_interval_);
+
+  /**
+   * @brief Makes @p ssl_ctx issue and accept session tickets with these
+   * keys.
+   *
+   * The session cache is disabled, the tickets hold the whole session.
+   */
+  void attach(SSL_CTX *ssl_ctx);
+
+  /** @brief Generates a new key for the new tickets. */
+  bool rotate();
+
+  /**
+   * @brief Rotates the keys if @p now is at least rotation_interval seconds
+   * after the last rotation.
+   *
+   * @return @c true if the keys were rotated.
+   */
+  bool rotateIfDue(time_t now);
+
+  /** @brief Returns the keys as hex strings, newest first. */
+  std::vector<std::string> exportKeys();
+
+  /**
+   * @brief Replaces the keys by the hex strings @p hex_keys, newest first.
+   *
+   * @return @c false, keeping the current keys, if any of them is malformed.
+   */
+  bool importKeys(const std::vector<std::string> &hex_keys);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  static int ticketKeyCallback(SSL *ssl, unsigned char *key_name,
+                               unsigned char *iv, EVP_CIPHER_CTX *cipher_ctx,
+                               EVP_MAC_CTX *hmac_ctx, int enc);
+#else
+  static int ticketKeyCallback(SSL *ssl, unsigned char *key_name,
+                               unsigned char *iv, EVP_CIPHER_CTX *cipher_ctx,
+                               HMAC_CTX *hmac_ctx, int enc);
+#endif
+};
+
+}  // namespace ssl
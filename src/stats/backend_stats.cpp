@@ -55,6 +55,8 @@ Statistics::BackendInfo::BackendInfo() {
   established_conn = 0;
   total_connections = 0;
   pending_connections = 0;
+  idle_connections = 0;
+  reused_connections = 0;
   max_response_time = -1;
   avg_response_time = -1;
   min_response_time = -1;
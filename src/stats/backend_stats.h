@@ -45,6 +45,10 @@ class BackendInfo {
   std::atomic<int> established_conn;
   std::atomic<int> total_connections;
   std::atomic<int> pending_connections;
+  /** Keep-alive connections waiting in the workers pools. */
+  std::atomic<int> idle_connections;
+  /** Requests served over a pooled connection. */
+  std::atomic<int> reused_connections;
   time_t current_time;
   // TODO: TRANSFERENCIA BYTES/SEC (NO HACER)
   // TODO: WRITE/READ TIME (TIEMPO COMPLETO)
@@ -76,6 +80,16 @@ class BackendInfo {
 
   inline int getPendingConn() { return pending_connections; }
 
+  inline void increaseIdleConn() { idle_connections++; }
+
+  inline void decreaseIdleConn() { if(idle_connections.load() > 0) idle_connections--; }
+
+  inline void increaseReusedConn() { reused_connections++; }
+
+  inline int getIdleConn() { return idle_connections; }
+
+  inline int getReusedConn() { return reused_connections; }
+
   inline int getAssignedConn() { return total_connections; }
 
   inline int getEstablishedConn() { return established_conn; }
@@ -21,9 +21,12 @@
 
 #include "listener_manager.h"
 
+#include <sys/wait.h>
 #include <memory>
 #include "../config/global.h"
 #include "../ssl/ssl_session.h"
+#include "../util/network.h"
+#include "../util/socket_handoff.h"
 #ifdef ENABLE_HEAP_PROFILE
 #include <gperftools/heap-profiler.h>
 #endif
@@ -40,14 +43,25 @@
 void ListenerManager::HandleEvent(int fd, EVENT_TYPE event_type,
                                   EVENT_GROUP event_group) {
   if (event_group == EVENT_GROUP::MAINTENANCE) {
+    if (upgrading && fd == upgrade_fd) {
+      finishUpgrade(SocketHandoff::readReady(upgrade_fd));
+      return;
+    }
     if (fd == timer_maintenance.getFileDescriptor()) {
       // general maintenance timer
       for (auto &[sm_id, sm] : ServiceManager::getInstance()) {
         if (sm->disabled) continue;
+        if (sm->ssl_context != nullptr && sm->ssl_context->ticket_keys != nullptr)
+          sm->ssl_context->ticket_keys->rotateIfDue(std::time(nullptr));
+        if (sm->ssl_context != nullptr && sm->ssl_context->cert_cache != nullptr)
+          sm->ssl_context->cert_cache->prebuildHot();
         for (auto service : sm->getServices()) {
           service->doMaintenance();
         }
       }
+#if ENABLE_SSL_SESSION_CACHING
+      ssl::SslSessionManager::getInstance()->flushExpired(std::time(nullptr));
+#endif
       timer_maintenance.set(
           global::run_options::getCurrent().backend_resurrect_timeout * 1000);
       updateFd(timer_maintenance.getFileDescriptor(), EVENT_TYPE::READ_ONESHOT,
@@ -109,6 +123,61 @@ std::string ListenerManager::handleTask(ctl::CtlTask &task) {
           std::make_unique<JsonDataValue>(Counter<BackendConnection>::count));
       status->emplace("HttpStream", std::make_unique<JsonDataValue>(
                                         Counter<HttpStream>::count));
+      status->emplace(
+          "HttpStreamPoolSize",
+          std::make_unique<JsonDataValue>(ObjectPool<HttpStream>::total_slots));
+      status->emplace(
+          "HttpStreamPoolUsed",
+          std::make_unique<JsonDataValue>(ObjectPool<HttpStream>::used_slots));
+      status->emplace("IOBufferPoolSize", std::make_unique<JsonDataValue>(
+                                              BufferPool::total_buffers));
+      status->emplace("IOBufferPoolUsed", std::make_unique<JsonDataValue>(
+                                              BufferPool::used_buffers));
+#if ENABLE_ZERO_COPY
+      status->emplace("SplicePipePoolSize", std::make_unique<JsonDataValue>(
+                                                SplicePipePool::total_pipes));
+      status->emplace("SplicePipePoolUsed", std::make_unique<JsonDataValue>(
+                                                SplicePipePool::used_pipes));
+      status->emplace("SplicedBytes",
+                      std::make_unique<JsonDataValue>(static_cast<unsigned long>(
+                          SplicePipePool::spliced_bytes.load())));
+#endif
+#if ENABLE_SSL_SESSION_CACHING
+      auto session_cache = ssl::SslSessionManager::getInstance();
+      status->emplace("SslSessionCacheEntries",
+                      std::make_unique<JsonDataValue>(
+                          session_cache->entries.load()));
+      status->emplace("SslSessionCacheBytes", std::make_unique<JsonDataValue>(
+                                                  session_cache->bytes.load()));
+      status->emplace("SslSessionCacheHits",
+                      std::make_unique<JsonDataValue>(static_cast<unsigned long>(
+                          session_cache->hits.load())));
+      status->emplace("SslSessionCacheMisses",
+                      std::make_unique<JsonDataValue>(static_cast<unsigned long>(
+                          session_cache->misses.load())));
+      status->emplace("SslSessionCacheEvictions",
+                      std::make_unique<JsonDataValue>(static_cast<unsigned long>(
+                          session_cache->evictions.load())));
+      status->emplace("SslSessionCacheExpirations",
+                      std::make_unique<JsonDataValue>(static_cast<unsigned long>(
+                          session_cache->expirations.load())));
+#endif
+      uint64_t worker_ctl_calls = 0, requests = 0;
+      for (auto &sm : stream_manager_set) {
+        if (sm.second == nullptr) continue;
+        worker_ctl_calls += sm.second->getCtlCalls();
+        requests += sm.second->getRequestCount();
+      }
+      status->emplace("EpollCtlCalls",
+                      std::make_unique<JsonDataValue>(
+                          static_cast<unsigned long>(worker_ctl_calls)));
+      status->emplace("Requests", std::make_unique<JsonDataValue>(
+                                      static_cast<unsigned long>(requests)));
+      status->emplace(
+          "EpollCtlPerRequest",
+          std::make_unique<JsonDataValue>(
+              requests > 0 ? static_cast<double>(worker_ctl_calls) / requests
+                           : 0.0));
       // root->emplace(JSON_KEYS::DEBUG, std::unique_ptr<JsonDataValue>(new
       // JsonDataValue(Counter<HttpStream>)));
       double vm, rss;
@@ -266,12 +335,6 @@ std::string ListenerManager::handleTask(ctl::CtlTask &task) {
       root->emplace("clients", std::move(clients_stats));
       root->emplace("ssl", std::move(ssl_stats));
 
-#if ENABLE_SSL_SESSION_CACHING
-      root->emplace(
-          "SESSION list size",
-          std::unique_ptr<JsonDataValue>(new JsonDataValue(static_cast<int>(
-              ssl::SslSessionManager::getInstance()->sessions.size()))));
-#endif
 #endif
 
       return root->stringify();
@@ -283,6 +346,11 @@ std::string ListenerManager::handleTask(ctl::CtlTask &task) {
       }
       break;
     }
+    case ctl::CTL_SUBJECT::UPGRADE: {
+      if (task.command == ctl::CTL_COMMAND::UPDATE && upgradeBinary())
+        return JSON_OP_RESULT::OK;
+      break;
+    }
     default: {
       break;
     }
@@ -304,6 +372,7 @@ ListenerManager::~ListenerManager() {
     sm.second->stop();
     delete sm.second;
   }
+  ssl::HandshakePool::getInstance().stop();
 #ifdef ENABLE_HEAP_PROFILE
   HeapProfilerDump("Heap profile data");
   HeapProfilerStop();
@@ -316,6 +385,18 @@ void ListenerManager::doWork() {
       // something bad happend
       //      Logger::LogInfo("No event received");
     }
+    if (upgrading && std::time(nullptr) > upgrade_deadline) finishUpgrade(-1);
+    if (upgraded) {
+      Time::updateTime();
+      size_t streams = 0;
+      for (auto &[sm_id, sm] : stream_manager_set)
+        if (sm != nullptr) streams += sm->streamCount();
+      if (streams == 0 || Time::getTimeSec() > drain_deadline) {
+        Logger::logmsg(LOG_NOTICE, "Upgrade done, %lu connections left",
+                       streams);
+        is_running = false;
+      }
+    }
   }
   Logger::logmsg(LOG_REMOVE, "Exiting loop");
 }
@@ -329,23 +410,54 @@ void ListenerManager::stop() {
 void ListenerManager::start() {
   auto cm = ctl::ControlManager::getInstance();
   cm->attach(std::ref(*this));
-  auto concurrency_level = std::thread::hardware_concurrency() * 2;
+  // one worker per allowed cpu by default
+  auto cpus = helper::ThreadHelper::getAllowedCpus();
+  int concurrency_level = !cpus.empty()
+                              ? static_cast<int>(cpus.size())
+                              : static_cast<int>(std::thread::hardware_concurrency());
   auto num_threads = global::run_options::getCurrent().num_threads != 0
                          ? global::run_options::getCurrent().num_threads
                          : concurrency_level;
+  auto engine = global::run_options::getCurrent().use_io_uring
+                    ? EVENT_ENGINE::IO_URING
+                    : EVENT_ENGINE::EPOLL;
+  auto handshake_threads = global::run_options::getCurrent().handshake_threads;
+  if (handshake_threads > 0)
+    ssl::HandshakePool::getInstance().start(handshake_threads);
   for (int sm = 0; sm < num_threads; sm++) {
-    stream_manager_set[sm] = new StreamManager();
+    stream_manager_set[sm] = new StreamManager(engine);
+    stream_manager_set[sm]->setEdgeTriggered(
+        global::run_options::getCurrent().edge_triggered);
+    stream_manager_set[sm]->setBackendPool(
+        static_cast<size_t>(global::run_options::getCurrent().backend_pool_size),
+        global::run_options::getCurrent().backend_pool_timeout);
+    stream_manager_set[sm]->setZeroCopy(
+        global::run_options::getCurrent().zero_copy);
+    if (handshake_threads > 0 &&
+        !stream_manager_set[sm]->setHandshakeOffload(true))
+      Logger::logmsg(LOG_WARNING,
+                     "Worker %d runs its TLS handshakes in its event loop", sm);
   }
 #ifdef ENABLE_HEAP_PROFILE
   HeapProfilerStart("/tmp/zproxy");
 #endif
   is_running = true;
+  // Pin the workers only if each one can get its own cpu. The reuseport
+  // program returns the cpu id as the socket index, so steer the connections
+  // only if worker i runs on cpu i for every worker.
+  bool pin_workers = !cpus.empty() && num_threads <= concurrency_level;
+  bool cpu_steering = pin_workers && num_threads == concurrency_level &&
+                      cpus.back() == num_threads - 1;
   for (size_t i = 0; i < stream_manager_set.size(); i++) {
     auto sm = stream_manager_set[i];
     if (sm != nullptr) {
-      sm->start(i);
+      sm->start(i, pin_workers ? cpus[i] : -1, cpu_steering,
+                i + 1 == stream_manager_set.size());
     }
   }
+  // listeners removed from the configuration of an upgraded process
+  SocketHandoff::closeInherited();
+  SocketHandoff::notifyReady();
   //  signal_fd.init();
   auto alive_to = global::run_options::getCurrent().backend_resurrect_timeout;
   timer_maintenance.set(
@@ -375,10 +487,16 @@ StreamManager *ListenerManager::getManager(int fd) {
   return stream_manager_set[id];
 }
 
-bool ListenerManager::addListener(
+std::shared_ptr<ServiceManager> ListenerManager::createServiceManager(
     std::shared_ptr<ListenerConfig> listener_config) {
   int service_id = 0;
-  auto &lm = ServiceManager::getInstance(listener_config);
+  // resolved once here, the workers only read it
+  if (listener_config->addr_info == nullptr) {
+    listener_config->addr_info =
+        Network::getAddress(listener_config->address, listener_config->port)
+            .release();
+  }
+  auto lm = std::make_shared<ServiceManager>(listener_config);
   for (auto service_config = listener_config->services;
        service_config != nullptr; service_config = service_config->next) {
     if (!service_config->disabled) {
@@ -388,9 +506,106 @@ bool ListenerManager::addListener(
                      listener_config->name.data(), service_config->name.data());
     }
   }
+  return lm;
+}
+
+std::map<std::string, int> ListenerManager::openListeners(
+    const std::map<int, std::shared_ptr<ServiceManager>> &service_managers,
+    const std::set<std::string> &served) {
+  std::map<std::string, int> listen_fds;
+  for (auto &[sm_id, sm] : service_managers) {
+    auto &listener_config = sm->listener_config_;
+    auto key = SocketHandoff::listenerKey(listener_config->address,
+                                          listener_config->port);
+    if (sm->disabled || served.count(key) != 0 ||
+        listen_fds.count(key) != 0 || listener_config->addr_info == nullptr)
+      continue;
+    int listen_fd = Connection::listen(*listener_config->addr_info);
+    if (listen_fd > 0) listen_fds[key] = listen_fd;
+  }
+  return listen_fds;
+}
+
+StreamManager *ListenerManager::getWorker(int worker_id) {
+  auto worker = stream_manager_set.find(worker_id);
+  return worker != stream_manager_set.end() ? worker->second : nullptr;
+}
+
+bool ListenerManager::addListener(
+    std::shared_ptr<ListenerConfig> listener_config) {
+  auto service_managers = ServiceManager::getInstance();
+  if (service_managers.count(listener_config->id) == 0)
+    service_managers[listener_config->id] =
+        createServiceManager(listener_config);
+  ServiceManager::setInstance(std::move(service_managers));
+  return true;
+}
+
+bool ListenerManager::upgradeBinary() {
+  if (upgraded || upgrading) return false;
+  auto &start_options = global::StartOptions::getCurrent();
+  if (start_options.binary_path.empty()) return false;
+  int channel_fd = -1;
+  auto pid = SocketHandoff::spawnUpgrade(start_options.binary_path,
+                                         start_options.argv, channel_fd);
+  if (pid < 0) {
+    Logger::logmsg(LOG_ERR, "Could not start %s: %s",
+                   start_options.binary_path.data(), std::strerror(errno));
+    return false;
+  }
+  bool sent = ctl::ControlManager::getInstance()->handOver(channel_fd);
+  for (auto &[sm_id, sm] : stream_manager_set) {
+    if (sm == nullptr) continue;
+    for (auto &[listen_fd, key] : sm->getListeners())
+      sent = sent && SocketHandoff::sendSocket(channel_fd, listen_fd, key);
+  }
+  // the new process receives until the end of the stream
+  ::shutdown(channel_fd, SHUT_WR);
+  if (!sent) {
+    Logger::logmsg(LOG_ERR, "Upgrade to %s failed, keep serving",
+                   start_options.binary_path.data());
+    ::close(channel_fd);
+    ::kill(pid, SIGTERM);
+    ::waitpid(pid, nullptr, 0);
+    return false;
+  }
+  // the control thread is not held while the new process starts
+  upgrade_fd = channel_fd;
+  upgrade_pid = pid;
+  upgrade_deadline = std::time(nullptr) + UPGRADE_READY_TIMEOUT;
+  upgrading = true;
+  addFd(upgrade_fd, EVENT_TYPE::READ_ONESHOT, EVENT_GROUP::MAINTENANCE);
+  Logger::logmsg(LOG_NOTICE, "Upgrading to %s, waiting for process %d",
+                 start_options.binary_path.data(), pid);
   return true;
 }
 
+void ListenerManager::finishUpgrade(pid_t new_pid) {
+  deleteFd(upgrade_fd);
+  ::close(upgrade_fd);
+  upgrade_fd = -1;
+  if (new_pid < 0) {
+    Logger::logmsg(LOG_ERR, "Upgrade to %s failed, keep serving",
+                   global::StartOptions::getCurrent().binary_path.data());
+    ::kill(upgrade_pid, SIGTERM);
+    ::waitpid(upgrade_pid, nullptr, 0);
+    upgrading = false;
+    return;
+  }
+  // the exec'd process already exited if it daemonized
+  ::waitpid(upgrade_pid, nullptr, WNOHANG);
+  Logger::logmsg(LOG_NOTICE, "Upgraded to process %d, draining", new_pid);
+  ctl::ControlManager::getInstance()->release();
+  for (auto &[sm_id, sm] : stream_manager_set) {
+    if (sm != nullptr) sm->drainListeners();
+  }
+  Time::updateTime();
+  drain_deadline =
+      Time::getTimeSec() + global::run_options::getCurrent().grace_time;
+  upgraded = true;
+  upgrading = false;
+}
+
 bool ListenerManager::reloadConfigFile() {
   Config config;
   if (!config.init(global::run_options::getCurrent().config_file_name)) {
@@ -404,40 +619,44 @@ bool ListenerManager::reloadConfigFile() {
     return false;
   }
   Logger::log_level = config.log_level;
-  // clear and stop old config
-  auto &sm_set = ServiceManager::getInstance();
-  for (auto it = sm_set.begin(); it != sm_set.end();) {
-    // stop the listener in all stream workers
-    it->second->disabled = true;
-    for (auto &[sm_id, sm] : stream_manager_set) {
-      sm->stopListener((it->second)->id);
-    }
-    // remove Listener from StreamManager set
-    sm_set[(it->second)->id] = nullptr;
-    it = sm_set.erase(it);
+  // Build the new snapshot aside the running one. The workers switch to it
+  // keeping the listening sockets that did not change, and the old one is
+  // released once the last connection accepted with it is closed.
+  // The running set is only replaced once the new one is complete, the
+  // maintenance timer iterates it meanwhile.
+  std::map<int, std::shared_ptr<ServiceManager>> sm_set;
+  auto old_sm_set = ServiceManager::getInstance();
+  // the tickets already issued keep resuming sessions in the same address
+  std::map<std::string, std::vector<std::string>> ticket_keys;
+  for (auto &[svm_id, svm] : old_sm_set) {
+    if (svm->ssl_context != nullptr && svm->ssl_context->ticket_keys != nullptr)
+      ticket_keys[svm->listener_config_->address + ":" +
+                  std::to_string(svm->listener_config_->port)] =
+          svm->ssl_context->ticket_keys->exportKeys();
   }
-  // create new instances with new configuration, connections may be lost during
-  // this switch
   for (auto lc = config.listeners; lc != nullptr; lc = lc->next) {
     if (lc->disabled) continue;
     auto listener_config = std::shared_ptr<ListenerConfig>(lc);
-    this->addListener(listener_config);
+    auto &sm = sm_set[listener_config->id];
+    if (sm == nullptr) sm = createServiceManager(listener_config);
+    auto keys = ticket_keys.find(lc->address + ":" + std::to_string(lc->port));
+    if (keys != ticket_keys.end() && sm->ssl_context != nullptr &&
+        sm->ssl_context->ticket_keys != nullptr)
+      sm->ssl_context->ticket_keys->importKeys(keys->second);
   }
-
-  for (size_t i = 0; i < stream_manager_set.size(); i++) {
-    auto sm = stream_manager_set[i];
+  std::set<std::string> served;
+  for (auto &[svm_id, svm] : old_sm_set) {
+    if (!svm->disabled)
+      served.insert(SocketHandoff::listenerKey(svm->listener_config_->address,
+                                               svm->listener_config_->port));
+    svm->disabled = true;
+  }
+  ServiceManager::setInstance(sm_set);
+  for (auto &[sm_id, sm] : stream_manager_set) {
     if (sm != nullptr) {
-      for (auto &[svm_id, svm] : ServiceManager::getInstance()) {
-        if (svm->disabled) continue;
-        if (!sm->registerListener(svm)) {
-          Logger::logmsg(LOG_ERR,
-                         "Error initializing StreamManager for farm %s",
-                         svm->listener_config_->name.data());
-          return false;
-        }
-      }
+      sm->reloadListeners(sm_set, openListeners(sm_set, served));
     } else {
-      Logger::logmsg(LOG_ERR, "StreamManager id: %d doesn't exist  ", i);
+      Logger::logmsg(LOG_ERR, "StreamManager id: %d doesn't exist  ", sm_id);
     }
   }
   // update maintenance timeouts
@@ -26,6 +26,8 @@
 #include "../event/epoll_manager.h"
 #include "../event/signal_fd.h"
 #include "stream_manager.h"
+#include <set>
+#include <string>
 #include <thread>
 #include <vector>
 #if WAF_ENABLED
@@ -54,8 +56,43 @@ class ListenerManager : public EpollManager, public CtlObserver<ctl::CtlTask, st
   TimerFd timer_internal_maintenance;
 #endif
   SignalFd signal_fd;
+  /** Set once an upgraded process took over, the workers are draining. */
+  std::atomic<bool> upgraded{false};
+  time_t drain_deadline{0};
+  /** Set while the upgraded process is starting, until it is ready. */
+  std::atomic<bool> upgrading{false};
+  /** Handoff socket and pid of the upgraded process, while upgrading. */
+  int upgrade_fd{-1};
+  pid_t upgrade_pid{-1};
+  time_t upgrade_deadline{0};
   void doWork();
+  /**
+   * @brief Makes the workers drain once the upgraded process is ready, from
+   * the main thread.
+   *
+   * @param new_pid is the pid reported by the upgraded process, or -1 if it
+   * failed or did not answer in time, the upgrade is cancelled then.
+   */
+  void finishUpgrade(pid_t new_pid);
   StreamManager *getManager(int fd);
+  /**
+   * @brief Creates the ServiceManager of @p listener_config with its
+   * services, without publishing it.
+   */
+  static std::shared_ptr<ServiceManager> createServiceManager(
+      std::shared_ptr<ListenerConfig> listener_config);
+  /**
+   * @brief Opens a listening socket for each listener of @p service_managers
+   * whose address and port are not in @p served.
+   *
+   * Called once per worker in worker order, so socket i of each reuseport
+   * group belongs to worker i as when they are opened on start.
+   *
+   * @return the sockets keyed by their SocketHandoff key.
+   */
+  static std::map<std::string, int> openListeners(
+      const std::map<int, std::shared_ptr<ServiceManager>> &service_managers,
+      const std::set<std::string> &served);
 
  public:
   ListenerManager();
@@ -113,6 +150,9 @@ class ListenerManager : public EpollManager, public CtlObserver<ctl::CtlTask, st
    * @return true if should handle the task, false if not.
    */
   bool isHandler(ctl::CtlTask &task) override;
+
+  /** @brief Returns the worker @p worker_id, @c nullptr if there is none. */
+  StreamManager *getWorker(int worker_id);
   /**
  * @brief Reload the listeners config from the current loaded configuration file.
  *
@@ -120,4 +160,20 @@ class ListenerManager : public EpollManager, public CtlObserver<ctl::CtlTask, st
  * @return true if reload succeded compeletely.
  */
   bool reloadConfigFile();
+
+  /**
+   * @brief Replaces the running process with the zproxy binary at the path
+   * it was started from, without closing the listeners.
+   *
+   * The binary is executed again with the same command line and receives the
+   * listening and control sockets, see SocketHandoff. It returns once the
+   * sockets are sent, the main thread waits for the new process to report it
+   * is serving, see finishUpgrade(). Then the workers stop accepting and
+   * drain their connections, and the process exits when they are done or
+   * after the Grace time.
+   *
+   * @return @c false if the new process could not be started or an upgrade
+   * is already running, this one keeps serving in that case.
+   */
+  bool upgradeBinary();
 };
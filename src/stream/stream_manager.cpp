@@ -24,6 +24,7 @@
 #include <thread>
 #include "../handlers/https_manager.h"
 #include "../util/network.h"
+#include "../util/socket_handoff.h"
 #include "stream_data_logger.h"
 
 #ifdef ON_FLY_COMRESSION
@@ -85,6 +86,9 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
           break;
         case EVENT_GROUP::MAINTENANCE:
           break;
+        case EVENT_GROUP::HANDSHAKE:
+          onHandshakeDone();
+          break;
         default:
           deleteFd(fd);
           close(fd);
@@ -99,7 +103,7 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
           break;
         case EVENT_GROUP::SERVER: {
           DEBUG_COUNTER_HIT(debug__::event_backend_write);
-          auto stream = bck_streams_set[fd];
+          auto stream = bck_streams_set.get(fd);
           if (stream == nullptr) {
             deleteFd(fd);
             ::close(fd);
@@ -110,7 +114,7 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
         }
         case EVENT_GROUP::CLIENT: {
           DEBUG_COUNTER_HIT(debug__::event_client_write);
-          auto stream = cl_streams_set[fd];
+          auto stream = cl_streams_set.get(fd);
           if (stream == nullptr) {
             deleteFd(fd);
             ::close(fd);
@@ -133,7 +137,7 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
       switch (event_group) {
         case EVENT_GROUP::SERVER: {
           DEBUG_COUNTER_HIT(debug__::event_backend_disconnect);
-          auto stream = bck_streams_set[fd];
+          auto stream = bck_streams_set.get(fd);
           if (stream == nullptr) {
             char addr[150];
             Logger::logmsg(
@@ -149,7 +153,7 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
         }
         case EVENT_GROUP::CLIENT: {
           DEBUG_COUNTER_HIT(debug__::event_client_disconnect);
-          auto stream = cl_streams_set[fd];
+          auto stream = cl_streams_set.get(fd);
           if (stream == nullptr) {
             char addr[150];
             Logger::logmsg(
@@ -182,15 +186,19 @@ void StreamManager::stop() {
   if (this->worker.joinable()) this->worker.join();
 }
 
-void StreamManager::start(int thread_id_) {
+void StreamManager::start(int thread_id_, int cpu, bool cpu_steering_,
+                          bool adopt_inherited) {
   ctl::ControlManager::getInstance()->attach(std::ref(*this));
 
   is_running = true;
   worker_id = thread_id_;
+  cpu_id = cpu;
+  cpu_steering = cpu >= 0 && cpu_steering_;
 
-  for (auto& [sm_id, sm] : ServiceManager::getInstance()) {
+  service_managers = ServiceManager::getInstance();
+  for (auto& [sm_id, sm] : service_managers) {
     if (sm->disabled) continue;
-    if (!this->registerListener(sm)) {
+    if (!this->registerListener(sm, adopt_inherited)) {
       Logger::logmsg(LOG_ERR, "Error initializing StreamManager for farm %s",
                      sm->listener_config_->name.data());
       return;
@@ -202,14 +210,292 @@ void StreamManager::start(int thread_id_) {
     doWork();
   });
   if (worker_id >= 0) {
-    //    helper::ThreadHelper::setThreadAffinity(worker_id,
-    //    worker.native_handle());
+    if (cpu_id >= 0 &&
+        !helper::ThreadHelper::setThreadAffinity(cpu_id,
+                                                 worker.native_handle())) {
+      Logger::logmsg(LOG_WARNING, "Could not pin worker %d to cpu %d",
+                     worker_id, cpu_id);
+    }
     helper::ThreadHelper::setThreadName("WORKER_" + std::to_string(worker_id),
                                         worker.native_handle());
   }
 }
 
-StreamManager::StreamManager(){
+void StreamManager::setBackendPool(size_t max_idle, int idle_timeout) {
+  backend_pool.max_idle = max_idle;
+  backend_pool.idle_timeout = idle_timeout;
+}
+
+bool StreamManager::setHandshakeOffload(bool enable) {
+  if (!enable) {
+    handshake_offload.reset();
+    return true;
+  }
+  handshake_offload = std::make_unique<ssl::HandshakeOffload>();
+  if (!handshake_offload->init() ||
+      !handshake_offload->enableEvents(this, EVENT_TYPE::READ,
+                                       EVENT_GROUP::HANDSHAKE)) {
+    handshake_offload.reset();
+    return false;
+  }
+  return true;
+}
+
+void StreamManager::onHandshakeDone() {
+  if (handshake_offload == nullptr) return;
+  for (auto &job : handshake_offload->takeDone()) {
+    auto stream = cl_streams_set.get(job.connection->getFileDescriptor());
+    if (stream == nullptr) continue;
+    auto stall_start = Time::getMonotonicUs();
+    stream->clearStatus(STREAM_STATUS::HANDSHAKE_OFFLOADED);
+    ssl::HandshakeOffload::resume(job, *this);
+    stream->service_manager->countHandshakeStall(Time::getMonotonicUs() -
+                                                 stall_start);
+    if (stream->hasStatus(STREAM_STATUS::CLEAR_PENDING)) {
+      clearStream(stream);
+      continue;
+    }
+#if USE_TIMER_FD_TIMEOUT == 0
+    // disabling the events of the connection removed its timeout
+    setTimeOut(stream->client_connection.getFileDescriptor(),
+               TIMEOUT_TYPE::CLIENT_READ_TIMEOUT,
+               stream->service_manager->listener_config_->to);
+#endif
+    onClientHandshake(stream, job.result);
+  }
+}
+
+void StreamManager::setZeroCopy(bool enable) {
+#if ENABLE_ZERO_COPY
+  zero_copy = enable;
+#else
+  zero_copy = false;
+  static_cast<void>(enable);
+#endif
+}
+
+bool StreamManager::releaseBackendConnection(HttpStream* stream) {
+  auto backend = stream->backend_connection.getBackend();
+  if (!backend_pool.isEnabled() || backend == nullptr ||
+      backend->backend_type != BACKEND_TYPE::REMOTE || backend->isHttps() ||
+      !stream->hasStatus(STREAM_STATUS::BCK_IDLE) ||
+      stream->hasOption(STREAM_OPTION::PINNED_CONNECTION) ||
+      // the backends of a reloaded configuration are about to go away
+      stream->service_manager->disabled ||
+      stream->backend_connection.buffer_size > 0 ||
+#if ENABLE_ZERO_COPY
+      stream->backend_connection.splice_pipe.bytes > 0 ||
+#endif
+      stream->request.hasPendingData())
+    return false;
+  int fd = stream->backend_connection.getFileDescriptor();
+  if (!backend_pool.put(backend, fd, Time::getTimeSec())) return false;
+  deleteFd(fd);
+  bck_streams_set.erase(fd);
+  stream->backend_connection.releaseFileDescriptor();
+  stream->backend_connection.releaseBuffer();
+  stream->clearStatus(STREAM_STATUS::BCK_IDLE);
+  backend->decreaseConnection();
+#if USE_TIMER_FD_TIMEOUT == 0
+  setTimeOut(fd, TIMEOUT_TYPE::BACKEND_IDLE_TIMEOUT, backend_pool.idle_timeout);
+#endif
+  return true;
+}
+
+void StreamManager::onBackendConnectionCheckout(int fd) {
+#if USE_TIMER_FD_TIMEOUT == 0
+  stopTimeOut(fd);
+#else
+  static_cast<void>(fd);
+#endif
+}
+
+void StreamManager::refreshServiceManager(HttpStream* stream) {
+  auto& old_sm = stream->service_manager;
+  if (!old_sm->disabled ||
+      stream->hasOption(STREAM_OPTION::PINNED_CONNECTION) ||
+      stream->hasStatus(STREAM_STATUS::HANDSHAKE_OFFLOADED) ||
+      // a handshake in progress goes on with the context it started with
+      (stream->client_connection.ssl != nullptr &&
+       !stream->client_connection.ssl_connected) ||
+      stream->request.hasPendingData() || stream->response.hasPendingData() ||
+      (stream->backend_connection.getFileDescriptor() > 0 &&
+       !stream->hasStatus(STREAM_STATUS::BCK_IDLE)))
+    return;
+  std::shared_ptr<ServiceManager> new_sm;
+  for (auto& [sm_id, sm] : service_managers) {
+    if (!sm->disabled &&
+        sm->listener_config_->address == old_sm->listener_config_->address &&
+        sm->listener_config_->port == old_sm->listener_config_->port &&
+        sm->is_https_listener == old_sm->is_https_listener) {
+      new_sm = sm;
+      break;
+    }
+  }
+  if (new_sm == nullptr) return;
+  // the backends of the retired snapshot are about to go away
+  int bck_fd = stream->backend_connection.getFileDescriptor();
+  if (bck_fd > 0) {
+    deleteFd(bck_fd);
+    bck_streams_set.erase(bck_fd);
+    if (stream->backend_connection.getBackend() != nullptr)
+      stream->backend_connection.getBackend()->decreaseConnection();
+    stream->backend_connection.reset();
+    stream->clearStatus(STREAM_STATUS::BCK_IDLE);
+  }
+  stream->request.setService(nullptr);
+  auto& listener_config = *new_sm->listener_config_;
+  stream->request.permanent_extra_headers.clear();
+  stream->response.permanent_extra_headers.clear();
+  if (!listener_config.add_head.empty())
+    stream->request.addHeader(listener_config.add_head, true);
+  if (!listener_config.response_add_head.empty())
+    stream->response.addHeader(listener_config.response_add_head, true);
+#if WAF_ENABLED
+  stream->waf_rules = listener_config.rules;
+#endif
+  old_sm->established_connection--;
+  new_sm->established_connection++;
+  stream->service_manager = std::move(new_sm);
+}
+
+void StreamManager::releaseBuffers(HttpStream* stream) {
+  if (stream->backend_connection.buffer_size == 0)
+    stream->backend_connection.releaseBuffer();
+  if (stream->client_connection.buffer_size == 0 &&
+      !stream->request.hasPendingData()) {
+    // the request data points to the buffer
+    stream->request.reset_parser();
+    stream->request.http_message = nullptr;
+    stream->request.http_message_length = 0;
+    stream->client_connection.releaseBuffer();
+  }
+}
+
+#if ENABLE_ZERO_COPY
+void StreamManager::setupSplice(HttpStream* stream, Connection& src,
+                                http_parser::HttpData& data) {
+  data.splice_body = false;
+  auto backend = stream->backend_connection.getBackend();
+  if (!zero_copy || stream->hasOption(STREAM_OPTION::PINNED_CONNECTION) ||
+      backend == nullptr || backend->backend_type != BACKEND_TYPE::REMOTE ||
+      stream->request.request_method == http::REQUEST_METHOD::HEAD)
+    return;
+  // the multishot recv takes the data out of the socket before splice(2)
+  if (isRecvEnabled(src.getFileDescriptor())) return;
+  // TLS records can only be spliced when the kernel handles them
+  bool is_request = &src == &stream->client_connection;
+  Connection& dst = is_request
+                        ? static_cast<Connection&>(stream->backend_connection)
+                        : stream->client_connection;
+  bool https_listener = stream->service_manager->is_https_listener;
+  if ((is_request ? https_listener : backend->isHttps()) &&
+      !ssl::SSLConnectionManager::isKtlsReadReady(src))
+    return;
+  if ((is_request ? backend->isHttps() : https_listener) &&
+      !ssl::SSLConnectionManager::isKtlsWriteReady(dst))
+    return;
+#if WAF_ENABLED
+  if (stream->modsec_transaction != nullptr) return;
+#endif
+#ifdef CACHE_ENABLED
+  auto service = static_cast<Service*>(stream->request.getService());
+  if (service != nullptr && service->cache_enabled) return;
+#endif
+  std::string transfer_encoding;
+  if (data.chunked_status != CHUNKED_STATUS::CHUNKED_DISABLED &&
+      data.getHeaderValue(http::HTTP_HEADER_NAME::TRANSFER_ENCODING,
+                          transfer_encoding) &&
+      ::strcasestr(transfer_encoding.data(), "chunked") != nullptr) {
+    // the start of the body came with the headers, in the buffer
+    data.chunked_parser.reset();
+    data.chunked_parser.feed(data.message, data.message_length);
+    if (data.chunked_parser.failed() || data.chunked_parser.done()) return;
+  } else if (data.chunked_status != CHUNKED_STATUS::CHUNKED_DISABLED ||
+             data.message_bytes_left < SPLICE_MIN_BODY) {
+    // a length unknown until the connection is closed or a rewritten body
+    return;
+  }
+  if (!src.acquirePipe()) return;
+  data.splice_body = true;
+}
+
+void StreamManager::spliceBody(HttpStream* stream, Connection& src,
+                               Connection& dst, http_parser::HttpData& data) {
+  auto& splice_pipe = src.splice_pipe;
+  auto& parser = data.chunked_parser;
+  bool chunked = data.chunked_status != CHUNKED_STATUS::CHUNKED_DISABLED;
+  auto received_all = [&] {
+    return chunked ? parser.done()
+                   : static_cast<size_t>(data.message_bytes_left) <=
+                         splice_pipe.bytes;
+  };
+  for (;;) {
+    auto result = IO::IO_RESULT::SUCCESS;
+    size_t received = 0;
+    while (result == IO::IO_RESULT::SUCCESS && splice_pipe.room() > 0 &&
+           !received_all()) {
+      if (!chunked) {
+        result = src.zeroRead(
+            static_cast<size_t>(data.message_bytes_left) - splice_pipe.bytes,
+            received);
+      } else if (parser.inData()) {
+        result = src.zeroRead(parser.chunk_left, received);
+        parser.skip(received);
+      } else {
+        result = src.zeroReadFraming(parser, received);
+      }
+    }
+    if (result != IO::IO_RESULT::SUCCESS &&
+        result != IO::IO_RESULT::DONE_TRY_AGAIN) {
+      Logger::logmsg(LOG_DEBUG, "fd: %d:%d Error receiving the spliced body",
+                     stream->client_connection.getFileDescriptor(),
+                     stream->backend_connection.getFileDescriptor());
+      clearStream(stream);
+      return;
+    }
+    size_t sent = 0;
+    auto write_result = src.zeroWrite(dst.getFileDescriptor(), sent);
+    if (!chunked) data.message_bytes_left -= static_cast<ssize_t>(sent);
+    if (write_result == IO::IO_RESULT::DONE_TRY_AGAIN) {
+      // the pipe keeps what was received until the peer is writable
+      src.disableEvents();
+      dst.enableWriteEvent();
+      return;
+    }
+    if (write_result != IO::IO_RESULT::SUCCESS) {
+      Logger::logmsg(LOG_DEBUG, "fd: %d:%d Error sending the spliced body",
+                     stream->client_connection.getFileDescriptor(),
+                     stream->backend_connection.getFileDescriptor());
+      clearStream(stream);
+      return;
+    }
+    if (received_all()) break;
+    if (result == IO::IO_RESULT::DONE_TRY_AGAIN) {
+      src.enableReadEvent();
+      dst.enableReadEvent();
+      return;
+    }
+  }
+  // the whole body was relayed, finish the message as the buffered path
+  src.releasePipe();
+  data.reset_parser();
+  if (&data == &stream->response) {
+    stream->clearStatus(STREAM_STATUS::BCK_READ_PENDING);
+    if (stream->response.keep_alive)
+      stream->status |= helper::to_underlying(STREAM_STATUS::BCK_IDLE);
+    releaseBuffers(stream);
+    if (stream->hasStatus(STREAM_STATUS::CLOSE_CONNECTION)) {
+      clearStream(stream);
+      return;
+    }
+  }
+  stream->backend_connection.enableReadEvent();
+  stream->client_connection.enableReadEvent();
+}
+#endif
+
+StreamManager::StreamManager(EVENT_ENGINE engine) : EpollManager(engine) {
     // TODO:: do attach for config changes
 };
 
@@ -217,12 +503,13 @@ StreamManager::~StreamManager() {
   ctl::ControlManager::getInstance()->deAttach(std::ref(*this));
   stop();
   if (worker.joinable()) worker.join();
-  for (auto& key_pair : cl_streams_set) {
-    delete key_pair.second;
-  }
-  for (auto& key_pair : bck_streams_set) {
-    delete key_pair.second;
-  }
+  // the pool may still be running the handshake of a stream
+  if (handshake_offload != nullptr) handshake_offload->waitIdle();
+  // every live stream is in the client set, the backend set only holds
+  // aliases of them
+  cl_streams_set.forEach(
+      [this](int, HttpStream* stream) { stream_pool.release(stream); });
+  for (auto& [key, listen_fd] : pending_listen_fds) ::close(listen_fd);
 }
 
 void StreamManager::doWork() {
@@ -230,6 +517,8 @@ void StreamManager::doWork() {
     if (loopOnce(EPOLL_WAIT_TIMEOUT) <= 0) {
       //       something bad happend
     }
+    if (reload_pending) applyListeners();
+    if (drain_pending || draining) applyDrain();
     // if(needMainatance)
     //    doMaintenance();
   }
@@ -239,14 +528,20 @@ void StreamManager::addStream(int fd,
                               std::shared_ptr<ServiceManager> service_manager) {
   DEBUG_COUNTER_HIT(debug__::on_client_connect);
 #if SM_HANDLE_ACCEPT
-  HttpStream* stream = cl_streams_set[fd];
+  HttpStream* stream = cl_streams_set.get(fd);
   if (UNLIKELY(stream != nullptr)) {
     clearStream(stream);
   }
-  stream = new HttpStream();
+  stream = stream_pool.acquire();
+  if (UNLIKELY(stream == nullptr)) {
+    Logger::logmsg(LOG_ERR, "Could not allocate a stream for fd %d", fd);
+    cl_streams_set.erase(fd);
+    ::close(fd);
+    return;
+  }
   stream->client_connection.setFileDescriptor(fd);
   stream->service_manager = std::move(service_manager);  // TODO::benchmark!!
-  cl_streams_set[fd] = stream;
+  cl_streams_set.set(fd, stream);
   auto& listener_config = *stream->service_manager->listener_config_;
   // update log info
   StreamDataLogger logger(stream, listener_config);
@@ -255,12 +550,14 @@ void StreamManager::addStream(int fd,
   stream->timer_fd.set(listener_config.to * 1000);
   addFd(stream->timer_fd.getFileDescriptor(), EVENT_TYPE::TIMEOUT,
         EVENT_GROUP::REQUEST_TIMEOUT);
-  timers_set[stream->timer_fd.getFileDescriptor()] = stream;
+  timers_set.set(stream->timer_fd.getFileDescriptor(), stream);
 #else
   this->setTimeOut(fd, TIMEOUT_TYPE::CLIENT_READ_TIMEOUT,listener_config.to);
 #endif
   stream->client_connection.enableEvents(this, EVENT_TYPE::READ,
                                          EVENT_GROUP::CLIENT);
+  // plain clients are only read by Connection::read(), TLS reads the socket
+  if (!stream->service_manager->is_https_listener) enableRecv(fd);
   //increment connections
   stream->service_manager->established_connection++;
   // Add requested header to the stream permanent header set, not cleared during
@@ -289,8 +586,55 @@ void StreamManager::addStream(int fd,
 
 int StreamManager::getWorkerId() { return worker_id; }
 
+void StreamManager::onClientHandshake(HttpStream* stream, bool result) {
+  auto& listener_config_ = *stream->service_manager->listener_config_;
+  if (!result) {
+    Logger::logmsg(LOG_DEBUG, "fd: %d:%d Handshake error with %s ",
+                   stream->client_connection.getFileDescriptor(),
+                   stream->backend_connection.getFileDescriptor(),
+                   stream->client_connection.getPeerAddress().c_str());
+    clearStream(stream);
+    return;
+  }
+  if (stream->client_connection.ssl_connected) {
+    DEBUG_COUNTER_HIT(debug__::on_handshake);
+    stream->service_manager->countHandshake(stream->client_connection);
+    httpsHeaders(stream, listener_config_.clnt_check);
+    stream->backend_connection.server_name =
+        stream->client_connection.server_name;
+    onRequestEvent(stream->client_connection.getFileDescriptor());
+    return;
+  } else if ((ERR_GET_REASON(ERR_peek_error()) == SSL_R_HTTP_REQUEST) &&
+             (ERR_GET_LIB(ERR_peek_error()) == ERR_LIB_SSL)) {
+    /* the client speaks plain HTTP on our HTTPS port */
+    Logger::logmsg(LOG_NOTICE,
+                   "Client %s sent a plain HTTP message to an SSL port",
+                   stream->client_connection.getPeerAddress().c_str());
+    if (listener_config_.nossl_redir > 0) {
+      Logger::logmsg(LOG_NOTICE,
+                     "(%lx) errNoSsl from %s redirecting to \"%s\"",
+                     pthread_self(),
+                     stream->client_connection.getPeerAddress().c_str(),
+                     listener_config_.nossl_url.data());
+      if (http_manager::replyRedirect(listener_config_.nossl_redir,
+                                      listener_config_.nossl_url, *stream))
+        clearStream(stream);
+      return;
+    } else {
+      Logger::logmsg(LOG_NOTICE, "(%lx) errNoSsl from %s sending error",
+                     pthread_self(),
+                     stream->client_connection.getPeerAddress().c_str());
+      http_manager::replyError(http::Code::BadRequest,
+                               http::reasonPhrase(http::Code::BadRequest),
+                               listener_config_.errnossl,
+                               stream->client_connection);
+      clearStream(stream);
+    }
+  }
+}
+
 void StreamManager::onRequestEvent(int fd) {
-  HttpStream* stream = cl_streams_set[fd];
+  HttpStream* stream = cl_streams_set.get(fd);
 
   if (stream == nullptr) {
     deleteFd(fd);
@@ -302,6 +646,18 @@ void StreamManager::onRequestEvent(int fd) {
   ScopeExit logStream{
       [stream, &extra_log] {  HttpStream::dumpDebugData(stream,"OnRequest",extra_log.data()); }};
 #endif
+#if ENABLE_ZERO_COPY
+  if (stream->request.splice_body) {
+    // the body waits for the headers to be sent to the backend
+    if (stream->request.getHeaderSent())
+      spliceBody(stream, stream->client_connection,
+                 stream->backend_connection, stream->request);
+    else
+      stream->client_connection.disableEvents();
+    return;
+  }
+#endif
+  refreshServiceManager(stream);
   auto& listener_config_ = *stream->service_manager->listener_config_;
   // update log info
   StreamDataLogger logger(stream, listener_config_);
@@ -332,50 +688,22 @@ void StreamManager::onRequestEvent(int fd) {
   switch (result) {
     case IO::IO_RESULT::SSL_HANDSHAKE_ERROR:
     case IO::IO_RESULT::SSL_NEED_HANDSHAKE: {
-      if (!ssl::SSLConnectionManager::handleHandshake(
-              *stream->service_manager->ssl_context,
-              stream->client_connection)) {
-        Logger::logmsg(LOG_DEBUG, "fd: %d:%d Handshake error with %s ",
-                       stream->client_connection.getFileDescriptor(),
-                       stream->backend_connection.getFileDescriptor(),
-                       stream->client_connection.getPeerAddress().c_str());
-        clearStream(stream);
-        return;
-      }
-      if (stream->client_connection.ssl_connected) {
-        DEBUG_COUNTER_HIT(debug__::on_handshake);
-        httpsHeaders(stream, listener_config_.clnt_check);
-        stream->backend_connection.server_name =
-            stream->client_connection.server_name;
-        onRequestEvent(fd);
+      auto stall_start = Time::getMonotonicUs();
+      if (handshake_offload != nullptr) {
+        stream->status |=
+            helper::to_underlying(STREAM_STATUS::HANDSHAKE_OFFLOADED);
+        handshake_offload->submit(stream->client_connection,
+                                  *stream->service_manager->ssl_context);
+        stream->service_manager->tls_offloaded++;
+        stream->service_manager->countHandshakeStall(
+            Time::getMonotonicUs() - stall_start);
         return;
-      } else if ((ERR_GET_REASON(ERR_peek_error()) == SSL_R_HTTP_REQUEST) &&
-                 (ERR_GET_LIB(ERR_peek_error()) == ERR_LIB_SSL)) {
-        /* the client speaks plain HTTP on our HTTPS port */
-        Logger::logmsg(LOG_NOTICE,
-                       "Client %s sent a plain HTTP message to an SSL port",
-                       stream->client_connection.getPeerAddress().c_str());
-        if (listener_config_.nossl_redir > 0) {
-          Logger::logmsg(LOG_NOTICE,
-                         "(%lx) errNoSsl from %s redirecting to \"%s\"",
-                         pthread_self(),
-                         stream->client_connection.getPeerAddress().c_str(),
-                         listener_config_.nossl_url.data());
-          if (http_manager::replyRedirect(listener_config_.nossl_redir,
-                                          listener_config_.nossl_url, *stream))
-            clearStream(stream);
-          return;
-        } else {
-          Logger::logmsg(LOG_NOTICE, "(%lx) errNoSsl from %s sending error",
-                         pthread_self(),
-                         stream->client_connection.getPeerAddress().c_str());
-          http_manager::replyError(http::Code::BadRequest,
-                                   http::reasonPhrase(http::Code::BadRequest),
-                                   listener_config_.errnossl,
-                                   stream->client_connection);
-          clearStream(stream);
-        }
       }
+      auto handshake_result = ssl::SSLConnectionManager::handleHandshake(
+          *stream->service_manager->ssl_context, stream->client_connection);
+      stream->service_manager->countHandshakeStall(Time::getMonotonicUs() -
+                                                   stall_start);
+      onClientHandshake(stream, handshake_result);
       return;
     }
     case IO::IO_RESULT::SUCCESS:
@@ -444,6 +772,17 @@ void StreamManager::onRequestEvent(int fd) {
   parse_result = stream->request.parseRequest(
       stream->client_connection.buffer + stream->client_connection.buffer_offset, stream->client_connection.buffer_size,
       &parsed);  // parsing http data as response structured
+  if (parse_result == http_parser::PARSE_RESULT::INCOMPLETE &&
+      stream->client_connection.buffer_offset +
+              stream->client_connection.buffer_size ==
+          stream->client_connection.bufferCapacity()) {
+    /* the headers do not fit, move them to a bigger buffer and read again */
+    if (stream->client_connection.growBuffer()) {
+      onRequestEvent(fd);
+      return;
+    }
+    parse_result = http_parser::PARSE_RESULT::TOOLONG;
+  }
 
   switch (parse_result) {
     case http_parser::PARSE_RESULT::SUCCESS: {
@@ -519,7 +858,7 @@ void StreamManager::onRequestEvent(int fd) {
 #if USE_TIMER_FD_TIMEOUT
       stream->timer_fd.unset();
       deleteFd(stream->timer_fd.getFileDescriptor());
-      timers_set[stream->timer_fd.getFileDescriptor()] = nullptr;
+      timers_set.erase(stream->timer_fd.getFileDescriptor());
 #else
       stopTimeOut(fd);
 #endif
@@ -575,6 +914,7 @@ void StreamManager::onRequestEvent(int fd) {
   IO::IO_OP op_state = IO::IO_OP::OP_ERROR;
   static size_t total_request;
   total_request++;
+  request_count++;
   stream->response.reset_parser();
   switch (bck->backend_type) {
     case BACKEND_TYPE::REMOTE: {
@@ -589,7 +929,8 @@ void StreamManager::onRequestEvent(int fd) {
       }
       if (need_new_backend) {
         // null
-        if (stream->backend_connection.getFileDescriptor() > 0) {
+        if (stream->backend_connection.getFileDescriptor() > 0 &&
+            !releaseBackendConnection(stream)) {
           deleteFd(
               stream->backend_connection.getFileDescriptor());  // Client cannot
           // Client cannot  be connected to more than one backend at
@@ -602,8 +943,20 @@ void StreamManager::onRequestEvent(int fd) {
         stream->backend_connection.reset();
         stream->backend_connection.setBackend(bck);
         Time::getTime(stream->backend_connection.time_start);
-        op_state = stream->backend_connection.doConnect(*bck->address_info,
-                                                        bck->conn_timeout);
+        int idle_fd = backend_pool.isEnabled() && !bck->isHttps()
+                          ? backend_pool.get(bck, Time::getTimeSec(),
+                                             [this](int idle) {
+                                               onBackendConnectionCheckout(
+                                                   idle);
+                                             })
+                          : -1;
+        if (idle_fd >= 0) {
+          stream->backend_connection.setFileDescriptor(idle_fd);
+          op_state = IO::IO_OP::OP_SUCCESS;
+        } else {
+          op_state = stream->backend_connection.doConnect(*bck->address_info,
+                                                          bck->conn_timeout);
+        }
         switch (op_state) {
           case IO::IO_OP::OP_ERROR: {
             Logger::logmsg(LOG_NOTICE, "Error connecting to backend %s",
@@ -632,17 +985,16 @@ void StreamManager::onRequestEvent(int fd) {
             break;
           }
         }
-        auto bck_stream = bck_streams_set.find(
-            stream->backend_connection.getFileDescriptor());
-        if (bck_stream != bck_streams_set.end()) {
+        if (bck_streams_set.get(
+                stream->backend_connection.getFileDescriptor()) != nullptr) {
           Logger::logmsg(LOG_DEBUG, "## BCK Stream exists in set");
-          // delete bck_stream->second;
         }
-        bck_streams_set[stream->backend_connection.getFileDescriptor()] =
-            stream;
+        bck_streams_set.set(stream->backend_connection.getFileDescriptor(),
+                            stream);
         stream->backend_connection.enableEvents(this, EVENT_TYPE::WRITE,
                                                 EVENT_GROUP::SERVER);
       }
+      stream->clearStatus(STREAM_STATUS::BCK_IDLE);
 
       Logger::logmsg(LOG_DEBUG, "%s %lu [%s] %.*s [%s (%d) -> %s:%d (%d)]",
                      need_new_backend ? "NEW" : "REUSED", total_request,
@@ -681,6 +1033,9 @@ void StreamManager::onRequestEvent(int fd) {
       if (service->service_config.pinned_connection) {
         stream->options |= helper::to_underlying(STREAM_OPTION::PINNED_CONNECTION);
       }
+#if ENABLE_ZERO_COPY
+      setupSplice(stream, stream->client_connection, stream->request);
+#endif
       stream->backend_connection.enableWriteEvent();
       break;
     }
@@ -704,7 +1059,7 @@ void StreamManager::onRequestEvent(int fd) {
 }
 
 void StreamManager::onResponseEvent(int fd) {
-  HttpStream* stream = bck_streams_set[fd];
+  HttpStream* stream = bck_streams_set.get(fd);
   if (stream == nullptr) {
     deleteFd(fd);
     ::close(fd);
@@ -729,6 +1084,13 @@ void StreamManager::onResponseEvent(int fd) {
     stream->backend_connection.disableEvents();
     return;
   }
+#if ENABLE_ZERO_COPY
+  if (stream->response.splice_body) {
+    spliceBody(stream, stream->backend_connection, stream->client_connection,
+               stream->response);
+    return;
+  }
+#endif
 #if PRINT_DEBUG_FLOW_BUFFERS
   auto buffer_size_in = stream->backend_connection.buffer_size;
   if (stream->backend_connection.buffer_size != 0)
@@ -754,39 +1116,7 @@ void StreamManager::onResponseEvent(int fd) {
     result =
         ssl::SSLConnectionManager::handleDataRead(stream->backend_connection);
   } else {
-#if ENABLE_ZERO_COPY
-    if (stream->response.message_bytes_left > 0 &&
-        !stream->backend_connection.getBackend()->isHttps() &&
-        !this->is_https_listener
-        /*&& stream->response.transfer_encoding_header*/) {
-      result = stream->backend_connection.zeroRead();
-      if (result == IO::IO_RESULT::ERROR) {
-        Logger::LogInfo("Error reading response ", LOG_DEBUG);
-        clearStream(stream);
-        return;
-      }
-#if ENABLE_QUICK_RESPONSE
-      result = stream->backend_connection.zeroWrite(
-          stream->client_connection.getFileDescriptor(), stream->response);
-      switch (result) {
-        case IO::IO_RESULT::FD_CLOSED:
-        case IO::IO_RESULT::ERROR: {
-          Logger::LogInfo("Error Writing response ", LOG_NOTICE);
-          clearStream(stream);
-          return;
-        }
-        case IO::IO_RESULT::SUCCESS:
-          return;
-        case IO::IO_RESULT::DONE_TRY_AGAIN:
-          stream->client_connection.enableWriteEvent();
-          return;
-        case IO::IO_RESULT::FULL_BUFFER:
-          break;
-      }
-#endif
-    } else
-#endif
-      result = stream->backend_connection.read();
+    result = stream->backend_connection.read();
   }
 #if PRINT_DEBUG_FLOW_BUFFERS
   Logger::logmsg(
@@ -807,9 +1137,8 @@ void StreamManager::onResponseEvent(int fd) {
     case IO::IO_RESULT::SSL_NEED_HANDSHAKE: {
       stream->backend_connection.server_name =
           stream->client_connection.server_name;
-      if (!ssl::SSLConnectionManager::handleHandshake(
-              stream->backend_connection.getBackend()->ctx.get(),
-              stream->backend_connection, true)) {
+      if (!stream->backend_connection.getBackend()->handleHandshake(
+              stream->backend_connection)) {
         Logger::logmsg(LOG_INFO, "Backend handshake error with %s ",
                       stream->backend_connection.address_str.c_str());
         http_manager::replyError(
@@ -877,6 +1206,7 @@ void StreamManager::onResponseEvent(int fd) {
   }else {
     stream->clearStatus(STREAM_STATUS::BCK_READ_PENDING);
   }
+  stream->clearStatus(STREAM_STATUS::BCK_IDLE);
   if (stream->hasOption(STREAM_OPTION::PINNED_CONNECTION) || stream->response.hasPendingData()) {
 #ifdef CACHE_ENABLED
     if (stream->response.chunked_status != CHUNKED_STATUS::CHUNKED_DISABLED) {
@@ -914,6 +1244,17 @@ void StreamManager::onResponseEvent(int fd) {
     auto ret = stream->response.parseResponse(
         stream->backend_connection.buffer,
         stream->backend_connection.buffer_size, &parsed);
+    if (ret == http_parser::PARSE_RESULT::INCOMPLETE &&
+        stream->backend_connection.buffer_size ==
+            stream->backend_connection.bufferCapacity()) {
+      /* the headers do not fit, move them to a bigger buffer and read again */
+      if (stream->backend_connection.growBuffer()) {
+        stream->clearStatus(STREAM_STATUS::BCK_READ_PENDING);
+        onResponseEvent(fd);
+        return;
+      }
+      ret = http_parser::PARSE_RESULT::TOOLONG;
+    }
     static size_t total_responses;
     switch (ret) {
       case http_parser::PARSE_RESULT::SUCCESS: {
@@ -979,6 +1320,19 @@ void StreamManager::onResponseEvent(int fd) {
       return;
     }
     stream->status |= helper::to_underlying(STREAM_STATUS::RESPONSE_PENDING);
+    // the client is closed once idle, it reconnects to the upgraded process
+    if (draining && stream->response.http_status_code != 101) {
+      auto& response = stream->response;
+      for (size_t i = 0; i != response.num_headers; i++) {
+        auto header_name = http::http_info::headers_names.find(std::string_view(
+            response.headers[i].name, response.headers[i].name_len));
+        if (header_name != nullptr &&
+            (*header_name == http::HTTP_HEADER_NAME::CONNECTION ||
+             *header_name == http::HTTP_HEADER_NAME::KEEP_ALIVE))
+          response.headers[i].header_off = true;
+      }
+      response.addHeader(http::HTTP_HEADER_NAME::CONNECTION, "close");
+    }
 
 #if WAF_ENABLED
     if (stream->modsec_transaction != nullptr) {
@@ -1019,9 +1373,12 @@ void StreamManager::onResponseEvent(int fd) {
     http_manager::setBackendCookie(service, stream);
     setStrictTransportSecurity(service, stream);
 #if ON_FLY_COMRESSION
-    if (!this->is_https_listener) {
+    if (!stream->service_manager->is_https_listener) {
       Compression::applyCompression(service, stream);
     }
+#endif
+#if ENABLE_ZERO_COPY
+    setupSplice(stream, stream->backend_connection, stream->response);
 #endif
     StreamDataLogger::logTransaction(*stream);
 #if ENABLE_QUICK_RESPONSE
@@ -1034,9 +1391,9 @@ void StreamManager::onResponseEvent(int fd) {
 void StreamManager::onConnectTimeoutEvent(int fd) {
   DEBUG_COUNTER_HIT(debug__::on_backend_connect_timeout);
 #if USE_TIMER_FD_TIMEOUT
-  HttpStream* stream = timers_set[fd];
+  HttpStream* stream = timers_set.get(fd);
 #else
-  HttpStream* stream = bck_streams_set[fd];
+  HttpStream* stream = bck_streams_set.get(fd);
 #endif
   if (stream == nullptr) {
     //Logger::LogInfo("Stream null pointer", LOG_REMOVE);
@@ -1064,9 +1421,9 @@ void StreamManager::onConnectTimeoutEvent(int fd) {
 void StreamManager::onRequestTimeoutEvent(int fd) {
   DEBUG_COUNTER_HIT(debug__::on_request_timeout);
 #if USE_TIMER_FD_TIMEOUT
-  HttpStream* stream = timers_set[fd];
+  HttpStream* stream = timers_set.get(fd);
 #else
-  HttpStream* stream = cl_streams_set[fd];
+  HttpStream* stream = cl_streams_set.get(fd);
 #endif
   if (stream == nullptr) {
     deleteFd(fd);
@@ -1093,9 +1450,9 @@ void StreamManager::onRequestTimeoutEvent(int fd) {
 void StreamManager::onResponseTimeoutEvent(int fd) {
   DEBUG_COUNTER_HIT(debug__::on_response_timeout);
 #if USE_TIMER_FD_TIMEOUT
-  HttpStream* stream = timers_set[fd];
+  HttpStream* stream = timers_set.get(fd);
 #else
-  HttpStream* stream = bck_streams_set[fd];
+  HttpStream* stream = bck_streams_set.get(fd);
 #endif
   if (stream == nullptr) {
     //Logger::LogInfo("Stream null pointer", LOG_REMOVE);
@@ -1173,7 +1530,6 @@ void StreamManager::setStreamBackend(HttpStream* stream) {
           stream->backend_connection.getBackend()->decreaseConnection();
       }
     deleteFd(stream->backend_connection.getFileDescriptor());
-    bck_streams_set[stream->backend_connection.getFileDescriptor()] = nullptr;
     bck_streams_set.erase(stream->backend_connection.getFileDescriptor());
     stream->backend_connection.closeConnection();
   }
@@ -1235,8 +1591,8 @@ void StreamManager::setStreamBackend(HttpStream* stream) {
             break;
           }
         }
-        bck_streams_set[stream->backend_connection.getFileDescriptor()] =
-            stream;
+        bck_streams_set.set(stream->backend_connection.getFileDescriptor(),
+                            stream);
         stream->backend_connection.enableEvents(this, EVENT_TYPE::WRITE,
                                                 EVENT_GROUP::SERVER);
         if (stream->backend_connection.getBackend()->nf_mark > 0)
@@ -1316,6 +1672,13 @@ void StreamManager::onServerWriteEvent(HttpStream* stream) {
             stream->backend_connection.time_start);
 
   }
+#if ENABLE_ZERO_COPY
+  if (stream->request.splice_body && stream->request.getHeaderSent()) {
+    spliceBody(stream, stream->client_connection, stream->backend_connection,
+               stream->request);
+    return;
+  }
+#endif
   /*Check if the buffer has data to be send */
   if (stream->client_connection.buffer_size == 0) {
     stream->client_connection.enableReadEvent();
@@ -1337,11 +1700,6 @@ void StreamManager::onServerWriteEvent(HttpStream* stream) {
       if (stream->client_connection.buffer_size > 0)
         result = stream->client_connection.writeTo(
             stream->backend_connection.getFileDescriptor(), written);
-#if ENABLE_ZERO_COPY
-      else if (stream->client_connection.splice_pipe.bytes > 0)
-        result = stream->client_connection.zeroWrite(
-            stream->backend_connection.getFileDescriptor(), stream->request);
-#endif
     }
 #if EXTENDED_DEBUG_LOG
     extra_log = IO::getResultString(result);
@@ -1349,9 +1707,8 @@ void StreamManager::onServerWriteEvent(HttpStream* stream) {
     switch (result) {
       case IO::IO_RESULT::SSL_HANDSHAKE_ERROR:
       case IO::IO_RESULT::SSL_NEED_HANDSHAKE: {
-        if (!ssl::SSLConnectionManager::handleHandshake(
-                stream->backend_connection.getBackend()->ctx.get(),
-                stream->backend_connection, true)) {
+        if (!stream->backend_connection.getBackend()->handleHandshake(
+                stream->backend_connection)) {
           Logger::logmsg(
               LOG_DEBUG, "Handshake error with %s ",
               stream->backend_connection.getBackend()->address.data());
@@ -1426,9 +1783,8 @@ void StreamManager::onServerWriteEvent(HttpStream* stream) {
     case IO::IO_RESULT::SSL_NEED_HANDSHAKE: {
       stream->backend_connection.server_name =
           stream->client_connection.server_name;
-      if (!ssl::SSLConnectionManager::handleHandshake(
-              stream->backend_connection.getBackend()->ctx.get(),
-              stream->backend_connection, true)) {
+      if (!stream->backend_connection.getBackend()->handleHandshake(
+              stream->backend_connection)) {
         Logger::logmsg(LOG_DEBUG, "Handshake error with %s ",
                        stream->backend_connection.getBackend()->address.data());
         clearStream(stream);
@@ -1509,6 +1865,13 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
       stream->backend_connection.buffer_size, stream->response.content_length,
       stream->response.message_bytes_left);
   auto buffer_size_in = stream->backend_connection.buffer_size;
+#endif
+#if ENABLE_ZERO_COPY
+  if (stream->response.splice_body && stream->response.getHeaderSent()) {
+    spliceBody(stream, stream->backend_connection, stream->client_connection,
+               stream->response);
+    return;
+  }
 #endif
   IO::IO_RESULT result = IO::IO_RESULT::ERROR;
   /* If the connection is pinned, then we need to write the buffer
@@ -1523,11 +1886,6 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
       if (stream->backend_connection.buffer_size > 0)
         result = stream->backend_connection.writeTo(
             stream->client_connection.getFileDescriptor(), written);
-#if ENABLE_ZERO_COPY
-      else if (stream->backend_connection.splice_pipe.bytes > 0)
-        result = stream->backend_connection.zeroWrite(
-            stream->client_connection.getFileDescriptor(), stream->response);
-#endif
     }
 #if EXTENDED_DEBUG_LOG
     extra_log = IO::getResultString(result);
@@ -1584,10 +1942,17 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
               http::CHUNKED_STATUS::CHUNKED_LAST_CHUNK &&
           stream->backend_connection.buffer_size == 0) {
         stream->response.reset_parser();
+        if (stream->response.keep_alive)
+          stream->status |= helper::to_underlying(STREAM_STATUS::BCK_IDLE);
+        releaseBuffers(stream);
       } else if (stream->response.message_bytes_left > 0) {
         stream->response.message_bytes_left -= written;
-        if (stream->response.message_bytes_left <= 0)
+        if (stream->response.message_bytes_left <= 0) {
           stream->response.reset_parser();
+          if (stream->response.keep_alive)
+            stream->status |= helper::to_underlying(STREAM_STATUS::BCK_IDLE);
+          releaseBuffers(stream);
+        }
       }
     }
 #if PRINT_DEBUG_FLOW_BUFFERS
@@ -1689,6 +2054,7 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
       }
       if (stream->client_connection.ssl_connected) {
         DEBUG_COUNTER_HIT(debug__::on_handshake);
+        stream->service_manager->countHandshake(stream->client_connection);
         httpsHeaders(stream, listener_config_.clnt_check);
         stream->backend_connection.server_name =
             stream->client_connection.server_name;
@@ -1710,6 +2076,11 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
         stream->client_connection.enableWriteEvent();
         return;
       }
+      /* the whole response fitted in the buffer */
+      if (stream->response.keep_alive &&
+          stream->backend_connection.buffer_size == 0 &&
+          !stream->response.hasPendingData())
+        stream->status |= helper::to_underlying(STREAM_STATUS::BCK_IDLE);
       break;
     default:
       Logger::logmsg(
@@ -1773,6 +2144,9 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
       clearStream(stream);
       return;
     }
+    if (!stream->hasOption(STREAM_OPTION::PINNED_CONNECTION) &&
+        !stream->response.hasPendingData())
+      releaseBuffers(stream);
 #ifdef CACHE_ENABLED
     if (!stream->response.isCached())
 #endif
@@ -1790,20 +2164,98 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
 }
 
 bool StreamManager::registerListener(
-    std::weak_ptr<ServiceManager> service_manager) {
+    std::weak_ptr<ServiceManager> service_manager, bool adopt_inherited,
+    int listen_fd) {
   auto& listener_config = service_manager.lock()->listener_config_;
-  auto address =
-      Network::getAddress(listener_config->address, listener_config->port);
-  listener_config->addr_info = address.release();
-  int listen_fd = Connection::listen(*listener_config->addr_info);
+  auto key = SocketHandoff::listenerKey(listener_config->address,
+                                        listener_config->port);
+  if (listen_fd < 0) listen_fd = SocketHandoff::takeInherited(key);
+  if (listen_fd < 0) {
+    if (listener_config->addr_info == nullptr) {
+      auto address =
+          Network::getAddress(listener_config->address, listener_config->port);
+      listener_config->addr_info = address.release();
+    }
+    if (listener_config->addr_info == nullptr) return false;
+    listen_fd = Connection::listen(*listener_config->addr_info);
+  }
 
   if (listen_fd > 0) {
+    if (cpu_steering && !Network::setReusePortCpuSteering(listen_fd)) {
+      Logger::logmsg(LOG_WARNING,
+                     "Could not attach reuseport cpu steering to %s: %s",
+                     listener_config->name.data(), std::strerror(errno));
+    }
     service_manager_set[listen_fd] = service_manager;
-    return handleAccept(listen_fd);
+    if (!handleAccept(listen_fd)) return false;
+    // the previous binary ran more workers, serve their queues too
+    while (adopt_inherited &&
+           (listen_fd = SocketHandoff::takeInherited(key)) > 0) {
+      service_manager_set[listen_fd] = service_manager;
+      handleAccept(listen_fd);
+    }
+    return true;
   }
   return false;
 }
 
+std::vector<std::pair<int, std::string>> StreamManager::getListeners() {
+  std::vector<std::pair<int, std::string>> listeners;
+  std::lock_guard<std::mutex> lock(reload_mutex);
+  for (auto& [listen_fd, sm] : service_manager_set) {
+    auto spt = sm.lock();
+    if (spt == nullptr) continue;
+    listeners.emplace_back(
+        listen_fd, SocketHandoff::listenerKey(spt->listener_config_->address,
+                                              spt->listener_config_->port));
+  }
+  return listeners;
+}
+
+void StreamManager::drainListeners() { drain_pending = true; }
+
+void StreamManager::applyDrain() {
+  if (drain_pending) {
+    std::lock_guard<std::mutex> lock(reload_mutex);
+    drain_pending = false;
+    draining = true;
+    for (auto& [listen_fd, sm] : service_manager_set) {
+      this->stopAccept(listen_fd);
+      ::close(listen_fd);
+    }
+    service_manager_set.clear();
+    Logger::logmsg(LOG_DEBUG, "Worker %d draining", worker_id);
+  }
+  if (Time::getTimeSec() == last_drain_sweep) return;
+  last_drain_sweep = Time::getTimeSec();
+  cl_streams_set.forEach([this](int, HttpStream* stream) {
+    if (isClientIdle(stream)) clearStream(stream);
+  });
+}
+
+bool StreamManager::isClientIdle(HttpStream* stream) {
+  if (stream->hasOption(STREAM_OPTION::PINNED_CONNECTION) ||
+      stream->hasStatus(STREAM_STATUS::HANDSHAKE_OFFLOADED) ||
+      stream->hasStatus(STREAM_STATUS::RESPONSE_PENDING))
+    return false;
+  auto& client = stream->client_connection;
+  if (client.buffer_size > 0 || stream->request.hasPendingData() ||
+      stream->response.hasPendingData())
+    return false;
+  // a backend connection not idle has a request in flight
+  if (stream->backend_connection.getFileDescriptor() >= 0 &&
+      !stream->hasStatus(STREAM_STATUS::BCK_IDLE))
+    return false;
+  if (client.ssl != nullptr &&
+      (!client.ssl_connected || SSL_pending(client.ssl) > 0))
+    return false;
+  // a request received since the last loop iteration is served first
+  if (hasRecvData(client.getFileDescriptor())) return false;
+  char byte;
+  return ::recv(client.getFileDescriptor(), &byte, 1,
+                MSG_PEEK | MSG_DONTWAIT) <= 0;
+}
+
 /** Clears the HttpStream. It deletes all the timers and events. Finally,
  * deletes the HttpStream.
  */
@@ -1811,6 +2263,11 @@ void StreamManager::clearStream(HttpStream* stream) {
   if (stream == nullptr) {
     return;
   }
+  if (stream->hasStatus(STREAM_STATUS::HANDSHAKE_OFFLOADED)) {
+    // released once the HandshakePool gives the client connection back
+    stream->status |= helper::to_underlying(STREAM_STATUS::CLEAR_PENDING);
+    return;
+  }
 #ifdef CACHE_ENABLED
   CacheManager::handleStreamClose(stream);
 #endif
@@ -1818,7 +2275,6 @@ void StreamManager::clearStream(HttpStream* stream) {
   if (stream->timer_fd.getFileDescriptor() > 0) {
     deleteFd(stream->timer_fd.getFileDescriptor());
     stream->timer_fd.unset();
-    timers_set[stream->timer_fd.getFileDescriptor()] = nullptr;
     timers_set.erase(stream->timer_fd.getFileDescriptor());
 #if DEBUG_STREAM_EVENTS_COUNT
     clear_timer++;
@@ -1826,15 +2282,16 @@ void StreamManager::clearStream(HttpStream* stream) {
   }
 #endif
   if (stream->client_connection.getFileDescriptor() > 0) {
+    stream->service_manager->countKtls(stream->client_connection, -1);
     deleteFd(stream->client_connection.getFileDescriptor());
-    cl_streams_set[stream->client_connection.getFileDescriptor()] = nullptr;
     cl_streams_set.erase(stream->client_connection.getFileDescriptor());
     stream->client_connection.closeConnection();
 #if DEBUG_STREAM_EVENTS_COUNT
     clear_client++;
 #endif
   }
-  if (stream->backend_connection.getFileDescriptor() > 0) {
+  if (stream->backend_connection.getFileDescriptor() > 0 &&
+      !releaseBackendConnection(stream)) {
     if (stream->hasStatus(STREAM_STATUS::BCK_CONN_PENDING)) {
       stream->backend_connection.getBackend()->decreaseConnTimeoutAlive();
     }else{
@@ -1844,7 +2301,6 @@ void StreamManager::clearStream(HttpStream* stream) {
     clear_backend++;
 #endif
     deleteFd(stream->backend_connection.getFileDescriptor());
-    bck_streams_set[stream->backend_connection.getFileDescriptor()] = nullptr;
     bck_streams_set.erase(stream->backend_connection.getFileDescriptor());
     stream->backend_connection.closeConnection();
   }
@@ -1853,7 +2309,7 @@ void StreamManager::clearStream(HttpStream* stream) {
 #endif
   DEBUG_COUNTER_HIT(debug__::on_clear_stream);
   stream->service_manager->established_connection--;
-  delete stream;
+  stream_pool.release(stream);
 }
 
 void StreamManager::onClientDisconnect(HttpStream* stream) {
@@ -1924,7 +2380,6 @@ void StreamManager::onServerDisconnect(HttpStream* stream) {
     clear_backend++;
 #endif
     deleteFd(stream->backend_connection.getFileDescriptor());
-    bck_streams_set[stream->backend_connection.getFileDescriptor()] = nullptr;
     bck_streams_set.erase(stream->backend_connection.getFileDescriptor());
     stream->backend_connection.closeConnection();
   }
@@ -1949,6 +2404,88 @@ void StreamManager::onServerDisconnect(HttpStream* stream) {
   clearStream(stream);
 }
 
+void StreamManager::reloadListeners(
+    std::map<int, std::shared_ptr<ServiceManager>> service_managers_,
+    std::map<std::string, int> listen_fds) {
+  std::lock_guard<std::mutex> lock(reload_mutex);
+  pending_service_managers = std::move(service_managers_);
+  // a previous reload not applied yet may have opened other listeners
+  for (auto& [key, listen_fd] : listen_fds) {
+    auto& pending_fd = pending_listen_fds[key];
+    if (pending_fd > 0) ::close(pending_fd);
+    pending_fd = listen_fd;
+  }
+  reload_pending = true;
+}
+
+void StreamManager::applyListeners() {
+  std::map<int, std::shared_ptr<ServiceManager>> new_service_managers;
+  std::map<std::string, int> listen_fds;
+  // held while the listeners change, getListeners() reads them
+  std::lock_guard<std::mutex> lock(reload_mutex);
+  new_service_managers.swap(pending_service_managers);
+  listen_fds.swap(pending_listen_fds);
+  reload_pending = false;
+  // a draining worker does not accept anymore
+  if (draining) {
+    for (auto& [key, listen_fd] : listen_fds) ::close(listen_fd);
+    service_managers.swap(new_service_managers);
+    return;
+  }
+  // the pooled connections are keyed by the backends of the old snapshot
+  backend_pool.clear(
+      [this](int fd) { onBackendConnectionCheckout(fd); });
+  std::map<int, std::weak_ptr<ServiceManager>> listen_set;
+  std::vector<std::shared_ptr<ServiceManager>> new_listeners;
+  for (auto& [sm_id, sm] : new_service_managers) {
+    if (sm->disabled) continue;
+    auto kept = service_manager_set.end();
+    for (auto it = service_manager_set.begin(); it != service_manager_set.end();
+         it++) {
+      auto old_sm = it->second.lock();
+      if (old_sm && old_sm->listener_config_->address ==
+                        sm->listener_config_->address &&
+          old_sm->listener_config_->port == sm->listener_config_->port) {
+        kept = it;
+        break;
+      }
+    }
+    if (kept != service_manager_set.end()) {
+      listen_set[kept->first] = sm;
+      service_manager_set.erase(kept);
+    } else {
+      new_listeners.push_back(sm);
+    }
+  }
+  // removed listeners, serve what is already queued before closing them
+  for (auto& [listen_fd, old_sm] : service_manager_set) {
+    auto spt = old_sm.lock();
+    int new_fd;
+    while (spt && (new_fd = Connection::doAccept(listen_fd)) > 0)
+      addStream(new_fd, spt);
+    this->stopAccept(listen_fd);
+    ::close(listen_fd);
+  }
+  service_manager_set.swap(listen_set);
+  for (auto& sm : new_listeners) {
+    int listen_fd = -1;
+    auto opened = listen_fds.find(SocketHandoff::listenerKey(
+        sm->listener_config_->address, sm->listener_config_->port));
+    if (opened != listen_fds.end()) {
+      listen_fd = opened->second;
+      listen_fds.erase(opened);
+    }
+    if (!registerListener(sm, false, listen_fd)) {
+      Logger::logmsg(LOG_ERR, "Error initializing StreamManager for farm %s",
+                     sm->listener_config_->name.data());
+    }
+  }
+  for (auto& [key, listen_fd] : listen_fds) ::close(listen_fd);
+  // release the old snapshot, its streams keep what they still use
+  service_managers.swap(new_service_managers);
+  Logger::logmsg(LOG_DEBUG, "Worker %d configuration reloaded", worker_id);
+}
+
 void StreamManager::stopListener(int listener_id, bool cut_connection) {
   for (const auto& lc : service_manager_set) {
     auto spt = lc.second.lock();
@@ -1971,13 +2508,9 @@ void StreamManager::stopListener(int listener_id, bool cut_connection) {
     }
   }
   if (cut_connection) {
-    for (auto it = cl_streams_set.begin(); it != cl_streams_set.end();) {
-      if (it->second->service_manager->id == listener_id) {
-        auto item = it++;
-        clearStream(item->second);
-      } else
-        it++;
-    }
+    cl_streams_set.forEach([this, listener_id](int, HttpStream* stream) {
+      if (stream->service_manager->id == listener_id) clearStream(stream);
+    });
   }
 }
 #if USE_TIMER_FD_TIMEOUT==0
@@ -1994,6 +2527,9 @@ void StreamManager::onTimeOut(int fd, TIMEOUT_TYPE type) {
       break;
     case TIMEOUT_TYPE::CLIENT_WRITE_TIMEOUT:
       break;
+    case TIMEOUT_TYPE::BACKEND_IDLE_TIMEOUT:
+      backend_pool.expire(fd);
+      break;
     }
 }
 #endif
@@ -21,18 +21,23 @@
 
 #pragma once
 #include "../config/config_data.h"
+#include "../connection/backend_pool.h"
 #include "../event/epoll_manager.h"
+#include "../event/fd_table.h"
 #include "../event/timer_fd.h"
 #include "../handlers/cache_manager.h"
 #include "../handlers/http_manager.h"
 #include "../http/http_stream.h"
 #include "../service/backend.h"
 #include "../service/service_manager.h"
+#include "../ssl/handshake_offload.h"
 #include "../ssl/ssl_connection_manager.h"
 #include "../stats/counter.h"
+#include "../util/object_pool.h"
 #if WAF_ENABLED
 #include "../handlers/waf.h"
 #endif
+#include <mutex>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -134,20 +139,147 @@ class StreamManager : public EpollManager, public CtlObserver<ctl::CtlTask, std:
   int clear_client{0};
 #endif
   int worker_id{};
+  /** CPU the worker thread is pinned to, -1 if not pinned. */
+  int cpu_id{-1};
+  /** Steer the listeners connections to the worker on the receiving CPU. */
+  bool cpu_steering{false};
   std::thread worker;
   std::map<int, std::weak_ptr<ServiceManager> > service_manager_set;
+  /**
+   * Configuration snapshot the worker accepts new connections with, keyed by
+   * listener id. The streams keep a reference to the ServiceManager they were
+   * accepted with, so a replaced snapshot is released once the worker has
+   * switched and its last stream is gone.
+   */
+  std::map<int, std::shared_ptr<ServiceManager>> service_managers;
+  /** Snapshot published by reloadListeners(), taken by the worker thread. */
+  std::map<int, std::shared_ptr<ServiceManager>> pending_service_managers;
+  std::map<std::string, int> pending_listen_fds;
+  std::mutex reload_mutex;
+  std::atomic<bool> reload_pending{false};
+  /** Set by drainListeners(), taken by the worker thread. */
+  std::atomic<bool> drain_pending{false};
+  /** The worker no longer accepts, it closes the idle client connections. */
+  bool draining{false};
+  time_t last_drain_sweep{0};
   std::atomic<bool> is_running{};
-  std::unordered_map<int, HttpStream *> cl_streams_set;
-  std::unordered_map<int, HttpStream *> bck_streams_set;
+  /** HttpStream storage, reused across the worker connections. */
+  ObjectPool<HttpStream> stream_pool;
+  /** Streams indexed by client, backend and timer fd. */
+  FdTable<HttpStream> cl_streams_set;
+  FdTable<HttpStream> bck_streams_set;
 #if USE_TIMER_FD_TIMEOUT
-  std::unordered_map<int, HttpStream *> timers_set;
+  FdTable<HttpStream> timers_set;
 #endif
+  /** Idle keep-alive backend connections shared by the worker streams. */
+  BackendConnectionPool backend_pool;
+  /** Requests dispatched to a backend, for the debug statistics. */
+  std::atomic<uint64_t> request_count{0};
+  /** Relay the large plain HTTP bodies with splice(), see setZeroCopy(). */
+  bool zero_copy{false};
+  /** Client handshakes run in the HandshakePool, see setHandshakeOffload(). */
+  std::unique_ptr<ssl::HandshakeOffload> handshake_offload{nullptr};
   void HandleEvent(int fd, EVENT_TYPE event_type,
                    EVENT_GROUP event_group) override;
   void doWork();
+  /**
+   * @brief Switches the worker to the snapshot published by
+   * reloadListeners(), from the worker thread.
+   *
+   * The listening sockets whose address and port are still in use are kept
+   * and handed over to the new ServiceManager, so no pending connection is
+   * lost. The ones no longer configured accept what is already queued with
+   * the old configuration and are closed, and the new ones are opened.
+   */
+  void applyListeners();
+  /**
+   * @brief Closes the listening sockets and the client connections without a
+   * request in flight, from the worker thread, once drainListeners() was
+   * called.
+   *
+   * The sockets already belong to the upgraded process too, so it keeps
+   * serving what is queued on them. The responses relayed meanwhile carry a
+   * "Connection: close" header, and every client found idle, see
+   * isClientIdle(), is closed and reconnects to the new process.
+   */
+  void applyDrain();
+  /**
+   * @brief Checks if the client of @p stream can be closed without losing a
+   * request.
+   *
+   * It is idle if it has no request or response in flight, no TLS handshake
+   * running and nothing received not read yet, whether it was never used,
+   * its backend connection is kept or it was handed to the pool.
+   */
+  bool isClientIdle(HttpStream *stream);
+  /**
+   * @brief Hands the backend connection of @p stream over to the
+   * BackendConnectionPool.
+   *
+   * Only plain HTTP connections whose last response was completely relayed
+   * and allows keep-alive are pooled.
+   *
+   * @param stream owning the backend connection.
+   * @return @c true if the connection was pooled, it is detached from the
+   * stream. If @c false the caller must close it as usual.
+   */
+  inline bool releaseBackendConnection(HttpStream *stream);
+  /**
+   * @brief Cancels the idle timeout of @p fd once it leaves the
+   * BackendConnectionPool.
+   */
+  inline void onBackendConnectionCheckout(int fd);
+  /**
+   * @brief Gives the drained I/O buffers of @p stream back to the
+   * BufferPool once a response has been completely relayed.
+   *
+   * The client buffer is kept if the client already sent more data.
+   *
+   * @param stream whose exchange has finished.
+   */
+  inline void releaseBuffers(HttpStream *stream);
+  /**
+   * @brief Moves @p stream to the ServiceManager of the current snapshot
+   * once its listener was reloaded.
+   *
+   * Only done between two exchanges, the backend connection opened with the
+   * retired snapshot is closed and the next request is routed with the
+   * reloaded services. A stream whose listener was removed keeps the retired
+   * ServiceManager until it is closed.
+   *
+   * @param stream about to read a request.
+   */
+  void refreshServiceManager(HttpStream *stream);
+#if ENABLE_ZERO_COPY
+  /**
+   * @brief Decides if the rest of the body of @p data, received from @p src,
+   * is spliced and takes the pipe for it.
+   *
+   * It must be called once the headers are validated and rewritten, only the
+   * body bypasses the buffers. Bodies that must be read or modified, those of
+   * pinned or cached connections, the short known length ones and those of
+   * HTTPS connections without kTLS offload keep the buffered path.
+   *
+   * @param stream owning the message.
+   * @param src is the connection the body is received from.
+   * @param data is the request or the response of @p stream.
+   */
+  void setupSplice(HttpStream *stream, Connection &src,
+                   http_parser::HttpData &data);
+  /**
+   * @brief Relays the body of @p data from @p src to @p dst through the pipe
+   * of @p src, until it would block or the body ends.
+   *
+   * A known length body is relayed by count, a chunked one is followed by its
+   * ChunkedParser, which only sees the framing. Once the body ends the
+   * message is finished as in the buffered path.
+   */
+  void spliceBody(HttpStream *stream, Connection &src, Connection &dst,
+                  http_parser::HttpData &data);
+#endif
 
 public:
-  StreamManager();
+  explicit StreamManager(EVENT_ENGINE engine = EVENT_ENGINE::EPOLL);
   StreamManager(const StreamManager &) = delete;
   ~StreamManager() final;
 
@@ -173,6 +305,9 @@ public:
    */
   int getWorkerId();
 
+  /** @brief Returns the number of requests dispatched to a backend. */
+  inline uint64_t getRequestCount() const { return request_count; }
+
   /**
    * @brief Initialize the StreamManager.
    *
@@ -180,19 +315,103 @@ public:
    * @p listener_config. If the listener_config is a HTTPS one, the
    * StreamManager initializes ssl::SSLConnectionManager too.
    *
+   * An upgraded process accepts on the socket inherited from the previous
+   * binary for the same address and port, if there is one left, instead of
+   * binding a new one.
+   *
    * @param listener_config from the configuration file.
+   * @param adopt_inherited accepts on every inherited socket left for the
+   * listener too.
+   * @param listen_fd is the socket already opened for the listener, -1 to
+   * open it.
    * @returns @c true if everything is fine.
    */
-  bool registerListener(std::weak_ptr<ServiceManager> service_manager);
+  bool registerListener(std::weak_ptr<ServiceManager> service_manager,
+                        bool adopt_inherited = false, int listen_fd = -1);
+
+  /**
+   * @brief Returns the listening sockets of the worker with their
+   * SocketHandoff key, to hand them over to an upgraded process.
+   */
+  std::vector<std::pair<int, std::string>> getListeners();
+
+  /**
+   * @brief Makes the worker stop accepting and drain its connections.
+   *
+   * It can be called from any thread, see applyDrain().
+   */
+  void drainListeners();
+
+  /** @brief Returns the number of streams of the worker, from any thread. */
+  size_t streamCount() const { return stream_pool.inUse(); }
+
+  /**
+   * @brief Publishes a new configuration snapshot to the worker.
+   *
+   * It can be called from any thread, the worker switches to it at the end of
+   * its current event loop iteration, see applyListeners(). The established
+   * connections keep using the ServiceManager they were accepted with until
+   * they are closed.
+   *
+   * @param service_managers is the new ServiceManager set keyed by listener
+   * id.
+   * @param listen_fds are the sockets opened for the listeners not served
+   * yet, keyed by their SocketHandoff key. The reuseport groups index the
+   * sockets in the order they are opened, so they are opened for each
+   * worker in turn and not by the workers themselves.
+   */
+  void reloadListeners(
+      std::map<int, std::shared_ptr<ServiceManager>> service_managers,
+      std::map<std::string, int> listen_fds = {});
 
   /**
    * @brief Starts the StreamManager event manager.
    *
-   * Sets the thread name to WORKER_"{worker_id}" and call doWork().
+   * Sets the thread name to WORKER_"{worker_id}" and call doWork(). Each
+   * worker owns a SO_REUSEPORT socket per listener, if @p cpu is set the
+   * worker thread is pinned to it and, with @p cpu_steering, a reuseport
+   * program delivers each connection to the worker of the CPU that received
+   * its packets. The worker index must match the CPU id for the steering to
+   * work.
    *
    * @param thread_id_ thread id to call functions on them.
+   * @param cpu to pin the worker thread to, -1 to not pin it.
+   * @param cpu_steering enables the reuseport CPU steering.
+   * @param adopt_inherited makes the worker accept on the listening sockets
+   * inherited on upgrade that the previous workers left, set it for the last
+   * worker.
+   */
+  void start(int thread_id_ = 0, int cpu = -1, bool cpu_steering = false,
+             bool adopt_inherited = false);
+
+  /**
+   * @brief Sets the limits of the keep-alive backend connection pool.
+   *
+   * Must be called before start().
+   *
+   * @param max_idle connections kept per backend, 0 disables the pool.
+   * @param idle_timeout in seconds before an idle connection is closed.
    */
-  void start(int thread_id_ = 0);
+  void setBackendPool(size_t max_idle, int idle_timeout);
+
+  /**
+   * @brief Enables the splice() relay of the large plain HTTP bodies.
+   *
+   * It has no effect if zproxy was built without ENABLE_ZERO_COPY. Must be
+   * called before start().
+   */
+  void setZeroCopy(bool enable);
+
+  /**
+   * @brief Makes the worker run the steps of the client TLS handshakes in
+   * the ssl::HandshakePool, which must be started, instead of its event loop.
+   *
+   * Must be called before start().
+   *
+   * @return @c false if the eventfd the pool wakes the worker up with can not
+   * be created, the handshakes are then run by the worker.
+   */
+  bool setHandshakeOffload(bool enable);
 
   /**
    * @brief Stops the StreamManager event manager.
@@ -225,6 +444,23 @@ public:
    */
   inline void onRequestEvent(int fd);
 
+  /**
+   * @brief Goes on with the client connection of @p stream after a step of
+   * its TLS handshake.
+   *
+   * Once the handshake is done the request is read, a plain HTTP client is
+   * redirected or replied an error, as NoHTTPS sets.
+   *
+   * @param result returned by ssl::SSLConnectionManager::handleHandshake().
+   */
+  void onClientHandshake(HttpStream *stream, bool result);
+
+  /**
+   * @brief Takes the client handshake steps the ssl::HandshakePool finished
+   * back, when it wakes the worker up.
+   */
+  void onHandshakeDone();
+
   /**
    * @brief Handles the connect timeout event.
    *
@@ -0,0 +1,224 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "header_matcher.h"
+#include <atomic>
+#include <cctype>
+#include <cstring>
+
+#define HEADER_MATCHER_FLAGS (REG_ICASE | REG_NEWLINE | REG_EXTENDED)
+
+/** Header name whose anchored literals matched, or not, by matcher. */
+struct HeaderMatcherMemo {
+  uint64_t matcher_id;
+  uint8_t name_len;
+  char name[HEADER_MATCHER_MEMO_NAME];
+  bool matched;
+};
+
+static inline unsigned char foldCase(char c) {
+  return static_cast<unsigned char>(c >= 'A' && c <= 'Z' ? c | 0x20 : c);
+}
+
+HeaderMatcher::HeaderMatcher() {
+  static std::atomic<uint64_t> next_id{1};
+  id = next_id++;
+  transitions.assign(class_count, 0);
+  depth.assign(1, 0);
+  flags.assign(1, 0);
+}
+
+bool HeaderMatcher::parseLiteral(const std::string &pattern,
+                                 Literal &literal) {
+  size_t begin = 0, end = pattern.size();
+  literal.anchored = end > 0 && pattern[0] == '^';
+  if (literal.anchored) begin = 1;
+  // a trailing ".*" matches anything
+  if (end - begin >= 3 && pattern.compare(end - 3, 3, ".*$") == 0) end -= 3;
+  while (end - begin >= 2 && pattern.compare(end - 2, 2, ".*") == 0) end -= 2;
+  literal.text.clear();
+  for (size_t i = begin; i < end; i++) {
+    char c = pattern[i];
+    if (c == '\\') {
+      // \d, \s, \1 and alike are not literals
+      if (++i == end || std::isalnum(static_cast<unsigned char>(pattern[i])))
+        return false;
+      c = pattern[i];
+    } else if (std::strchr("^$.[]|()?*+{}", c) != nullptr) {
+      return false;
+    }
+    literal.text += static_cast<char>(foldCase(c));
+  }
+  return !literal.text.empty();
+}
+
+void HeaderMatcher::buildAutomaton() {
+  byte_class.fill(0);
+  class_count = 1;
+  for (auto &literal : literals)
+    for (unsigned char c : literal.text)
+      if (byte_class[c] == 0) byte_class[c] = class_count++;
+  for (int c = 'A'; c <= 'Z'; c++) byte_class[c] = byte_class[c | 0x20];
+
+  // the trie of the literals, 0 is the root and a missing child
+  transitions.assign(class_count, 0);
+  depth.assign(1, 0);
+  flags.assign(1, 0);
+  has_name_literals = has_line_literals = false;
+  for (auto &literal : literals) {
+    uint32_t node = 0;
+    for (unsigned char c : literal.text) {
+      size_t index = node * class_count + byte_class[c];
+      if (transitions[index] == 0) {
+        transitions[index] = static_cast<uint32_t>(depth.size());
+        transitions.resize(transitions.size() + class_count, 0);
+        depth.push_back(depth[node] + 1);
+        flags.push_back(0);
+      }
+      node = transitions[index];
+    }
+    auto colon = literal.text.find(':');
+    if (!literal.anchored) {
+      flags[node] |= FLOATING_END;
+      has_line_literals = true;
+    } else if (colon == std::string::npos || colon == literal.text.size() - 1) {
+      flags[node] |= NAME_END;
+      has_name_literals = true;
+    } else {
+      flags[node] |= LINE_END;
+      has_line_literals = true;
+    }
+  }
+
+  // breadth first, the missing children are taken from the failure node
+  std::vector<uint32_t> fail(depth.size(), 0);
+  std::vector<uint32_t> queue;
+  for (int k = 0; k < class_count; k++)
+    if (transitions[k] != 0) queue.push_back(transitions[k]);
+  for (size_t q = 0; q < queue.size(); q++) {
+    auto node = queue[q];
+    flags[node] |= flags[fail[node]] & FLOATING_END;
+    for (int k = 0; k < class_count; k++) {
+      size_t index = node * class_count + k;
+      auto fail_next = transitions[fail[node] * class_count + k];
+      if (transitions[index] != 0) {
+        fail[transitions[index]] = fail_next;
+        queue.push_back(transitions[index]);
+      } else {
+        transitions[index] = fail_next;
+      }
+    }
+  }
+}
+
+bool HeaderMatcher::buildExpressions() {
+  std::string alternation;
+  separate.clear();
+  for (auto &expression : expressions) {
+    bool back_reference = false;
+    for (size_t i = 0; i + 1 < expression.size(); i++) {
+      if (expression[i] != '\\') continue;
+      char c = expression[++i];
+      if ((c >= '1' && c <= '9') || c == 'g' || c == 'k') back_reference = true;
+    }
+    // the group numbers would change in the alternation
+    if (back_reference) {
+      separate.push_back(std::make_unique<RegexPattern>());
+      if (!separate.back()->compile(expression.c_str(), HEADER_MATCHER_FLAGS))
+        return false;
+      continue;
+    }
+    if (!alternation.empty()) alternation += '|';
+    alternation += "(?:" + expression + ")";
+  }
+  if (alternation.empty()) return true;
+  return combined.compile(alternation.c_str(), HEADER_MATCHER_FLAGS);
+}
+
+bool HeaderMatcher::add(const std::string &pattern) {
+  Literal literal;
+  if (parseLiteral(pattern, literal)) {
+    literals.push_back(literal);
+    buildAutomaton();
+    return true;
+  }
+  RegexPattern expression;
+  if (!expression.compile(pattern.c_str(), HEADER_MATCHER_FLAGS)) return false;
+  expressions.push_back(pattern);
+  return buildExpressions();
+}
+
+bool HeaderMatcher::matchesName(const char *line, size_t name_len) const {
+  uint32_t node = 0;
+  // up to the colon that follows the name
+  for (size_t i = 0; i <= name_len; i++) {
+    node = transitions[node * class_count +
+                       byte_class[static_cast<unsigned char>(line[i])]];
+    if (depth[node] != i + 1) return false;
+    if ((flags[node] & NAME_END) != 0) return true;
+  }
+  return false;
+}
+
+bool HeaderMatcher::matchesLine(const char *line, size_t length) const {
+  uint32_t node = 0;
+  for (size_t i = 0; i < length; i++) {
+    node = transitions[node * class_count +
+                       byte_class[static_cast<unsigned char>(line[i])]];
+    if ((flags[node] & FLOATING_END) != 0 ||
+        ((flags[node] & LINE_END) != 0 && depth[node] == i + 1))
+      return true;
+  }
+  return false;
+}
+
+bool HeaderMatcher::matches(const char *line, size_t length,
+                            size_t name_len) const {
+  if (has_name_literals && name_len < length) {
+    if (name_len <= HEADER_MATCHER_MEMO_NAME) {
+      static thread_local std::array<HeaderMatcherMemo, HEADER_MATCHER_MEMO_SIZE>
+          memo;
+      uint64_t hash = id * 0x9e3779b97f4a7c15ULL;
+      for (size_t i = 0; i < name_len; i++)
+        hash = (hash ^ foldCase(line[i])) * 0x100000001b3ULL;
+      auto &entry = memo[hash & (HEADER_MATCHER_MEMO_SIZE - 1)];
+      bool found = entry.matcher_id == id && entry.name_len == name_len;
+      for (size_t i = 0; found && i < name_len; i++)
+        found = static_cast<unsigned char>(entry.name[i]) == foldCase(line[i]);
+      if (!found) {
+        entry.matcher_id = id;
+        entry.name_len = static_cast<uint8_t>(name_len);
+        for (size_t i = 0; i < name_len; i++)
+          entry.name[i] = static_cast<char>(foldCase(line[i]));
+        entry.matched = matchesName(line, name_len);
+      }
+      if (entry.matched) return true;
+    } else if (matchesName(line, name_len)) {
+      return true;
+    }
+  }
+  if (has_line_literals && matchesLine(line, length)) return true;
+  auto subject = std::string_view(line, length);
+  if (combined.isCompiled() && combined.match(subject)) return true;
+  for (auto &expression : separate)
+    if (expression->match(subject)) return true;
+  return false;
+}
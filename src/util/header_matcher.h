@@ -0,0 +1,102 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "regex_pattern.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** Header names remembered by each thread, a power of two. */
+#define HEADER_MATCHER_MEMO_SIZE 256
+/** Longest header name remembered. */
+#define HEADER_MATCHER_MEMO_NAME 48
+
+/**
+ * @class HeaderMatcher header_matcher.h "src/util/header_matcher.h"
+ * @brief All the HeadRemove or RemoveResponseHead patterns of a listener,
+ * matched in a single pass over each header line.
+ *
+ * The literal patterns, as "^X-Forwarded-For:" or "X-Powered-By", are merged
+ * into one Aho-Corasick automaton, the others into a single alternation run
+ * by the JIT. The literals anchored at the line start only depend on the
+ * header name, so their result is remembered per thread by name.
+ */
+class HeaderMatcher {
+  /** The node ends an anchored literal within the name and its colon. */
+  static constexpr uint8_t NAME_END = 0x1;
+  /** The node ends an anchored literal reaching into the value. */
+  static constexpr uint8_t LINE_END = 0x2;
+  /** The node, or one of its suffixes, ends an unanchored literal. */
+  static constexpr uint8_t FLOATING_END = 0x4;
+
+  struct Literal {
+    std::string text;
+    bool anchored;
+  };
+
+  /** Tells the memo entries of the different matchers apart. */
+  uint64_t id;
+  std::vector<Literal> literals;
+  std::vector<std::string> expressions;
+  /** Byte, case folded, to automaton input class, 0 for the unused ones. */
+  std::array<uint16_t, 256> byte_class{};
+  int class_count{1};
+  /** Next node of each node and input class. */
+  std::vector<uint32_t> transitions;
+  std::vector<uint32_t> depth;
+  std::vector<uint8_t> flags;
+  bool has_name_literals{false};
+  bool has_line_literals{false};
+  RegexPattern combined;
+  /** Patterns with back references, which can not be combined. */
+  std::vector<std::unique_ptr<RegexPattern>> separate;
+
+  static bool parseLiteral(const std::string &pattern, Literal &literal);
+  void buildAutomaton();
+  bool buildExpressions();
+  bool matchesName(const char *line, size_t name_len) const;
+  bool matchesLine(const char *line, size_t length) const;
+
+ public:
+  HeaderMatcher();
+  HeaderMatcher(const HeaderMatcher &) = delete;
+  HeaderMatcher &operator=(const HeaderMatcher &) = delete;
+
+  /**
+   * @brief Adds @p pattern, compiled with REG_ICASE and REG_NEWLINE as
+   * regcomp() does.
+   *
+   * @return @c false if the pattern is not valid.
+   */
+  bool add(const std::string &pattern);
+
+  /** @brief Whether there are no patterns. */
+  bool empty() const { return literals.empty() && expressions.empty(); }
+
+  /**
+   * @brief Whether any pattern matches the header line @p line of @p length
+   * bytes, without the CRLF, whose name takes the first @p name_len ones.
+   */
+  bool matches(const char *line, size_t length, size_t name_len) const;
+};
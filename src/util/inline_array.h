@@ -0,0 +1,72 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @class InlineArray inline_array.h "src/util/inline_array.h"
+ * @brief Fixed capacity array of trivial elements stored inline, with a heap
+ * spill for the uncommon case that needs more room.
+ *
+ * It is meant for per message tables, like the parsed headers, that are
+ * small almost always but have a large upper bound: the common case stays in
+ * a few cache lines of the owner object and only the messages that need it
+ * pay for the allocation, once, as the spill is kept for reuse. The elements
+ * are contiguous in either case, so data() can be handed to C APIs.
+ *
+ * @tparam T is the element type, it must be trivially copyable.
+ * @tparam INLINE_SIZE is the number of elements stored inline.
+ */
+template <typename T, size_t INLINE_SIZE>
+class InlineArray {
+  T inline_data[INLINE_SIZE];
+  std::vector<T> spill;
+
+ public:
+  inline T *data() { return spill.empty() ? inline_data : spill.data(); }
+  inline const T *data() const {
+    return spill.empty() ? inline_data : spill.data();
+  }
+  inline T &operator[](size_t pos) { return data()[pos]; }
+  inline const T &operator[](size_t pos) const { return data()[pos]; }
+
+  /** @brief Returns the number of elements that fit without reserving. */
+  inline size_t capacity() const {
+    return spill.empty() ? INLINE_SIZE : spill.size();
+  }
+
+  /**
+   * @brief Makes room for at least @p size elements, keeping the current
+   * ones.
+   */
+  void reserve(size_t size) {
+    if (size <= capacity()) return;
+    if (spill.empty()) {
+      spill.resize(size);
+      std::copy(inline_data, inline_data + INLINE_SIZE, spill.begin());
+    } else {
+      spill.resize(size);
+    }
+  }
+};
@@ -22,6 +22,7 @@
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <linux/filter.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
@@ -292,6 +293,27 @@ class Network {
            -1;
   }
 
+  /**
+   * @brief Attaches a classic BPF program to the SO_REUSEPORT group of
+   * @p sock_fd that selects the socket with the same index as the CPU handling
+   * the incoming packet. If the index is out of the group the kernel falls
+   * back to the default hash.
+   */
+  inline static bool setReusePortCpuSteering(int sock_fd) {
+    sock_filter code[] = {
+        /* A = id of the cpu processing the packet */
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0,
+         static_cast<__u32>(SKF_AD_OFF + SKF_AD_CPU)},
+        /* return A, index of the socket in the reuseport group */
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    sock_fprog prog{};
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+    return setsockopt(sock_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+                      sizeof(prog)) != -1;
+  }
+
   inline static bool setTcpNoDelayOption(int sock_fd) {
     int flag = 1;
     return setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) != -1;
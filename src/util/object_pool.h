@@ -0,0 +1,129 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <sys/mman.h>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * @class ObjectPool object_pool.h "src/util/object_pool.h"
+ * @brief Slab allocator for large, frequently created objects.
+ *
+ * The storage is mmapped in slabs of SLAB_OBJECTS slots, outside the malloc
+ * arenas, and the released slots are kept in a LIFO free list so the next
+ * acquire() reuses the most recently used, cache hot, slot. Objects are
+ * constructed in place on acquire() and destroyed on release(); as long as
+ * the constructor does not touch the large members (e.g. the I/O buffers)
+ * that is as cheap as a reset and no state leaks between uses. The pool
+ * keeps its peak size until it is destroyed. It is not thread safe, each
+ * worker owns its own pool, only the statistics can be read from other
+ * threads.
+ *
+ * @tparam T is the object type.
+ * @tparam SLAB_OBJECTS is the number of slots allocated at once.
+ */
+template <typename T, size_t SLAB_OBJECTS = 16>
+class ObjectPool {
+  union Slot {
+    Slot *next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+  std::vector<void *> slabs;
+  Slot *free_list{nullptr};
+  size_t capacity{0};
+  std::atomic<size_t> used{0};
+
+  bool grow() {
+    void *slab = ::mmap(nullptr, sizeof(Slot) * SLAB_OBJECTS,
+                        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                        -1, 0);
+    if (slab == MAP_FAILED) return false;
+    slabs.push_back(slab);
+    auto slots = static_cast<Slot *>(slab);
+    for (size_t i = SLAB_OBJECTS; i > 0; i--) {
+      slots[i - 1].next = free_list;
+      free_list = &slots[i - 1];
+    }
+    capacity += SLAB_OBJECTS;
+    total_slots += SLAB_OBJECTS;
+    return true;
+  }
+
+ public:
+  /** Slots allocated by all the pools of type T. */
+  static std::atomic<int> total_slots;
+  /** Objects in use from all the pools of type T. */
+  static std::atomic<int> used_slots;
+
+  ObjectPool() = default;
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool &operator=(const ObjectPool &) = delete;
+  /** All the objects must have been released. */
+  ~ObjectPool() {
+    for (auto slab : slabs) ::munmap(slab, sizeof(Slot) * SLAB_OBJECTS);
+    total_slots -= static_cast<int>(capacity);
+    used_slots -= static_cast<int>(used.load());
+  }
+
+  /**
+   * @brief Constructs a T in a free slot.
+   *
+   * @param args are forwarded to the T constructor.
+   * @return the new object or @c nullptr if a new slab could not be mapped.
+   */
+  template <typename... Args>
+  T *acquire(Args &&... args) {
+    if (free_list == nullptr && !grow()) return nullptr;
+    Slot *slot = free_list;
+    free_list = slot->next;
+    T *object = new (slot->storage) T(std::forward<Args>(args)...);
+    used.fetch_add(1, std::memory_order_relaxed);
+    used_slots++;
+    return object;
+  }
+
+  /** @brief Destroys @p object and returns its slot to the free list. */
+  void release(T *object) {
+    if (object == nullptr) return;
+    object->~T();
+    auto slot = reinterpret_cast<Slot *>(object);
+    slot->next = free_list;
+    free_list = slot;
+    used.fetch_sub(1, std::memory_order_relaxed);
+    used_slots--;
+  }
+
+  /** @brief Returns the number of slots allocated by this pool. */
+  size_t size() const { return capacity; }
+
+  /** @brief Returns the number of objects in use from this pool, from any
+   * thread. */
+  size_t inUse() const { return used.load(std::memory_order_relaxed); }
+};
+
+template <typename T, size_t SLAB_OBJECTS>
+std::atomic<int> ObjectPool<T, SLAB_OBJECTS>::total_slots(0);
+
+template <typename T, size_t SLAB_OBJECTS>
+std::atomic<int> ObjectPool<T, SLAB_OBJECTS>::used_slots(0);
@@ -0,0 +1,164 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+namespace helper {
+
+/**
+ * @class PerfectHash perfect_hash.h "src/util/perfect_hash.h"
+ * @brief Fixed set of names, as the header names or the methods, looked up
+ * without collisions, comparisons or allocations.
+ *
+ * The table is built by the compiler when the object is constexpr: the seed
+ * of the hash is searched until each name gets a slot of its own, and a set
+ * of names that can not be told apart does not compile. A lookup hashes the
+ * length and the first and last eight bytes, then compares the only
+ * candidate eight bytes at a time, folding the case of the letters with a
+ * mask when @p CASE_INSENSITIVE.
+ */
+template <typename T, size_t N, bool CASE_INSENSITIVE = true>
+class PerfectHash {
+ public:
+  struct Entry {
+    std::string_view name;
+    T value;
+  };
+
+  /** Longest name, in eight byte words. */
+  static constexpr size_t WORDS = 6;
+
+ private:
+  /** At least eight slots per name, a power of two. */
+  static constexpr size_t slotCount() {
+    size_t slot_count = 8;
+    while (slot_count < 8 * N) slot_count *= 2;
+    return slot_count;
+  }
+  static constexpr size_t SLOTS = slotCount();
+  static constexpr uint64_t FOLD = CASE_INSENSITIVE ? 0x2020202020202020ULL : 0;
+  static_assert(N < 255, "the slots hold the name index in a byte");
+
+  std::array<T, N> values{};
+  std::array<size_t, N> lengths{};
+  /** Names, lower case if CASE_INSENSITIVE, as little endian words. */
+  std::array<std::array<uint64_t, WORDS>, N> keys{};
+  /** 0x20 in the bytes of the letters, which match in any case. */
+  std::array<std::array<uint64_t, WORDS>, N> case_masks{};
+  /** Name index plus one, 0 for the empty slots. */
+  std::array<uint8_t, SLOTS> slots{};
+  uint64_t seed{0};
+
+  /** The @p length bytes, at most 8, at @p data as a little endian word. */
+  template <bool RUNTIME>
+  static constexpr uint64_t loadWord(const char *data, size_t length) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if constexpr (RUNTIME) {
+      if (length >= 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data, sizeof(word));
+        return word;
+      }
+    }
+#endif
+    uint64_t word = 0;
+    for (size_t i = 0; i < length && i < 8; i++)
+      word |= static_cast<uint64_t>(static_cast<unsigned char>(data[i]))
+              << (8 * i);
+    return word;
+  }
+
+  template <bool RUNTIME>
+  static constexpr size_t slot(const char *data, size_t length,
+                               uint64_t hash_seed) {
+    size_t tail = length < 8 ? length : 8;
+    uint64_t hash =
+        ((loadWord<RUNTIME>(data, length) | FOLD) * 0x9e3779b97f4a7c15ULL) ^
+        ((loadWord<RUNTIME>(data + length - tail, tail) | FOLD) *
+         0xc2b2ae3d27d4eb4fULL) ^
+        ((length + hash_seed) * 0x165667b19e3779f9ULL);
+    hash ^= hash >> 32;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 29;
+    return static_cast<size_t>(hash & (SLOTS - 1));
+  }
+
+ public:
+  constexpr explicit PerfectHash(const Entry (&entries)[N]) {
+    for (size_t i = 0; i < N; i++) {
+      auto name = entries[i].name;
+      if (name.size() > WORDS * 8) throw std::length_error("name too long");
+      values[i] = entries[i].value;
+      lengths[i] = name.size();
+      for (size_t k = 0; k < name.size(); k++) {
+        auto c = static_cast<unsigned char>(name[k]);
+        uint64_t case_mask =
+            CASE_INSENSITIVE && (c | 0x20) >= 'a' && (c | 0x20) <= 'z' ? 0x20
+                                                                       : 0;
+        keys[i][k / 8] |= (c | case_mask) << (8 * (k % 8));
+        case_masks[i][k / 8] |= case_mask << (8 * (k % 8));
+      }
+    }
+    for (;; seed++) {
+      if (seed == 0x10000) throw std::logic_error("duplicated names");
+      for (auto &index : slots) index = 0;
+      bool collision = false;
+      for (size_t i = 0; i < N && !collision; i++) {
+        auto &index =
+            slots[slot<false>(entries[i].name.data(), lengths[i], seed)];
+        collision = index != 0;
+        index = static_cast<uint8_t>(i + 1);
+      }
+      if (!collision) break;
+    }
+  }
+
+  /** @brief Returns the value of @p name, or nullptr if it is not known. */
+  const T *find(std::string_view name) const {
+    auto length = name.size();
+    if (length > WORDS * 8) return nullptr;
+    auto index = slots[slot<true>(name.data(), length, seed)];
+    if (index == 0 || lengths[index - 1] != length) return nullptr;
+    auto &key = keys[index - 1];
+    auto &case_mask = case_masks[index - 1];
+    for (size_t k = 0; k * 8 < length; k++) {
+      size_t left = length - k * 8;
+      uint64_t word;
+      if (left >= 8)
+        word = loadWord<true>(name.data() + k * 8, 8);
+      else if (length >= 8)
+        // the last bytes, without reading past the name
+        word = loadWord<true>(name.data() + length - 8, 8) >> (8 * (8 - left));
+      else
+        word = loadWord<true>(name.data(), left);
+      if ((word | case_mask[k]) != key[k]) return nullptr;
+    }
+    return &values[index - 1];
+  }
+};
+
+}  // namespace helper
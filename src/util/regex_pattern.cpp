@@ -0,0 +1,120 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "regex_pattern.h"
+#include "../debug/logger.h"
+
+/** Match data and JIT stack of a thread, reused by all its matches. */
+struct RegexMatchContext {
+  pcre2_match_data *match_data;
+  pcre2_match_context *match_context;
+  pcre2_jit_stack *jit_stack;
+
+  RegexMatchContext()
+      : match_data(pcre2_match_data_create(REGEX_MAX_CAPTURES, nullptr)),
+        match_context(pcre2_match_context_create(nullptr)),
+        jit_stack(pcre2_jit_stack_create(32 * 1024, REGEX_JIT_STACK_MAX,
+                                         nullptr)) {
+    if (match_context != nullptr && jit_stack != nullptr)
+      pcre2_jit_stack_assign(match_context, nullptr, jit_stack);
+  }
+
+  ~RegexMatchContext() {
+    if (match_data != nullptr) pcre2_match_data_free(match_data);
+    if (match_context != nullptr) pcre2_match_context_free(match_context);
+    if (jit_stack != nullptr) pcre2_jit_stack_free(jit_stack);
+  }
+};
+
+static RegexMatchContext &threadMatchContext() {
+  static thread_local RegexMatchContext match_context;
+  return match_context;
+}
+
+RegexPattern::~RegexPattern() {
+  if (code != nullptr) pcre2_code_free(code);
+}
+
+bool RegexPattern::compile(const char *pattern, int flags) {
+  if (code != nullptr) {
+    pcre2_code_free(code);
+    code = nullptr;
+    jit = false;
+  }
+  // the options pcreposix sets for each flag
+  uint32_t options = 0;
+  if ((flags & REG_ICASE) != 0) options |= PCRE2_CASELESS;
+  if ((flags & REG_NEWLINE) != 0) options |= PCRE2_MULTILINE;
+  if ((flags & REG_NOSUB) != 0) options |= PCRE2_NO_AUTO_CAPTURE;
+#ifdef REG_DOTALL
+  if ((flags & REG_DOTALL) != 0) options |= PCRE2_DOTALL;
+#endif
+#ifdef REG_UTF8
+  if ((flags & REG_UTF8) != 0) options |= PCRE2_UTF;
+#endif
+  int error_code;
+  PCRE2_SIZE error_offset;
+  code = pcre2_compile(reinterpret_cast<PCRE2_SPTR>(pattern),
+                       PCRE2_ZERO_TERMINATED, options, &error_code,
+                       &error_offset, nullptr);
+  if (code == nullptr) {
+    PCRE2_UCHAR message[256];
+    pcre2_get_error_message(error_code, message, sizeof(message));
+    Logger::logmsg(LOG_ERR, "Error compiling pattern %s at %zu: %s", pattern,
+                   static_cast<size_t>(error_offset),
+                   reinterpret_cast<char *>(message));
+    return false;
+  }
+  jit = pcre2_jit_compile(code, PCRE2_JIT_COMPLETE) == 0;
+  return true;
+}
+
+bool RegexPattern::match(std::string_view subject, size_t n_match,
+                         regmatch_t p_match[], int e_flags) const {
+  if (code == nullptr) return false;
+  auto &context = threadMatchContext();
+  if (context.match_data == nullptr) return false;
+  uint32_t options = 0;
+  if ((e_flags & REG_NOTBOL) != 0) options |= PCRE2_NOTBOL;
+  if ((e_flags & REG_NOTEOL) != 0) options |= PCRE2_NOTEOL;
+  auto subject_ptr = reinterpret_cast<PCRE2_SPTR>(subject.data());
+  // the JIT fast path does not take PCRE2_ZERO_TERMINATED
+  auto length = subject.size();
+  int result =
+      jit ? pcre2_jit_match(code, subject_ptr, length, 0, options,
+                            context.match_data, context.match_context)
+          : pcre2_match(code, subject_ptr, length, 0, options,
+                        context.match_data, context.match_context);
+  if (result < 0) return false;
+  // 0 means the groups did not fit, all the reported ones are set
+  size_t groups = result == 0 ? REGEX_MAX_CAPTURES : static_cast<size_t>(result);
+  auto ovector = pcre2_get_ovector_pointer(context.match_data);
+  for (size_t i = 0; i < n_match; i++) {
+    if (i < groups && ovector[2 * i] != PCRE2_UNSET) {
+      p_match[i].rm_so = static_cast<regoff_t>(ovector[2 * i]);
+      p_match[i].rm_eo = static_cast<regoff_t>(ovector[2 * i + 1]);
+    } else {
+      p_match[i].rm_so = -1;
+      p_match[i].rm_eo = -1;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,87 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#include <pcreposix.h>
+#include <cstddef>
+#include <string_view>
+
+/** Groups reported by a match at most, the whole match included. */
+#define REGEX_MAX_CAPTURES 32
+/** Largest JIT stack of a thread, in bytes. */
+#define REGEX_JIT_STACK_MAX (512 * 1024)
+
+/**
+ * @class RegexPattern regex_pattern.h "src/util/regex_pattern.h"
+ * @brief Configured pattern matched against the requests and responses,
+ * compiled once at config load with the PCRE2 JIT.
+ *
+ * It replaces the pcreposix regcomp() and regexec() pair, taking the same
+ * flags with the same meaning, so the patterns keep their behaviour without
+ * the translation of the POSIX wrapper on every match. The compiled pattern
+ * is shared read only, the match data and the JIT stack are per thread, so
+ * each worker reuses its own ones. When the JIT is not available the pattern
+ * is run by the PCRE2 interpreter.
+ */
+class RegexPattern {
+  pcre2_code *code{nullptr};
+  bool jit{false};
+
+ public:
+  RegexPattern() = default;
+  RegexPattern(const RegexPattern &) = delete;
+  RegexPattern &operator=(const RegexPattern &) = delete;
+  ~RegexPattern();
+
+  /**
+   * @brief Compiles @p pattern, replacing the previous one.
+   *
+   * @param flags are the regcomp() ones, REG_ICASE and REG_NEWLINE among
+   * them.
+   * @return @c false if the pattern is not valid.
+   */
+  bool compile(const char *pattern, int flags);
+
+  /** @brief Whether there is a compiled pattern. */
+  bool isCompiled() const { return code != nullptr; }
+
+  /** @brief Whether the pattern runs as JIT compiled machine code. */
+  bool isJit() const { return jit; }
+
+  /**
+   * @brief Matches the NUL terminated @p subject, as regexec().
+   *
+   * @param n_match is the size of @p p_match, filled with the offsets of the
+   * match and of its groups, -1 for the ones not matched.
+   * @param e_flags are the regexec() ones, REG_NOTBOL and REG_NOTEOL.
+   * @return @c true if the pattern matches.
+   */
+  bool match(const char *subject, size_t n_match = 0,
+             regmatch_t p_match[] = nullptr, int e_flags = 0) const {
+    return match(std::string_view(subject), n_match, p_match, e_flags);
+  }
+
+  /** @brief Matches @p subject, which needs no NUL terminator. */
+  bool match(std::string_view subject, size_t n_match = 0,
+             regmatch_t p_match[] = nullptr, int e_flags = 0) const;
+};
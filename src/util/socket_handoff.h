@@ -0,0 +1,259 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../debug/logger.h"
+
+/** Environment variable with the handoff socket of an upgraded process. */
+#define UPGRADE_SOCKET_ENV "ZPROXY_UPGRADE_FD"
+/** Seconds the running process waits for the upgraded one to be ready. */
+#define UPGRADE_READY_TIMEOUT 30
+/** Maximum length of the key sent along with each socket. */
+#define UPGRADE_KEY_SIZE 256
+
+extern char **environ;
+
+/**
+ * @class SocketHandoff socket_handoff.h "src/util/socket_handoff.h"
+ * @brief Passes the listening sockets to a new zproxy binary.
+ *
+ * The running process execs the binary with one end of a SOCK_SEQPACKET
+ * socket pair, whose number is exported in UPGRADE_SOCKET_ENV, and sends
+ * through it every listening socket with SCM_RIGHTS, one message each, keyed
+ * by the listener address and port. The new process collects them at startup
+ * and its workers accept on them instead of binding new ones, so the pending
+ * connections of the accept queues are not lost. Once its workers are running
+ * it answers with its pid, and the old process stops accepting and drains.
+ */
+class SocketHandoff {
+  inline static std::mutex inherited_mutex;
+  inline static std::multimap<std::string, int> inherited_fds;
+  inline static int upgrade_fd{-1};
+
+ public:
+  /** @brief Returns the key of the listening socket of @p address:@p port. */
+  static std::string listenerKey(const std::string &address, int port) {
+    return address + ":" + std::to_string(port);
+  }
+
+  /** @brief Sends @p fd and its @p key through @p channel_fd. */
+  static bool sendSocket(int channel_fd, int fd, const std::string &key) {
+    iovec iov{const_cast<char *>(key.data()), key.size()};
+    union {
+      cmsghdr align;
+      char buffer[CMSG_SPACE(sizeof(int))];
+    } control{};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    if (::sendmsg(channel_fd, &msg, MSG_NOSIGNAL) < 0) {
+      Logger::logmsg(LOG_ERR, "Could not hand over socket %s: %s", key.data(),
+                     std::strerror(errno));
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Receives a socket and its @p key from @p channel_fd.
+   *
+   * @return the socket, 0 once the sender is done or -1 on error. The socket
+   * never takes a standard stream number, those are closed on daemonize.
+   */
+  static int receiveSocket(int channel_fd, std::string &key) {
+    char key_buffer[UPGRADE_KEY_SIZE];
+    iovec iov{key_buffer, sizeof(key_buffer)};
+    union {
+      cmsghdr align;
+      char buffer[CMSG_SPACE(sizeof(int))];
+    } control{};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+    auto size = ::recvmsg(channel_fd, &msg, MSG_CMSG_CLOEXEC);
+    if (size <= 0) return size == 0 ? 0 : -1;
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET ||
+        cmsg->cmsg_type != SCM_RIGHTS)
+      return -1;
+    int fd;
+    std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    if (fd <= STDERR_FILENO) {
+      int moved_fd = ::fcntl(fd, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+      ::close(fd);
+      fd = moved_fd;
+    }
+    key.assign(key_buffer, static_cast<size_t>(size));
+    return fd;
+  }
+
+  /**
+   * @brief Execs @p binary with @p argv and the handoff socket.
+   *
+   * @param channel_fd is set to the end of the handoff socket kept by the
+   * running process.
+   * @return the pid of the new process or -1 on error.
+   */
+  static pid_t spawnUpgrade(const std::string &binary,
+                            const std::vector<std::string> &argv,
+                            int &channel_fd) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0)
+      return -1;
+    // inherited by the new binary, out of the standard streams range
+    int child_fd = ::fcntl(fds[1], F_DUPFD, STDERR_FILENO + 1);
+    ::close(fds[1]);
+    if (child_fd < 0) {
+      ::close(fds[0]);
+      return -1;
+    }
+    // everything is prepared before fork, the child of a threaded process
+    // can only exec
+    std::string env_entry =
+        std::string(UPGRADE_SOCKET_ENV "=") + std::to_string(child_fd);
+    std::vector<char *> args;
+    for (auto &arg : argv) args.push_back(const_cast<char *>(arg.data()));
+    args.push_back(nullptr);
+    std::vector<char *> envs;
+    for (auto env = environ; *env != nullptr; env++) {
+      if (std::strncmp(*env, UPGRADE_SOCKET_ENV "=",
+                       sizeof(UPGRADE_SOCKET_ENV)) != 0)
+        envs.push_back(*env);
+    }
+    envs.push_back(env_entry.data());
+    envs.push_back(nullptr);
+    pid_t pid = ::fork();
+    if (pid == 0) {
+      ::execve(binary.data(), args.data(), envs.data());
+      ::_exit(EXIT_FAILURE);
+    }
+    ::close(child_fd);
+    if (pid < 0) {
+      ::close(fds[0]);
+      return -1;
+    }
+    channel_fd = fds[0];
+    return pid;
+  }
+
+  /**
+   * @brief Waits until the upgraded process on @p channel_fd is ready.
+   *
+   * @return the pid of the upgraded process or -1 if it failed or did not
+   * answer in @p timeout seconds.
+   */
+  static pid_t waitReady(int channel_fd, int timeout) {
+    pollfd pfd{channel_fd, POLLIN, 0};
+    if (::poll(&pfd, 1, timeout * 1000) <= 0) return -1;
+    return readReady(channel_fd);
+  }
+
+  /**
+   * @brief Reads the answer of the upgraded process on @p channel_fd, once it
+   * is readable.
+   *
+   * @return the pid of the upgraded process or -1 if it exited without
+   * being ready.
+   */
+  static pid_t readReady(int channel_fd) {
+    pid_t pid;
+    if (::recv(channel_fd, &pid, sizeof(pid), MSG_DONTWAIT) != sizeof(pid))
+      return -1;
+    return pid;
+  }
+
+  /**
+   * @brief Collects the sockets of the previous binary, if this process is an
+   * upgrade.
+   *
+   * @return @c true if this process was started by an upgrade.
+   */
+  static bool receiveInherited() {
+    auto env = ::getenv(UPGRADE_SOCKET_ENV);
+    if (env == nullptr) return false;
+    upgrade_fd = std::atoi(env);
+    ::unsetenv(UPGRADE_SOCKET_ENV);
+    ::fcntl(upgrade_fd, F_SETFD, FD_CLOEXEC);
+    std::lock_guard<std::mutex> lock(inherited_mutex);
+    std::string key;
+    int fd;
+    while ((fd = receiveSocket(upgrade_fd, key)) > 0) inherited_fds.emplace(key, fd);
+    if (fd < 0)
+      Logger::logmsg(LOG_ERR, "Error receiving the upgrade sockets: %s",
+                     std::strerror(errno));
+    Logger::logmsg(LOG_NOTICE, "Upgrading, %lu sockets inherited",
+                   inherited_fds.size());
+    return true;
+  }
+
+  /**
+   * @brief Takes an inherited socket with @p key.
+   *
+   * @return the socket or -1 if there is none left.
+   */
+  static int takeInherited(const std::string &key) {
+    std::lock_guard<std::mutex> lock(inherited_mutex);
+    auto it = inherited_fds.find(key);
+    if (it == inherited_fds.end()) return -1;
+    int fd = it->second;
+    inherited_fds.erase(it);
+    return fd;
+  }
+
+  /** @brief Closes the inherited sockets not used by the new configuration. */
+  static void closeInherited() {
+    std::lock_guard<std::mutex> lock(inherited_mutex);
+    for (auto &[key, fd] : inherited_fds) {
+      Logger::logmsg(LOG_NOTICE, "Closing inherited socket %s", key.data());
+      ::close(fd);
+    }
+    inherited_fds.clear();
+  }
+
+  /** @brief Tells the previous binary that this process is serving. */
+  static void notifyReady() {
+    if (upgrade_fd < 0) return;
+    pid_t pid = ::getpid();
+    if (::send(upgrade_fd, &pid, sizeof(pid), MSG_NOSIGNAL) < 0)
+      Logger::logmsg(LOG_ERR, "Could not notify the upgrade: %s",
+                     std::strerror(errno));
+    ::close(upgrade_fd);
+    upgrade_fd = -1;
+  }
+};
@@ -5,6 +5,8 @@
 #pragma once
 
 #include <sys/time.h>
+#include <cstdint>
+#include <ctime>
 
 #define TV_TO_MS(x) (x.tv_sec * 1000.0 + x.tv_usec/1000.0)
 #define TV_TO_S(x) (x.tv_sec  + x.tv_usec/1000000.0);
@@ -32,6 +34,22 @@ struct Time {
     return (milliseconds - TV_TO_MS(start_point))/1000.0;
   }
 
+  /** @brief Returns the monotonic clock, in microseconds. */
+  inline static uint64_t getMonotonicUs() {
+    timespec now{};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 +
+           static_cast<uint64_t>(now.tv_nsec) / 1000;
+  }
+
+  /** @brief Returns the CPU time used by the calling thread, in microseconds. */
+  inline static uint64_t getThreadCpuUs() {
+    timespec now{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 +
+           static_cast<uint64_t>(now.tv_nsec) / 1000;
+  }
+
  private:
   inline static thread_local double milliseconds;
 };
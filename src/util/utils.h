@@ -29,6 +29,7 @@
 #include <string>
 #include <string_view>
 #include <thread>
+#include <vector>
 
 namespace IO {
 
@@ -152,6 +153,18 @@ struct ThreadHelper {
     return rc == 0;
   }
 
+  /** Returns the ids of the CPUs this process is allowed to run on. */
+  static std::vector<int> getAllowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &cpuset)) cpus.push_back(cpu);
+    }
+    return cpus;
+  }
+
   static bool setThreadName(std::string name, pthread_t native_handle) {
     int rc = pthread_setname_np(native_handle, name.c_str());
     return rc == 0;
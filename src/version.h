@@ -0,0 +1,53 @@
+/*
+*    Zevenet zproxy Load Balancer Software License
+*    This file is part of the Zevenet zproxy Load Balancer software package.
+*
+*    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU Affero General Public License as
+*    published by the Free Software Foundation, either version 3 of the
+*    License, or any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#pragma once
+#include <string>
+
+#define ZPROXY_VERSION_MAJOR 0
+#define ZPROXY_VERSION_MINOR 2
+#define ZPROXY_VERSION_PATCH 1
+#define ZPROXY_VERSION_TWEAK 0
+#define ZPROXY_VERSION "0.2.1-0"
+#define ZPROXY_GIT_REF "refs/heads/master"
+#define ZPROXY_SOURCE_VERSION "91fb41c417c2f527afa8fc66235dcbd86a5242b7"
+#define ZPROXY_BUILD_DATE "18 Oct 2026"
+#define ZPROXY_BUILD_TIME "05:24:35"
+#define ZPROXY_BUILD_INFO "GNU-12.2.0 Release  18 Oct 2026 05:24:35"
+#define ZPROXY_HOST_INFO "Linux 6.18.44-fc-v139 x86_64"
+#define ZPROXY_COPYRIGHT "Copyright (C) 2026 Zevenet"
+
+struct zproxyInfo{
+    static std::string version_major ()  { return  "0"; }
+    static std::string version_minor ()  { return  "2"; }
+    static std::string version_patch ()  { return  "1"; }
+    static std::string version_tweak ()  { return  "0"; }
+    static std::string version ()  { return  "0.2.1-0"; }
+    static std::string git_ref ()  { return  "refs/heads/master"; }
+    static std::string source_version ()  { return  "91fb41c417c2f527afa8fc66235dcbd86a5242b7"; }
+    static std::string build_date ()  { return  "18 Oct 2026"; }
+    static std::string build_time ()  { return  "05:24:35"; }
+    static std::string build_info ()  { return  "GNU-12.2.0 Release  18 Oct 2026 05:24:35"; }
+    static std::string host_info ()  { return  "Linux 6.18.44-fc-v139 x86_64"; }
+    static std::string copyright ()  { return  "Copyright (C) 2026 Zevenet"; }
+};
+
+
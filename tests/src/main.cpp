@@ -19,6 +19,10 @@
  *
  */
 #include "../../src/debug/logger.h"
+#include "t_backend_pool.h"
+#include "t_buffer_pool.h"
+#include "t_cert_cache.h"
+#include "t_client_session.h"
 #ifdef ENABLE_ON_FLY_COMRESSION
 #include "t_compression.h"
 #endif
@@ -26,11 +30,28 @@
 #include "t_control_manager.h"
 #include "t_crypto.h"
 #include "t_epoll_manager.h"
+#include "t_fd_table.h"
+#include "t_handshake_offload.h"
+#include "t_header_matcher.h"
+#include "t_io_uring.h"
 #include "t_http_parser.h"
+#include "t_http_scan.h"
 #include "t_json.h"
+#include "t_ktls.h"
+#include "t_object_pool.h"
 #include "t_observer.h"
+#include "t_perfect_hash.h"
+#include "t_regex_pattern.h"
+#include "t_reload.h"
+#include "t_service_index.h"
+#include "t_sni_index.h"
+#include "t_socket_handoff.h"
+#include "t_splice.h"
+#include "t_ssl_session.h"
 #include "t_sslcontext.h"
+#include "t_ticket_keys.h"
 #include "t_timerfd.h"
+#include "t_timer_wheel.h"
 #include "tst_basictest.h"
 #include "t_priority.h"
 
@@ -0,0 +1,147 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/connection/backend_pool.h"
+#include "../../src/handlers/http_manager.h"
+#include "gtest/gtest.h"
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <vector>
+
+static bool isOpenFd(int fd) { return ::fcntl(fd, F_GETFD) != -1; }
+
+TEST(BackendPoolTest, CheckoutReusesLastReturned) {
+  BackendConnectionPool pool;
+  Statistics::BackendInfo backend;
+  int first[2], second[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, first), 0);
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, second), 0);
+
+  /* Disabled by default. */
+  EXPECT_FALSE(pool.put(&backend, first[0], 100));
+  EXPECT_EQ(pool.get(&backend, 100), -1);
+
+  pool.max_idle = 1;
+  EXPECT_TRUE(pool.put(&backend, first[0], 100));
+  /* Full for this backend, the caller keeps the socket. */
+  EXPECT_FALSE(pool.put(&backend, second[0], 100));
+  EXPECT_EQ(backend.getIdleConn(), 1);
+  EXPECT_EQ(pool.get(&backend, 101), first[0]);
+  EXPECT_EQ(backend.getIdleConn(), 0);
+  EXPECT_EQ(backend.getReusedConn(), 1);
+  EXPECT_EQ(pool.get(&backend, 101), -1);
+
+  pool.max_idle = 2;
+  EXPECT_TRUE(pool.put(&backend, first[0], 100));
+  EXPECT_TRUE(pool.put(&backend, second[0], 101));
+  EXPECT_EQ(pool.get(&backend, 102), second[0]);
+  EXPECT_EQ(pool.size(), 1u);
+
+  /* Other backends do not share the connections. */
+  Statistics::BackendInfo other;
+  EXPECT_EQ(pool.get(&other, 102), -1);
+
+  int released = -1;
+  pool.clear([&released](int fd) { released = fd; });
+  EXPECT_EQ(released, first[0]);
+  EXPECT_FALSE(isOpenFd(first[0]));
+  EXPECT_EQ(backend.getIdleConn(), 0);
+  for (auto fd : {first[1], second[0], second[1]}) ::close(fd);
+}
+
+TEST(BackendPoolTest, DiscardsDeadAndExpiredConnections) {
+  BackendConnectionPool pool;
+  pool.max_idle = 4;
+  pool.idle_timeout = 5;
+  Statistics::BackendInfo backend;
+  int closed[2], dirty[2], stale[2], expired[2];
+  for (auto pair : {closed, dirty, stale, expired})
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair), 0);
+
+  /* The backend closed it while idle. */
+  ::close(closed[1]);
+  /* Unexpected data, out of sync with the HTTP exchange. */
+  ASSERT_EQ(::write(dirty[1], "x", 1), 1);
+  EXPECT_TRUE(pool.put(&backend, stale[0], 100));
+  EXPECT_TRUE(pool.put(&backend, dirty[0], 110));
+  EXPECT_TRUE(pool.put(&backend, closed[0], 110));
+  /* Only the stale one is alive, but it has been idle for too long. */
+  std::vector<int> released;
+  EXPECT_EQ(pool.get(&backend, 110,
+                     [&released](int fd) { released.push_back(fd); }),
+            -1);
+  /* Their idle timeouts are cancelled before the sockets are closed. */
+  EXPECT_EQ(released, std::vector<int>({closed[0], dirty[0], stale[0]}));
+  EXPECT_EQ(pool.size(), 0u);
+  EXPECT_EQ(backend.getIdleConn(), 0);
+  EXPECT_EQ(backend.getReusedConn(), 0);
+  for (auto fd : {closed[0], dirty[0], stale[0]}) EXPECT_FALSE(isOpenFd(fd));
+
+  /* Idle timeout reported by the worker timer. */
+  EXPECT_TRUE(pool.put(&backend, expired[0], 120));
+  EXPECT_TRUE(pool.expire(expired[0]));
+  EXPECT_FALSE(pool.expire(expired[0]));
+  EXPECT_FALSE(isOpenFd(expired[0]));
+  EXPECT_EQ(pool.get(&backend, 120), -1);
+  EXPECT_EQ(backend.getIdleConn(), 0);
+  for (auto fd : {dirty[1], stale[1], expired[1]}) ::close(fd);
+}
+
+/**
+ * Validates @p response to @p request as relayed by a stream, and returns
+ * whether its backend connection may go back to the pool.
+ */
+static bool keepsBackendAlive(const std::string &request,
+                              const std::string &response) {
+  HttpStream stream;
+  stream.service_manager =
+      std::make_shared<ServiceManager>(std::make_shared<ListenerConfig>());
+  size_t parsed = 0;
+  stream.request.parseRequest(request, &parsed);
+  stream.request.setRequestMethod();
+  stream.response.parseResponse(response, &parsed);
+  EXPECT_EQ(http_manager::validateResponse(stream),
+            validation::REQUEST_RESULT::OK);
+  return stream.response.keep_alive;
+}
+
+TEST(BackendPoolTest, ReusesOnlyDelimitedResponses) {
+  const std::string get = "GET / HTTP/1.1\r\nHost: a\r\n\r\n";
+  EXPECT_TRUE(keepsBackendAlive(
+      get, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello"));
+  EXPECT_TRUE(keepsBackendAlive(
+      get, "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n"));
+  EXPECT_TRUE(keepsBackendAlive(
+      get, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"));
+  EXPECT_TRUE(keepsBackendAlive(get, "HTTP/1.1 204 No Content\r\n\r\n"));
+  EXPECT_TRUE(keepsBackendAlive(get, "HTTP/1.1 304 Not Modified\r\n\r\n"));
+  EXPECT_TRUE(keepsBackendAlive("HEAD / HTTP/1.1\r\nHost: a\r\n\r\n",
+                                "HTTP/1.1 200 OK\r\n\r\n"));
+  /* The body lasts until the backend closes the connection. */
+  EXPECT_FALSE(keepsBackendAlive(get, "HTTP/1.1 200 OK\r\n\r\nhello"));
+  EXPECT_FALSE(keepsBackendAlive(
+      get, "HTTP/1.1 200 OK\r\nConnection: close\r\n"
+           "Content-Length: 5\r\n\r\nhello"));
+  EXPECT_FALSE(keepsBackendAlive(
+      get, "HTTP/1.0 200 OK\r\nContent-Length: 5\r\n\r\nhello"));
+}
@@ -0,0 +1,118 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/connection/connection.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+
+TEST(BufferPoolTest, ReusesReleasedBuffers) {
+  auto &pool = BufferPool::local();
+  auto free_buffers = pool.freeBuffers(0);
+  auto used = BufferPool::used_buffers.load();
+  auto first = pool.get(0);
+  ASSERT_NE(first, nullptr);
+  first[BufferPool::classSize(0) - 1] = 'x';
+  EXPECT_EQ(BufferPool::used_buffers.load(), used + 1);
+  pool.put(first, 0);
+  EXPECT_EQ(pool.freeBuffers(0), free_buffers + 1);
+  EXPECT_EQ(BufferPool::used_buffers.load(), used);
+  /* The most recently released buffer is reused first. */
+  EXPECT_EQ(pool.get(0), first);
+  auto big = pool.get(BUFFER_POOL_CLASSES - 1);
+  ASSERT_NE(big, nullptr);
+  big[MAX_BUFFER_SIZE - 1] = 'x';
+  pool.put(big, BUFFER_POOL_CLASSES - 1);
+  pool.put(first, 0);
+}
+
+TEST(BufferPoolTest, ReturnsBuffersToTheirOwner) {
+  auto &pool = BufferPool::local();
+  auto free_buffers = pool.freeBuffers(0);
+  auto used = BufferPool::used_buffers.load();
+  char *buffer = nullptr;
+  char *reused = nullptr;
+  std::thread worker([&] {
+    auto &worker_pool = BufferPool::local();
+    buffer = worker_pool.get(0);
+    /* Given back from another thread, the buffer goes back to its owner. */
+    std::thread([&] { BufferPool::local().put(buffer, 0); }).join();
+    reused = worker_pool.get(0);
+    worker_pool.put(reused, 0);
+  });
+  worker.join();
+  ASSERT_NE(buffer, nullptr);
+  EXPECT_EQ(reused, buffer);
+  EXPECT_EQ(pool.freeBuffers(0), free_buffers);
+  EXPECT_EQ(BufferPool::used_buffers.load(), used);
+}
+
+TEST(BufferPoolTest, BufferOutlivesItsThread) {
+  auto &pool = BufferPool::local();
+  auto free_buffers = pool.freeBuffers(0);
+  auto used = BufferPool::used_buffers.load();
+  auto total = BufferPool::total_buffers.load();
+  char *buffer = nullptr;
+  std::thread([&] { buffer = BufferPool::local().get(0); }).join();
+  ASSERT_NE(buffer, nullptr);
+  /* The pool of the thread is kept until its last buffer is back. */
+  buffer[BufferPool::classSize(0) - 1] = 'x';
+  EXPECT_EQ(BufferPool::used_buffers.load(), used + 1);
+  pool.put(buffer, 0);
+  EXPECT_EQ(pool.freeBuffers(0), free_buffers);
+  EXPECT_EQ(BufferPool::used_buffers.load(), used);
+  EXPECT_EQ(BufferPool::total_buffers.load(), total);
+}
+
+TEST(BufferPoolTest, ConnectionHoldsBufferOnlyWithData) {
+  int fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+  Connection connection;
+  connection.setFileDescriptor(fds[0]);
+  EXPECT_EQ(connection.buffer, nullptr);
+  EXPECT_EQ(connection.bufferCapacity(), 0u);
+
+  /* Nothing to read, no buffer is kept. */
+  EXPECT_EQ(connection.read(), IO::IO_RESULT::DONE_TRY_AGAIN);
+  EXPECT_EQ(connection.buffer, nullptr);
+
+  std::string request = "GET / HTTP/1.1\r\nHost: zproxy\r\n";
+  ASSERT_EQ(::write(fds[1], request.data(), request.size()),
+            static_cast<ssize_t>(request.size()));
+  EXPECT_EQ(connection.read(), IO::IO_RESULT::SUCCESS);
+  ASSERT_NE(connection.buffer, nullptr);
+  EXPECT_EQ(connection.bufferCapacity(), static_cast<size_t>(MAX_DATA_SIZE));
+  EXPECT_EQ(std::string(connection.buffer, connection.buffer_size), request);
+
+  /* Oversized headers move to a bigger size class keeping the data. */
+  while (connection.bufferCapacity() < MAX_BUFFER_SIZE)
+    ASSERT_TRUE(connection.growBuffer());
+  EXPECT_FALSE(connection.growBuffer());
+  EXPECT_EQ(std::string(connection.buffer, connection.buffer_size), request);
+
+  connection.releaseBuffer();
+  EXPECT_EQ(connection.buffer, nullptr);
+  EXPECT_EQ(connection.buffer_size, 0u);
+  ::close(fds[1]);
+}
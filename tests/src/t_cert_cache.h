@@ -0,0 +1,284 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/ssl/cert_cache.h"
+#include "../../src/ssl/ssl_connection_manager.h"
+#include "../../src/ssl/ssl_context.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/** Writes a self signed certificate for @p name, with its key, to a file. */
+static std::string certCacheFile(const std::string &dir,
+                                 const std::string &name) {
+  EVP_PKEY *key = EVP_EC_gen("P-256");
+  X509 *cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME_add_entry_by_txt(
+      X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+      reinterpret_cast<const unsigned char *>(name.c_str()), -1, -1, 0);
+  X509_set_issuer_name(cert, X509_get_subject_name(cert));
+  X509_sign(cert, key, EVP_sha256());
+  auto path = dir + "/" + name + ".pem";
+  FILE *file = std::fopen(path.c_str(), "w");
+  PEM_write_X509(file, cert);
+  PEM_write_PrivateKey(file, key, nullptr, nullptr, 0, nullptr, nullptr);
+  std::fclose(file);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return path;
+}
+
+/** Certificates not loaded, named "<prefix>0.test", "<prefix>1.test"... */
+static std::shared_ptr<POUND_CTX> certCacheLazyList(const std::string &dir,
+                                                    const std::string &prefix,
+                                                    int count) {
+  std::shared_ptr<POUND_CTX> head, last;
+  for (int i = 0; i < count; i++) {
+    auto pc = std::make_shared<POUND_CTX>();
+    auto name = prefix + std::to_string(i) + ".test";
+    pc->server_name = ::strdup(name.c_str());
+    pc->subjectAltNameCount = 0;
+    pc->cert_file = certCacheFile(dir, name);
+    if (head == nullptr)
+      head = pc;
+    else
+      last->next = pc;
+    last = pc;
+  }
+  return head;
+}
+
+/** Default context of a listener, with the certificate of @p name. */
+static std::shared_ptr<SSL_CTX> certCacheDefault(const std::string &dir,
+                                                 const std::string &name) {
+  auto path = certCacheFile(dir, name);
+  std::shared_ptr<SSL_CTX> ctx(SSL_CTX_new(TLS_server_method()),
+                               &::SSL_CTX_free);
+  SSL_CTX_use_certificate_chain_file(ctx.get(), path.c_str());
+  SSL_CTX_use_PrivateKey_file(ctx.get(), path.c_str(), SSL_FILETYPE_PEM);
+  SSL_CTX_set_cipher_list(ctx.get(), "ECDHE-ECDSA-AES128-GCM-SHA256");
+  SSL_CTX_set_max_proto_version(ctx.get(), TLS1_2_VERSION);
+  return ctx;
+}
+
+/** Listener with the default certificate, keeping @p capacity contexts. */
+static std::shared_ptr<ListenerConfig> certCacheListener(
+    const std::string &dir, size_t capacity) {
+  auto listener_config = std::make_shared<ListenerConfig>();
+  listener_config->address = "127.0.0.1";
+  listener_config->port = 8443;
+  listener_config->ctx = std::make_shared<POUND_CTX>();
+  listener_config->ctx->ctx = certCacheDefault(dir, "default.test");
+  listener_config->ctx->server_name = ::strdup("default.test");
+  listener_config->cert_cache_size = capacity;
+  return listener_config;
+}
+
+/**
+ * Completes a handshake with @p server_ctx, resuming @p session if set.
+ *
+ * @return the session of the handshake, with the group of its key exchange
+ * in @p group and if it was resumed in @p reused.
+ */
+static SSL_SESSION *certCacheHandshake(SSL_CTX *server_ctx,
+                                       SSL_SESSION *session, int *group,
+                                       bool *reused) {
+  std::shared_ptr<SSL_CTX> client_ctx(SSL_CTX_new(TLS_client_method()),
+                                      &::SSL_CTX_free);
+  int fds[2];
+  ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+  SSL *client = SSL_new(client_ctx.get());
+  SSL *server = SSL_new(server_ctx);
+  SSL_set_fd(client, fds[0]);
+  SSL_set_fd(server, fds[1]);
+  if (session != nullptr) SSL_set_session(client, session);
+  SSL_set_connect_state(client);
+  SSL_set_accept_state(server);
+  SSL_SESSION *result = nullptr;
+  bool client_done = false, server_done = false;
+  for (int i = 0; i < 20 && !(client_done && server_done); i++) {
+    if (!client_done) client_done = SSL_do_handshake(client) == 1;
+    if (!server_done) server_done = SSL_do_handshake(server) == 1;
+  }
+  if (client_done && server_done) {
+    *group = SSL_get_negotiated_group(server);
+    *reused = SSL_session_reused(client) == 1;
+    result = SSL_get1_session(client);
+    /* a session not shut down is not resumable */
+    SSL_shutdown(client);
+    SSL_shutdown(server);
+  }
+  SSL_free(client);
+  SSL_free(server);
+  ::close(fds[0]);
+  ::close(fds[1]);
+  return result;
+}
+
+TEST(CertCacheTest, BuildsOnFirstUseAndEvicts) {
+  char dir[] = "/tmp/zproxy_certs_XXXXXX";
+  ASSERT_NE(::mkdtemp(dir), nullptr);
+  auto lazy = certCacheLazyList(dir, "tenant", 3);
+  ssl::CertCache cert_cache(certCacheListener(dir, 2), nullptr);
+  auto pc0 = lazy.get(), pc1 = lazy->next.get(), pc2 = lazy->next->next.get();
+
+  auto ctx0 = cert_cache.get(pc0);
+  ASSERT_NE(ctx0, nullptr);
+  EXPECT_EQ(SSL_CTX_get_max_proto_version(ctx0.get()), TLS1_2_VERSION);
+  EXPECT_EQ(cert_cache.get(pc0), ctx0);
+  EXPECT_EQ(cert_cache.hits.load(), 1u);
+  EXPECT_EQ(cert_cache.misses.load(), 1u);
+  EXPECT_EQ(cert_cache.cold_builds.load(), 1u);
+
+  cert_cache.get(pc1);
+  cert_cache.get(pc2);
+  EXPECT_EQ(cert_cache.size(), 2u);
+  /* The first one was released, and is still usable by its holders. */
+  auto again = cert_cache.get(pc0);
+  EXPECT_NE(again, ctx0);
+  EXPECT_EQ(cert_cache.cold_builds.load(), 4u);
+  EXPECT_GE(cert_cache.max_cold_build_us.load(),
+            cert_cache.cold_build_us.load() / 4);
+
+  pc0->cert_file = std::string(dir) + "/missing.pem";
+  cert_cache.get(pc1);
+  cert_cache.get(pc2);
+  EXPECT_EQ(cert_cache.get(pc0), nullptr);
+  EXPECT_EQ(cert_cache.build_errors.load(), 1u);
+  std::system(("rm -rf " + std::string(dir)).c_str());
+}
+
+TEST(CertCacheTest, PrebuildsHotCertificates) {
+  char dir[] = "/tmp/zproxy_certs_XXXXXX";
+  ASSERT_NE(::mkdtemp(dir), nullptr);
+  auto lazy = certCacheLazyList(dir, "tenant", 3);
+  ssl::CertCache cert_cache(certCacheListener(dir, 1), nullptr);
+  auto pc0 = lazy.get(), pc1 = lazy->next.get(), pc2 = lazy->next->next.get();
+  /* Both are evicted by each other on every lookup. */
+  for (int i = 0; i < CERT_CACHE_HOT_REQUESTS; i++) {
+    cert_cache.get(pc0);
+    cert_cache.get(pc1);
+  }
+  cert_cache.get(pc0);
+  cert_cache.get(pc2);
+  /* Only as many as the capacity, the most requested first. */
+  EXPECT_EQ(cert_cache.prebuildHot(), 1u);
+  EXPECT_EQ(cert_cache.prebuilds.load(), 1u);
+  auto hits = cert_cache.hits.load();
+  cert_cache.get(pc0);
+  EXPECT_EQ(cert_cache.hits.load(), hits + 1);
+  /* The counts start again after each maintenance. */
+  EXPECT_EQ(cert_cache.prebuildHot(), 0u);
+  std::system(("rm -rf " + std::string(dir)).c_str());
+}
+
+TEST(CertCacheTest, BuildsWithTheListenerSettings) {
+  char dir[] = "/tmp/zproxy_certs_XXXXXX";
+  ASSERT_NE(::mkdtemp(dir), nullptr);
+  auto lazy = certCacheLazyList(dir, "tenant", 2);
+  auto listener_config = certCacheListener(dir, 1);
+  listener_config->ecdh_curve_nid = NID_secp384r1;
+  auto ticket_keys = std::make_shared<ssl::TicketKeys>(3600);
+  ssl::CertCache cert_cache(listener_config, ticket_keys);
+  auto pc0 = lazy.get(), pc1 = lazy->next.get();
+
+  int group = 0;
+  bool reused = true;
+  auto session =
+      certCacheHandshake(cert_cache.get(pc0).get(), nullptr, &group, &reused);
+  ASSERT_NE(session, nullptr);
+  EXPECT_EQ(group, NID_secp384r1);
+  EXPECT_FALSE(reused);
+  /* Another certificate is not resumed, the same one rebuilt is. */
+  auto other =
+      certCacheHandshake(cert_cache.get(pc1).get(), session, &group, &reused);
+  ASSERT_NE(other, nullptr);
+  EXPECT_FALSE(reused);
+  SSL_SESSION_free(other);
+  auto rebuilt = cert_cache.get(pc0);
+  EXPECT_EQ(cert_cache.cold_builds.load(), 3u);
+  auto resumed = certCacheHandshake(rebuilt.get(), session, &group, &reused);
+  ASSERT_NE(resumed, nullptr);
+  EXPECT_TRUE(reused);
+  SSL_SESSION_free(resumed);
+  SSL_SESSION_free(session);
+  std::system(("rm -rf " + std::string(dir)).c_str());
+}
+
+TEST(CertCacheTest, ServesTheCertificateOfTheServerName) {
+  char dir[] = "/tmp/zproxy_certs_XXXXXX";
+  ASSERT_NE(::mkdtemp(dir), nullptr);
+  auto listener_config = std::make_shared<ListenerConfig>();
+  listener_config->ctx = std::make_shared<POUND_CTX>();
+  listener_config->ctx->ctx = certCacheDefault(dir, "default.test");
+  listener_config->ctx->server_name = ::strdup("default.test");
+  listener_config->lazy_ctx = certCacheLazyList(dir, "tenant", 2);
+  listener_config->cert_cache_size = 8;
+  ssl::SSLContext server_context;
+  ASSERT_TRUE(server_context.init(listener_config));
+  ASSERT_NE(server_context.cert_cache, nullptr);
+
+  for (auto name : {"tenant1.test", "unknown.test", "tenant1.test"}) {
+    std::shared_ptr<SSL_CTX> client_ctx(SSL_CTX_new(TLS_client_method()),
+                                        &::SSL_CTX_free);
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+    Connection client, server;
+    client.setFileDescriptor(fds[0]);
+    server.setFileDescriptor(fds[1]);
+    ASSERT_TRUE(ssl::SSLConnectionManager::initSslConnection(client_ctx.get(),
+                                                             client, true));
+    SSL_set_tlsext_host_name(client.ssl, name);
+    for (int i = 0; i < 20 && !(server.ssl_connected && client.ssl_connected);
+         i++) {
+      if (!client.ssl_connected) {
+        ASSERT_TRUE(ssl::SSLConnectionManager::handleHandshake(
+            client_ctx.get(), client, true));
+      }
+      if (!server.ssl_connected) {
+        ASSERT_TRUE(
+            ssl::SSLConnectionManager::handleHandshake(server_context, server));
+      }
+    }
+    ASSERT_TRUE(server.ssl_connected && client.ssl_connected);
+    X509 *cert = SSL_get1_peer_certificate(client.ssl);
+    char common_name[64] = {0};
+    X509_NAME_get_text_by_NID(X509_get_subject_name(cert), NID_commonName,
+                              common_name, sizeof(common_name));
+    X509_free(cert);
+    EXPECT_EQ(std::string(common_name),
+              std::string(name) == "unknown.test" ? "default.test" : name);
+  }
+  EXPECT_EQ(server_context.cert_cache->cold_builds.load(), 1u);
+  EXPECT_EQ(server_context.cert_cache->hits.load(), 1u);
+  std::system(("rm -rf " + std::string(dir)).c_str());
+}
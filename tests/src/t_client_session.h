@@ -0,0 +1,111 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/ssl/ssl_client_session.h"
+#include "gtest/gtest.h"
+#include "t_ticket_keys.h"
+#include <sys/socket.h>
+
+/**
+ * Connects a new client of @p client_ctx, bound to @p store, to @p server_ctx
+ * and returns whether the session was resumed. The client reads what the
+ * server sent after the handshake, the TLSv1.3 tickets.
+ */
+static bool clientSessionHandshake(SSL_CTX *server_ctx, SSL_CTX *client_ctx,
+                                   ssl::ClientSessionStore &store) {
+  int fds[2];
+  ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+  Connection client, server;
+  client.setFileDescriptor(fds[0]);
+  server.setFileDescriptor(fds[1]);
+  EXPECT_TRUE(
+      ssl::SSLConnectionManager::initSslConnection(client_ctx, client, true));
+  store.offer(client.ssl);
+  for (int i = 0; i < 20 && !(server.ssl_connected && client.ssl_connected);
+       i++) {
+    if (!client.ssl_connected) {
+      EXPECT_TRUE(
+          ssl::SSLConnectionManager::handleHandshake(client_ctx, client, true));
+      if (client.ssl_connected) store.countHandshake(client.ssl);
+    }
+    if (!server.ssl_connected) {
+      EXPECT_TRUE(ssl::SSLConnectionManager::handleHandshake(server_ctx, server));
+    }
+  }
+  EXPECT_TRUE(server.ssl_connected && client.ssl_connected);
+  char data;
+  EXPECT_LE(SSL_read(client.ssl, &data, 1), 0);
+  return SSL_session_reused(client.ssl) != 0;
+}
+
+/** Backend client context, as the HTTPS backend directive creates it. */
+static std::shared_ptr<SSL_CTX> clientSessionCtx() {
+  std::shared_ptr<SSL_CTX> client_ctx(SSL_CTX_new(TLS_client_method()),
+                                      &::SSL_CTX_free);
+  ssl::ClientSessionStore::attach(client_ctx.get());
+  return client_ctx;
+}
+
+TEST(ClientSessionTest, ResumesTls12Sessions) {
+  auto server_ctx = ticketServerCtx();
+  SSL_CTX_set_max_proto_version(server_ctx.get(), TLS1_2_VERSION);
+  // session ids, the server cache
+  SSL_CTX_set_options(server_ctx.get(), SSL_OP_NO_TICKET);
+  auto client_ctx = clientSessionCtx();
+  ssl::ClientSessionStore store;
+  EXPECT_FALSE(clientSessionHandshake(server_ctx.get(), client_ctx.get(), store));
+  EXPECT_TRUE(store.hasSession());
+  for (int i = 0; i < 3; i++)
+    EXPECT_TRUE(clientSessionHandshake(server_ctx.get(), client_ctx.get(), store));
+  EXPECT_EQ(store.handshakes.load(), 4u);
+  EXPECT_EQ(store.resumed.load(), 3u);
+}
+
+TEST(ClientSessionTest, ResumesTls13Tickets) {
+  auto server_ctx = ticketServerCtx();
+  auto client_ctx = clientSessionCtx();
+  ssl::ClientSessionStore store;
+  EXPECT_FALSE(clientSessionHandshake(server_ctx.get(), client_ctx.get(), store));
+  EXPECT_TRUE(store.hasSession());
+  EXPECT_TRUE(clientSessionHandshake(server_ctx.get(), client_ctx.get(), store));
+  EXPECT_EQ(store.resumed.load(), 1u);
+}
+
+TEST(ClientSessionTest, DropsRefusedSessions) {
+  auto server_ctx = ticketServerCtx();
+  SSL_CTX_set_max_proto_version(server_ctx.get(), TLS1_2_VERSION);
+  SSL_CTX_set_options(server_ctx.get(), SSL_OP_NO_TICKET);
+  auto client_ctx = clientSessionCtx();
+  ssl::ClientSessionStore store;
+  EXPECT_FALSE(clientSessionHandshake(server_ctx.get(), client_ctx.get(), store));
+  /* A restarted backend does not know the session any more, and issues none. */
+  auto restarted_ctx = ticketServerCtx();
+  SSL_CTX_set_max_proto_version(restarted_ctx.get(), TLS1_2_VERSION);
+  SSL_CTX_set_options(restarted_ctx.get(), SSL_OP_NO_TICKET);
+  SSL_CTX_set_session_cache_mode(restarted_ctx.get(), SSL_SESS_CACHE_OFF);
+  EXPECT_FALSE(
+      clientSessionHandshake(restarted_ctx.get(), client_ctx.get(), store));
+  EXPECT_FALSE(store.hasSession());
+  EXPECT_EQ(store.handshakes.load(), 2u);
+  EXPECT_EQ(store.resumed.load(), 0u);
+}
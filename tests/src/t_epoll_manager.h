@@ -94,3 +94,91 @@ TEST(EpollManagerTest, EpollManagerBasicOp) {
   EXPECT_TRUE(errno == ENOENT);
 
 }
+
+/* Handler that consumes the events like a worker does: reads a few bytes per
+ * event and tells the event manager once the socket is drained. */
+class EdgeTriggeredHandler : public EpollManager {
+ public:
+  int reads{0};
+  int writes{0};
+  int disconnects{0};
+  size_t read_size{1};
+  EdgeTriggeredHandler() { setEdgeTriggered(true); }
+  void HandleEvent(int fd, EVENT_TYPE event_type,
+                   EVENT_GROUP event_group) override {
+    char buffer[64];
+    switch (event_type) {
+      case EVENT_TYPE::READ:
+        reads++;
+        if (::read(fd, buffer, read_size) < 0 && errno == EAGAIN)
+          setReadDrained(fd);
+        break;
+      case EVENT_TYPE::WRITE:
+        writes++;
+        break;
+      case EVENT_TYPE::DISCONNECT:
+        disconnects++;
+        deleteFd(fd);
+        break;
+      default:
+        break;
+    }
+  }
+};
+
+TEST(EpollManagerTest, EdgeTriggeredRegistersOnce) {
+  EdgeTriggeredHandler handler;
+  ASSERT_TRUE(handler.isEdgeTriggered());
+  int pair[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair), 0);
+  auto ctl_calls = handler.getCtlCalls();
+  EXPECT_TRUE(handler.addFd(pair[0], EVENT_TYPE::READ, EVENT_GROUP::CLIENT));
+  EXPECT_EQ(handler.getCtlCalls(), ctl_calls + 1);
+  /* the kernel reports it writable, but no one asked for it */
+  handler.loopOnce(10);
+  EXPECT_EQ(handler.writes, 0);
+  EXPECT_EQ(handler.reads, 0);
+
+  /* Level triggered read: reported until the handler drains the socket,
+   * although the kernel reports a single edge. */
+  ASSERT_EQ(::write(pair[1], "abc", 3), 3);
+  EXPECT_EQ(handler.loopOnce(1000), 2);
+  EXPECT_EQ(handler.reads, 2);
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.reads, 3);
+  /* the last one finds it empty */
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.reads, 4);
+  EXPECT_EQ(handler.loopOnce(10), 0);
+
+  /* One shot write, the socket is writable so it is reported at once. */
+  EXPECT_TRUE(handler.updateFd(pair[0], EVENT_TYPE::WRITE, EVENT_GROUP::CLIENT));
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.writes, 1);
+  EXPECT_EQ(handler.loopOnce(10), 0);
+  /* Blocked writes wait for the kernel. */
+  handler.setWriteBlocked(pair[0]);
+  EXPECT_TRUE(handler.updateFd(pair[0], EVENT_TYPE::WRITE, EVENT_GROUP::CLIENT));
+  EXPECT_EQ(handler.loopOnce(10), 0);
+  EXPECT_EQ(handler.writes, 1);
+
+  /* Data arrived while disabled is reported once enabled again. */
+  EXPECT_TRUE(handler.disableFd(pair[0]));
+  ASSERT_EQ(::write(pair[1], "d", 1), 1);
+  handler.loopOnce(10);
+  EXPECT_EQ(handler.reads, 4);
+  handler.read_size = 64;
+  EXPECT_TRUE(handler.updateFd(pair[0], EVENT_TYPE::READ, EVENT_GROUP::CLIENT));
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.reads, 5);
+
+  /* None of the changes needed a system call. */
+  EXPECT_EQ(handler.getCtlCalls(), ctl_calls + 1);
+
+  /* Peer close is reported as disconnect. */
+  ::close(pair[1]);
+  handler.loopOnce(1000);
+  EXPECT_EQ(handler.disconnects, 1);
+  EXPECT_EQ(handler.getCtlCalls(), ctl_calls + 2);
+  ::close(pair[0]);
+}
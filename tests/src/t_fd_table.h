@@ -0,0 +1,123 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/event/fd_table.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace events;
+
+TEST(FdTableTest, GetSetErase) {
+  FdTable<int> table;
+  int a = 1, b = 2;
+  /* Unknown fds read as null and are not inserted. */
+  EXPECT_EQ(table.get(5), nullptr);
+  EXPECT_EQ(table.get(-1), nullptr);
+  EXPECT_EQ(table.size(), 0u);
+
+  table.set(5, &a);
+  table.set(1000, &b);
+  table.set(-3, &b);
+  EXPECT_EQ(table.get(5), &a);
+  EXPECT_EQ(table.get(1000), &b);
+  EXPECT_EQ(table.get(999), nullptr);
+  EXPECT_EQ(table.size(), 2u);
+
+  table.set(5, &b);
+  EXPECT_EQ(table.size(), 2u);
+  table.erase(5);
+  table.erase(5);
+  table.erase(123456);
+  EXPECT_EQ(table.get(5), nullptr);
+  EXPECT_EQ(table.size(), 1u);
+}
+
+TEST(FdTableTest, ForEachAllowsErasing) {
+  FdTable<int> table;
+  std::vector<int> values(64);
+  for (int fd = 0; fd < 64; fd++) table.set(fd, &values[fd]);
+  int visited = 0;
+  table.forEach([&](int fd, int *value) {
+    EXPECT_EQ(value, &values[fd]);
+    visited++;
+    table.erase(fd);
+    table.erase(fd + 1);
+  });
+  EXPECT_EQ(visited, 32);
+  EXPECT_EQ(table.size(), 0u);
+}
+
+/*
+ * Microbenchmark of the event dispatch hot path: resolve the stream of the
+ * fd reported by the event manager, as StreamManager::HandleEvent() does, for
+ * a worker with N connections (client and backend fds interleaved).
+ */
+struct DispatchStream {
+  int fd;
+  uint64_t events{0};
+};
+
+TEST(FdTableTest, DispatchBenchmark) {
+  const int connections = 10000, lookups = 2000000;
+  std::vector<DispatchStream> streams(connections);
+  std::unordered_map<int, DispatchStream *> map_set;
+  FdTable<DispatchStream> table_set;
+  for (int i = 0; i < connections; i++) {
+    streams[i].fd = 10 + i * 2;
+    map_set[streams[i].fd] = &streams[i];
+    table_set.set(streams[i].fd, &streams[i]);
+  }
+  std::mt19937 rng(42);
+  std::vector<int> ready(4096);
+  for (auto &fd : ready) fd = 10 + static_cast<int>(rng() % (connections * 2));
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < lookups; i++) {
+    auto stream = map_set[ready[i & 4095]];
+    if (stream != nullptr) stream->events++;
+  }
+  auto map_ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start)
+                    .count() /
+                lookups;
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < lookups; i++) {
+    auto stream = table_set.get(ready[i & 4095]);
+    if (stream != nullptr) stream->events++;
+  }
+  auto table_ns = std::chrono::duration<double, std::nano>(
+                      std::chrono::steady_clock::now() - start)
+                      .count() /
+                  lookups;
+
+  std::cout << "unordered_map dispatch: " << map_ns << " ns/event, "
+            << map_set.size() - connections << " null entries inserted"
+            << std::endl;
+  std::cout << "FdTable dispatch: " << table_ns << " ns/event" << std::endl;
+  EXPECT_EQ(table_set.size(), static_cast<size_t>(connections));
+}
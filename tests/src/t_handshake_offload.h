@@ -0,0 +1,268 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/event/epoll_manager.h"
+#include "../../src/ssl/handshake_offload.h"
+#include "../../src/ssl/ssl_connection_manager.h"
+#include "../../src/util/time.h"
+#include "gtest/gtest.h"
+#include <condition_variable>
+#include <iostream>
+#include <openssl/x509.h>
+#include <set>
+#include <sys/socket.h>
+#include <thread>
+
+/** Listener context with a self signed certificate of an RSA @p bits key. */
+static std::unique_ptr<ssl::SSLContext> offloadServerContext(int bits) {
+  std::shared_ptr<SSL_CTX> server_ctx(SSL_CTX_new(TLS_server_method()),
+                                      &::SSL_CTX_free);
+  EVP_PKEY *key = EVP_RSA_gen(bits);
+  X509 *cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char *>("zproxy"),
+                             -1, -1, 0);
+  X509_set_issuer_name(cert, X509_get_subject_name(cert));
+  X509_sign(cert, key, EVP_sha256());
+  SSL_CTX_use_certificate(server_ctx.get(), cert);
+  SSL_CTX_use_PrivateKey(server_ctx.get(), key);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  auto listener_config = std::make_shared<ListenerConfig>();
+  listener_config->ctx = std::make_shared<POUND_CTX>();
+  listener_config->ctx->ctx = server_ctx;
+  auto ssl_context = std::make_unique<ssl::SSLContext>();
+  EXPECT_TRUE(ssl_context->init(listener_config));
+  return ssl_context;
+}
+
+/*
+ * Event loop of a worker serving the server side of TLS connections. It runs
+ * the handshakes inline or in the HandshakePool, and accounts the time it
+ * spent on them.
+ */
+class HandshakeWorker : public EpollManager {
+ public:
+  const ssl::SSLContext &ssl_context;
+  std::unique_ptr<ssl::HandshakeOffload> handshake_offload;
+  std::map<int, Connection *> connections;
+  uint64_t stall_us{0};
+  int steps{0};
+  int errors{0};
+  /** A plain connection, the events the worker handles meanwhile. */
+  int ping_fd{-1};
+  int pings{0};
+  HandshakeWorker(const ssl::SSLContext &ssl_context_, bool offload)
+      : ssl_context(ssl_context_) {
+    if (!offload) return;
+    handshake_offload = std::make_unique<ssl::HandshakeOffload>();
+    EXPECT_TRUE(handshake_offload->init());
+    handshake_offload->enableEvents(this, EVENT_TYPE::READ,
+                                    EVENT_GROUP::HANDSHAKE);
+  }
+  void add(Connection &connection) {
+    connections[connection.getFileDescriptor()] = &connection;
+    connection.enableEvents(this, EVENT_TYPE::READ, EVENT_GROUP::CLIENT);
+  }
+  void HandleEvent(int fd, EVENT_TYPE, EVENT_GROUP event_group) override {
+    auto start = Time::getMonotonicUs();
+    if (fd == ping_fd) {
+      char byte;
+      while (::read(fd, &byte, 1) == 1) pings++;
+    } else if (event_group == EVENT_GROUP::HANDSHAKE) {
+      for (auto &job : handshake_offload->takeDone()) {
+        ssl::HandshakeOffload::resume(job, *this);
+        if (!job.result) errors++;
+      }
+    } else if (connections.count(fd) != 0 && !connections[fd]->ssl_connected) {
+      steps++;
+      if (handshake_offload != nullptr)
+        handshake_offload->submit(*connections[fd], ssl_context);
+      else if (!ssl::SSLConnectionManager::handleHandshake(ssl_context,
+                                                           *connections[fd]))
+        errors++;
+    }
+    stall_us += Time::getMonotonicUs() - start;
+  }
+};
+
+/** Runs @p count TLSv1.2 handshakes against @p worker, returns the done. */
+static int offloadHandshakes(HandshakeWorker &worker, int count) {
+  std::shared_ptr<SSL_CTX> client_ctx(SSL_CTX_new(TLS_client_method()),
+                                      &::SSL_CTX_free);
+  SSL_CTX_set_max_proto_version(client_ctx.get(), TLS1_2_VERSION);
+  SSL_CTX_set_cipher_list(client_ctx.get(), "ECDHE-RSA-AES128-GCM-SHA256");
+  std::vector<std::unique_ptr<Connection>> clients, servers;
+  for (int i = 0; i < count; i++) {
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+    clients.push_back(std::make_unique<Connection>());
+    servers.push_back(std::make_unique<Connection>());
+    clients.back()->setFileDescriptor(fds[0]);
+    servers.back()->setFileDescriptor(fds[1]);
+    EXPECT_TRUE(ssl::SSLConnectionManager::initSslConnection(
+        client_ctx.get(), *clients.back(), true));
+    worker.add(*servers.back());
+  }
+  int connected = 0;
+  for (int i = 0; i < 2000 && connected < count; i++) {
+    for (auto &client : clients) {
+      if (client->ssl_connected) continue;
+      // polled on every iteration, not only when readable
+      client->handshake_retries = 0;
+      ssl::SSLConnectionManager::handleHandshake(client_ctx.get(), *client,
+                                                 true);
+    }
+    worker.loopOnce(1);
+    connected = 0;
+    for (auto &server : servers) connected += server->ssl_connected ? 1 : 0;
+  }
+  if (worker.handshake_offload != nullptr)
+    worker.handshake_offload->waitIdle();
+  for (auto &server : servers) server->disableEvents();
+  return connected;
+}
+
+/** Threads the server handshakes ran on, and a gate that holds them. */
+static std::mutex handshake_threads_mtx;
+static std::condition_variable handshake_threads_cv;
+static std::set<std::thread::id> handshake_threads;
+static bool handshake_gate_closed{false};
+static bool handshake_held{false};
+static std::thread::id handshake_worker_thread;
+
+static void handshakeThreadCallback(const SSL *, int where, int) {
+  if ((where & SSL_CB_HANDSHAKE_START) == 0) return;
+  std::unique_lock<std::mutex> lock(handshake_threads_mtx);
+  handshake_threads.insert(std::this_thread::get_id());
+  /* never hold the worker itself, an inline handshake fails the test */
+  if (std::this_thread::get_id() == handshake_worker_thread) return;
+  handshake_held = handshake_gate_closed;
+  handshake_threads_cv.notify_all();
+  handshake_threads_cv.wait(lock, [] { return !handshake_gate_closed; });
+}
+
+TEST(HandshakeOffloadTest, KeepsTheWorkerServingDuringHandshakes) {
+  ssl::HandshakePool::getInstance().start(1);
+  auto ssl_context = offloadServerContext(2048);
+  SSL_CTX_set_info_callback(ssl_context->ssl_ctx.get(),
+                            handshakeThreadCallback);
+  HandshakeWorker worker(*ssl_context, true);
+  int ping_fds[2];
+  ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, ping_fds);
+  Connection ping;
+  ping.setFileDescriptor(ping_fds[0]);
+  worker.ping_fd = ping_fds[0];
+  ping.enableEvents(&worker, EVENT_TYPE::READ, EVENT_GROUP::CLIENT);
+  {
+    std::lock_guard<std::mutex> lock(handshake_threads_mtx);
+    handshake_threads.clear();
+    handshake_worker_thread = std::this_thread::get_id();
+    handshake_gate_closed = true;
+    handshake_held = false;
+  }
+
+  std::shared_ptr<SSL_CTX> client_ctx(SSL_CTX_new(TLS_client_method()),
+                                      &::SSL_CTX_free);
+  int fds[2];
+  ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+  Connection client, server;
+  client.setFileDescriptor(fds[0]);
+  server.setFileDescriptor(fds[1]);
+  ASSERT_TRUE(ssl::SSLConnectionManager::initSslConnection(client_ctx.get(),
+                                                           client, true));
+  worker.add(server);
+  ssl::SSLConnectionManager::handleHandshake(client_ctx.get(), client, true);
+  for (int i = 0; i < 100 && worker.steps == 0; i++) worker.loopOnce(10);
+  {
+    /* The pool thread is inside the handshake, held by the gate. */
+    std::unique_lock<std::mutex> lock(handshake_threads_mtx);
+    ASSERT_TRUE(handshake_threads_cv.wait_for(
+        lock, std::chrono::seconds(10), [] { return handshake_held; }));
+  }
+  /* Meanwhile the worker goes on handling the events of other clients. */
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(::write(ping_fds[1], "p", 1), 1);
+    for (int j = 0; j < 100 && worker.pings == i; j++) worker.loopOnce(10);
+    EXPECT_EQ(worker.pings, i + 1);
+  }
+  EXPECT_FALSE(server.ssl_connected);
+  {
+    std::lock_guard<std::mutex> lock(handshake_threads_mtx);
+    handshake_gate_closed = false;
+  }
+  handshake_threads_cv.notify_all();
+
+  for (int i = 0; i < 2000 && !(client.ssl_connected && server.ssl_connected);
+       i++) {
+    if (!client.ssl_connected) {
+      client.handshake_retries = 0;
+      ssl::SSLConnectionManager::handleHandshake(client_ctx.get(), client,
+                                                 true);
+    }
+    worker.loopOnce(1);
+  }
+  worker.handshake_offload->waitIdle();
+  EXPECT_TRUE(server.ssl_connected);
+  EXPECT_EQ(worker.errors, 0);
+  {
+    std::lock_guard<std::mutex> lock(handshake_threads_mtx);
+    EXPECT_EQ(handshake_threads.size(), 1u);
+    EXPECT_EQ(handshake_threads.count(std::this_thread::get_id()), 0u);
+  }
+  server.disableEvents();
+  ping.disableEvents();
+  ::close(ping_fds[1]);
+  ssl::HandshakePool::getInstance().stop();
+}
+
+TEST(HandshakeOffloadTest, RunsHandshakesInThePool) {
+  ssl::HandshakePool::getInstance().start(2);
+  ASSERT_TRUE(ssl::HandshakePool::getInstance().isRunning());
+  auto ssl_context = offloadServerContext(2048);
+  HandshakeWorker worker(*ssl_context, true);
+  EXPECT_EQ(offloadHandshakes(worker, 4), 4);
+  EXPECT_EQ(worker.errors, 0);
+  EXPECT_GE(worker.steps, 8);
+  ssl::HandshakePool::getInstance().stop();
+  EXPECT_FALSE(ssl::HandshakePool::getInstance().isRunning());
+}
+
+TEST(HandshakeOffloadTest, Benchmark) {
+  const int handshakes = 32;
+  ssl::HandshakePool::getInstance().start(2);
+  auto ssl_context = offloadServerContext(3072);
+  HandshakeWorker inline_worker(*ssl_context, false);
+  HandshakeWorker offload_worker(*ssl_context, true);
+  EXPECT_EQ(offloadHandshakes(inline_worker, handshakes), handshakes);
+  EXPECT_EQ(offloadHandshakes(offload_worker, handshakes), handshakes);
+  ssl::HandshakePool::getInstance().stop();
+  std::cout << handshakes << " RSA 3072 handshakes, event loop stall "
+            << inline_worker.stall_us / handshakes << " us inline, "
+            << offload_worker.stall_us / handshakes << " us offloaded"
+            << std::endl;
+}
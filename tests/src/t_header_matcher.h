@@ -0,0 +1,183 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/util/header_matcher.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** Whether @p matcher matches the header line @p line. */
+static bool headerMatches(const HeaderMatcher &matcher,
+                          const std::string &line) {
+  return matcher.matches(line.data(), line.size(), line.find(':'));
+}
+
+/** Whether any of @p patterns matches @p line, one after the other. */
+static bool headerMatchesAny(
+    const std::vector<std::unique_ptr<RegexPattern>> &patterns,
+    const std::string &line) {
+  for (auto &pattern : patterns)
+    if (pattern->match(std::string_view(line))) return true;
+  return false;
+}
+
+static const std::vector<std::string> header_patterns = {
+    "^X-Forwarded-For:",     "^X-Real-IP",         "Powered-By",
+    "^Host: internal\\.",    "^Via:.*$",           "^X-(Debug|Trace)-",
+    "^Cookie:.*session=",    "^(Proxy|Surrogate)", "^X-Amz-.*:",
+    "^Server:[[:space:]]*",  "([a-z])\\1{3}",      "^x-internal$"};
+
+static const std::vector<std::string> header_lines = {
+    "X-Forwarded-For: 10.0.0.1",
+    "x-forwarded-for: 10.0.0.1",
+    "X-Forwarded-For-Original: 10.0.0.1",
+    "X-Forwarded: for=10.0.0.1",
+    "X-Real-IP: 10.0.0.1",
+    "X-Real-IPv6: ::1",
+    "X-Powered-By: PHP",
+    "X-Engine: powered-by-php",
+    "Host: internal.example.com",
+    "Host: www.example.com",
+    "Via: 1.1 proxy",
+    "X-Via: 1.1 proxy",
+    "X-Debug-Id: 1",
+    "X-Trace-Id: 1",
+    "X-Request-Id: 1",
+    "Cookie: theme=dark; session=abc",
+    "Cookie: theme=dark",
+    "Proxy-Authorization: Basic eg==",
+    "Surrogate-Control: no-store",
+    "X-Amz-Date: 20240101",
+    "Server: nginx",
+    "Accept: aaaa/bbbb",
+    "Accept: text/html",
+    "X-Internal: 1"};
+
+TEST(HeaderMatcherTest, MatchesAsThePatterns) {
+  std::vector<std::unique_ptr<RegexPattern>> patterns;
+  HeaderMatcher all;
+  for (auto &pattern : header_patterns) {
+    patterns.push_back(std::make_unique<RegexPattern>());
+    ASSERT_TRUE(patterns.back()->compile(pattern.c_str(),
+                                         REG_ICASE | REG_NEWLINE | REG_EXTENDED));
+    HeaderMatcher single;
+    ASSERT_TRUE(single.add(pattern));
+    ASSERT_TRUE(all.add(pattern));
+    for (auto &line : header_lines)
+      EXPECT_EQ(headerMatches(single, line), patterns.back()->match(line.c_str()))
+          << pattern << " on " << line;
+  }
+  /* Twice, the second one from the memo. */
+  for (int round = 0; round < 2; round++)
+    for (auto &line : header_lines)
+      EXPECT_EQ(headerMatches(all, line), headerMatchesAny(patterns, line))
+          << line;
+}
+
+TEST(HeaderMatcherTest, MatchesTheHeaderLineOnly) {
+  HeaderMatcher matcher;
+  ASSERT_TRUE(matcher.add("^X-Forwarded-For:"));
+  ASSERT_TRUE(matcher.add("^Host: internal"));
+  /* The next header in the buffer is not part of the line. */
+  std::string headers = "Host: www.example.com\r\nX-Forwarded-For: 1\r\n";
+  EXPECT_FALSE(matcher.matches(headers.data(), headers.find('\r'), 4));
+  EXPECT_TRUE(matcher.matches(headers.data() + 23, 18, 15));
+  /* Only the beginning of the line is anchored. */
+  EXPECT_FALSE(headerMatches(matcher, "X-Host: internal"));
+  EXPECT_TRUE(headerMatches(matcher, "HOST: Internal"));
+}
+
+TEST(HeaderMatcherTest, KeepsTheMatchersApart) {
+  HeaderMatcher request_matcher, response_matcher;
+  ASSERT_TRUE(request_matcher.add("^X-Forwarded-For:"));
+  ASSERT_TRUE(response_matcher.add("^Server:"));
+  for (int round = 0; round < 2; round++) {
+    EXPECT_TRUE(headerMatches(request_matcher, "X-Forwarded-For: 1"));
+    EXPECT_FALSE(headerMatches(response_matcher, "X-Forwarded-For: 1"));
+    EXPECT_FALSE(headerMatches(request_matcher, "Server: zproxy"));
+    EXPECT_TRUE(headerMatches(response_matcher, "Server: zproxy"));
+  }
+  HeaderMatcher empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_FALSE(headerMatches(empty, "Server: zproxy"));
+  EXPECT_FALSE(empty.add("^X-(Unbalanced"));
+  EXPECT_TRUE(empty.empty());
+}
+
+TEST(HeaderMatcherTest, Benchmark) {
+  std::vector<std::string> patterns;
+  for (auto name : {"X-Forwarded-For", "X-Forwarded-Host", "X-Forwarded-Proto",
+                    "X-Real-IP", "X-Client-IP", "X-Cluster-Client-IP",
+                    "X-Original-URL", "X-Rewrite-URL", "X-Debug", "X-Trace-Id",
+                    "X-Powered-By", "X-AspNet-Version", "X-Runtime",
+                    "X-Backend-Server", "X-Cache-Debug", "Proxy-Connection",
+                    "Surrogate-Capability", "True-Client-IP", "Forwarded",
+                    "Via"})
+    patterns.push_back(std::string("^") + name + ":");
+  for (auto pattern : {"^X-Amz-.*:", "^X-(Internal|Private)-", "Powered-By",
+                       "^Cookie:.*debug="})
+    patterns.push_back(pattern);
+  std::vector<std::unique_ptr<RegexPattern>> regexes;
+  HeaderMatcher matcher;
+  for (auto &pattern : patterns) {
+    regexes.push_back(std::make_unique<RegexPattern>());
+    ASSERT_TRUE(regexes.back()->compile(pattern.c_str(),
+                                        REG_ICASE | REG_NEWLINE | REG_EXTENDED));
+    ASSERT_TRUE(matcher.add(pattern));
+  }
+  const std::vector<std::string> request = {
+      "Host: www.example.com",
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:120.0) Gecko/20100101",
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8",
+      "Accept-Language: en-US,en;q=0.5",
+      "Accept-Encoding: gzip, deflate, br",
+      "Connection: keep-alive",
+      "Cookie: theme=dark; session=0123456789abcdef",
+      "Upgrade-Insecure-Requests: 1",
+      "X-Forwarded-For: 192.168.1.10",
+      "Cache-Control: max-age=0"};
+  const int rounds = 2000;
+  size_t regex_removed = 0, matcher_removed = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++)
+    for (auto &line : request) regex_removed += headerMatchesAny(regexes, line);
+  auto regex_time = std::chrono::steady_clock::now() - start;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++)
+    for (auto &line : request) matcher_removed += headerMatches(matcher, line);
+  auto matcher_time = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(matcher_removed, regex_removed);
+  EXPECT_EQ(matcher_removed, static_cast<size_t>(rounds));
+
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  auto header_count = rounds * request.size();
+  std::cout << patterns.size() << " patterns: one by one "
+            << duration_cast<nanoseconds>(regex_time).count() / header_count
+            << " ns, single pass "
+            << duration_cast<nanoseconds>(matcher_time).count() / header_count
+            << " ns per header" << std::endl;
+}
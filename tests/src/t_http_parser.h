@@ -24,6 +24,8 @@
 #include "../../src/debug/logger.h"
 #include "../../src/http/http_parser.h"
 #include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
 #include <string>
 
 static int bufis(const char *s, size_t l, const char *t) {
@@ -64,3 +66,203 @@ TEST(HttpParserTest, HttpParserTest1) {
   ASSERT_TRUE(bufis(headers[1].name, headers[1].name_len, "User-Agent"));
   ASSERT_TRUE(bufis(headers[1].value, headers[1].value_len, "\343\201\262\343/1.0"));
 }
+
+TEST(HttpParserTest, HttpDataSpillsManyHeaders) {
+  http_parser::HttpData request;
+  std::string s = "GET / HTTP/1.1\r\n";
+  for (int i = 0; i < INLINE_HEADERS_SIZE * 2; i++)
+    s += "X-Header-" + std::to_string(i) + ": " + std::to_string(i) + "\r\n";
+  s += "\r\n";
+  size_t parsed = 0;
+  ASSERT_EQ(request.parseRequest(s, &parsed),
+            http_parser::PARSE_RESULT::SUCCESS);
+  ASSERT_EQ(parsed, s.size());
+  ASSERT_EQ(request.num_headers, static_cast<size_t>(INLINE_HEADERS_SIZE * 2));
+  auto &last = request.headers[request.num_headers - 1];
+  ASSERT_TRUE(bufis(last.value, last.value_len,
+                    std::to_string(INLINE_HEADERS_SIZE * 2 - 1).c_str()));
+
+  /* Over the limit is still a parse error. */
+  std::string too_many = "GET / HTTP/1.1\r\n";
+  for (int i = 0; i <= MAX_HEADERS_SIZE; i++) too_many += "X-A: b\r\n";
+  too_many += "\r\n";
+  ASSERT_EQ(request.parseRequest(too_many, &parsed),
+            http_parser::PARSE_RESULT::FAILED);
+}
+
+TEST(HttpParserTest, HttpDataExtraHeaders) {
+  http_parser::HttpData request;
+  std::string s = "GET / HTTP/1.1\r\nHost: zproxy\r\n\r\n";
+  size_t parsed = 0;
+  ASSERT_EQ(request.parseRequest(s, &parsed),
+            http_parser::PARSE_RESULT::SUCCESS);
+  request.addHeader(http::HTTP_HEADER_NAME::X_FORWARDED_FOR, "10.0.0.1");
+  request.addHeader(http::HTTP_HEADER_NAME::DESTINATION, "/a");
+  request.addHeader("X-Permanent: 1", true);
+  request.removeHeader(http::HTTP_HEADER_NAME::X_FORWARDED_FOR);
+  request.prepareToSend();
+  std::string sent;
+  for (size_t i = 0; i < request.iov_size; i++)
+    sent.append(static_cast<char *>(request.iov[i].iov_base),
+                request.iov[i].iov_len);
+  ASSERT_EQ(sent,
+            "GET / HTTP/1.1\r\nHost: zproxy\r\nDestination: /a\r\n"
+            "X-Permanent: 1\r\n\r\n");
+
+  /* Only the permanent headers survive the next message. */
+  request.reset_parser();
+  ASSERT_TRUE(request.extra_headers.empty());
+  ASSERT_EQ(request.permanent_extra_headers, "X-Permanent: 1\r\n");
+}
+
+/** A request with @p count headers whose values are @p value_size long. */
+static std::string trickledRequest(int count, size_t value_size) {
+  std::string s = "GET /index.html HTTP/1.1\r\n";
+  for (int i = 0; i < count; i++)
+    s += "X-Header-" + std::to_string(i) + ": " + std::string(value_size, 'v') +
+         "\r\n";
+  return s + "\r\n";
+}
+
+/**
+ * Parses @p s as a client that sends a byte per read would, into @p buffers,
+ * moving it from the first to the second one at @p move_at, and returns the
+ * nanoseconds spent. @p reparse drops the parser state before every read.
+ */
+static long trickleParse(http_parser::HttpData &request, const std::string &s,
+                         std::string (&buffers)[2],
+                         size_t move_at = std::string::npos,
+                         bool reparse = false) {
+  auto &buffer = buffers[0], &moved = buffers[1];
+  buffer.assign(s.size(), '\0');
+  moved.assign(s.size(), '\0');
+  auto data = &buffer[0];
+  size_t parsed = 0;
+  auto result = http_parser::PARSE_RESULT::INCOMPLETE;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t size = 1; size <= s.size(); size++) {
+    data[size - 1] = s[size - 1];
+    if (size == move_at) {
+      std::copy(data, data + size, &moved[0]);
+      data = &moved[0];
+    }
+    if (reparse) request.reset_parser();
+    result = request.parseRequest(data, size, &parsed);
+    if (size < s.size()) {
+      EXPECT_EQ(result, http_parser::PARSE_RESULT::INCOMPLETE) << size;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  EXPECT_EQ(result, http_parser::PARSE_RESULT::SUCCESS);
+  EXPECT_EQ(parsed, s.size());
+  EXPECT_EQ(request.buffer, data);
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+      .count();
+}
+
+TEST(HttpParserTest, HttpDataResumesIncompleteMessages) {
+  /* Spills to the heap headers in the middle of the message. */
+  auto s = trickledRequest(INLINE_HEADERS_SIZE * 2, 10);
+  http_parser::HttpData whole;
+  size_t parsed = 0;
+  ASSERT_EQ(whole.parseRequest(s, &parsed), http_parser::PARSE_RESULT::SUCCESS);
+  for (auto move_at : {std::string::npos, s.size() / 2}) {
+    http_parser::HttpData request;
+    std::string buffers[2];
+    trickleParse(request, s, buffers, move_at);
+    ASSERT_EQ(request.num_headers, whole.num_headers);
+    ASSERT_TRUE(bufis(request.method, request.method_len, "GET"));
+    ASSERT_TRUE(bufis(request.path, request.path_length, "/index.html"));
+    ASSERT_EQ(request.minor_version, 1);
+    for (size_t i = 0; i != request.num_headers; i++) {
+      ASSERT_EQ(std::string(request.headers[i].name, request.headers[i].name_len),
+                std::string(whole.headers[i].name, whole.headers[i].name_len));
+      ASSERT_EQ(
+          std::string(request.headers[i].value, request.headers[i].value_len),
+          std::string(whole.headers[i].value, whole.headers[i].value_len));
+      ASSERT_EQ(request.headers[i].line_size, whole.headers[i].line_size);
+    }
+    /* The next message starts over in the same buffer. */
+    std::string next = "GET /next HTTP/1.0\r\n\r\n";
+    ASSERT_EQ(request.parseRequest(next.data(), next.size(), &parsed),
+              http_parser::PARSE_RESULT::SUCCESS);
+    ASSERT_TRUE(bufis(request.path, request.path_length, "/next"));
+    ASSERT_EQ(request.num_headers, 0u);
+  }
+
+  /* An error in a line is found once the line ends. */
+  http_parser::HttpData request;
+  std::string bad = "GET / HTTP/1.1\r\nHost: zproxy\r\nBad Name: 1\r\n\r\n";
+  auto bad_line = bad.find("Bad");
+  EXPECT_EQ(request.parseRequest(bad.data(), bad_line, &parsed),
+            http_parser::PARSE_RESULT::INCOMPLETE);
+  EXPECT_EQ(request.parseRequest(bad.data(), bad_line + 5, &parsed),
+            http_parser::PARSE_RESULT::INCOMPLETE);
+  EXPECT_EQ(request.parseRequest(bad.data(), bad.size(), &parsed),
+            http_parser::PARSE_RESULT::FAILED);
+
+  /* Without a line end a new message is still checked, a TLS ClientHello
+   * sent to a plain port is rejected with its first read. */
+  const std::string client_hello("\x16\x03\x01\x02\x00\x01\x00\x01\xfc\x03\x03", 11);
+  http_parser::HttpData tls;
+  EXPECT_EQ(tls.parseRequest(client_hello.data(), client_hello.size(), &parsed),
+            http_parser::PARSE_RESULT::FAILED);
+
+  http_parser::HttpData response;
+  std::string r = "HTTP/1.1 200 OK\r\nServer: zproxy\r\nContent-Length: 0\r\n\r\n";
+  for (size_t size = 1; size < r.size(); size++)
+    ASSERT_EQ(response.parseResponse(r.data(), size, &parsed),
+              http_parser::PARSE_RESULT::INCOMPLETE);
+  ASSERT_EQ(response.parseResponse(r.data(), r.size(), &parsed),
+            http_parser::PARSE_RESULT::SUCCESS);
+  ASSERT_EQ(response.http_status_code, 200);
+  ASSERT_EQ(response.num_headers, 2u);
+  ASSERT_TRUE(bufis(response.headers[1].value, response.headers[1].value_len, "0"));
+}
+
+TEST(HttpParserTest, HttpDataParsesEachLineOnce) {
+  /* A byte per read, after every read only the incomplete line is left, the
+   * complete ones are never parsed again. */
+  auto s = trickledRequest(INLINE_HEADERS_SIZE * 2, 30);
+  std::string buffer(s.size(), '\0');
+  http_parser::HttpData request;
+  size_t parsed = 0, line_start = 0;
+  for (size_t size = 1; size <= s.size(); size++) {
+    buffer[size - 1] = s[size - 1];
+    auto result = request.parseRequest(buffer.data(), size, &parsed);
+    if (size == s.size()) {
+      ASSERT_EQ(result, http_parser::PARSE_RESULT::SUCCESS);
+      break;
+    }
+    ASSERT_EQ(result, http_parser::PARSE_RESULT::INCOMPLETE) << size;
+    if (s[size - 1] == '\n') line_start = size;
+    ASSERT_EQ(request.parsed_length, line_start) << size;
+    ASSERT_EQ(request.last_length, size);
+  }
+  ASSERT_EQ(parsed, s.size());
+  ASSERT_EQ(request.num_headers, static_cast<size_t>(INLINE_HEADERS_SIZE * 2));
+}
+
+TEST(HttpParserTest, SlowClientBenchmark) {
+  /* A byte per read, the cost per byte does not grow with the message. */
+  auto small = trickledRequest(20, 100);
+  auto large = trickledRequest(80, 100);
+  long small_time = 0, large_time = 0, reparse_time = 0;
+  std::string buffers[2];
+  for (int round = 0; round < 3; round++) {
+    http_parser::HttpData request;
+    auto time = trickleParse(request, small, buffers);
+    small_time = round == 0 ? time : std::min(small_time, time);
+    time = trickleParse(request, large, buffers);
+    large_time = round == 0 ? time : std::min(large_time, time);
+  }
+  http_parser::HttpData request;
+  reparse_time = trickleParse(request, large, buffers, std::string::npos, true);
+  std::cout << "slow client: " << small.size() << " bytes "
+            << static_cast<double>(small_time) / small.size() << " ns/byte, "
+            << large.size() << " bytes "
+            << static_cast<double>(large_time) / large.size()
+            << " ns/byte, parsed again in every read "
+            << static_cast<double>(reparse_time) / large.size() << " ns/byte"
+            << std::endl;
+}
@@ -0,0 +1,188 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/http/http_scan.h"
+#include "gtest/gtest.h"
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/** Range pairs as the parser passes them, padded to the 16 bytes read. */
+struct ScanRanges {
+  char ranges[17];
+  size_t size;
+};
+
+/** The range sets of the request parser: line end, value, token, name. */
+static const std::vector<ScanRanges> &scanRanges() {
+  static const std::vector<ScanRanges> ranges = {
+      {"\r\r\n\n", 4},
+      {"\000\040\177\177", 4},
+      {"\0\010\012\037\177\177", 6},
+      {"\x00 \"\"(),,//:@[]{\377", 16},
+      {"::", 2},
+  };
+  return ranges;
+}
+
+static std::vector<http::scan::KERNEL> scanKernels() {
+  std::vector<http::scan::KERNEL> kernels;
+  for (auto kernel : {http::scan::KERNEL::SCALAR, http::scan::KERNEL::SSE42,
+                      http::scan::KERNEL::AVX2})
+    if (http::scan::supported(kernel)) kernels.push_back(kernel);
+  return kernels;
+}
+
+TEST(HttpScanTest, KernelsMatchTheScalarOne) {
+  std::mt19937 random(42);
+  /* Mostly header text, with some control and high bytes. */
+  const std::string alphabet =
+      "abcdefghijklmnopqrstuvwxyz0123456789 %:;,/=\t\r\n\x01\x7f\x80\xff";
+  std::string buffer(200, 'x');
+  for (int round = 0; round < 300; round++) {
+    for (auto &c : buffer)
+      c = random() % 8 == 0 ? alphabet[random() % alphabet.size()]
+                            : static_cast<char>('a' + random() % 26);
+    for (size_t offset = 0; offset < 33; offset++) {
+      for (size_t length = 0; offset + length <= buffer.size();
+           length += 1 + length / 16) {
+        auto buf = buffer.data() + offset;
+        auto buf_end = buf + length;
+        for (auto &[ranges, size] : scanRanges()) {
+          auto expected = http::scan::findRanges(
+              http::scan::KERNEL::SCALAR, buf, buf_end, ranges, size);
+          for (auto kernel : scanKernels())
+            ASSERT_EQ(http::scan::findRanges(kernel, buf, buf_end,
+                                             ranges, size),
+                      expected)
+                << http::scan::kernelName(kernel) << " at " << offset << "+"
+                << length;
+        }
+        auto expected = http::scan::findEncodedNull(http::scan::KERNEL::SCALAR,
+                                                    buf, buf_end);
+        for (auto kernel : scanKernels())
+          ASSERT_EQ(http::scan::findEncodedNull(kernel, buf, buf_end), expected)
+              << http::scan::kernelName(kernel) << " at " << offset << "+"
+              << length;
+      }
+    }
+  }
+}
+
+TEST(HttpScanTest, FindsTheEncodedNull) {
+  for (auto kernel : scanKernels()) {
+    for (size_t position = 0; position < 70; position++) {
+      std::string path(80, 'a');
+      path.replace(position, 3, "%00");
+      auto found = http::scan::findEncodedNull(kernel, path.data(),
+                                               path.data() + path.size());
+      EXPECT_EQ(found - path.data(), static_cast<long>(position))
+          << http::scan::kernelName(kernel);
+      /* A truncated one is not found. */
+      auto end = path.data() + position + 2;
+      EXPECT_EQ(http::scan::findEncodedNull(kernel, path.data(), end), end)
+          << http::scan::kernelName(kernel);
+    }
+    const std::string path = "/a%0%%00%0";
+    EXPECT_EQ(http::scan::findEncodedNull(kernel, path.data(),
+                                          path.data() + path.size()) -
+                  path.data(),
+              5);
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+TEST(HttpScanTest, Benchmark) {
+  std::string corpus;
+  const std::string request =
+      "GET /static/js/app.min.js?v=20231024&lang=en HTTP/1.1\r\n"
+      "Host: www.example.com\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:120.0) Gecko/20100101 "
+      "Firefox/120.0\r\n"
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+      "Accept-Language: en-US,en;q=0.5\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "Referer: https://www.example.com/products/list?page=3&sort=price\r\n"
+      "Cookie: theme=dark; session=0123456789abcdef0123456789abcdef; "
+      "_ga=GA1.2.1234567890.1234567890\r\n"
+      "Connection: keep-alive\r\n"
+      "Cache-Control: max-age=0\r\n\r\n";
+  while (corpus.size() < 64 * 1024) corpus += request;
+  /* Each scan goes through a line as the parser does. */
+  std::vector<std::pair<size_t, size_t>> lines;
+  for (size_t start = 0, end; start < corpus.size(); start = end + 1) {
+    end = corpus.find('\n', start);
+    if (end == std::string::npos) break;
+    lines.emplace_back(start, end + 1);
+  }
+  /* The URL paths checked for "%00". */
+  const std::vector<std::string> paths = {
+      "/",
+      "/index.html",
+      "/static/js/app.min.js?v=20231024&lang=en",
+      "/api/v2/users/1234567/orders?status=shipped&sort=-created_at&page=2",
+      "/search?q=zproxy%20load%20balancer&category=software%2Fnetwork",
+      "/images/products/2023/10/large/1234567890abcdef-1920x1080.webp",
+      "/wp-content/themes/twentytwentythree/assets/fonts/inter/"
+      "Inter-VariableFont_slnt,wght.ttf?ver=6.3.2"};
+  size_t paths_size = 0;
+  for (auto &path : paths) paths_size += path.size();
+  auto &value_ranges = scanRanges()[2];
+  const int rounds = 200, path_rounds = 20000;
+  for (auto kernel : scanKernels()) {
+    size_t found = 0;
+    auto start = __rdtsc();
+    for (int round = 0; round < rounds; round++) {
+      for (auto &[begin, end] : lines) {
+        auto buf = corpus.data() + begin;
+        auto buf_end = corpus.data() + end;
+        found += http::scan::findRanges(kernel, buf, buf_end,
+                                        value_ranges.ranges,
+                                        value_ranges.size) != buf_end;
+      }
+    }
+    auto ranges_cycles = __rdtsc() - start;
+    EXPECT_EQ(found, lines.size() * rounds);
+    found = 0;
+    start = __rdtsc();
+    for (int round = 0; round < path_rounds; round++) {
+      for (auto &path : paths)
+        found += http::scan::findEncodedNull(kernel, path.data(),
+                                             path.data() + path.size()) !=
+                 path.data() + path.size();
+    }
+    auto null_cycles = __rdtsc() - start;
+    EXPECT_EQ(found, 0u);
+    std::cout << "http scan " << http::scan::kernelName(kernel)
+              << ": header lines "
+              << static_cast<double>(corpus.size()) * rounds / ranges_cycles
+              << " bytes/cycle, encoded null "
+              << static_cast<double>(paths_size) * path_rounds / null_cycles
+              << " bytes/cycle" << std::endl;
+  }
+}
+#endif
@@ -0,0 +1,369 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/event/epoll_manager.h"
+#include "gtest/gtest.h"
+#include "t_reload.h"
+#include <sys/socket.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace events;
+
+/* Echo-less handler that behaves like a worker: reads the pending data and
+ * re-arms the one shot read event. */
+class EngineTestHandler : public EpollManager {
+ public:
+  int reads{0};
+  int writes{0};
+  int disconnects{0};
+  std::string received;
+  explicit EngineTestHandler(EVENT_ENGINE engine) : EpollManager(engine) {}
+  void HandleEvent(int fd, EVENT_TYPE event_type,
+                   EVENT_GROUP event_group) override {
+    char buffer[1024];
+    ssize_t count;
+    switch (event_type) {
+      case EVENT_TYPE::READ:
+        while ((count = recv(fd, buffer, sizeof(buffer))) > 0)
+          received.append(buffer, static_cast<size_t>(count));
+        reads++;
+        updateFd(fd, EVENT_TYPE::READ_ONESHOT, event_group);
+        break;
+      case EVENT_TYPE::WRITE:
+        writes++;
+        break;
+      case EVENT_TYPE::DISCONNECT:
+        disconnects++;
+        deleteFd(fd);
+        break;
+      default:
+        break;
+    }
+  }
+};
+
+static void runEngineEvents(EVENT_ENGINE engine) {
+  EngineTestHandler handler(engine);
+  int pair[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair), 0);
+
+  /* Same epoll_ctl error contract. */
+  EXPECT_TRUE(handler.addFd(pair[0], EVENT_TYPE::READ_ONESHOT,
+                            EVENT_GROUP::CLIENT));
+  EXPECT_FALSE(handler.addFd(-1, EVENT_TYPE::READ, EVENT_GROUP::CLIENT));
+  EXPECT_EQ(handler.loopOnce(0), 0);
+
+  /* One shot read, re-armed by the handler. */
+  ASSERT_EQ(::write(pair[1], "a", 1), 1);
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.reads, 1);
+  ASSERT_EQ(::write(pair[1], "b", 1), 1);
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.reads, 2);
+
+  /* Write event, one shot. */
+  EXPECT_TRUE(
+      handler.updateFd(pair[0], EVENT_TYPE::WRITE, EVENT_GROUP::CLIENT));
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.writes, 1);
+  EXPECT_EQ(handler.loopOnce(10), 0);
+
+  /* Level triggered read keeps firing until the data is consumed. */
+  EXPECT_TRUE(handler.updateFd(pair[0], EVENT_TYPE::READ, EVENT_GROUP::CLIENT));
+  ASSERT_EQ(::write(pair[1], "c", 1), 1);
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.reads, 3);
+
+  /* Removed descriptors do not report anything. */
+  EXPECT_TRUE(handler.deleteFd(pair[0]));
+  ASSERT_EQ(::write(pair[1], "d", 1), 1);
+  EXPECT_EQ(handler.loopOnce(10), 0);
+
+  /* Peer close is reported as disconnect. */
+  EXPECT_TRUE(handler.addFd(pair[0], EVENT_TYPE::READ, EVENT_GROUP::CLIENT));
+  ::close(pair[1]);
+  handler.loopOnce(1000);
+  EXPECT_EQ(handler.disconnects, 1);
+  ::close(pair[0]);
+}
+
+TEST(EventEngineTest, EpollEvents) { runEngineEvents(EVENT_ENGINE::EPOLL); }
+
+#if ENABLE_IO_URING
+TEST(EventEngineTest, IoUringEvents) {
+  EngineTestHandler probe(EVENT_ENGINE::IO_URING);
+  if (probe.getEventEngine() != EVENT_ENGINE::IO_URING)
+    GTEST_SKIP() << "io_uring not supported by the running kernel";
+  runEngineEvents(EVENT_ENGINE::IO_URING);
+}
+#endif
+
+#if ENABLE_IO_URING
+TEST(EventEngineTest, IoUringMultishotRecv) {
+  EngineTestHandler handler(EVENT_ENGINE::IO_URING);
+  int pair[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair), 0);
+  ASSERT_TRUE(
+      handler.addFd(pair[0], EVENT_TYPE::READ_ONESHOT, EVENT_GROUP::CLIENT));
+  if (!handler.enableRecv(pair[0]))
+    GTEST_SKIP() << "multishot recv not supported by the running kernel";
+  EXPECT_TRUE(handler.isRecvEnabled(pair[0]));
+  handler.loopOnce(0);
+
+  /* The data comes with the event, no read(2) is needed. */
+  ASSERT_EQ(::write(pair[1], "hello", 5), 5);
+  auto syscalls = handler.getSyscalls();
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.received, "hello");
+  EXPECT_LE(handler.getSyscalls() - syscalls, 1u);
+
+  /* Data received while disabled is kept and reported once enabled. */
+  EXPECT_TRUE(handler.disableFd(pair[0]));
+  ASSERT_EQ(::write(pair[1], " world", 6), 6);
+  EXPECT_EQ(handler.loopOnce(10), 0);
+  EXPECT_TRUE(handler.hasRecvData(pair[0]));
+  EXPECT_TRUE(handler.updateFd(pair[0], EVENT_TYPE::READ, EVENT_GROUP::CLIENT));
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.received, "hello world");
+  EXPECT_FALSE(handler.hasRecvData(pair[0]));
+
+  /* More than one provided buffer, in order. */
+  std::string data;
+  for (int i = 0; data.size() < 3 * IO_URING_RECV_BUFFER_SIZE; i++)
+    data += std::to_string(i) + ",";
+  handler.received.clear();
+  ASSERT_EQ(::write(pair[1], data.data(), data.size()),
+            static_cast<ssize_t>(data.size()));
+  for (int i = 0; i < 10 && handler.received.size() < data.size(); i++)
+    handler.loopOnce(1000);
+  EXPECT_EQ(handler.received, data);
+
+  /* The hang up is reported after the data. */
+  handler.received.clear();
+  ASSERT_EQ(::write(pair[1], "bye", 3), 3);
+  ::close(pair[1]);
+  for (int i = 0; i < 10 && handler.disconnects == 0; i++)
+    handler.loopOnce(1000);
+  EXPECT_EQ(handler.received, "bye");
+  EXPECT_EQ(handler.disconnects, 1);
+  EXPECT_FALSE(handler.isRecvEnabled(pair[0]));
+  ::close(pair[0]);
+}
+
+TEST(EventEngineTest, IoUringMultishotRecvOutOfBuffers) {
+  EngineTestHandler handler(EVENT_ENGINE::IO_URING);
+  /* Enough fds not reading to take every provided buffer. */
+  const int stalled =
+      2 * IO_URING_RECV_BUFFERS / IO_URING_RECV_FD_BUFFERS;
+  const size_t size = (IO_URING_RECV_FD_BUFFERS + 4) * IO_URING_RECV_BUFFER_SIZE;
+  std::string data;
+  for (int i = 0; data.size() < size; i++) data += std::to_string(i) + ",";
+  std::vector<int> pairs((stalled + 1) * 2);
+  for (int i = 0; i <= stalled; i++) {
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0,
+                           &pairs[i * 2]),
+              0);
+    int buffer_size = 4 * static_cast<int>(size);
+    ::setsockopt(pairs[i * 2 + 1], SOL_SOCKET, SO_SNDBUF, &buffer_size,
+                 sizeof(buffer_size));
+    ASSERT_TRUE(handler.addFd(pairs[i * 2], EVENT_TYPE::READ_ONESHOT,
+                              EVENT_GROUP::CLIENT));
+    if (!handler.enableRecv(pairs[i * 2]))
+      GTEST_SKIP() << "multishot recv not supported by the running kernel";
+  }
+  handler.loopOnce(0);
+  for (int i = 0; i < stalled; i++) {
+    EXPECT_TRUE(handler.disableFd(pairs[i * 2]));
+    ASSERT_EQ(::write(pairs[i * 2 + 1], data.data(), data.size()),
+              static_cast<ssize_t>(data.size()));
+  }
+  for (int i = 0; i < 5; i++) handler.loopOnce(10);
+
+  /* The last fd still gets its data, read(2) from the socket. */
+  int last = pairs[stalled * 2];
+  ASSERT_EQ(::write(pairs[stalled * 2 + 1], "ping", 4), 4);
+  EXPECT_EQ(handler.loopOnce(1000), 1);
+  EXPECT_EQ(handler.received, "ping");
+  ::close(pairs[stalled * 2 + 1]);
+  handler.loopOnce(1000);
+  ::close(last);
+
+  /* The stalled ones get the data in order, from the buffers and the socket. */
+  for (int i = 0; i < stalled; i++) {
+    handler.received.clear();
+    EXPECT_TRUE(handler.updateFd(pairs[i * 2], EVENT_TYPE::READ,
+                                 EVENT_GROUP::CLIENT));
+    for (int loop = 0; loop < 100 && handler.received.size() < data.size();
+         loop++)
+      handler.loopOnce(1000);
+    EXPECT_EQ(handler.received, data) << "fd " << i;
+    handler.deleteFd(pairs[i * 2]);
+    ::close(pairs[i * 2]);
+    ::close(pairs[i * 2 + 1]);
+  }
+}
+
+/*
+ * The plain HTTP clients of an io_uring worker are read by the multishot
+ * recv: requests spanning several provided buffers and pipelined requests
+ * are proxied as with epoll.
+ */
+TEST(EventEngineTest, IoUringProxiesPlainClients) {
+  ReloadBackend backend("one");
+  int port = reloadFreePort();
+  char file_name[] = "/tmp/zproxy_io_uring_XXXXXX";
+  ::close(::mkstemp(file_name));
+  {
+    std::ofstream config(file_name);
+    config << "Threads 1\nEventEngine io_uring\n"
+              "ListenHTTP\n\tAddress 127.0.0.1\n\tPort "
+           << port
+           << "\n\tService \"srv\"\n\t\tBackEnd\n"
+              "\t\t\tAddress 127.0.0.1\n\t\t\tPort "
+           << backend.port << "\n\t\tEnd\n\tEnd\nEnd\n";
+  }
+  Config config;
+  ASSERT_TRUE(config.init(std::string(file_name)));
+  config.setAsCurrent();
+  ListenerManager listener;
+  for (auto lc = config.listeners; lc != nullptr; lc = lc->next)
+    ASSERT_TRUE(listener.addListener(lc));
+  std::thread listener_thread([&listener] { listener.start(); });
+
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  timeval read_timeout{5, 0};
+  ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &read_timeout,
+               sizeof(read_timeout));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  for (int i = 0; i < 100 && ::connect(client,
+                                       reinterpret_cast<sockaddr *>(&address),
+                                       sizeof(address)) != 0;
+       i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  bool io_uring =
+      listener.getWorker(0)->getEventEngine() == EVENT_ENGINE::IO_URING;
+  if (io_uring) {
+    EXPECT_EQ(reloadRequest(client), "one");
+
+    /* Headers larger than a provided buffer. */
+    std::string request = "GET / HTTP/1.1\r\nHost: io-uring.test\r\nX-Pad: " +
+                          std::string(2 * IO_URING_RECV_BUFFER_SIZE, 'a') +
+                          "\r\n\r\n";
+    /* Followed by a pipelined one, in the same write. */
+    request += "GET / HTTP/1.1\r\nHost: io-uring.test\r\n\r\n";
+    ASSERT_EQ(::write(client, request.data(), request.size()),
+              static_cast<ssize_t>(request.size()));
+    std::string responses;
+    char buffer[4096];
+    ssize_t size;
+    while (responses.find("one", responses.find("one") + 3) ==
+               std::string::npos &&
+           (size = ::read(client, buffer, sizeof(buffer))) > 0)
+      responses.append(buffer, static_cast<size_t>(size));
+    EXPECT_EQ(responses.find("HTTP/1.1 200"), 0u);
+    EXPECT_NE(responses.find("HTTP/1.1 200", 1), std::string::npos);
+    EXPECT_EQ(reloadRequest(client), "one");
+  }
+
+  ::close(client);
+  listener.stop();
+  listener_thread.join();
+  ServiceManager::setInstance({});
+  global::run_options::getCurrent().use_io_uring = false;
+  ::unlink(file_name);
+  if (!io_uring) GTEST_SKIP() << "io_uring not supported by the running kernel";
+}
+#endif
+
+/*
+ * Microbenchmark: N connections receive a 128 bytes request per round, the
+ * handler reads it and re-arms the one shot read event as the workers do.
+ * With epoll every event costs an epoll_ctl(2) and the read(2) calls; with
+ * io_uring the re-arms are batched in the next wait, and with the multishot
+ * recv the data comes along with the completion so the read(2) calls are
+ * gone too.
+ */
+static double benchEngine(EVENT_ENGINE engine, int connections, int rounds,
+                          bool multishot, double &syscalls) {
+  EngineTestHandler handler(engine);
+  std::vector<int> pairs(connections * 2);
+  for (int i = 0; i < connections; i++) {
+    ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, &pairs[i * 2]);
+    handler.addFd(pairs[i * 2], EVENT_TYPE::READ_ONESHOT, EVENT_GROUP::CLIENT);
+    if (multishot) handler.enableRecv(pairs[i * 2]);
+  }
+  const std::string request(128, 'x');
+  handler.loopOnce(0);
+  auto start_syscalls = handler.getSyscalls();
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (int i = 0; i < connections; i++)
+      (void)!::write(pairs[i * 2 + 1], request.data(), request.size());
+    int expected = handler.reads + connections;
+    while (handler.reads < expected) handler.loopOnce(1000);
+    handler.received.clear();
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto events = static_cast<double>(connections) * rounds;
+  syscalls = static_cast<double>(handler.getSyscalls() - start_syscalls) / events;
+  for (auto fd : pairs) ::close(fd);
+  return std::chrono::duration<double, std::nano>(end - start).count() / events;
+}
+
+TEST(EventEngineTest, EngineBenchmark) {
+  const int connections = 256, rounds = 200;
+  double syscalls;
+  auto epoll_ns =
+      benchEngine(EVENT_ENGINE::EPOLL, connections, rounds, false, syscalls);
+  std::cout << "epoll: " << epoll_ns << " ns/event, " << syscalls
+            << " syscalls/event" << std::endl;
+#if ENABLE_IO_URING
+  EngineTestHandler probe(EVENT_ENGINE::IO_URING);
+  if (probe.getEventEngine() == EVENT_ENGINE::IO_URING) {
+    double poll_syscalls;
+    auto uring_ns = benchEngine(EVENT_ENGINE::IO_URING, connections, rounds,
+                                false, poll_syscalls);
+    std::cout << "io_uring poll: " << uring_ns << " ns/event, "
+              << poll_syscalls << " syscalls/event" << std::endl;
+    int pair[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair);
+    probe.addFd(pair[0], EVENT_TYPE::READ, EVENT_GROUP::CLIENT);
+    if (probe.enableRecv(pair[0])) {
+      auto recv_ns = benchEngine(EVENT_ENGINE::IO_URING, connections, rounds,
+                                 true, syscalls);
+      std::cout << "io_uring multishot recv: " << recv_ns << " ns/event, "
+                << syscalls << " syscalls/event" << std::endl;
+      EXPECT_LT(syscalls, poll_syscalls);
+    }
+    probe.deleteFd(pair[0]);
+    ::close(pair[0]);
+    ::close(pair[1]);
+  }
+#endif
+}
@@ -0,0 +1,181 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/ssl/ssl_connection_manager.h"
+#include "gtest/gtest.h"
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/x509.h>
+#include <string>
+#include <sys/socket.h>
+
+#ifdef SSL_OP_ENABLE_KTLS
+
+/** Connected non blocking TCP loopback sockets, client side first. */
+static std::pair<int, int> ktlsSocketPair() {
+  int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  ::bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  ::listen(listen_fd, 1);
+  ::getsockname(listen_fd, reinterpret_cast<sockaddr *>(&address), &length);
+  int client_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  ::connect(client_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  int server_fd = ::accept(listen_fd, nullptr, nullptr);
+  ::close(listen_fd);
+  for (int fd : {client_fd, server_fd})
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return {client_fd, server_fd};
+}
+
+/** Whether the kernel tls module can be attached to a TCP socket. */
+static bool ktlsKernelSupport() {
+  auto [client_fd, server_fd] = ktlsSocketPair();
+  bool supported = ::setsockopt(client_fd, SOL_TCP, TCP_ULP, "tls",
+                                sizeof("tls")) == 0;
+  ::close(client_fd);
+  ::close(server_fd);
+  return supported;
+}
+
+/** TLSv1.2 contexts with a self signed EC certificate. */
+static std::pair<std::shared_ptr<SSL_CTX>, std::shared_ptr<SSL_CTX>>
+ktlsContexts(bool enable_ktls, const char *ciphers) {
+  std::shared_ptr<SSL_CTX> server_ctx(SSL_CTX_new(TLS_server_method()),
+                                      &::SSL_CTX_free);
+  std::shared_ptr<SSL_CTX> client_ctx(SSL_CTX_new(TLS_client_method()),
+                                      &::SSL_CTX_free);
+  EVP_PKEY *key = EVP_EC_gen("P-256");
+  X509 *cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char *>("zproxy"),
+                             -1, -1, 0);
+  X509_set_issuer_name(cert, X509_get_subject_name(cert));
+  X509_sign(cert, key, EVP_sha256());
+  SSL_CTX_use_certificate(server_ctx.get(), cert);
+  SSL_CTX_use_PrivateKey(server_ctx.get(), key);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  for (auto ctx : {server_ctx.get(), client_ctx.get()}) {
+    // the receive offload of TLSv1.3 needs a newer OpenSSL
+    SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_cipher_list(ctx, ciphers);
+    if (enable_ktls) SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+  }
+  return {server_ctx, client_ctx};
+}
+
+static bool ktlsHandshake(SSL_CTX *server_ctx, Connection &server,
+                          SSL_CTX *client_ctx, Connection &client) {
+  for (int i = 0; i < 20 && !(server.ssl_connected && client.ssl_connected);
+       i++) {
+    if (!client.ssl_connected &&
+        !ssl::SSLConnectionManager::handleHandshake(client_ctx, client, true))
+      return false;
+    if (!server.ssl_connected &&
+        !ssl::SSLConnectionManager::handleHandshake(server_ctx, server))
+      return false;
+  }
+  return server.ssl_connected && client.ssl_connected;
+}
+
+/** Sends @p data from @p src and returns what @p dst received. */
+static std::string ktlsRelay(Connection &src, Connection &dst,
+                             const std::string &data) {
+  size_t written = 0;
+  EXPECT_EQ(ssl::SSLConnectionManager::handleWrite(src, data.data(),
+                                                   data.size(), written),
+            IO::IO_RESULT::SUCCESS);
+  EXPECT_EQ(written, data.size());
+  std::string received;
+  for (int i = 0; i < 1000 && received.size() < data.size(); i++) {
+    ssl::SSLConnectionManager::handleDataRead(dst);
+    if (dst.buffer == nullptr) continue;
+    received.append(dst.buffer + dst.buffer_offset, dst.buffer_size);
+    dst.buffer_size = 0;
+  }
+  dst.releaseBuffer();
+  return received;
+}
+
+TEST(KtlsTest, OffloadsRecordsToTheKernel) {
+  if (!ktlsKernelSupport()) GTEST_SKIP() << "the tls module is not loaded";
+  auto [server_ctx, client_ctx] =
+      ktlsContexts(true, "ECDHE-ECDSA-AES128-GCM-SHA256");
+  auto [client_fd, server_fd] = ktlsSocketPair();
+  Connection client, server;
+  client.setFileDescriptor(client_fd);
+  server.setFileDescriptor(server_fd);
+  ASSERT_TRUE(ktlsHandshake(server_ctx.get(), server, client_ctx.get(), client));
+  EXPECT_TRUE(server.ktls_send);
+  EXPECT_TRUE(server.ktls_recv);
+  EXPECT_TRUE(client.ktls_send);
+  EXPECT_TRUE(client.ktls_recv);
+  EXPECT_TRUE(ssl::SSLConnectionManager::isKtlsReadReady(server));
+  EXPECT_TRUE(ssl::SSLConnectionManager::isKtlsWriteReady(server));
+
+  const std::string request = "GET / HTTP/1.1\r\nHost: zproxy\r\n\r\n";
+  const std::string response(100000, 'k');
+  EXPECT_EQ(ktlsRelay(client, server, request), request);
+  EXPECT_EQ(ktlsRelay(server, client, response), response);
+}
+
+TEST(KtlsTest, FallsBackForUnsupportedCiphers) {
+  // CBC ciphers are never offloaded
+  auto [server_ctx, client_ctx] = ktlsContexts(true, "ECDHE-ECDSA-AES128-SHA");
+  auto [client_fd, server_fd] = ktlsSocketPair();
+  Connection client, server;
+  client.setFileDescriptor(client_fd);
+  server.setFileDescriptor(server_fd);
+  ASSERT_TRUE(ktlsHandshake(server_ctx.get(), server, client_ctx.get(), client));
+  EXPECT_FALSE(server.ktls_send || server.ktls_recv);
+  EXPECT_FALSE(client.ktls_send || client.ktls_recv);
+
+  const std::string request = "GET / HTTP/1.1\r\nHost: zproxy\r\n\r\n";
+  EXPECT_EQ(ktlsRelay(client, server, request), request);
+  EXPECT_EQ(ktlsRelay(server, client, request), request);
+}
+
+TEST(KtlsTest, KeepsOpenSslWhenDisabled) {
+  auto [server_ctx, client_ctx] =
+      ktlsContexts(false, "ECDHE-ECDSA-AES128-GCM-SHA256");
+  auto [client_fd, server_fd] = ktlsSocketPair();
+  Connection client, server;
+  client.setFileDescriptor(client_fd);
+  server.setFileDescriptor(server_fd);
+  ASSERT_TRUE(ktlsHandshake(server_ctx.get(), server, client_ctx.get(), client));
+  EXPECT_FALSE(server.ktls_send || server.ktls_recv);
+  EXPECT_FALSE(ssl::SSLConnectionManager::isKtlsReadReady(server));
+
+  const std::string response(100000, 'o');
+  EXPECT_EQ(ktlsRelay(server, client, response), response);
+}
+
+#endif
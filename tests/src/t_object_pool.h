@@ -0,0 +1,83 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/util/object_pool.h"
+#include "gtest/gtest.h"
+#include <set>
+#include <vector>
+
+struct PoolTestObject {
+  static int alive;
+  int value;
+  char buffer[1024 * 32];
+  explicit PoolTestObject(int value_ = 7) : value(value_) { alive++; }
+  ~PoolTestObject() { alive--; }
+};
+int PoolTestObject::alive = 0;
+
+TEST(ObjectPoolTest, ReusesReleasedSlots) {
+  ObjectPool<PoolTestObject, 4> pool;
+  auto first = pool.acquire();
+  ASSERT_NE(first, nullptr);
+  EXPECT_EQ(first->value, 7);
+  EXPECT_EQ(PoolTestObject::alive, 1);
+  EXPECT_EQ(pool.size(), 4u);
+  EXPECT_EQ(pool.inUse(), 1u);
+
+  /* Released objects are destroyed and the most recent slot is reused. */
+  pool.release(first);
+  EXPECT_EQ(PoolTestObject::alive, 0);
+  auto second = pool.acquire(42);
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(second->value, 42);
+
+  /* A new slab is mapped once the slots run out. */
+  std::vector<PoolTestObject *> objects{second};
+  for (int i = 0; i < 9; i++) objects.push_back(pool.acquire(i));
+  EXPECT_EQ(pool.size(), 12u);
+  EXPECT_EQ(pool.inUse(), 10u);
+  EXPECT_EQ((ObjectPool<PoolTestObject, 4>::total_slots.load()), 12);
+  EXPECT_EQ((ObjectPool<PoolTestObject, 4>::used_slots.load()), 10);
+  std::set<PoolTestObject *> unique(objects.begin(), objects.end());
+  EXPECT_EQ(unique.size(), objects.size());
+  for (auto object : objects) {
+    ASSERT_NE(object, nullptr);
+    object->buffer[sizeof(object->buffer) - 1] = 'x';
+    pool.release(object);
+  }
+  EXPECT_EQ(PoolTestObject::alive, 0);
+  EXPECT_EQ(pool.inUse(), 0u);
+  EXPECT_EQ(pool.size(), 12u);
+}
+
+TEST(ObjectPoolTest, CountersFollowThePools) {
+  {
+    ObjectPool<PoolTestObject, 2> pool;
+    pool.acquire();
+    EXPECT_EQ((ObjectPool<PoolTestObject, 2>::total_slots.load()), 2);
+    EXPECT_EQ((ObjectPool<PoolTestObject, 2>::used_slots.load()), 1);
+  }
+  EXPECT_EQ((ObjectPool<PoolTestObject, 2>::total_slots.load()), 0);
+  EXPECT_EQ((ObjectPool<PoolTestObject, 2>::used_slots.load()), 0);
+  PoolTestObject::alive = 0;
+}
@@ -0,0 +1,150 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/http/http_parser.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+TEST(PerfectHashTest, FindsTheHeaderNames) {
+  size_t known = 0;
+  for (auto &[header_name, name] : http::http_info::headers_names_strings) {
+    /* Some names are only written, as the ones added by the proxy. */
+    if (http::http_info::headers_names.find(name) == nullptr) continue;
+    known++;
+    std::string lower, upper;
+    for (char c : name) {
+      lower += static_cast<char>(std::tolower(c));
+      upper += static_cast<char>(std::toupper(c));
+    }
+    for (auto &variant : {name, lower, upper}) {
+      auto found = http::http_info::headers_names.find(variant);
+      ASSERT_NE(found, nullptr) << variant;
+      EXPECT_EQ(*found, header_name) << variant;
+    }
+    EXPECT_EQ(http::http_info::headers_names.find(name + "s"), nullptr);
+    EXPECT_EQ(http::http_info::headers_names.find(name.substr(1)), nullptr);
+  }
+  EXPECT_EQ(known, 82u);
+  /* Only the letters match in any case. */
+  for (auto name : {"", "Hos", "Hostname", "Content_Length", "Content-Lengtj",
+                    "X-Forwarded-Fo\x12", "Access-Control-Allow-Credentialz",
+                    "Content-Security-Policy-Report-Only-And-More-Than-48"})
+    EXPECT_EQ(http::http_info::headers_names.find(name), nullptr) << name;
+}
+
+TEST(PerfectHashTest, FindsTheMethodsAndConnectionValues) {
+  for (auto &[method, name] : http::http_info::http_verb_strings) {
+    auto found = http::http_info::http_verbs.find(name);
+    ASSERT_NE(found, nullptr) << name;
+    EXPECT_EQ(*found, method);
+  }
+  /* The methods are case sensitive. */
+  EXPECT_EQ(http::http_info::http_verbs.find("get"), nullptr);
+  EXPECT_EQ(http::http_info::http_verbs.find("GETS"), nullptr);
+
+  for (auto [value, connection_value] :
+       std::vector<std::pair<std::string, http::CONNECTION_VALUES>>{
+           {"Upgrade", http::CONNECTION_VALUES::UPGRADE},
+           {"upgrade", http::CONNECTION_VALUES::UPGRADE},
+           {"close", http::CONNECTION_VALUES::CLOSE},
+           {"Close", http::CONNECTION_VALUES::CLOSE},
+           {"keep-alive", http::CONNECTION_VALUES::KEEP_ALIVE}}) {
+    auto found = http::http_info::connection_values.find(value);
+    ASSERT_NE(found, nullptr) << value;
+    EXPECT_EQ(*found, connection_value);
+  }
+  EXPECT_EQ(http::http_info::connection_values.find("keep-alive, Upgrade"),
+            nullptr);
+}
+
+TEST(PerfectHashTest, Benchmark) {
+  /* The ordered map and the string keys the lookups used before. */
+  std::map<std::string, http::HTTP_HEADER_NAME, helper::ci_less> names_map;
+  for (auto &[header_name, name] : http::http_info::headers_names_strings)
+    names_map.emplace(name, header_name);
+  std::map<std::string, http::CONNECTION_VALUES, std::less<>> connection_map = {
+      {"Upgrade", http::CONNECTION_VALUES::UPGRADE},
+      {"close", http::CONNECTION_VALUES::CLOSE},
+      {"Keep-Alive", http::CONNECTION_VALUES::KEEP_ALIVE}};
+  const std::string request =
+      "GET /index.html HTTP/1.1\r\n"
+      "Host: www.example.com\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:120.0) Gecko/20100101\r\n"
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9\r\n"
+      "Accept-Language: en-US,en;q=0.5\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "Connection: Upgrade\r\n"
+      "Upgrade: websocket\r\n"
+      "Cookie: theme=dark; session=0123456789abcdef\r\n"
+      "Upgrade-Insecure-Requests: 1\r\n"
+      "X-Custom-Header: 1\r\n"
+      "If-None-Match: \"abc\"\r\n"
+      "Cache-Control: max-age=0\r\n\r\n";
+  const int rounds = 20000;
+  size_t map_known = 0, hash_known = 0;
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  std::chrono::steady_clock::duration map_time{}, hash_time{};
+  for (int round = 0; round < rounds; round++) {
+    http_parser::HttpData data;
+    size_t parsed = 0;
+    data.parseRequest(request, &parsed);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i != data.num_headers; i++) {
+      auto header = std::string_view(data.headers[i].name, data.headers[i].name_len);
+      auto it = names_map.find(header);
+      if (it == names_map.end()) continue;
+      map_known++;
+      if (it->second == http::HTTP_HEADER_NAME::CONNECTION)
+        map_known += connection_map.count(std::string(data.headers[i].value,
+                                                      data.headers[i].value_len));
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (size_t i = 0; i != data.num_headers; i++) {
+      auto header_name = http::http_info::headers_names.find(
+          std::string_view(data.headers[i].name, data.headers[i].name_len));
+      if (header_name == nullptr) continue;
+      hash_known++;
+      if (*header_name == http::HTTP_HEADER_NAME::CONNECTION)
+        hash_known += http::http_info::connection_values.find(std::string_view(
+                          data.headers[i].value, data.headers[i].value_len)) !=
+                      nullptr;
+    }
+    auto end = std::chrono::steady_clock::now();
+    map_time += middle - start;
+    hash_time += end - middle;
+  }
+  EXPECT_EQ(hash_known, map_known);
+  EXPECT_EQ(hash_known, static_cast<size_t>(rounds) * 12);
+
+  auto header_count = static_cast<size_t>(rounds) * 12;
+  std::cout << "header classification: map "
+            << duration_cast<nanoseconds>(map_time).count() / header_count
+            << " ns, perfect hash "
+            << duration_cast<nanoseconds>(hash_time).count() / header_count
+            << " ns per header" << std::endl;
+}
@@ -0,0 +1,178 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/util/regex_pattern.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Offsets of a pcreposix regexec() of @p pattern, empty if not matched. */
+static std::vector<std::pair<int, int>> posixMatch(const char *pattern,
+                                                   int flags,
+                                                   const char *subject) {
+  std::vector<std::pair<int, int>> groups;
+  regex_t regex;
+  if (::regcomp(&regex, pattern, flags) != 0) return groups;
+  regmatch_t matches[10];
+  if (::regexec(&regex, subject, 10, matches, 0) == 0)
+    for (auto &group : matches) groups.emplace_back(group.rm_so, group.rm_eo);
+  ::regfree(&regex);
+  return groups;
+}
+
+/** Offsets of a RegexPattern match of @p pattern, empty if not matched. */
+static std::vector<std::pair<int, int>> patternMatch(const char *pattern,
+                                                     int flags,
+                                                     const char *subject) {
+  std::vector<std::pair<int, int>> groups;
+  RegexPattern regex;
+  if (!regex.compile(pattern, flags)) return groups;
+  regmatch_t matches[10];
+  if (regex.match(subject, 10, matches))
+    for (auto &group : matches) groups.emplace_back(group.rm_so, group.rm_eo);
+  return groups;
+}
+
+TEST(RegexPatternTest, MatchesAsRegexec) {
+  const int flags = REG_ICASE | REG_NEWLINE | REG_EXTENDED;
+  for (auto &[pattern, subject] : std::vector<std::pair<const char *, const char *>>{
+           {"^(GET|POST|HEAD) ([^ ]+) HTTP/1.[01].*$",
+            "GET /index.html HTTP/1.1"},
+           {"^(GET|POST|HEAD) ([^ ]+) HTTP/1.[01].*$",
+            "get /index.html HTTP/1.0"},
+           {"^(GET|POST|HEAD) ([^ ]+) HTTP/1.[01].*$", "PUT / HTTP/1.1"},
+           {"^Host: (www\\.)?example\\.com$", "Host: example.com"},
+           {"^Host: (www\\.)?example\\.com$", "Host: other.com\nHost: example.com"},
+           {"^/(app|api)(/v[0-9]+)?/(.*)$", "/api/users"},
+           {".*html|.*png|.*jpg|.*mp4", "/images/logo.PNG"},
+           {"^/static/", "/dynamic/static/"}}) {
+    EXPECT_EQ(patternMatch(pattern, flags, subject),
+              posixMatch(pattern, flags, subject))
+        << pattern << " on " << subject;
+  }
+  /* The groups not taking part in the match are unset. */
+  auto groups = patternMatch("^/(app|api)(/v[0-9]+)?/(.*)$", flags, "/api/users");
+  ASSERT_FALSE(groups.empty());
+  EXPECT_EQ(groups[2], std::make_pair(-1, -1));
+  EXPECT_EQ(groups[3], std::make_pair(5, 10));
+  EXPECT_EQ(groups[4], std::make_pair(-1, -1));
+}
+
+TEST(RegexPatternTest, CompilesAndRecompiles) {
+  RegexPattern regex;
+  EXPECT_FALSE(regex.isCompiled());
+  EXPECT_FALSE(regex.match("anything"));
+  EXPECT_FALSE(regex.compile("^(unbalanced", REG_EXTENDED));
+  EXPECT_FALSE(regex.isCompiled());
+  ASSERT_TRUE(regex.compile("^first$", REG_EXTENDED));
+  EXPECT_TRUE(regex.match("first"));
+  EXPECT_FALSE(regex.match("FIRST"));
+  ASSERT_TRUE(regex.compile("^second$", REG_EXTENDED | REG_ICASE));
+  EXPECT_TRUE(regex.match("SECOND"));
+  EXPECT_FALSE(regex.match("first"));
+  /* The beginning of the subject is not a line start. */
+  EXPECT_FALSE(regex.match("second", 0, nullptr, REG_NOTBOL));
+}
+
+TEST(RegexPatternTest, MatchesFromSeveralThreads) {
+  RegexPattern regex;
+  ASSERT_TRUE(regex.compile("^/user/([0-9]+)$", REG_EXTENDED));
+  std::vector<std::thread> threads;
+  std::vector<int> matched(4, 0);
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&regex, &matched, t] {
+      for (int i = 0; i < 1000; i++) {
+        auto url = "/user/" + std::to_string(t * 1000 + i);
+        regmatch_t matches[2];
+        if (regex.match(url.c_str(), 2, matches) &&
+            url.substr(matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so) ==
+                std::to_string(t * 1000 + i))
+          matched[t]++;
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  EXPECT_EQ(matched, std::vector<int>(4, 1000));
+}
+
+TEST(RegexPatternTest, Benchmark) {
+  const int flags = REG_ICASE | REG_NEWLINE | REG_EXTENDED;
+  /* The xHTTP 3 and 4 verbs and the Content pattern of the test configs, and
+   * common URL and HeadRequire ones. */
+  std::vector<std::pair<const char *, std::vector<std::string>>> cases = {
+      {"^(GET|POST|HEAD|PUT|PATCH|DELETE|LOCK|UNLOCK|PROPFIND|PROPPATCH|SEARCH|"
+       "MKCOL|MKCALENDAR|MOVE|COPY|OPTIONS|TRACE|MKACTIVITY|CHECKOUT|MERGE|"
+       "REPORT|SUBSCRIBE|UNSUBSCRIBE|BPROPPATCH|POLL|BMOVE|BCOPY|BDELETE|"
+       "BPROPFIND|NOTIFY|CONNECT) ([^ ]+) HTTP/1.[01].*$",
+       {"GET /index.html HTTP/1.1", "NOTIFY /events/stream HTTP/1.1",
+        "BREW /pot HTTP/1.1"}},
+      {"^(GET|POST|HEAD|PUT|PATCH|DELETE|LOCK|UNLOCK|PROPFIND|PROPPATCH|SEARCH|"
+       "MKCOL|MKCALENDAR|MOVE|COPY|OPTIONS|TRACE|MKACTIVITY|CHECKOUT|MERGE|"
+       "REPORT|SUBSCRIBE|UNSUBSCRIBE|BPROPPATCH|POLL|BMOVE|BCOPY|BDELETE|"
+       "BPROPFIND|NOTIFY|CONNECT|RPC_IN_DATA|RPC_OUT_DATA|VERSION-CONTROL) ([^ "
+       "]+) HTTP/1.[01].*$",
+       {"POST /api/v1/users?page=2&sort=name HTTP/1.1",
+        "RPC_IN_DATA /rpc/rpcproxy.dll HTTP/1.1"}},
+      {".*html|.*png|.*jpg|.*mp4",
+       {"/index.html", "/assets/images/background.jpg", "/api/v1/users"}},
+      {"^/api/v[0-9]+/", {"/api/v1/users?page=2", "/static/app.js"}},
+      {"^Host: (www\\.)?example\\.com[[:space:]]*$",
+       {"Host: www.example.com", "Host: cdn.example.org"}},
+      {"^User-Agent: .*(bot|crawler|spider)",
+       {"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+        "(KHTML, like Gecko) Chrome/120.0 Safari/537.36",
+        "User-Agent: Googlebot/2.1 (+http://www.google.com/bot.html)"}}};
+  const int rounds = 2000;
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  for (auto &[pattern, subjects] : cases) {
+    regex_t posix;
+    RegexPattern regex;
+    ASSERT_EQ(::regcomp(&posix, pattern, flags), 0);
+    ASSERT_TRUE(regex.compile(pattern, flags));
+    regmatch_t matches[3];
+    size_t posix_matches = 0, pattern_matches = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+      for (auto &subject : subjects)
+        posix_matches += ::regexec(&posix, subject.c_str(), 3, matches, 0) == 0;
+    auto posix_time = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+      for (auto &subject : subjects)
+        pattern_matches += regex.match(subject.c_str(), 3, matches);
+    auto pattern_time = std::chrono::steady_clock::now() - start;
+    ::regfree(&posix);
+    EXPECT_EQ(pattern_matches, posix_matches);
+
+    auto match_count = rounds * subjects.size();
+    std::cout << std::string(pattern).substr(0, 40) << ": regexec "
+              << duration_cast<nanoseconds>(posix_time).count() / match_count
+              << " ns, " << (regex.isJit() ? "JIT " : "interpreter ")
+              << duration_cast<nanoseconds>(pattern_time).count() / match_count
+              << " ns per match" << std::endl;
+  }
+}
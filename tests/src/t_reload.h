@@ -0,0 +1,307 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/config/config.h"
+#include "../../src/stream/listener_manager.h"
+#include "../../src/util/network.h"
+#include "../../src/util/socket_handoff.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <fstream>
+#include <linux/filter.h>
+#include <netinet/in.h>
+#include <thread>
+
+/** Keep-alive backend answering every request with its name as body. */
+class ReloadBackend {
+  int listen_fd{-1};
+  std::thread worker;
+
+  void serve() {
+    int fd;
+    while ((fd = ::accept(listen_fd, nullptr, nullptr)) >= 0) {
+      char buffer[4096];
+      std::string request;
+      ssize_t size;
+      while ((size = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        request.append(buffer, static_cast<size_t>(size));
+        size_t end;
+        while ((end = request.find("\r\n\r\n")) != std::string::npos) {
+          request.erase(0, end + 4);
+          auto response = "HTTP/1.1 200 OK\r\nContent-Length: " +
+                          std::to_string(name.size()) + "\r\n\r\n" + name;
+          if (::write(fd, response.data(), response.size()) < 0) break;
+        }
+      }
+      ::close(fd);
+    }
+  }
+
+ public:
+  std::string name;
+  int port{0};
+
+  explicit ReloadBackend(std::string name_) : name(std::move(name_)) {
+    listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    ::listen(listen_fd, 16);
+    port = Network::getlocalPort(listen_fd);
+    worker = std::thread([this] { serve(); });
+  }
+
+  ~ReloadBackend() {
+    ::shutdown(listen_fd, SHUT_RDWR);
+    worker.join();
+    ::close(listen_fd);
+  }
+};
+
+/** Writes a configuration with one listener in @p port routed to @p backend. */
+static void writeReloadConfig(const std::string &file_name, int port,
+                              const ReloadBackend &backend) {
+  std::ofstream config(file_name);
+  config << "Threads 1\n"
+            "ListenHTTP\n"
+            "\tAddress 127.0.0.1\n"
+            "\tPort "
+         << port
+         << "\n"
+            "\tService \"srv\"\n"
+            "\t\tBackEnd\n"
+            "\t\t\tAddress 127.0.0.1\n"
+            "\t\t\tPort "
+         << backend.port
+         << "\n"
+            "\t\tEnd\n"
+            "\tEnd\n"
+            "End\n";
+}
+
+/** Sends a request through @p fd and returns the response body. */
+static std::string reloadRequest(int fd) {
+  const std::string request = "GET / HTTP/1.1\r\nHost: reload.test\r\n\r\n";
+  if (::write(fd, request.data(), request.size()) < 0) return "";
+  std::string response;
+  char buffer[4096];
+  size_t headers_end;
+  while ((headers_end = response.find("\r\n\r\n")) == std::string::npos ||
+         response.size() < headers_end + 7) {
+    auto size = ::read(fd, buffer, sizeof(buffer));
+    if (size <= 0) return "";
+    response.append(buffer, static_cast<size_t>(size));
+  }
+  return response.substr(headers_end + 4);
+}
+
+/**
+ * Reloads the configuration while a keep-alive client is connected. The
+ * next request of the client is routed with the reloaded services, and the
+ * retired snapshot is released once the client left it.
+ */
+TEST(ReloadTest, MovesKeepAliveClientsToTheReloadedServices) {
+  ReloadBackend one("one"), two("two");
+  int port_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ::bind(port_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  int port = Network::getlocalPort(port_fd);
+  ::close(port_fd);
+  char file_name[] = "/tmp/zproxy_reload_XXXXXX";
+  ::close(::mkstemp(file_name));
+  writeReloadConfig(file_name, port, one);
+
+  Config config;
+  ASSERT_TRUE(config.init(std::string(file_name)));
+  config.setAsCurrent();
+  ListenerManager listener;
+  for (auto lc = config.listeners; lc != nullptr; lc = lc->next)
+    ASSERT_TRUE(listener.addListener(lc));
+  std::thread listener_thread([&listener] { listener.start(); });
+
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  timeval read_timeout{5, 0};
+  ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &read_timeout,
+               sizeof(read_timeout));
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  for (int i = 0; i < 100 && ::connect(client,
+                                       reinterpret_cast<sockaddr *>(&address),
+                                       sizeof(address)) != 0;
+       i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(reloadRequest(client), "one");
+
+  std::weak_ptr<ServiceManager> retired =
+      ServiceManager::getInstance().begin()->second;
+  writeReloadConfig(file_name, port, two);
+  /* The control thread reloads while the maintenance timer reads the set. */
+  std::thread reload_thread([&listener] {
+    EXPECT_TRUE(listener.reloadConfigFile());
+  });
+  reload_thread.join();
+  EXPECT_NE(ServiceManager::getInstance().begin()->second, retired.lock());
+  /* Once the worker switched, only the client stream holds the old one. */
+  for (int i = 0; i < 500 && retired.use_count() > 1; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(retired.use_count(), 1);
+
+  EXPECT_EQ(reloadRequest(client), "two");
+  EXPECT_TRUE(retired.expired());
+  EXPECT_EQ(reloadRequest(client), "two");
+
+  ::close(client);
+  listener.stop();
+  listener_thread.join();
+  ServiceManager::setInstance({});
+  ::unlink(file_name);
+}
+
+/** Returns a port free in the loopback address. */
+static int reloadFreePort() {
+  int port_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ::bind(port_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  int port = Network::getlocalPort(port_fd);
+  ::close(port_fd);
+  return port;
+}
+
+/** Makes the reuseport group of @p listen_fd deliver to socket @p index. */
+static bool reloadSteerTo(int listen_fd, uint32_t index) {
+  sock_filter code[] = {{BPF_RET | BPF_K, 0, 0, index}};
+  sock_fprog prog{};
+  prog.len = 1;
+  prog.filter = code;
+  return ::setsockopt(listen_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+                      sizeof(prog)) == 0;
+}
+
+/**
+ * A listener added by a reload is opened for each worker in turn, so as on
+ * start socket i of its reuseport group belongs to worker i, which the CPU
+ * steering relies on.
+ */
+TEST(ReloadTest, KeepsTheReusePortIndexOfTheWorkers) {
+  ReloadBackend backend("one");
+  int ports[] = {reloadFreePort(), reloadFreePort()};
+  char file_name[] = "/tmp/zproxy_reload_XXXXXX";
+  ::close(::mkstemp(file_name));
+  auto write_config = [&](int listeners) {
+    std::ofstream config(file_name);
+    config << "Threads 2\n";
+    for (int i = 0; i < listeners; i++)
+      config << "ListenHTTP\n\tAddress 127.0.0.1\n\tPort " << ports[i]
+             << "\n\tService \"srv\"\n\t\tBackEnd\n"
+                "\t\t\tAddress 127.0.0.1\n\t\t\tPort "
+             << backend.port << "\n\t\tEnd\n\tEnd\nEnd\n";
+  };
+  write_config(1);
+  Config config;
+  ASSERT_TRUE(config.init(std::string(file_name)));
+  config.setAsCurrent();
+  ListenerManager listener;
+  for (auto lc = config.listeners; lc != nullptr; lc = lc->next)
+    ASSERT_TRUE(listener.addListener(lc));
+  std::thread listener_thread([&listener] { listener.start(); });
+  auto connect_client = [](int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    timeval read_timeout{5, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &read_timeout,
+                 sizeof(read_timeout));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    for (int i = 0; i < 100 && ::connect(fd,
+                                         reinterpret_cast<sockaddr *>(&address),
+                                         sizeof(address)) != 0;
+         i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return fd;
+  };
+  int first = connect_client(ports[0]);
+  EXPECT_EQ(reloadRequest(first), "one");
+  ::close(first);
+
+  write_config(2);
+  EXPECT_TRUE(listener.reloadConfigFile());
+  auto key = SocketHandoff::listenerKey("127.0.0.1", ports[1]);
+  auto listen_fd = [&](int worker_id) {
+    for (auto &[fd, listen_key] : listener.getWorker(worker_id)->getListeners())
+      if (listen_key == key) return fd;
+    return -1;
+  };
+  for (int i = 0; i < 100 && (listen_fd(0) < 0 || listen_fd(1) < 0); i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_GE(listen_fd(0), 0);
+  ASSERT_GE(listen_fd(1), 0);
+  for (int worker_id : {1, 0}) {
+    ASSERT_TRUE(reloadSteerTo(listen_fd(0), static_cast<uint32_t>(worker_id)));
+    auto worker = listener.getWorker(worker_id);
+    auto other = listener.getWorker(1 - worker_id);
+    int client = connect_client(ports[1]);
+    EXPECT_EQ(reloadRequest(client), "one");
+    EXPECT_EQ(worker->streamCount(), 1u);
+    EXPECT_EQ(other->streamCount(), 0u);
+    /* The backend serves one connection at a time. */
+    ::close(client);
+    for (int i = 0; i < 100 && worker->streamCount() > 0; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  listener.stop();
+  listener_thread.join();
+  ServiceManager::setInstance({});
+  ::unlink(file_name);
+}
+
+TEST(ReloadTest, PublishesTheServiceManagersAtOnce) {
+  auto listener_config = std::make_shared<ListenerConfig>();
+  std::map<int, std::shared_ptr<ServiceManager>> first, second;
+  for (int id = 0; id < 8; id++) {
+    first[id] = std::make_shared<ServiceManager>(listener_config);
+    second[id] = std::make_shared<ServiceManager>(listener_config);
+  }
+  std::atomic<bool> done{false};
+  int torn = 0;
+  std::thread reader([&] {
+    while (!done) {
+      auto service_managers = ServiceManager::getInstance();
+      if (service_managers.empty()) continue;
+      auto &published =
+          service_managers.begin()->second == first[0] ? first : second;
+      if (service_managers != published) torn++;
+    }
+  });
+  for (int i = 0; i < 10000; i++)
+    ServiceManager::setInstance(i % 2 ? first : second);
+  done = true;
+  reader.join();
+  EXPECT_EQ(torn, 0);
+  ServiceManager::setInstance({});
+}
@@ -0,0 +1,227 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/service/service_index.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+#include <regex.h>
+#include <string>
+#include <vector>
+
+/** URL and HeadRequire patterns of a service, compiled as the config does. */
+struct IndexService {
+  std::vector<std::shared_ptr<regex_t>> url, req_head;
+  std::string host_literal, path_prefix;
+
+  IndexService(const std::vector<std::string> &urls,
+               const std::vector<std::string> &heads) {
+    for (auto &pattern : urls) {
+      url.push_back(indexPattern(pattern, REG_NEWLINE | REG_EXTENDED));
+      auto prefix = ServiceIndex::pathPrefix(pattern);
+      if (prefix.size() > path_prefix.size()) path_prefix = prefix;
+    }
+    for (auto &pattern : heads) {
+      req_head.push_back(
+          indexPattern(pattern, REG_ICASE | REG_NEWLINE | REG_EXTENDED));
+      if (host_literal.empty())
+        host_literal = ServiceIndex::hostLiteral(pattern);
+    }
+  }
+
+  static std::shared_ptr<regex_t> indexPattern(const std::string &pattern,
+                                               int flags) {
+    std::shared_ptr<regex_t> regex(new regex_t, [](regex_t *compiled) {
+      ::regfree(compiled);
+      delete compiled;
+    });
+    EXPECT_EQ(::regcomp(regex.get(), pattern.c_str(), flags), 0) << pattern;
+    return regex;
+  }
+
+  /** Service::doMatch(). */
+  bool doMatch(http_parser::HttpData &request) const {
+    auto path = std::string(request.path, request.path_length);
+    for (auto &m : url)
+      if (::regexec(m.get(), path.data(), 0, nullptr, 0)) return false;
+    for (auto &m : req_head) {
+      bool found = false;
+      for (size_t i = 0; i < request.num_headers && !found; i++)
+        if (!::regexec(m.get(), request.headers[i].name, 0, nullptr, 0))
+          found = true;
+      if (!found) return false;
+    }
+    return true;
+  }
+};
+
+/** The lookup done before the index, every service in order. */
+static size_t serviceLinearFind(const std::vector<IndexService> &services,
+                                http_parser::HttpData &request) {
+  for (size_t i = 0; i < services.size(); i++)
+    if (services[i].doMatch(request)) return i;
+  return ServiceIndex::npos;
+}
+
+static size_t serviceIndexFind(const ServiceIndex &service_index,
+                               const std::vector<IndexService> &services,
+                               http_parser::HttpData &request) {
+  return service_index.find(request, [&](size_t position) {
+    return services[position].doMatch(request);
+  });
+}
+
+static ServiceIndex serviceIndex(const std::vector<IndexService> &services) {
+  ServiceIndex service_index;
+  for (auto &service : services)
+    service_index.add(service.host_literal, service.path_prefix);
+  return service_index;
+}
+
+TEST(ServiceIndexTest, ExtractsLiteralHosts) {
+  EXPECT_EQ(ServiceIndex::hostLiteral("^Host: www\\.example\\.com$"),
+            "www.example.com");
+  EXPECT_EQ(ServiceIndex::hostLiteral("^host:[[:blank:]]*A\\.test:8080[[:space:]]*$"),
+            "a.test:8080");
+  EXPECT_EQ(ServiceIndex::hostLiteral("^Host: *api\\.test\\s*$"), "api.test");
+  // the dot, the missing anchors or the quantifiers match other hosts
+  for (auto pattern :
+       {"^Host: www.example.com$", "Host: www\\.example\\.com$",
+        "^Host: www\\.example\\.com", "^Host: ww*\\.test$",
+        "^Host: (a|b)\\.test$", "^X-Host: a\\.test$", "^Host:[[:space:]]*a$",
+        "^Host: a\\.test$|^Host: b\\.test$", "^Host:[ \\t]*ta\\.test$"}) {
+    EXPECT_EQ(ServiceIndex::hostLiteral(pattern), "") << pattern;
+  }
+}
+
+TEST(ServiceIndexTest, ExtractsPathPrefixes) {
+  EXPECT_EQ(ServiceIndex::pathPrefix("^/api/v1/.*"), "/api/v1/");
+  EXPECT_EQ(ServiceIndex::pathPrefix("^/static\\.files/(css|js)/"),
+            "/static.files/");
+  EXPECT_EQ(ServiceIndex::pathPrefix("^/apis?/"), "/api");
+  EXPECT_EQ(ServiceIndex::pathPrefix("^/ab+c"), "/ab");
+  EXPECT_EQ(ServiceIndex::pathPrefix("^/a{2}"), "/");
+  EXPECT_EQ(ServiceIndex::pathPrefix("^/\\<word"), "/");
+  for (auto pattern : {"/api/", "\\.php$", "^/a|^/b", "^[/]api", "^(/api)",
+                       "^/a[|]b|c", ".*"}) {
+    EXPECT_EQ(ServiceIndex::pathPrefix(pattern), "") << pattern;
+  }
+  EXPECT_EQ(ServiceIndex::pathPrefix("^/a[|]b"), "/a");
+}
+
+TEST(ServiceIndexTest, MatchesInConfigurationOrder) {
+  std::vector<IndexService> services;
+  services.emplace_back(std::vector<std::string>{"^/admin/"},
+                        std::vector<std::string>{"^Host: a\\.test[[:space:]]*$"});
+  services.emplace_back(std::vector<std::string>{"\\.php$"},
+                        std::vector<std::string>{});
+  services.emplace_back(std::vector<std::string>{"^/api/v1/", "^/api/"},
+                        std::vector<std::string>{});
+  services.emplace_back(std::vector<std::string>{"^/api/v2"},
+                        std::vector<std::string>{"^Host: b\\.test[[:space:]]*$"});
+  services.emplace_back(std::vector<std::string>{"^/"},
+                        std::vector<std::string>{"Host: .*\\.test"});
+  services.emplace_back(std::vector<std::string>{"^/api"},
+                        std::vector<std::string>{"^Host: a\\.test[[:space:]]*$"});
+  services.emplace_back(std::vector<std::string>{},
+                        std::vector<std::string>{"^Host: c\\.test[[:space:]]*$"});
+  services.emplace_back(std::vector<std::string>{}, std::vector<std::string>{});
+  auto service_index = serviceIndex(services);
+  for (auto host : {"", "a.test", "A.Test", "b.test", "c.test", "d.example",
+                    "a.test.example"}) {
+    for (auto path : {"/", "/admin/", "/admin", "/index.php", "/api/v1/x",
+                      "/api/v2/y", "/api", "/ap", "/apix", "/other"}) {
+      std::string data = std::string("GET ") + path + " HTTP/1.1\r\n";
+      if (*host != '\0') data += std::string("Host: ") + host + "\r\n";
+      data += "Accept: */*\r\n\r\n";
+      http_parser::HttpData request;
+      size_t parsed = 0;
+      ASSERT_EQ(request.parseRequest(data, &parsed),
+                http_parser::PARSE_RESULT::SUCCESS);
+      EXPECT_EQ(serviceIndexFind(service_index, services, request),
+                serviceLinearFind(services, request))
+          << host << path;
+    }
+  }
+  /* Different Host headers do not narrow the services. */
+  std::string data =
+      "GET /api HTTP/1.1\r\nHost: d.test\r\nHost: a.test\r\n\r\n";
+  http_parser::HttpData request;
+  size_t parsed = 0;
+  ASSERT_EQ(request.parseRequest(data, &parsed),
+            http_parser::PARSE_RESULT::SUCCESS);
+  EXPECT_EQ(serviceIndexFind(service_index, services, request), 4u);
+  EXPECT_EQ(serviceLinearFind(services, request), 4u);
+}
+
+/*
+ * Selects the service of 1000 requests among 500 services, each one with a
+ * literal Host and a path prefix, with the index and with the sequential
+ * scan, and reports the time per request.
+ */
+TEST(ServiceIndexTest, Benchmark) {
+  const int service_count = 500;
+  std::vector<IndexService> services;
+  for (int i = 0; i < service_count; i++) {
+    auto tenant = std::to_string(i);
+    services.emplace_back(
+        std::vector<std::string>{"^/app" + tenant + "/.*"},
+        std::vector<std::string>{"^Host: tenant" + tenant +
+                                 "\\.example\\.com[[:space:]]*$"});
+  }
+  auto service_index = serviceIndex(services);
+  std::vector<std::string> requests;
+  for (int i = 0; i < 1000; i++) {
+    auto tenant = std::to_string((i * 7919) % service_count);
+    requests.push_back("GET /app" + tenant + "/index.html HTTP/1.1\r\nHost: tenant" +
+                       tenant + ".example.com\r\nAccept: */*\r\n\r\n");
+  }
+  requests.push_back("GET / HTTP/1.1\r\nHost: unknown.example.com\r\n\r\n");
+  std::vector<http_parser::HttpData> parsed_requests(requests.size());
+  for (size_t i = 0; i < requests.size(); i++) {
+    size_t parsed = 0;
+    parsed_requests[i].parseRequest(requests[i], &parsed);
+  }
+
+  // the patterns build their automata on the first use
+  for (auto &request : parsed_requests) serviceLinearFind(services, request);
+  std::vector<size_t> indexed, linear;
+  auto start = std::chrono::steady_clock::now();
+  for (auto &request : parsed_requests)
+    indexed.push_back(serviceIndexFind(service_index, services, request));
+  auto index_time = std::chrono::steady_clock::now() - start;
+  start = std::chrono::steady_clock::now();
+  for (auto &request : parsed_requests)
+    linear.push_back(serviceLinearFind(services, request));
+  auto linear_time = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(indexed, linear);
+  EXPECT_EQ(indexed.back(), ServiceIndex::npos);
+
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  std::cout << service_count << " services: lookup "
+            << duration_cast<nanoseconds>(index_time).count() / requests.size()
+            << " ns indexed, "
+            << duration_cast<nanoseconds>(linear_time).count() / requests.size()
+            << " ns sequential" << std::endl;
+}
@@ -0,0 +1,138 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/ssl/sni_index.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstring>
+#include <fnmatch.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/** Certificate list with the CN and subjectAltNames given, as load_cert(). */
+static std::shared_ptr<POUND_CTX> sniContexts(
+    const std::vector<std::vector<std::string>> &certificates) {
+  std::shared_ptr<POUND_CTX> head, last;
+  for (auto &names : certificates) {
+    auto pc = std::make_shared<POUND_CTX>();
+    pc->server_name = ::strdup(names[0].c_str());
+    pc->subjectAltNameCount = static_cast<unsigned int>(names.size() - 1);
+    pc->subjectAltNames = static_cast<unsigned char **>(
+        std::calloc(names.size(), sizeof(unsigned char *)));
+    for (size_t i = 1; i < names.size(); i++)
+      pc->subjectAltNames[i - 1] =
+          reinterpret_cast<unsigned char *>(::strdup(names[i].c_str()));
+    if (head == nullptr)
+      head = pc;
+    else
+      last->next = pc;
+    last = pc;
+  }
+  return head;
+}
+
+/** The lookup done before the index, a fnmatch() of every name in order. */
+static POUND_CTX *sniLinearFind(POUND_CTX *ctx, const char *server_name) {
+  for (auto pc = ctx; pc; pc = pc->next.get()) {
+    if (::fnmatch(pc->server_name, server_name, 0) == 0) return pc;
+    for (unsigned int i = 0; i < pc->subjectAltNameCount; i++)
+      if (::fnmatch(reinterpret_cast<char *>(pc->subjectAltNames[i]),
+                    server_name, 0) == 0)
+        return pc;
+  }
+  return nullptr;
+}
+
+TEST(SniIndexTest, MatchesInConfigurationOrder) {
+  auto ctx = sniContexts({{"default.test"},
+                          {"*.example.com", "example.com"},
+                          {"www.example.com", "*.www.example.com"},
+                          {"*.b.example.com"},
+                          {"api?.example.org", "*.example.org"},
+                          {"*", "unreachable.test"}});
+  ssl::SniIndex sni_index(ctx.get());
+  EXPECT_EQ(sni_index.defaultContext(), ctx.get());
+  for (auto host :
+       {"default.test", "example.com", "www.example.com", "a.b.example.com",
+        "x.www.example.com", ".example.com", "example.com.evil.test",
+        "api1.example.org", "api12.example.org", "b.example.org",
+        "example.org", "unreachable.test", "other.test", "", "."}) {
+    EXPECT_EQ(sni_index.find(host), sniLinearFind(ctx.get(), host)) << host;
+  }
+  EXPECT_EQ(sni_index.find("www.example.com"), ctx->next.get());
+  EXPECT_EQ(sni_index.find("a.b.example.com"), ctx->next.get());
+  EXPECT_EQ(sni_index.find("api1.example.org"), ctx->next->next->next->next.get());
+}
+
+TEST(SniIndexTest, FindsNothingWithoutFallbackPattern) {
+  auto ctx = sniContexts({{"default.test"}, {"*.example.com"}});
+  ssl::SniIndex sni_index(ctx.get());
+  EXPECT_EQ(sni_index.find("example.com"), nullptr);
+  EXPECT_EQ(sni_index.find("other.test"), nullptr);
+  EXPECT_EQ(sni_index.find("a.example.com"), ctx->next.get());
+}
+
+/*
+ * Looks up 1000 server names among 10k certificates, each one with a plain CN
+ * and a wildcard subjectAltName, with the index and with the linear fnmatch()
+ * scan, and reports the time per lookup.
+ */
+TEST(SniIndexTest, Benchmark) {
+  const int certificates = 10000;
+  std::vector<std::vector<std::string>> names;
+  for (int i = 0; i < certificates; i++)
+    names.push_back({"tenant" + std::to_string(i) + ".example.com",
+                     "*.tenant" + std::to_string(i) + ".example.net"});
+  auto ctx = sniContexts(names);
+  auto build_start = std::chrono::steady_clock::now();
+  ssl::SniIndex sni_index(ctx.get());
+  auto build_time = std::chrono::steady_clock::now() - build_start;
+  std::vector<std::string> hosts;
+  for (int i = 0; i < 1000; i++) {
+    auto tenant = std::to_string((i * 7919) % certificates);
+    hosts.push_back(i % 2 ? "tenant" + tenant + ".example.com"
+                          : "www.tenant" + tenant + ".example.net");
+  }
+  hosts.push_back("unknown.example.com");
+
+  std::vector<POUND_CTX *> indexed, linear;
+  auto start = std::chrono::steady_clock::now();
+  for (auto &host : hosts) indexed.push_back(sni_index.find(host));
+  auto index_time = std::chrono::steady_clock::now() - start;
+  start = std::chrono::steady_clock::now();
+  for (auto &host : hosts) linear.push_back(sniLinearFind(ctx.get(), host.c_str()));
+  auto linear_time = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(indexed, linear);
+  EXPECT_EQ(indexed.back(), nullptr);
+
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  std::cout << certificates << " certificates: index built in "
+            << duration_cast<std::chrono::milliseconds>(build_time).count()
+            << " ms, lookup "
+            << duration_cast<nanoseconds>(index_time).count() / hosts.size()
+            << " ns indexed, "
+            << duration_cast<nanoseconds>(linear_time).count() / hosts.size()
+            << " ns linear" << std::endl;
+}
@@ -0,0 +1,151 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/util/network.h"
+#include "../../src/util/socket_handoff.h"
+#include "gtest/gtest.h"
+#include "t_reload.h"
+#include <netinet/in.h>
+
+TEST(SocketHandoffTest, PassesListeningSockets) {
+  int fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds), 0);
+  int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GT(listen_fd, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(::bind(listen_fd, reinterpret_cast<sockaddr *>(&address),
+                   sizeof(address)),
+            0);
+  ASSERT_EQ(::listen(listen_fd, 16), 0);
+  int port = Network::getlocalPort(listen_fd);
+  auto key = SocketHandoff::listenerKey("127.0.0.1", port);
+
+  /* The running process side. */
+  EXPECT_TRUE(SocketHandoff::sendSocket(fds[0], listen_fd, key));
+  ::shutdown(fds[0], SHUT_WR);
+
+  /* The upgraded process side. */
+  ::setenv(UPGRADE_SOCKET_ENV, std::to_string(fds[1]).data(), 1);
+  EXPECT_TRUE(SocketHandoff::receiveInherited());
+  EXPECT_EQ(::getenv(UPGRADE_SOCKET_ENV), nullptr);
+  EXPECT_EQ(SocketHandoff::takeInherited("127.0.0.1:1"), -1);
+  int inherited_fd = SocketHandoff::takeInherited(key);
+  ASSERT_GT(inherited_fd, STDERR_FILENO);
+  EXPECT_NE(inherited_fd, listen_fd);
+  EXPECT_EQ(Network::getlocalPort(inherited_fd), port);
+  EXPECT_EQ(SocketHandoff::takeInherited(key), -1);
+
+  /* Both processes share the accept queue. */
+  ::close(listen_fd);
+  int client_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  ASSERT_EQ(::connect(client_fd, reinterpret_cast<sockaddr *>(&address),
+                      sizeof(address)),
+            0);
+  int accepted_fd = ::accept(inherited_fd, nullptr, nullptr);
+  EXPECT_GT(accepted_fd, 0);
+
+  SocketHandoff::notifyReady();
+  EXPECT_EQ(SocketHandoff::waitReady(fds[0], 1), ::getpid());
+  ::close(accepted_fd);
+  ::close(client_fd);
+  ::close(inherited_fd);
+  ::close(fds[0]);
+}
+
+/**
+ * Once drained, a worker answers the request in flight with "Connection:
+ * close" and closes the idle clients. The listener defers the accept until
+ * the client sends, so every client accepted has sent something.
+ */
+TEST(SocketHandoffTest, DrainsTheIdleClients) {
+  ReloadBackend backend("one");
+  int port_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ::bind(port_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  int port = Network::getlocalPort(port_fd);
+  ::close(port_fd);
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  char file_name[] = "/tmp/zproxy_drain_XXXXXX";
+  ::close(::mkstemp(file_name));
+  writeReloadConfig(file_name, port, backend);
+  Config config;
+  ASSERT_TRUE(config.init(std::string(file_name)));
+  config.setAsCurrent();
+  ListenerManager listener;
+  for (auto lc = config.listeners; lc != nullptr; lc = lc->next)
+    ASSERT_TRUE(listener.addListener(lc));
+  StreamManager worker;
+  worker.start(0, -1, false, false);
+
+  auto connectClient = [&address] {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    timeval read_timeout{5, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &read_timeout,
+                 sizeof(read_timeout));
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                  sizeof(address)) != 0) {
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  };
+  int kept = connectClient(), slow = connectClient();
+  ASSERT_GE(kept, 0);
+  ASSERT_GE(slow, 0);
+  EXPECT_EQ(reloadRequest(kept), "one");
+  const std::string head = "GET / HTTP/1.1\r\nHost: drain.test\r\n";
+  ASSERT_EQ(::write(slow, head.data(), head.size()),
+            static_cast<ssize_t>(head.size()));
+  for (int i = 0; i < 100 && worker.streamCount() < 2; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_EQ(worker.streamCount(), 2u);
+
+  worker.drainListeners();
+  char byte;
+  EXPECT_EQ(::read(kept, &byte, 1), 0);
+  /* The request not complete yet is still served, the last on the client. */
+  ASSERT_EQ(::write(slow, "\r\n", 2), 2);
+  std::string response;
+  char buffer[4096];
+  ssize_t size;
+  while ((size = ::read(slow, buffer, sizeof(buffer))) > 0)
+    response.append(buffer, static_cast<size_t>(size));
+  EXPECT_EQ(size, 0);
+  EXPECT_NE(response.find("Connection: close\r\n"), std::string::npos);
+  EXPECT_EQ(response.substr(response.size() - 3), "one");
+  for (int i = 0; i < 100 && worker.streamCount() > 0; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(worker.streamCount(), 0u);
+  EXPECT_EQ(connectClient(), -1);
+
+  worker.stop();
+  ::close(kept);
+  ::close(slow);
+  ServiceManager::setInstance({});
+  ::unlink(file_name);
+}
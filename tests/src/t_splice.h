@@ -0,0 +1,236 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/connection/connection.h"
+#include "../../src/http/chunked_parser.h"
+#include "gtest/gtest.h"
+#include <ctime>
+#include <iostream>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+
+TEST(ChunkedParserTest, ParsesBodySplitAnywhere) {
+  const std::string body =
+      "4;name=value\r\nWiki\r\n"
+      "5\r\npedia\r\n"
+      "E\r\n in\r\n\r\nchunks.\r\n"
+      "0\r\nExpires: never\r\n\r\n";
+  const std::string input = body + "HTTP/1.1 200 OK\r\n";
+  for (size_t split = 0; split <= body.size(); split++) {
+    http::ChunkedParser parser;
+    EXPECT_EQ(parser.feed(input.data(), split), split);
+    EXPECT_EQ(parser.feed(input.data() + split, input.size() - split),
+              body.size() - split);
+    EXPECT_TRUE(parser.done());
+  }
+}
+
+TEST(ChunkedParserTest, StopsAtChunkData) {
+  http::ChunkedParser parser;
+  const std::string framing = "1a\r\n";
+  EXPECT_EQ(parser.parse(framing.data(), framing.size()), framing.size());
+  EXPECT_TRUE(parser.inData());
+  EXPECT_EQ(parser.chunk_left, 0x1au);
+  /* The data is only counted. */
+  EXPECT_EQ(parser.parse("xxxx", 4), 0u);
+  EXPECT_EQ(parser.skip(20), 20u);
+  EXPECT_EQ(parser.skip(20), 6u);
+  const std::string end = "\r\n0\r\n\r\n";
+  EXPECT_EQ(parser.parse(end.data(), end.size()), end.size());
+  EXPECT_TRUE(parser.done());
+}
+
+TEST(ChunkedParserTest, RejectsMalformedFraming) {
+  for (std::string body : {"\r\n", "g\r\n", "5\r\npediaX\r\n", "5\rX",
+                           "10000000000000000\r\n", "0\r\n\rX"}) {
+    http::ChunkedParser parser;
+    parser.feed(body.data(), body.size());
+    EXPECT_TRUE(parser.failed()) << body;
+  }
+}
+
+#if ENABLE_ZERO_COPY
+
+/** Connected TCP loopback sockets, the first one is the client side. */
+static std::pair<int, int> spliceSocketPair() {
+  int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  ::bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  ::listen(listen_fd, 1);
+  ::getsockname(listen_fd, reinterpret_cast<sockaddr *>(&address), &length);
+  int client_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  ::connect(client_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  int server_fd = ::accept(listen_fd, nullptr, nullptr);
+  ::close(listen_fd);
+  return {client_fd, server_fd};
+}
+
+static void spliceSendAll(int fd, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    auto count = ::send(fd, data.data() + sent, data.size() - sent, 0);
+    if (count <= 0) break;
+    sent += static_cast<size_t>(count);
+  }
+  ::shutdown(fd, SHUT_WR);
+}
+
+static std::string spliceReceiveAll(int fd) {
+  std::string data;
+  char buffer[MAX_DATA_SIZE];
+  ssize_t count;
+  while ((count = ::recv(fd, buffer, sizeof(buffer), 0)) > 0)
+    data.append(buffer, static_cast<size_t>(count));
+  return data;
+}
+
+TEST(SpliceTest, RelaysChunkedBody) {
+  auto [backend_fd, in_fd] = spliceSocketPair();
+  auto [out_fd, client_fd] = spliceSocketPair();
+  std::string body = "186a0;ext\r\n" + std::string(100000, 'x') + "\r\n" +
+                     "3\r\nend\r\n0\r\nTrailer: 1\r\n\r\n";
+  std::thread backend([&, fd = backend_fd] { spliceSendAll(fd, body); });
+  std::string received;
+  std::thread client([&, fd = client_fd] { received = spliceReceiveAll(fd); });
+
+  Connection src;
+  src.setFileDescriptor(in_fd);
+  ASSERT_TRUE(src.acquirePipe());
+  auto used_pipes = SplicePipePool::used_pipes.load();
+  auto spliced_bytes = SplicePipePool::spliced_bytes.load();
+  http::ChunkedParser parser;
+  size_t framing_bytes = 0;
+  while (!parser.done() && !parser.failed()) {
+    size_t count = 0, sent = 0;
+    IO::IO_RESULT result;
+    if (parser.inData()) {
+      result = src.zeroRead(parser.chunk_left, count);
+      parser.skip(count);
+    } else {
+      result = src.zeroReadFraming(parser, count);
+      framing_bytes += count;
+    }
+    ASSERT_EQ(result, IO::IO_RESULT::SUCCESS);
+    ASSERT_EQ(src.zeroWrite(out_fd, sent), IO::IO_RESULT::SUCCESS);
+    EXPECT_EQ(src.splice_pipe.bytes, 0u);
+  }
+  ::shutdown(out_fd, SHUT_WR);
+  backend.join();
+  client.join();
+  EXPECT_TRUE(parser.done());
+  EXPECT_EQ(received, body);
+  /* Only the framing went through user space. */
+  EXPECT_EQ(framing_bytes, body.size() - 100003);
+  EXPECT_EQ(SplicePipePool::spliced_bytes.load() - spliced_bytes, body.size());
+  src.releasePipe();
+  EXPECT_EQ(SplicePipePool::used_pipes.load(), used_pipes - 1);
+  ::close(out_fd);
+  ::close(backend_fd);
+  ::close(client_fd);
+}
+
+static double spliceThreadCpuMs() {
+  timespec now{};
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return static_cast<double>(now.tv_sec) * 1000 +
+         static_cast<double>(now.tv_nsec) / 1000000;
+}
+
+/*
+ * Relays 1, 10 and 100MB downloads over loopback TCP with a buffer, as the
+ * copy path does, and with splice(), and reports the relaying thread CPU time
+ * per GB and the bytes it copied to and from user space.
+ */
+TEST(SpliceTest, DownloadBenchmark) {
+  const std::string chunk(1024 * 1024, 'z');
+  for (size_t megabytes : {1, 10, 100}) {
+    const size_t size = megabytes * chunk.size();
+    for (bool zero_copy : {false, true}) {
+      auto [backend_fd, in_fd] = spliceSocketPair();
+      auto [out_fd, client_fd] = spliceSocketPair();
+      std::thread backend([&, fd = backend_fd] {
+        for (size_t sent = 0; sent < size; sent += chunk.size())
+          if (::send(fd, chunk.data(), chunk.size(), 0) <= 0) break;
+        ::shutdown(fd, SHUT_WR);
+      });
+      size_t received = 0;
+      std::thread client([&, fd = client_fd] {
+        char buffer[MAX_DATA_SIZE];
+        ssize_t count;
+        while ((count = ::recv(fd, buffer, sizeof(buffer), 0)) > 0)
+          received += static_cast<size_t>(count);
+      });
+
+      size_t copied = 0, left = size;
+      auto cpu_start = spliceThreadCpuMs();
+      if (zero_copy) {
+        Connection src;
+        src.setFileDescriptor(in_fd);
+        ASSERT_TRUE(src.acquirePipe());
+        while (left > 0) {
+          size_t count = 0, sent = 0;
+          if (src.zeroRead(left, count) != IO::IO_RESULT::SUCCESS ||
+              src.zeroWrite(out_fd, sent) != IO::IO_RESULT::SUCCESS)
+            break;
+          left -= sent;
+        }
+        src.releasePipe();
+        in_fd = -1;
+      } else {
+        char buffer[MAX_DATA_SIZE];
+        while (left > 0) {
+          auto count = ::recv(in_fd, buffer, sizeof(buffer), 0);
+          if (count <= 0) break;
+          auto length = static_cast<size_t>(count);
+          copied += length;
+          for (size_t sent = 0; sent < length;) {
+            auto written = ::send(out_fd, buffer + sent, length - sent, 0);
+            if (written <= 0) break;
+            sent += static_cast<size_t>(written);
+          }
+          copied += length;
+          left -= length;
+        }
+      }
+      auto cpu_ms = spliceThreadCpuMs() - cpu_start;
+      ::shutdown(out_fd, SHUT_WR);
+      backend.join();
+      client.join();
+      EXPECT_EQ(left, 0u);
+      EXPECT_EQ(received, size);
+      std::cout << (zero_copy ? "splice " : "copy   ") << megabytes
+                << "MB download: " << copied << " bytes copied to user space, "
+                << cpu_ms * 1024 / static_cast<double>(megabytes)
+                << " ms CPU/GB" << std::endl;
+      for (int fd : {backend_fd, in_fd, out_fd, client_fd})
+        if (fd >= 0) ::close(fd);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/ssl/ssl_session.h"
+#include "gtest/gtest.h"
+#include "t_ticket_keys.h"
+#include <string>
+
+/** A TLSv1.2 session with the id @p id, started at @p time. */
+static SSL_SESSION *cacheSession(const std::string &id, time_t time,
+                                 long timeout = 300) {
+  std::shared_ptr<SSL_CTX> ctx(SSL_CTX_new(TLS_method()), &::SSL_CTX_free);
+  std::shared_ptr<SSL> ssl(SSL_new(ctx.get()), &::SSL_free);
+  SSL_SESSION *session = SSL_SESSION_new();
+  const unsigned char master_key[48] = {1};
+  SSL_SESSION_set_protocol_version(session, TLS1_2_VERSION);
+  // ECDHE-ECDSA-AES128-GCM-SHA256
+  const unsigned char cipher_id[] = {0xc0, 0x2b};
+  SSL_SESSION_set_cipher(session, SSL_CIPHER_find(ssl.get(), cipher_id));
+  SSL_SESSION_set1_master_key(session, master_key, sizeof(master_key));
+  SSL_SESSION_set1_id(session, reinterpret_cast<const unsigned char *>(id.data()),
+                      static_cast<unsigned int>(id.size()));
+  SSL_SESSION_set_time(session, time);
+  SSL_SESSION_set_timeout(session, timeout);
+  return session;
+}
+
+/** Whether @p cache has the session @p id. */
+static bool cacheHas(ssl::SslSessionManager &cache, const std::string &id) {
+  int do_copy = 1;
+  auto session =
+      cache.getSession(nullptr, reinterpret_cast<const unsigned char *>(id.data()),
+                       static_cast<int>(id.size()), &do_copy);
+  EXPECT_EQ(do_copy, 0);
+  if (session == nullptr) return false;
+  unsigned int id_length;
+  auto session_id = SSL_SESSION_get_id(session, &id_length);
+  EXPECT_EQ(std::string(reinterpret_cast<const char *>(session_id), id_length), id);
+  SSL_SESSION_free(session);
+  return true;
+}
+
+TEST(SslSessionCacheTest, AddsGetsAndRemovesSessions) {
+  ssl::SslSessionManager cache;
+  auto now = std::time(nullptr);
+  for (int i = 0; i < 100; i++) {
+    auto session = cacheSession("session-" + std::to_string(i), now);
+    EXPECT_EQ(cache.addSession(nullptr, session), 0);
+    SSL_SESSION_free(session);
+  }
+  EXPECT_EQ(cache.entries.load(), 100u);
+  EXPECT_TRUE(cacheHas(cache, "session-42"));
+  EXPECT_FALSE(cacheHas(cache, "session-100"));
+  EXPECT_EQ(cache.hits.load(), 1u);
+  EXPECT_EQ(cache.misses.load(), 1u);
+
+  auto session = cacheSession("session-42", now);
+  cache.deleteSession(nullptr, session);
+  SSL_SESSION_free(session);
+  EXPECT_FALSE(cacheHas(cache, "session-42"));
+  EXPECT_EQ(cache.entries.load(), 99u);
+  /* Adding a session again replaces it. */
+  session = cacheSession("session-7", now);
+  cache.addSession(nullptr, session);
+  SSL_SESSION_free(session);
+  EXPECT_EQ(cache.entries.load(), 99u);
+}
+
+TEST(SslSessionCacheTest, EvictsLeastRecentlyUsedSessions) {
+  auto now = std::time(nullptr);
+  auto session = cacheSession("s00000", now);
+  size_t session_size =
+      sizeof(ssl::SslSessionData) + 6 + i2d_SSL_SESSION(session, nullptr);
+  SSL_SESSION_free(session);
+  /* Room for two sessions per shard. */
+  ssl::SslSessionManager cache(SSL_SESSION_CACHE_SHARDS * (2 * session_size + 1));
+  std::vector<std::string> ids;
+  for (int i = 0; i < 10 * SSL_SESSION_CACHE_SHARDS; i++) {
+    auto id = "s" + std::to_string(10000 + i);
+    session = cacheSession(id, now);
+    cache.addSession(nullptr, session);
+    SSL_SESSION_free(session);
+    ids.push_back(id);
+    /* The first one is kept in use. */
+    EXPECT_TRUE(cacheHas(cache, ids[0]));
+  }
+  EXPECT_LE(cache.bytes.load(), SSL_SESSION_CACHE_SHARDS * (2 * session_size + 1));
+  EXPECT_LE(cache.entries.load(), 2u * SSL_SESSION_CACHE_SHARDS);
+  EXPECT_EQ(cache.entries.load() + cache.evictions.load(), ids.size());
+  EXPECT_TRUE(cacheHas(cache, ids[0]));
+  EXPECT_TRUE(cacheHas(cache, ids.back()));
+}
+
+TEST(SslSessionCacheTest, ExpiresSessions) {
+  ssl::SslSessionManager cache;
+  auto now = std::time(nullptr);
+  for (auto &[id, timeout] : {std::pair<std::string, long>{"old", 10},
+                              {"older", 20}, {"fresh", 300}}) {
+    auto session = cacheSession(id, now - 60, timeout);
+    cache.addSession(nullptr, session);
+    SSL_SESSION_free(session);
+  }
+  EXPECT_FALSE(cacheHas(cache, "old"));
+  EXPECT_EQ(cache.expirations.load(), 1u);
+  cache.flushExpired(now);
+  EXPECT_EQ(cache.expirations.load(), 2u);
+  EXPECT_EQ(cache.entries.load(), 1u);
+  EXPECT_TRUE(cacheHas(cache, "fresh"));
+}
+
+TEST(SslSessionCacheTest, ResumesHandshakes) {
+  auto listener_config = std::make_shared<ListenerConfig>();
+  listener_config->ctx = std::make_shared<POUND_CTX>();
+  listener_config->ctx->ctx = ticketServerCtx();
+  ssl::SSLContext server_context;
+  ASSERT_TRUE(server_context.init(listener_config));
+  SSL_CTX_set_options(server_context.ssl_ctx.get(), SSL_OP_NO_TICKET);
+  ssl::SslSessionManager::attachCallbacks(server_context.ssl_ctx.get());
+  auto cache = ssl::SslSessionManager::getInstance();
+  auto entries = cache->entries.load();
+  auto hits = cache->hits.load();
+  SSL_SESSION *session = nullptr;
+  EXPECT_FALSE(ticketHandshake(server_context, session));
+  EXPECT_EQ(cache->entries.load(), entries + 1);
+  EXPECT_TRUE(ticketHandshake(server_context, session));
+  EXPECT_EQ(cache->hits.load(), hits + 1);
+  SSL_SESSION_free(session);
+}
@@ -0,0 +1,180 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/ssl/ssl_connection_manager.h"
+#include "../../src/ssl/ssl_context.h"
+#include "../../src/ssl/ssl_ticket_keys.h"
+#include "gtest/gtest.h"
+#include <iostream>
+#include <openssl/x509.h>
+#include <string>
+#include <sys/socket.h>
+
+/** Server context with a self signed EC certificate. */
+static std::shared_ptr<SSL_CTX> ticketServerCtx() {
+  std::shared_ptr<SSL_CTX> server_ctx(SSL_CTX_new(TLS_server_method()),
+                                      &::SSL_CTX_free);
+  EVP_PKEY *key = EVP_EC_gen("P-256");
+  X509 *cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char *>("zproxy"),
+                             -1, -1, 0);
+  X509_set_issuer_name(cert, X509_get_subject_name(cert));
+  X509_sign(cert, key, EVP_sha256());
+  SSL_CTX_use_certificate(server_ctx.get(), cert);
+  SSL_CTX_use_PrivateKey(server_ctx.get(), key);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return server_ctx;
+}
+
+/** Listener context resuming sessions with tickets, as SSLSessionTickets 1. */
+static std::unique_ptr<ssl::SSLContext> ticketServerContext(int rotation) {
+  auto listener_config = std::make_shared<ListenerConfig>();
+  listener_config->ctx = std::make_shared<POUND_CTX>();
+  listener_config->ctx->ctx = ticketServerCtx();
+  listener_config->ssl_session_tickets = true;
+  listener_config->ticket_key_rotation = rotation;
+  auto ssl_context = std::make_unique<ssl::SSLContext>();
+  EXPECT_TRUE(ssl_context->init(listener_config));
+  EXPECT_NE(ssl_context->ticket_keys, nullptr);
+  return ssl_context;
+}
+
+/**
+ * Connects a new client to @p server_context offering @p session, and returns
+ * whether the session was resumed. @p session is replaced by the one the
+ * server issued.
+ */
+static bool ticketHandshake(const ssl::SSLContext &server_context,
+                            SSL_SESSION *&session,
+                            uint64_t *handshake_cpu = nullptr) {
+  std::shared_ptr<SSL_CTX> client_ctx(SSL_CTX_new(TLS_client_method()),
+                                      &::SSL_CTX_free);
+  // the TLSv1.2 tickets are sent in the handshake itself
+  SSL_CTX_set_max_proto_version(client_ctx.get(), TLS1_2_VERSION);
+  int fds[2];
+  ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+  Connection client, server;
+  client.setFileDescriptor(fds[0]);
+  server.setFileDescriptor(fds[1]);
+  if (!ssl::SSLConnectionManager::initSslConnection(client_ctx.get(), client,
+                                                    true))
+    return false;
+  if (session != nullptr) SSL_set_session(client.ssl, session);
+  for (int i = 0; i < 20 && !(server.ssl_connected && client.ssl_connected);
+       i++) {
+    if (!client.ssl_connected &&
+        !ssl::SSLConnectionManager::handleHandshake(client_ctx.get(), client,
+                                                    true))
+      return false;
+    if (!server.ssl_connected &&
+        !ssl::SSLConnectionManager::handleHandshake(server_context, server))
+      return false;
+  }
+  EXPECT_TRUE(server.ssl_connected && client.ssl_connected);
+  if (session != nullptr) SSL_SESSION_free(session);
+  session = SSL_get1_session(client.ssl);
+  if (handshake_cpu != nullptr) *handshake_cpu = server.handshake_cpu;
+  return SSL_session_reused(server.ssl) != 0;
+}
+
+TEST(TicketKeysTest, ResumesSessionsAcrossRotations) {
+  auto server_context = ticketServerContext(3600);
+  auto &ticket_keys = *server_context->ticket_keys;
+  SSL_SESSION *session = nullptr;
+  uint64_t full_cpu = 0;
+  EXPECT_FALSE(ticketHandshake(*server_context, session, &full_cpu));
+  EXPECT_TRUE(ticketHandshake(*server_context, session));
+  EXPECT_GT(full_cpu, 0u);
+
+  EXPECT_FALSE(ticket_keys.rotateIfDue(std::time(nullptr)));
+  EXPECT_TRUE(ticket_keys.rotateIfDue(std::time(nullptr) + 3600));
+  /* A ticket of the previous key is accepted, and renewed. */
+  EXPECT_TRUE(ticketHandshake(*server_context, session));
+  for (int i = 0; i < TICKET_KEYS_MAX; i++) ticket_keys.rotate();
+  EXPECT_FALSE(ticketHandshake(*server_context, session));
+  SSL_SESSION_free(session);
+}
+
+TEST(TicketKeysTest, SharesKeysBetweenNodes) {
+  auto node1 = ticketServerContext(3600);
+  auto node2 = ticketServerContext(0);
+  auto &node1_keys = *node1->ticket_keys;
+  auto &node2_keys = *node2->ticket_keys;
+  SSL_SESSION *session = nullptr;
+  EXPECT_FALSE(ticketHandshake(*node1, session));
+  EXPECT_FALSE(ticketHandshake(*node2, session));
+
+  node1_keys.rotate();
+  auto keys = node1_keys.exportKeys();
+  ASSERT_EQ(keys.size(), 2u);
+  EXPECT_EQ(keys[0].size(), sizeof(ssl::TicketKey) * 2);
+  EXPECT_FALSE(ticketHandshake(*node1, session));
+  ASSERT_TRUE(node2_keys.importKeys(keys));
+  EXPECT_EQ(node2_keys.exportKeys(), keys);
+  EXPECT_TRUE(ticketHandshake(*node2, session));
+  EXPECT_FALSE(node2_keys.rotateIfDue(std::time(nullptr) + 3600));
+  SSL_SESSION_free(session);
+}
+
+TEST(TicketKeysTest, RejectsMalformedKeys) {
+  ssl::TicketKeys ticket_keys(3600);
+  auto keys = ticket_keys.exportKeys();
+  auto bad_digit = keys[0];
+  bad_digit[7] = 'g';
+  for (auto &bad_keys : std::vector<std::vector<std::string>>{
+           {},
+           {keys[0].substr(2)},
+           {bad_digit},
+           {keys[0], keys[0], keys[0], keys[0]}}) {
+    EXPECT_FALSE(ticket_keys.importKeys(bad_keys));
+    EXPECT_EQ(ticket_keys.exportKeys(), keys);
+  }
+}
+
+/*
+ * Runs 100 full handshakes and 100 resumed with a ticket, and reports the
+ * server CPU time of each kind.
+ */
+TEST(TicketKeysTest, Benchmark) {
+  const int handshakes = 100;
+  auto server_context = ticketServerContext(3600);
+  uint64_t full_cpu = 0, resumed_cpu = 0;
+  for (int i = 0; i < handshakes; i++) {
+    SSL_SESSION *session = nullptr;
+    uint64_t cpu = 0;
+    EXPECT_FALSE(ticketHandshake(*server_context, session, &cpu));
+    full_cpu += cpu;
+    EXPECT_TRUE(ticketHandshake(*server_context, session, &cpu));
+    resumed_cpu += cpu;
+    SSL_SESSION_free(session);
+  }
+  std::cout << handshakes << " handshakes: server CPU "
+            << full_cpu / handshakes << " us full, "
+            << resumed_cpu / handshakes << " us resumed" << std::endl;
+}
@@ -0,0 +1,165 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../../src/event/timer_wheel.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace events;
+
+TEST(TimerWheelTest, ExpiresAfterDelay) {
+  TimerWheel wheel;
+  time_t now = 1000;
+  std::vector<int> expired;
+  auto cb = [&expired](int fd, TIMEOUT_TYPE) { expired.push_back(fd); };
+
+  wheel.add(3, TIMEOUT_TYPE::CLIENT_READ_TIMEOUT, now, 5);
+  wheel.add(4, TIMEOUT_TYPE::SERVER_READ_TIMEOUT, now, 100);
+  wheel.add(5, TIMEOUT_TYPE::SERVER_WRITE_TIMEOUT, now, 5000);
+  EXPECT_EQ(wheel.size(), 3u);
+
+  /* Same semantics as before: expires once the delay has fully elapsed. */
+  wheel.advance(now + 5, cb);
+  EXPECT_TRUE(expired.empty());
+  wheel.advance(now + 6, cb);
+  ASSERT_EQ(expired.size(), 1u);
+  EXPECT_EQ(expired[0], 3);
+
+  wheel.advance(now + 100, cb);
+  EXPECT_EQ(expired.size(), 1u);
+  wheel.advance(now + 101, cb);
+  ASSERT_EQ(expired.size(), 2u);
+  EXPECT_EQ(expired[1], 4);
+
+  /* Cascaded from the upper levels. */
+  wheel.advance(now + 5000, cb);
+  EXPECT_EQ(expired.size(), 2u);
+  wheel.advance(now + 5001, cb);
+  ASSERT_EQ(expired.size(), 3u);
+  EXPECT_EQ(expired[2], 5);
+  EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(TimerWheelTest, RearmAndCancel) {
+  TimerWheel wheel;
+  time_t now = 50;
+  int fired = 0;
+  TIMEOUT_TYPE fired_type = TIMEOUT_TYPE::INACTIVE_TIMEOUT;
+  auto cb = [&](int, TIMEOUT_TYPE type) {
+    fired++;
+    fired_type = type;
+  };
+
+  wheel.add(7, TIMEOUT_TYPE::CLIENT_READ_TIMEOUT, now, 10);
+  /* Re-arming moves the timer, it is not duplicated. */
+  wheel.add(7, TIMEOUT_TYPE::SERVER_READ_TIMEOUT, now + 5, 10);
+  EXPECT_EQ(wheel.size(), 1u);
+  wheel.advance(now + 11, cb);
+  EXPECT_EQ(fired, 0);
+  wheel.advance(now + 16, cb);
+  EXPECT_EQ(fired, 1);
+  EXPECT_EQ(fired_type, TIMEOUT_TYPE::SERVER_READ_TIMEOUT);
+  EXPECT_FALSE(wheel.isArmed(7));
+
+  wheel.add(8, TIMEOUT_TYPE::CLIENT_READ_TIMEOUT, now + 16, 1);
+  EXPECT_TRUE(wheel.isArmed(8));
+  wheel.remove(8);
+  wheel.remove(8);
+  wheel.remove(1000);
+  EXPECT_FALSE(wheel.isArmed(8));
+  wheel.advance(now + 100, cb);
+  EXPECT_EQ(fired, 1);
+  EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(TimerWheelTest, RearmFromCallback) {
+  TimerWheel wheel;
+  time_t now = 0;
+  int fired = 0;
+  wheel.add(1, TIMEOUT_TYPE::CLIENT_READ_TIMEOUT, now, 1);
+  wheel.add(2, TIMEOUT_TYPE::CLIENT_READ_TIMEOUT, now, 1);
+  wheel.advance(now + 2, [&](int fd, TIMEOUT_TYPE type) {
+    fired++;
+    /* Cancel the sibling and re-arm ourselves. */
+    wheel.remove(fd == 1 ? 2 : 1);
+    wheel.add(fd, type, now + 2, 3);
+  });
+  EXPECT_EQ(fired, 1);
+  EXPECT_EQ(wheel.size(), 1u);
+  wheel.advance(now + 6, [&](int, TIMEOUT_TYPE) { fired++; });
+  EXPECT_EQ(fired, 2);
+}
+
+TEST(TimerWheelTest, ManyTimersAllExpireOnTime) {
+  TimerWheel wheel;
+  time_t now = 123456;
+  const int count = 20000;
+  for (int fd = 0; fd < count; fd++)
+    wheel.add(fd, TIMEOUT_TYPE::CLIENT_READ_TIMEOUT, now, fd % 9000 + 1);
+  int late = 0;
+  int fired = 0;
+  for (time_t t = now; t <= now + 9001; t++) {
+    wheel.advance(t, [&](int fd, TIMEOUT_TYPE) {
+      fired++;
+      if (t != now + fd % 9000 + 2) late++;
+    });
+  }
+  EXPECT_EQ(fired, count);
+  EXPECT_EQ(late, 0);
+}
+
+/*
+ * Microbenchmark: per loop iteration cost with N idle armed connections.
+ * The previous implementation scanned every timeout on each loopOnce(), so
+ * its cost grew linearly with N; here it stays flat.
+ */
+TEST(TimerWheelTest, Benchmark) {
+  const int iterations = 200000;
+  double per_iteration[3];
+  int sizes[3] = {1000, 10000, 100000};
+  for (int i = 0; i < 3; i++) {
+    TimerWheel wheel;
+    time_t now = 1000;
+    for (int fd = 0; fd < sizes[i]; fd++)
+      wheel.add(fd, TIMEOUT_TYPE::CLIENT_READ_TIMEOUT, now, 3600);
+    int fired = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++) {
+      /* Each iteration: one active fd re-arms its timeout and time moves
+       * forward once every 1000 iterations (about 4 loops/ms). */
+      int fd = it % sizes[i];
+      wheel.add(fd, TIMEOUT_TYPE::CLIENT_READ_TIMEOUT, now, 3600);
+      if (it % 1000 == 0) now++;
+      wheel.advance(now, [&fired](int, TIMEOUT_TYPE) { fired++; });
+    }
+    auto end = std::chrono::steady_clock::now();
+    EXPECT_EQ(fired, 0);
+    per_iteration[i] =
+        std::chrono::duration<double, std::nano>(end - start).count() /
+        iterations;
+    std::cout << "TimerWheel " << sizes[i] << " timers: " << per_iteration[i]
+              << " ns/iteration" << std::endl;
+  }
+}